@@ -123,7 +123,7 @@ else ()
 endif ()
 
 if (WIN32)
-    set(URHO3D_RENDERER D3D11 CACHE STRING "Select renderer: D3D9 | D3D11 | OpenGL")
+    set(URHO3D_RENDERER D3D11 CACHE STRING "Select renderer: D3D9 | D3D11 | OpenGL | Null")
     if (MSVC)
         option(URHO3D_MINIDUMPS "Enable writing minidumps on crash" ${URHO3D_ENABLE_ALL})
     endif ()
@@ -134,7 +134,7 @@ if (WIN32)
         endif ()
     endif ()
 else ()
-    set(URHO3D_RENDERER OpenGL)
+    set(URHO3D_RENDERER OpenGL CACHE STRING "Select renderer: OpenGL | Null")
 endif ()
 
 string(TOUPPER "${URHO3D_RENDERER}" URHO3D_RENDERER)
@@ -144,6 +144,8 @@ elseif (URHO3D_RENDERER STREQUAL D3D9)
     set (URHO3D_D3D9 ON)
 elseif (URHO3D_RENDERER STREQUAL D3D11)
     set (URHO3D_D3D11 ON)
+elseif (URHO3D_RENDERER STREQUAL NULL)
+    set (URHO3D_NULL_GRAPHICS ON)
 endif ()
 
 if (EMSCRIPTEN)
@@ -175,6 +175,11 @@ float defaultTicksPerSecond_ = 4800.0f;
 float importStartTime_ = 0.0f;
 float importEndTime_ = 0.0f;
 bool suppressFbxPivotNodes_ = true;
+// Animation compression error bounds
+bool compressAnimations_ = false;
+float animPositionError_ = 0.001f;
+float animRotationError_ = 0.1f;
+float animScaleError_ = 0.001f;
 
 int main(int argc, char** argv);
 void Run(const Vector<String>& arguments);
@@ -306,6 +311,9 @@ void Run(const Vector<String>& arguments)
             "-split <start> <end> (animation model only)\n"
             "            Split animation, will only import from start frame to end frame\n"
             "-np         Do not suppress $fbx pivot nodes (FBX files only)\n"
+            "-ca [<pos> <rot> <scale>]\n"
+            "            Compress animations by quantizing and removing keyframes within\n"
+            "            the error bounds. Rotation error is in degrees. Default 0.001 0.1 0.001\n"
         );
     }
 
@@ -465,6 +473,13 @@ void Run(const Vector<String>& arguments)
                     importEndTime_ = ToFloat(value2);
                 }
             }
+            else if (argument == "ca")
+            {
+                compressAnimations_ = true;
+                float* errors[] = { &animPositionError_, &animRotationError_, &animScaleError_ };
+                for (unsigned j = 0; j < 3 && i + 1 < arguments.Size() && arguments[i + 1].Length() && arguments[i + 1][0] != '-'; ++j)
+                    *errors[j] = ToFloat(arguments[++i]);
+            }
         }
     }
 
@@ -1487,6 +1502,31 @@ void BuildAndSaveAnimations(OutModel* model)
             }
         }
 
+        if (compressAnimations_)
+        {
+            unsigned oldKeyFrames = 0;
+            unsigned oldSize = 0;
+            unsigned newKeyFrames = 0;
+            unsigned newSize = 0;
+            const HashMap<StringHash, AnimationTrack>& tracks = outAnim->GetTracks();
+            for (HashMap<StringHash, AnimationTrack>::ConstIterator k = tracks.Begin(); k != tracks.End(); ++k)
+            {
+                oldKeyFrames += k->second_.GetNumKeyFrames();
+                oldSize += k->second_.GetKeyFrameMemoryUse();
+            }
+
+            outAnim->Compress(animPositionError_, animRotationError_, animScaleError_);
+
+            for (HashMap<StringHash, AnimationTrack>::ConstIterator k = tracks.Begin(); k != tracks.End(); ++k)
+            {
+                newKeyFrames += k->second_.GetNumKeyFrames() + k->second_.GetNumCompressedKeys();
+                newSize += k->second_.GetKeyFrameMemoryUse();
+            }
+
+            PrintLine("Compressed animation " + animName + " keyframes " + String(oldKeyFrames) + " -> " + String(newKeyFrames) +
+                ", memory " + String(oldSize) + " -> " + String(newSize) + " bytes");
+        }
+
         File outFile(context_);
         if (!outFile.Open(animOutName, FILE_WRITE))
             ErrorExit("Could not open output file " + animOutName);
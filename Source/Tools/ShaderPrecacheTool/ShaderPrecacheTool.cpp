@@ -0,0 +1,258 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/RenderPath.h>
+#include <Urho3D/Graphics/Renderer.h>
+#include <Urho3D/Graphics/Shader.h>
+#include <Urho3D/Graphics/ShaderPrecache.h>
+#include <Urho3D/Graphics/Technique.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <Urho3D/DebugNew.h>
+
+using namespace Urho3D;
+
+/// Scene pass used by a render path, with the extra defines of its command.
+struct PassInfo
+{
+    /// Pass name.
+    String name_;
+    /// Extra vertex shader defines.
+    String vsDefines_;
+    /// Extra pixel shader defines.
+    String psDefines_;
+};
+
+SharedPtr<Context> context_(new Context());
+bool quiet_ = false;
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+void AddPass(Vector<PassInfo>& passes, const String& name, const String& vsDefines = String::EMPTY, const String& psDefines = String::EMPTY);
+void CollectPasses(RenderPath* renderPath, Vector<PassInfo>& passes);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    if (arguments.Size() < 3)
+        ErrorExit(
+            "Usage: ShaderPrecacheTool <output file> <renderpath> <technique> [technique ...] [options]\n"
+            "\n"
+            "Options:\n"
+            "-p <dirs>     Resource directories separated by ';', default CoreData;Data\n"
+            "-s <quality>  Shadow quality 0-5, see the SHADOWQUALITY enum, default 2 (PCF 16bit)\n"
+            "-q            Enable quiet mode\n"
+            "\n"
+            "Enumerates every vertex and pixel shader combination that the techniques can be\n"
+            "rendered with by the render path, and writes them to a shader precache file that\n"
+            "can be loaded with Graphics::PrecacheShaders(). The render path and techniques are\n"
+            "resource names, for example RenderPaths/Forward.xml Techniques/Diff.xml\n"
+        );
+
+    const String& outputName = arguments[0];
+    const String& renderPathName = arguments[1];
+    Vector<String> techniqueNames;
+    String resourceDirs = "CoreData;Data";
+    int shadowQuality = SHADOWQUALITY_PCF_16BIT;
+
+    for (unsigned i = 2; i < arguments.Size(); ++i)
+    {
+        if (arguments[i].Length() > 1 && arguments[i][0] == '-')
+        {
+            switch (arguments[i][1])
+            {
+            case 'p':
+                if (i + 1 < arguments.Size())
+                    resourceDirs = arguments[++i];
+                break;
+
+            case 's':
+                if (i + 1 < arguments.Size())
+                    shadowQuality = ToInt(arguments[++i]);
+                break;
+
+            case 'q':
+                quiet_ = true;
+                break;
+
+            default:
+                ErrorExit("Unrecognized option " + arguments[i]);
+            }
+        }
+        else
+            techniqueNames.Push(arguments[i]);
+    }
+
+    if (techniqueNames.Empty())
+        ErrorExit("No techniques specified");
+    if (shadowQuality < SHADOWQUALITY_SIMPLE_16BIT || shadowQuality > SHADOWQUALITY_BLUR_VSM)
+        ErrorExit("Shadow quality must be between 0 and 5");
+
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new Log(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    RegisterResourceLibrary(context_);
+    RegisterGraphicsLibrary(context_);
+
+    if (quiet_)
+        context_->GetSubsystem<Log>()->SetQuiet(true);
+
+    auto* cache = context_->GetSubsystem<ResourceCache>();
+    Vector<String> dirs = resourceDirs.Split(';');
+    for (unsigned i = 0; i < dirs.Size(); ++i)
+    {
+        if (!cache->AddResourceDir(dirs[i]))
+            ErrorExit("Could not add resource directory " + dirs[i]);
+    }
+
+    // The renderer is not initialized without a graphics subsystem, but can still enumerate shader permutations
+    auto* renderer = new Renderer(context_);
+    context_->RegisterSubsystem(renderer);
+    renderer->SetShadowQuality((ShadowQuality)shadowQuality);
+
+    SharedPtr<RenderPath> renderPath(new RenderPath());
+    if (!renderPath->Load(cache->GetResource<XMLFile>(renderPathName)))
+        ErrorExit("Could not load render path " + renderPathName);
+
+    Vector<PassInfo> passes;
+    CollectPasses(renderPath, passes);
+
+    unsigned numCombinations = 0;
+    {
+        // The precache file is written when the collector is destroyed
+        SharedPtr<ShaderPrecache> precache(new ShaderPrecache(context_, outputName));
+        PODVector<Pair<ShaderDefineMask, ShaderDefineMask> > combinations;
+
+        for (unsigned i = 0; i < techniqueNames.Size(); ++i)
+        {
+            auto* technique = cache->GetResource<Technique>(techniqueNames[i]);
+            if (!technique)
+                ErrorExit("Could not load technique " + techniqueNames[i]);
+
+            for (unsigned j = 0; j < passes.Size(); ++j)
+            {
+                Pass* pass = technique->GetPass(passes[j].name_);
+                if (!pass)
+                    continue;
+
+                if (!renderer->GetPassShaderCombinations(pass, passes[j].vsDefines_, passes[j].psDefines_, combinations))
+                {
+                    PrintLine("Skipping pass " + passes[j].name_ + " of " + techniqueNames[i] + ": too many shader defines", true);
+                    continue;
+                }
+
+                for (unsigned k = 0; k < combinations.Size(); ++k)
+                {
+                    precache->StoreShaders(pass->GetVertexShader(), Shader::GetDefines(combinations[k].first_),
+                        pass->GetPixelShader(), Shader::GetDefines(combinations[k].second_));
+                }
+                numCombinations += combinations.Size();
+
+                if (!quiet_)
+                    PrintLine(techniqueNames[i] + " pass " + passes[j].name_ + ": " + String(combinations.Size()) + " combinations");
+            }
+        }
+    }
+
+    if (!quiet_)
+        PrintLine("Wrote " + String(numCombinations) + " shader combinations to " + outputName);
+}
+
+void AddPass(Vector<PassInfo>& passes, const String& name, const String& vsDefines, const String& psDefines)
+{
+    for (unsigned i = 0; i < passes.Size(); ++i)
+    {
+        if (passes[i].name_ == name && passes[i].vsDefines_ == vsDefines && passes[i].psDefines_ == psDefines)
+            return;
+    }
+
+    PassInfo info;
+    info.name_ = name;
+    info.vsDefines_ = vsDefines;
+    info.psDefines_ = psDefines;
+    passes.Push(info);
+}
+
+void CollectPasses(RenderPath* renderPath, Vector<PassInfo>& passes)
+{
+    // Mirror the pass selection of View: scene passes with their extra defines, forward light passes and the shadow pass
+    String litBasePass = "litbase";
+    String litAlphaPass = "litalpha";
+    String lightPass = "light";
+    bool hasForwardLights = false;
+
+    for (unsigned i = 0; i < renderPath->GetNumCommands(); ++i)
+    {
+        RenderPathCommand* command = renderPath->GetCommand(i);
+        if (!command->enabled_)
+            continue;
+
+        if (command->type_ == CMD_SCENEPASS)
+        {
+            AddPass(passes, command->pass_, command->vertexShaderDefines_, command->pixelShaderDefines_);
+
+            if (command->metadata_ == "base" && command->pass_ != "base")
+                litBasePass = "lit" + command->pass_;
+            else if (command->metadata_ == "alpha" && command->pass_ != "alpha")
+                litAlphaPass = "lit" + command->pass_;
+        }
+        else if (command->type_ == CMD_FORWARDLIGHTS)
+        {
+            hasForwardLights = true;
+            if (!command->pass_.Empty())
+                lightPass = command->pass_;
+        }
+    }
+
+    if (hasForwardLights)
+    {
+        AddPass(passes, lightPass);
+        AddPass(passes, litBasePass);
+        AddPass(passes, litAlphaPass);
+    }
+
+    AddPass(passes, "shadow");
+}
@@ -37,6 +37,7 @@
 #include "../Engine/EngineDefs.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/Renderer.h"
+#include "../Graphics/ShaderCache.h"
 #include "../Input/Input.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
@@ -198,6 +199,7 @@ bool Engine::Initialize(const VariantMap& parameters)
     {
         context_->RegisterSubsystem(new Graphics(context_));
         context_->RegisterSubsystem(new Renderer(context_));
+        context_->RegisterSubsystem(new ShaderCache(context_));
         context_->graphics_ = context_->GetSubsystem<Graphics>();
         context_->renderer_ = context_->GetSubsystem<Renderer>();
     }
@@ -286,6 +288,7 @@ bool Engine::Initialize(const VariantMap& parameters)
             return false;
 
         graphics->SetShaderCacheDir(GetParameter(parameters, EP_SHADER_CACHE_DIR, fileSystem->GetAppPreferencesDir("urho3d", "shadercache")).GetString());
+        GetSubsystem<ShaderCache>()->SetBackgroundCompile(GetParameter(parameters, EP_BACKGROUND_SHADER_COMPILE, false).GetBool());
 
         if (HasParameter(parameters, EP_DUMP_SHADERS))
             graphics->BeginDumpShaders(GetParameter(parameters, EP_DUMP_SHADERS, String::EMPTY).GetString());
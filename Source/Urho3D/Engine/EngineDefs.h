@@ -31,6 +31,7 @@ namespace Urho3D
 
 // Engine parameters
 static const String EP_AUTOLOAD_PATHS = "AutoloadPaths";
+static const String EP_BACKGROUND_SHADER_COMPILE = "BackgroundShaderCompile";
 static const String EP_BORDERLESS = "Borderless";
 static const String EP_DUMP_SHADERS = "DumpShaders";
 static const String EP_EVENT_PROFILER = "EventProfiler";
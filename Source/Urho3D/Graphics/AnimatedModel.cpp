@@ -42,6 +42,10 @@
 #include "../Resource/ResourceEvents.h"
 #include "../Scene/Scene.h"
 
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Urho3D
@@ -67,9 +71,58 @@ static bool CompareAnimationOrder(const SharedPtr<AnimationState>& lhs, const Sh
 
 static const unsigned MAX_ANIMATION_STATES = 256;
 
+static void ApplyMorphDeltas(unsigned char* destData, unsigned vertexSize, unsigned morphRangeStart, const unsigned* indices,
+    const float* deltas, unsigned count, float weight)
+{
+    const float* deltaX = deltas;
+    const float* deltaY = deltas + count;
+    const float* deltaZ = deltas + 2 * count;
+
+    unsigned i = 0;
+
+#ifdef URHO3D_SSE
+    // The vertex data is interleaved, so gather four vertices into a scratch block, add the weighted deltas as vectors and
+    // scatter the sums back. Each vertex occurs only once in the indices
+    __m128 scale = _mm_set1_ps(weight);
+    alignas(16) float block[12];
+    float* vertices[4];
+    for (; i + 4 <= count; i += 4)
+    {
+        for (unsigned j = 0; j < 4; ++j)
+        {
+            vertices[j] = (float*)(destData + (indices[i + j] - morphRangeStart) * vertexSize);
+            block[j] = vertices[j][0];
+            block[4 + j] = vertices[j][1];
+            block[8 + j] = vertices[j][2];
+        }
+
+        _mm_store_ps(&block[0], _mm_add_ps(_mm_load_ps(&block[0]), _mm_mul_ps(_mm_loadu_ps(deltaX + i), scale)));
+        _mm_store_ps(&block[4], _mm_add_ps(_mm_load_ps(&block[4]), _mm_mul_ps(_mm_loadu_ps(deltaY + i), scale)));
+        _mm_store_ps(&block[8], _mm_add_ps(_mm_load_ps(&block[8]), _mm_mul_ps(_mm_loadu_ps(deltaZ + i), scale)));
+
+        for (unsigned j = 0; j < 4; ++j)
+        {
+            vertices[j][0] = block[j];
+            vertices[j][1] = block[4 + j];
+            vertices[j][2] = block[8 + j];
+        }
+    }
+#endif
+
+    // Remaining vertices, or all of them without SSE
+    for (; i < count; ++i)
+    {
+        auto* dest = (float*)(destData + (indices[i] - morphRangeStart) * vertexSize);
+        dest[0] += deltaX[i] * weight;
+        dest[1] += deltaY[i] * weight;
+        dest[2] += deltaZ[i] * weight;
+    }
+}
+
 AnimatedModel::AnimatedModel(Context* context) :
     StaticModel(context),
     animationLodFrameNumber_(0),
+    animationEvaluationFrameNumber_(M_MAX_UNSIGNED),
     morphElementMask_(0),
     animationLodBias_(1.0f),
     animationLodTimer_(-1.0f),
@@ -78,22 +131,41 @@ AnimatedModel::AnimatedModel(Context* context) :
     animationDirty_(false),
     animationOrderDirty_(false),
     morphsDirty_(false),
+    morphsBlended_(false),
     skinningDirty_(true),
     boneBoundingBoxDirty_(true),
     isMaster_(true),
     loading_(false),
     assignBonesPending_(false),
-    forceAnimationUpdate_(false)
+    forceAnimationUpdate_(false),
+    usePoseBuffer_(false),
+    poseInputDirty_(false),
+    poseApplyPending_(false),
+    animationLodInterpolation_(false)
 {
 }
 
 AnimatedModel::~AnimatedModel()
 {
-    // When being destroyed, remove the bone hierarchy if appropriate (last AnimatedModel in the node)
-    Bone* rootBone = skeleton_.GetRootBone();
-    if (rootBone && rootBone->node_)
+    // When being destroyed, remove the bone hierarchy if appropriate (last AnimatedModel in the node). In pose buffer mode
+    // check any of the requested bone nodes instead
+    Node* boneNode = nullptr;
+    if (usePoseBuffer_)
     {
-        Node* parent = rootBone->node_->GetParent();
+        const Vector<Bone>& bones = skeleton_.GetBones();
+        for (Vector<Bone>::ConstIterator i = bones.Begin(); i != bones.End() && !boneNode; ++i)
+            boneNode = i->node_;
+    }
+    else
+    {
+        Bone* rootBone = skeleton_.GetRootBone();
+        if (rootBone)
+            boneNode = rootBone->node_;
+    }
+
+    if (boneNode)
+    {
+        Node* parent = boneNode->GetParent();
         if (parent && !parent->GetComponent<AnimatedModel>())
             RemoveRootBone();
     }
@@ -115,6 +187,9 @@ void AnimatedModel::RegisterObject(Context* context)
     URHO3D_ACCESSOR_ATTRIBUTE("Shadow Distance", GetShadowDistance, SetShadowDistance, float, 0.0f, AM_DEFAULT);
     URHO3D_ACCESSOR_ATTRIBUTE("LOD Bias", GetLodBias, SetLodBias, float, 1.0f, AM_DEFAULT);
     URHO3D_ACCESSOR_ATTRIBUTE("Animation LOD Bias", GetAnimationLodBias, SetAnimationLodBias, float, 1.0f, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Animation LOD Interpolation", GetAnimationLodInterpolation, SetAnimationLodInterpolation, bool, false,
+        AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Use Pose Buffer", GetUsePoseBuffer, SetUsePoseBuffer, bool, false, AM_DEFAULT);
     URHO3D_COPY_BASE_ATTRIBUTES(Drawable);
     URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Bone Animation Enabled", GetBonesEnabledAttr, SetBonesEnabledAttr, VariantVector,
         Variant::emptyVariantVector, AM_FILE | AM_NOEDIT);
@@ -173,12 +248,25 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         return;
 
     const Vector<Bone>& bones = skeleton_.GetBones();
+    AnimatedModel* poseSource = GetPoseSource();
     Sphere boneSphere;
 
     for (unsigned i = 0; i < bones.Size(); ++i)
     {
         const Bone& bone = bones[i];
-        if (!bone.node_)
+        Matrix3x4 transform;
+
+        // In pose buffer mode, get the bone transform from the pose buffer
+        if (poseSource)
+        {
+            const Matrix3x4* poseTransform = GetPoseTransform(poseSource, i);
+            if (!poseTransform)
+                continue;
+            transform = node_->GetWorldTransform() * *poseTransform;
+        }
+        else if (bone.node_)
+            transform = bone.node_->GetWorldTransform();
+        else
             continue;
 
         float distance;
@@ -188,7 +276,6 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         {
             // Do an initial crude test using the bone's AABB
             const BoundingBox& box = bone.boundingBox_;
-            const Matrix3x4& transform = bone.node_->GetWorldTransform();
             distance = query.ray_.HitDistance(box.Transformed(transform));
             if (distance >= query.maxDistance_)
                 continue;
@@ -204,7 +291,7 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         }
         else if (bone.collisionMask_ & BONECOLLISION_SPHERE)
         {
-            boneSphere.center_ = bone.node_->GetWorldPosition();
+            boneSphere.center_ = transform.Translation();
             boneSphere.radius_ = bone.radius_;
             distance = query.ray_.HitDistance(boneSphere);
             if (distance >= query.maxDistance_)
@@ -227,31 +314,21 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
 
 void AnimatedModel::Update(const RenderFrameInfo& frame)
 {
-    // If node was invisible last frame, need to decide animation LOD distance here
-    // If headless, retain the current animation distance (should be 0)
-    if (frame.camera_ && abs((int)frame.frameNumber_ - (int)viewFrameNumber_) > 1)
+    // If the pose buffer was evaluated in the octree's animation phase, only the bone nodes and bounding box remain to update
+    if (poseApplyPending_)
     {
-        // First check for no update at all when invisible. In that case reset LOD timer to ensure update
-        // next time the model is in view
-        if (!updateInvisible_)
-        {
-            if (animationDirty_)
-            {
-                animationLodTimer_ = -1.0f;
-                forceAnimationUpdate_ = true;
-            }
-            return;
-        }
-        float distance = frame.camera_->GetDistance(node_->GetWorldPosition());
-        // If distance is greater than draw distance, no need to update at all
-        if (drawDistance_ > 0.0f && distance > drawDistance_)
-            return;
-        float scale = GetWorldBoundingBox().Size().DotProduct(DOT_SCALE);
-        animationLodDistance_ = frame.camera_->GetLodDistance(distance, scale, lodBias_);
+        ApplyPose();
+        return;
     }
 
-    if (animationDirty_ || animationOrderDirty_)
+    if (!UpdateAnimationLodDistance(frame))
+        return;
+
+    // If the animation phase already ran for this model but the animation LOD skipped it, do not advance the LOD timer again
+    if ((animationDirty_ || animationOrderDirty_) && animationEvaluationFrameNumber_ != frame.frameNumber_)
         UpdateAnimation(frame);
+    else if (poseInputDirty_)
+        ApplyPoseInputs();
     else if (boneBoundingBoxDirty_)
         UpdateBoneBoundingBox();
 }
@@ -303,6 +380,12 @@ void AnimatedModel::UpdateGeometry(const RenderFrameInfo& frame)
         forceAnimationUpdate_ = false;
     }
 
+    // Late update in case bone nodes driving the pose buffer were changed after the animation update, for example by
+    // inverse kinematics
+    AnimatedModel* poseSource = GetPoseSource();
+    if (poseSource && poseSource->poseInputDirty_)
+        poseSource->ApplyPoseInputs();
+
     if (morphsDirty_)
         UpdateMorphs();
 
@@ -310,9 +393,74 @@ void AnimatedModel::UpdateGeometry(const RenderFrameInfo& frame)
         UpdateSkinning();
 }
 
+bool AnimatedModel::HasPendingAnimation() const
+{
+    return (usePoseBuffer_ && isMaster_ && (animationDirty_ || animationOrderDirty_)) ||
+        (morphsDirty_ && !morphsBlended_ && !morphVertexBuffers_.Empty());
+}
+
+AnimationEvaluation AnimatedModel::EvaluateAnimation(const RenderFrameInfo& frame)
+{
+    // Blend the morphs of models that were in view last frame, leaving only the upload to the main thread. Invisible models
+    // blend on demand if they come into view
+    if (morphsDirty_ && !morphsBlended_ && !morphVertexBuffers_.Empty() && abs((int)frame.frameNumber_ - (int)viewFrameNumber_) <= 1)
+        BlendMorphs();
+
+    if (!usePoseBuffer_ || !isMaster_ || (!animationDirty_ && !animationOrderDirty_))
+        return ANIMATION_NOT_EVALUATED;
+
+    animationEvaluationFrameNumber_ = frame.frameNumber_;
+
+    if (!UpdateAnimationLodDistance(frame))
+        return ANIMATION_SKIPPED;
+
+    // Interpolate only when animation LOD actually skips frames, as otherwise the pose would lag behind for no benefit
+    bool interpolate = animationLodInterpolation_ && animationLodBias_ > 0.0f && animationLodDistance_ > 0.0f &&
+        animationLodBias_ * frame.timeStep_ * ANIMATION_LOD_BASESCALE < animationLodDistance_;
+    AnimationEvaluation result;
+
+    if (UpdateAnimationLodTimer(frame))
+    {
+        if (animationOrderDirty_)
+        {
+            Sort(animationStates_.Begin(), animationStates_.End(), CompareAnimationOrder);
+            animationOrderDirty_ = false;
+        }
+
+        EvaluatePose();
+        animationDirty_ = false;
+
+        // Move towards the new pose from the previously evaluated one until the next evaluation
+        if (interpolate)
+        {
+            lodStartPoses_.Swap(lodEndPoses_);
+            lodEndPoses_ = bonePoses_;
+            if (lodStartPoses_.Size() != lodEndPoses_.Size())
+                lodStartPoses_ = lodEndPoses_;
+            InterpolatePose(animationLodTimer_ / animationLodDistance_);
+        }
+        else
+            lodEndPoses_.Clear();
+
+        result = ANIMATION_EVALUATED;
+    }
+    else if (interpolate && lodStartPoses_.Size() == bonePoses_.Size() && lodEndPoses_.Size() == bonePoses_.Size())
+    {
+        InterpolatePose(animationLodTimer_ / animationLodDistance_);
+        result = ANIMATION_INTERPOLATED;
+    }
+    else
+        return ANIMATION_SKIPPED;
+
+    CalculatePoseTransforms();
+    poseApplyPending_ = true;
+    return result;
+}
+
 UpdateGeometryType AnimatedModel::GetUpdateGeometryType()
 {
-    if (morphsDirty_ || forceAnimationUpdate_)
+    AnimatedModel* poseSource = GetPoseSource();
+    if (morphsDirty_ || forceAnimationUpdate_ || (poseSource && poseSource->poseInputDirty_))
         return UPDATE_MAIN_THREAD;
     else if (skinningDirty_)
         return UPDATE_WORKER_THREAD;
@@ -325,7 +473,42 @@ void AnimatedModel::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
     if (debug && IsEnabledEffective())
     {
         debug->AddBoundingBox(GetWorldBoundingBox(), Color::GREEN, depthTest);
-        debug->AddSkeleton(skeleton_, Color(0.75f, 0.75f, 0.75f), depthTest);
+
+        AnimatedModel* poseSource = GetPoseSource();
+        if (!poseSource)
+        {
+            debug->AddSkeleton(skeleton_, Color(0.75f, 0.75f, 0.75f), depthTest);
+            return;
+        }
+
+        // In pose buffer mode, draw the skeleton from the pose buffer the same way as from bone nodes
+        const Vector<Bone>& bones = skeleton_.GetBones();
+        const Matrix3x4& worldTransform = node_->GetWorldTransform();
+        for (unsigned i = 0; i < bones.Size(); ++i)
+        {
+            // Skip if bone contains no skinned geometry
+            if (bones[i].radius_ < M_EPSILON && bones[i].boundingBox_.Size().LengthSquared() < M_EPSILON)
+                continue;
+
+            const Matrix3x4* poseTransform = GetPoseTransform(poseSource, i);
+            if (!poseTransform)
+                continue;
+
+            Vector3 start = worldTransform * poseTransform->Translation();
+            Vector3 end = start;
+
+            // If bone has a parent which also skins geometry, draw a line to it
+            unsigned j = bones[i].parentIndex_;
+            if (j != i && j < bones.Size() &&
+                (bones[j].radius_ >= M_EPSILON || bones[j].boundingBox_.Size().LengthSquared() >= M_EPSILON))
+            {
+                const Matrix3x4* parentTransform = GetPoseTransform(poseSource, j);
+                if (parentTransform)
+                    end = worldTransform * parentTransform->Translation();
+            }
+
+            debug->AddLine(start, end, Color(0.75f, 0.75f, 0.75f), depthTest);
+        }
     }
 }
 
@@ -370,6 +553,7 @@ void AnimatedModel::SetModel(Model* model, bool createBones)
         // Copy morphs. Note: morph vertex buffers will be created later on-demand
         morphVertexBuffers_.Clear();
         morphs_.Clear();
+        appliedMorphs_.Clear();
         const Vector<ModelMorph>& morphs = model->GetMorphs();
         morphs_.Reserve(morphs.Size());
         morphElementMask_ = 0;
@@ -432,6 +616,7 @@ void AnimatedModel::SetModel(Model* model, bool createBones)
         geometryBoneMappings_.Clear();
         morphVertexBuffers_.Clear();
         morphs_.Clear();
+        appliedMorphs_.Clear();
         morphElementMask_ = 0;
         SetBoundingBox(BoundingBox());
         SetSkeleton(Skeleton(), false);
@@ -542,12 +727,127 @@ void AnimatedModel::SetAnimationLodBias(float bias)
     MarkNetworkUpdate();
 }
 
+void AnimatedModel::SetAnimationLodInterpolation(bool enable)
+{
+    animationLodInterpolation_ = enable;
+    if (!enable)
+    {
+        lodStartPoses_.Clear();
+        lodEndPoses_.Clear();
+    }
+    MarkNetworkUpdate();
+}
+
 void AnimatedModel::SetUpdateInvisible(bool enable)
 {
     updateInvisible_ = enable;
     MarkNetworkUpdate();
 }
 
+void AnimatedModel::SetUsePoseBuffer(bool enable)
+{
+    if (enable == usePoseBuffer_)
+        return;
+
+    // Replace the bone nodes of the old mode, unless loading or waiting for the bone nodes to be assigned from the scene
+    bool replaceBones = isMaster_ && node_ && skeleton_.GetNumBones() && !loading_ && !assignBonesPending_;
+    if (replaceBones)
+    {
+        RemoveRootBone();
+        Vector<Bone>& bones = skeleton_.GetModifiableBones();
+        for (Vector<Bone>::Iterator i = bones.Begin(); i != bones.End(); ++i)
+            i->node_.Reset();
+    }
+
+    usePoseBuffer_ = enable;
+
+    if (usePoseBuffer_)
+        InitializePose();
+    else
+    {
+        bonePoses_.Clear();
+        poseTransforms_.Clear();
+        poseOrder_.Clear();
+        lodStartPoses_.Clear();
+        lodEndPoses_.Clear();
+        poseInputDirty_ = false;
+        poseApplyPending_ = false;
+    }
+
+    if (replaceBones)
+    {
+        if (!usePoseBuffer_)
+            CreateBoneHierarchy();
+
+        // Reassign the animation tracks to the bones of the new mode
+        for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+        {
+            AnimationState* state = *i;
+            state->SetStartBone(state->GetStartBone());
+        }
+
+        // Non-master models refer to the bone nodes of the master model, so reassign them as well
+        PODVector<AnimatedModel*> models;
+        GetComponents<AnimatedModel>(models);
+        for (PODVector<AnimatedModel*>::Iterator i = models.Begin(); i != models.End(); ++i)
+        {
+            if (*i != this)
+                (*i)->AssignBoneNodes();
+        }
+
+        MarkAnimationDirty();
+    }
+
+    MarkNetworkUpdate();
+}
+
+Node* AnimatedModel::CreateBoneNode(const String& boneName)
+{
+    if (!isMaster_)
+    {
+        URHO3D_LOGERROR("Can not create bone node for non-master model");
+        return nullptr;
+    }
+
+    Bone* bone = skeleton_.GetBone(boneName);
+    if (!bone)
+        return nullptr;
+
+    // Without the pose buffer, all bones already have scene nodes
+    if (bone->node_ || !usePoseBuffer_ || !node_)
+        return bone->node_;
+
+    // Create as local like the bone hierarchy. As a direct child of the model's node, the node's transform is the bone's
+    // model-space transform
+    Node* boneNode = node_->CreateChild(boneName, LOCAL);
+    unsigned index = skeleton_.GetBoneIndex(bone);
+    if (index < poseTransforms_.Size())
+    {
+        Vector3 position;
+        Quaternion rotation;
+        Vector3 scale;
+        poseTransforms_[index].Decompose(position, rotation, scale);
+        boneNode->SetTransform(position, rotation, scale);
+    }
+    boneNode->SetTemporary(IsTemporary());
+    boneNode->AddListener(this);
+    bone->node_ = boneNode;
+
+    return boneNode;
+}
+
+void AnimatedModel::RemoveBoneNode(const String& boneName)
+{
+    // Without the pose buffer, the bone nodes are only removed along with the whole hierarchy
+    Bone* bone = skeleton_.GetBone(boneName);
+    if (!bone || !bone->node_ || !usePoseBuffer_ || !isMaster_)
+        return;
+
+    bone->node_->RemoveListener(this);
+    bone->node_->Remove();
+    bone->node_.Reset();
+}
+
 
 void AnimatedModel::SetMorphWeight(unsigned index, float weight)
 {
@@ -710,8 +1010,8 @@ void AnimatedModel::SetSkeleton(const Skeleton& skeleton, bool createBones)
 
             for (unsigned i = 0; i < destBones.Size(); ++i)
             {
-                if (destBones[i].node_ && destBones[i].name_ == srcBones[i].name_ && destBones[i].parentIndex_ ==
-                                                                                     srcBones[i].parentIndex_)
+                if ((destBones[i].node_ || usePoseBuffer_) && destBones[i].name_ == srcBones[i].name_ &&
+                    destBones[i].parentIndex_ == srcBones[i].parentIndex_)
                 {
                     // If compatible, just copy the values and retain the old node and animated status
                     Node* boneNode = destBones[i].node_;
@@ -741,28 +1041,11 @@ void AnimatedModel::SetSkeleton(const Skeleton& skeleton, bool createBones)
         // Merge bounding boxes from non-master models
         FinalizeBoneBoundingBoxes();
 
-        Vector<Bone>& bones = skeleton_.GetModifiableBones();
-        // Create scene nodes for the bones
-        if (createBones)
-        {
-            for (Vector<Bone>::Iterator i = bones.Begin(); i != bones.End(); ++i)
-            {
-                // Create bones as local, as they are never to be directly synchronized over the network
-                Node* boneNode = node_->CreateChild(i->name_, LOCAL);
-                boneNode->AddListener(this);
-                boneNode->SetTransform(i->initialPosition_, i->initialRotation_, i->initialScale_);
-                // Copy the model component's temporary status
-                boneNode->SetTemporary(IsTemporary());
-                i->node_ = boneNode;
-            }
-
-            for (unsigned i = 0; i < bones.Size(); ++i)
-            {
-                unsigned parentIndex = bones[i].parentIndex_;
-                if (parentIndex != i && parentIndex < bones.Size())
-                    bones[parentIndex].node_->AddChild(bones[i].node_);
-            }
-        }
+        // Create scene nodes for the bones. In pose buffer mode, bone nodes are only created on request
+        if (usePoseBuffer_)
+            InitializePose();
+        else if (createBones)
+            CreateBoneHierarchy();
 
         using namespace BoneHierarchyCreated;
 
@@ -909,26 +1192,39 @@ void AnimatedModel::UpdateBoneBoundingBox()
     {
         // The bone bounding box is in local space, so need the node's inverse transform
         boneBoundingBox_.Clear();
-        Matrix3x4 inverseNodeTransform = node_->GetWorldTransform().Inverse();
+        AnimatedModel* poseSource = GetPoseSource();
+        Matrix3x4 inverseNodeTransform = poseSource ? Matrix3x4::IDENTITY : node_->GetWorldTransform().Inverse();
 
         const Vector<Bone>& bones = skeleton_.GetBones();
-        for (Vector<Bone>::ConstIterator i = bones.Begin(); i != bones.End(); ++i)
+        for (unsigned i = 0; i < bones.Size(); ++i)
         {
-            Node* boneNode = i->node_;
-            if (!boneNode)
+            const Bone& bone = bones[i];
+            Matrix3x4 boneTransform;
+
+            // In pose buffer mode the bone transforms are already in model space
+            if (poseSource)
+            {
+                const Matrix3x4* poseTransform = GetPoseTransform(poseSource, i);
+                if (!poseTransform)
+                    continue;
+                boneTransform = *poseTransform;
+            }
+            else if (bone.node_)
+                boneTransform = inverseNodeTransform * bone.node_->GetWorldTransform();
+            else
                 continue;
 
             // Use hitbox if available. If not, use only half of the sphere radius
             /// \todo The sphere radius should be multiplied with bone scale
-            if (i->collisionMask_ & BONECOLLISION_BOX)
-                boneBoundingBox_.Merge(i->boundingBox_.Transformed(inverseNodeTransform * boneNode->GetWorldTransform()));
-            else if (i->collisionMask_ & BONECOLLISION_SPHERE)
-                boneBoundingBox_.Merge(Sphere(inverseNodeTransform * boneNode->GetWorldPosition(), i->radius_ * 0.5f));
+            if (bone.collisionMask_ & BONECOLLISION_BOX)
+                boneBoundingBox_.Merge(bone.boundingBox_.Transformed(boneTransform));
+            else if (bone.collisionMask_ & BONECOLLISION_SPHERE)
+                boneBoundingBox_.Merge(Sphere(boneTransform.Translation(), bone.radius_ * 0.5f));
         }
     }
 
     boneBoundingBoxDirty_ = false;
-    worldBoundingBoxDirty_ = true;
+    MarkWorldBoundingBoxDirty();
 }
 
 void AnimatedModel::OnNodeSet(Node* node)
@@ -950,9 +1246,15 @@ void AnimatedModel::OnMarkedDirty(Node* node)
     if (skeleton_.GetNumBones())
     {
         skinningDirty_ = true;
-        // Bone bounding box doesn't need to be marked dirty when only the base scene node moves
-        if (node != node_)
+        // Bone bounding box doesn't need to be marked dirty when only the base scene node moves. In pose buffer mode the
+        // bone nodes also move along with it, so check whether the node actually changes the pose
+        if (node != node_ && (!usePoseBuffer_ || !isMaster_))
+            boneBoundingBoxDirty_ = true;
+        else if (node != node_ && IsPoseInputChanged(node))
+        {
             boneBoundingBoxDirty_ = true;
+            poseInputDirty_ = true;
+        }
     }
 }
 
@@ -983,12 +1285,13 @@ void AnimatedModel::AssignBoneNodes()
     if (!node_)
         return;
 
-    // Find the bone nodes from the node hierarchy and add listeners
+    // Find the bone nodes from the node hierarchy and add listeners. In pose buffer mode the requested bone nodes are
+    // direct children
     Vector<Bone>& bones = skeleton_.GetModifiableBones();
     bool boneFound = false;
     for (Vector<Bone>::Iterator i = bones.Begin(); i != bones.End(); ++i)
     {
-        Node* boneNode = node_->GetChild(i->name_, true);
+        Node* boneNode = node_->GetChild(i->name_, !GetPoseSource());
         if (boneNode)
         {
             boneFound = true;
@@ -1037,6 +1340,8 @@ void AnimatedModel::FinalizeBoneBoundingBoxes()
             if ((*i) == this)
                 continue;
 
+            (*i)->SetMasterBoneIndices(skeleton_);
+
             Skeleton& otherSkeleton = (*i)->GetSkeleton();
             for (Vector<Bone>::Iterator j = bones.Begin(); j != bones.End(); ++j)
             {
@@ -1074,11 +1379,241 @@ void AnimatedModel::FinalizeBoneBoundingBoxes()
 
 void AnimatedModel::RemoveRootBone()
 {
+    // In pose buffer mode there is no hierarchy, so remove each requested bone node
+    if (usePoseBuffer_)
+    {
+        const Vector<Bone>& bones = skeleton_.GetBones();
+        for (Vector<Bone>::ConstIterator i = bones.Begin(); i != bones.End(); ++i)
+        {
+            if (i->node_)
+                i->node_->Remove();
+        }
+        return;
+    }
+
     Bone* rootBone = skeleton_.GetRootBone();
     if (rootBone && rootBone->node_)
         rootBone->node_->Remove();
 }
 
+void AnimatedModel::CreateBoneHierarchy()
+{
+    Vector<Bone>& bones = skeleton_.GetModifiableBones();
+    for (Vector<Bone>::Iterator i = bones.Begin(); i != bones.End(); ++i)
+    {
+        // Create bones as local, as they are never to be directly synchronized over the network
+        Node* boneNode = node_->CreateChild(i->name_, LOCAL);
+        boneNode->AddListener(this);
+        boneNode->SetTransform(i->initialPosition_, i->initialRotation_, i->initialScale_);
+        // Copy the model component's temporary status
+        boneNode->SetTemporary(IsTemporary());
+        i->node_ = boneNode;
+    }
+
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        unsigned parentIndex = bones[i].parentIndex_;
+        if (parentIndex != i && parentIndex < bones.Size())
+            bones[parentIndex].node_->AddChild(bones[i].node_);
+    }
+}
+
+void AnimatedModel::InitializePose()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBones = bones.Size();
+
+    bonePoses_.Resize(numBones);
+    poseTransforms_.Resize(numBones);
+    for (unsigned i = 0; i < numBones; ++i)
+    {
+        bonePoses_[i].position_ = bones[i].initialPosition_;
+        bonePoses_[i].rotation_ = bones[i].initialRotation_;
+        bonePoses_[i].scale_ = bones[i].initialScale_;
+    }
+
+    // Order the bones so that parents are evaluated before their children, as the skeleton does not guarantee it
+    PODVector<unsigned char> ordered;
+    ordered.Resize(numBones);
+    for (unsigned i = 0; i < numBones; ++i)
+        ordered[i] = 0;
+
+    poseOrder_.Clear();
+    poseOrder_.Reserve(numBones);
+    while (poseOrder_.Size() < numBones)
+    {
+        unsigned numOrdered = poseOrder_.Size();
+        for (unsigned i = 0; i < numBones; ++i)
+        {
+            unsigned parentIndex = bones[i].parentIndex_;
+            if (!ordered[i] && (parentIndex == i || parentIndex >= numBones || ordered[parentIndex]))
+            {
+                ordered[i] = 1;
+                poseOrder_.Push(i);
+            }
+        }
+
+        // If the parent indices form a cycle, evaluate the remaining bones in skeleton order
+        if (poseOrder_.Size() == numOrdered)
+        {
+            for (unsigned i = 0; i < numBones; ++i)
+            {
+                if (!ordered[i])
+                    poseOrder_.Push(i);
+            }
+        }
+    }
+
+    CalculatePoseTransforms();
+}
+
+void AnimatedModel::ResetPose()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    if (bonePoses_.Size() != bones.Size())
+    {
+        InitializePose();
+        return;
+    }
+
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        const Bone& bone = bones[i];
+        if (bone.animated_)
+        {
+            bonePoses_[i].position_ = bone.initialPosition_;
+            bonePoses_[i].rotation_ = bone.initialRotation_;
+            bonePoses_[i].scale_ = bone.initialScale_;
+        }
+    }
+}
+
+void AnimatedModel::EvaluatePose()
+{
+    ResetPose();
+    for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+        (*i)->Apply();
+}
+
+void AnimatedModel::InterpolatePose(float t)
+{
+    t = Clamp(t, 0.0f, 1.0f);
+    for (unsigned i = 0; i < bonePoses_.Size(); ++i)
+    {
+        const BonePose& start = lodStartPoses_[i];
+        const BonePose& end = lodEndPoses_[i];
+        BonePose& pose = bonePoses_[i];
+        pose.position_ = start.position_.Lerp(end.position_, t);
+        pose.rotation_ = start.rotation_.Nlerp(end.rotation_, t, true);
+        pose.scale_ = start.scale_.Lerp(end.scale_, t);
+    }
+}
+
+void AnimatedModel::CalculatePoseTransforms()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBones = bones.Size();
+    if (poseOrder_.Size() != numBones || poseTransforms_.Size() != numBones)
+        return;
+
+    for (PODVector<unsigned>::ConstIterator i = poseOrder_.Begin(); i != poseOrder_.End(); ++i)
+    {
+        unsigned index = *i;
+        const Bone& bone = bones[index];
+
+        // The node of a bone with animation disabled drives the pose, for example from physics or inverse kinematics
+        if (bone.node_ && !bone.animated_)
+        {
+            poseTransforms_[index] = bone.node_->GetTransform();
+            continue;
+        }
+
+        const BonePose& pose = bonePoses_[index];
+        unsigned parentIndex = bone.parentIndex_;
+        if (parentIndex != index && parentIndex < numBones)
+            poseTransforms_[index] = poseTransforms_[parentIndex] * Matrix3x4(pose.position_, pose.rotation_, pose.scale_);
+        else
+            poseTransforms_[index] = Matrix3x4(pose.position_, pose.rotation_, pose.scale_);
+    }
+
+    poseInputDirty_ = false;
+}
+
+void AnimatedModel::UpdatePoseBoneNodes()
+{
+    Vector<Bone>& bones = skeleton_.GetModifiableBones();
+    if (poseTransforms_.Size() != bones.Size())
+        return;
+
+    // The nodes of animated bones follow the pose. They are set silently and marked dirty along with the model's node
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        Bone& bone = bones[i];
+        if (bone.node_ && bone.animated_)
+        {
+            Vector3 position;
+            Quaternion rotation;
+            Vector3 scale;
+            poseTransforms_[i].Decompose(position, rotation, scale);
+            bone.node_->SetTransformSilent(position, rotation, scale);
+        }
+    }
+}
+
+void AnimatedModel::ApplyPose()
+{
+    UpdatePoseBoneNodes();
+
+    // Marking the model's node dirty also dirties the bone nodes and the skinning of all models in the node
+    node_->MarkDirty();
+    UpdateBoneBoundingBox();
+    poseApplyPending_ = false;
+}
+
+void AnimatedModel::ApplyPoseInputs()
+{
+    CalculatePoseTransforms();
+    ApplyPose();
+}
+
+bool AnimatedModel::IsPoseInputChanged(Node* node) const
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        if (bones[i].node_ == node)
+            return !bones[i].animated_ && i < poseTransforms_.Size() && !node->GetTransform().Equals(poseTransforms_[i]);
+    }
+
+    return false;
+}
+
+AnimatedModel* AnimatedModel::GetPoseSource() const
+{
+    if (isMaster_)
+        return usePoseBuffer_ ? const_cast<AnimatedModel*>(this) : nullptr;
+
+    // Non-master models skin from the master model's pose buffer
+    auto* master = node_ ? node_->GetComponent<AnimatedModel>() : nullptr;
+    return master && master != this && master->usePoseBuffer_ ? master : nullptr;
+}
+
+const Matrix3x4* AnimatedModel::GetPoseTransform(const AnimatedModel* poseSource, unsigned index) const
+{
+    if (poseSource != this)
+        index = index < masterBoneIndices_.Size() ? masterBoneIndices_[index] : M_MAX_UNSIGNED;
+
+    return index < poseSource->poseTransforms_.Size() ? &poseSource->poseTransforms_[index] : nullptr;
+}
+
+void AnimatedModel::SetMasterBoneIndices(const Skeleton& masterSkeleton)
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    masterBoneIndices_.Resize(bones.Size());
+    for (unsigned i = 0; i < bones.Size(); ++i)
+        masterBoneIndices_[i] = masterSkeleton.GetBoneIndex(bones[i].nameHash_);
+}
+
 void AnimatedModel::MarkAnimationDirty()
 {
     if (isMaster_)
@@ -1100,6 +1635,9 @@ void AnimatedModel::MarkAnimationOrderDirty()
 void AnimatedModel::MarkMorphsDirty()
 {
     morphsDirty_ = true;
+    morphsBlended_ = false;
+    // Queue for the octree update so that the morphs can be blended in the animation phase
+    MarkForUpdate();
 }
 
 void AnimatedModel::CloneGeometries()
@@ -1129,6 +1667,11 @@ void AnimatedModel::CloneGeometries()
             morphVertexBuffers_[i].Reset();
     }
 
+    // The clones start from the original vertices, so no morph needs to be restored on the first blend
+    appliedMorphs_.Resize(morphs_.Size());
+    for (unsigned i = 0; i < appliedMorphs_.Size(); ++i)
+        appliedMorphs_[i] = 0;
+
     // Geometries will always be cloned fully. They contain only references to buffer, so they are relatively light
     for (unsigned i = 0; i < geometries_.Size(); ++i)
     {
@@ -1253,6 +1796,40 @@ void AnimatedModel::SetGeometryBoneMappings()
 }
 
 void AnimatedModel::UpdateAnimation(const RenderFrameInfo& frame)
+{
+    if (UpdateAnimationLodTimer(frame))
+        ApplyAnimation();
+}
+
+bool AnimatedModel::UpdateAnimationLodDistance(const RenderFrameInfo& frame)
+{
+    // If node was invisible last frame, need to decide animation LOD distance here
+    // If headless, retain the current animation distance (should be 0)
+    if (frame.camera_ && abs((int)frame.frameNumber_ - (int)viewFrameNumber_) > 1)
+    {
+        // First check for no update at all when invisible. In that case reset LOD timer to ensure update
+        // next time the model is in view
+        if (!updateInvisible_)
+        {
+            if (animationDirty_)
+            {
+                animationLodTimer_ = -1.0f;
+                forceAnimationUpdate_ = true;
+            }
+            return false;
+        }
+        float distance = frame.camera_->GetDistance(node_->GetWorldPosition());
+        // If distance is greater than draw distance, no need to update at all
+        if (drawDistance_ > 0.0f && distance > drawDistance_)
+            return false;
+        float scale = GetWorldBoundingBox().Size().DotProduct(DOT_SCALE);
+        animationLodDistance_ = frame.camera_->GetLodDistance(distance, scale, lodBias_);
+    }
+
+    return true;
+}
+
+bool AnimatedModel::UpdateAnimationLodTimer(const RenderFrameInfo& frame)
 {
     // If using animation LOD, accumulate time and see if it is time to update
     if (animationLodBias_ > 0.0f && animationLodDistance_ > 0.0f)
@@ -1264,13 +1841,13 @@ void AnimatedModel::UpdateAnimation(const RenderFrameInfo& frame)
             if (animationLodTimer_ >= animationLodDistance_)
                 animationLodTimer_ = fmodf(animationLodTimer_, animationLodDistance_);
             else
-                return;
+                return false;
         }
         else
             animationLodTimer_ = 0.0f;
     }
 
-    ApplyAnimation();
+    return true;
 }
 
 void AnimatedModel::ApplyAnimation()
@@ -1286,15 +1863,25 @@ void AnimatedModel::ApplyAnimation()
     // (first AnimatedModel in a node)
     if (isMaster_)
     {
-        skeleton_.ResetSilent();
-        for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
-            (*i)->Apply();
+        // In pose buffer mode, animations are applied to the pose buffer and only the requested bone nodes are updated
+        if (usePoseBuffer_)
+        {
+            EvaluatePose();
+            CalculatePoseTransforms();
+            ApplyPose();
+        }
+        else
+        {
+            skeleton_.ResetSilent();
+            for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+                (*i)->Apply();
 
-        // Skeleton reset and animations apply the node transforms "silently" to avoid repeated marking dirty. Mark dirty now
-        node_->MarkDirty();
+            // Skeleton reset and animations apply the node transforms "silently" to avoid repeated marking dirty. Mark dirty now
+            node_->MarkDirty();
 
-        // Calculate new bone bounding box
-        UpdateBoneBoundingBox();
+            // Calculate new bone bounding box
+            UpdateBoneBoundingBox();
+        }
     }
 
     animationDirty_ = false;
@@ -1306,9 +1893,29 @@ void AnimatedModel::UpdateSkinning()
     const Vector<Bone>& bones = skeleton_.GetBones();
     // Use model's world transform in case a bone is missing
     const Matrix3x4& worldTransform = node_->GetWorldTransform();
+    // In pose buffer mode, use the model-space bone transforms instead of the bone nodes
+    AnimatedModel* poseSource = GetPoseSource();
+
+    if (poseSource)
+    {
+        for (unsigned i = 0; i < bones.Size(); ++i)
+        {
+            const Matrix3x4* poseTransform = GetPoseTransform(poseSource, i);
+            if (poseTransform)
+                skinMatrices_[i] = worldTransform * *poseTransform * bones[i].offsetMatrix_;
+            else
+                skinMatrices_[i] = worldTransform;
 
+            // Copy the skin matrix to per-geometry matrices as needed
+            if (geometrySkinMatrices_.Size())
+            {
+                for (unsigned j = 0; j < geometrySkinMatrixPtrs_[i].Size(); ++j)
+                    *geometrySkinMatrixPtrs_[i][j] = skinMatrices_[i];
+            }
+        }
+    }
     // Skinning with global matrices only
-    if (!geometrySkinMatrices_.Size())
+    else if (!geometrySkinMatrices_.Size())
     {
         for (unsigned i = 0; i < bones.Size(); ++i)
         {
@@ -1347,86 +1954,127 @@ void AnimatedModel::UpdateMorphs()
 
     if (morphs_.Size())
     {
-        // Reset the morph data range from all morphable vertex buffers, then apply morphs
+        if (!morphsBlended_)
+            BlendMorphs();
+
+        // Upload the morph data range of all morphable vertex buffers from their shadow data
         for (unsigned i = 0; i < morphVertexBuffers_.Size(); ++i)
         {
             VertexBuffer* buffer = morphVertexBuffers_[i];
-            if (buffer)
+            if (buffer && buffer->GetShadowData())
             {
-                VertexBuffer* originalBuffer = model_->GetVertexBuffers()[i];
                 unsigned morphStart = model_->GetMorphRangeStart(i);
                 unsigned morphCount = model_->GetMorphRangeCount(i);
+                buffer->SetDataRange(buffer->GetShadowData() + morphStart * buffer->GetVertexSize(), morphStart, morphCount);
+            }
+        }
+    }
 
-                void* dest = buffer->Lock(morphStart, morphCount);
-                if (dest)
-                {
-                    // Reset morph range by copying data from the original vertex buffer
-                    CopyMorphVertices(dest, originalBuffer->GetShadowData() + morphStart * originalBuffer->GetVertexSize(),
-                        morphCount, buffer, originalBuffer);
+    morphsDirty_ = false;
+    morphsBlended_ = false;
+}
 
-                    for (unsigned j = 0; j < morphs_.Size(); ++j)
-                    {
-                        if (morphs_[j].weight_ != 0.0f)
-                        {
-                            HashMap<unsigned, VertexBufferMorph>::Iterator k = morphs_[j].buffers_.Find(i);
-                            if (k != morphs_[j].buffers_.End())
-                                ApplyMorph(buffer, dest, morphStart, k->second_, morphs_[j].weight_);
-                        }
-                    }
+void AnimatedModel::BlendMorphs()
+{
+    for (unsigned i = 0; i < morphVertexBuffers_.Size(); ++i)
+    {
+        VertexBuffer* buffer = morphVertexBuffers_[i];
+        if (!buffer || !buffer->GetShadowData())
+            continue;
+
+        VertexBuffer* originalBuffer = model_->GetVertexBuffers()[i];
+        unsigned morphStart = model_->GetMorphRangeStart(i);
+        unsigned morphCount = model_->GetMorphRangeCount(i);
+        unsigned vertexSize = buffer->GetVertexSize();
+        unsigned originalVertexSize = originalBuffer->GetVertexSize();
+        unsigned char* dest = buffer->GetShadowData() + morphStart * vertexSize;
+        unsigned char* src = originalBuffer->GetShadowData() + morphStart * originalVertexSize;
+
+        // Reset the vertices moved by the previous blend by copying data from the original vertex buffer. If they cover
+        // the whole morph range, copying it in one go is cheaper
+        unsigned restoreCount = 0;
+        for (unsigned j = 0; j < morphs_.Size(); ++j)
+        {
+            if (appliedMorphs_[j])
+            {
+                HashMap<unsigned, VertexBufferMorph>::ConstIterator k = morphs_[j].buffers_.Find(i);
+                if (k != morphs_[j].buffers_.End())
+                    restoreCount += k->second_.deltaCount_;
+            }
+        }
+
+        if (restoreCount >= morphCount)
+            CopyMorphVertices(dest, src, morphCount, buffer, originalBuffer);
+        else if (restoreCount)
+        {
+            for (unsigned j = 0; j < morphs_.Size(); ++j)
+            {
+                if (!appliedMorphs_[j])
+                    continue;
+
+                HashMap<unsigned, VertexBufferMorph>::ConstIterator k = morphs_[j].buffers_.Find(i);
+                if (k == morphs_[j].buffers_.End())
+                    continue;
 
-                    buffer->Unlock();
+                const VertexBufferMorph& morph = k->second_;
+                for (unsigned l = 0; l < morph.deltaCount_; ++l)
+                {
+                    unsigned index = morph.deltaIndices_[l] - morphStart;
+                    CopyMorphVertices(dest + index * vertexSize, src + index * originalVertexSize, 1, buffer, originalBuffer);
                 }
             }
         }
+
+        for (unsigned j = 0; j < morphs_.Size(); ++j)
+        {
+            if (morphs_[j].weight_ != 0.0f)
+            {
+                HashMap<unsigned, VertexBufferMorph>::ConstIterator k = morphs_[j].buffers_.Find(i);
+                if (k != morphs_[j].buffers_.End())
+                    ApplyMorph(buffer, dest, morphStart, k->second_, morphs_[j].weight_);
+            }
+        }
     }
 
-    morphsDirty_ = false;
+    for (unsigned i = 0; i < morphs_.Size() && i < appliedMorphs_.Size(); ++i)
+        appliedMorphs_[i] = (unsigned char)(morphs_[i].weight_ != 0.0f);
+
+    morphsBlended_ = true;
 }
 
 void AnimatedModel::ApplyMorph(VertexBuffer* buffer, void* destVertexData, unsigned morphRangeStart, const VertexBufferMorph& morph,
     float weight)
 {
+    if (!morph.deltaCount_)
+        return;
+
     unsigned elementMask = morph.elementMask_ & buffer->GetElementMask();
-    unsigned vertexCount = morph.vertexCount_;
-    unsigned normalOffset = buffer->GetElementOffset(SEM_NORMAL);
-    unsigned tangentOffset = buffer->GetElementOffset(SEM_TANGENT);
+    unsigned count = morph.deltaCount_;
     unsigned vertexSize = buffer->GetVertexSize();
-
-    unsigned char* srcData = morph.morphData_;
+    const unsigned* indices = morph.deltaIndices_.Get();
+    const float* deltas = morph.deltas_.Get();
     auto* destData = (unsigned char*)destVertexData;
 
-    while (vertexCount--)
+    // The delta streams follow the morph's own element mask, so step over the elements the buffer does not have
+    if (morph.elementMask_ & MASK_POSITION)
     {
-        unsigned vertexIndex = *((unsigned*)srcData) - morphRangeStart;
-        srcData += sizeof(unsigned);
-
         if (elementMask & MASK_POSITION)
-        {
-            auto* dest = (float*)(destData + vertexIndex * vertexSize);
-            auto* src = (float*)srcData;
-            dest[0] += src[0] * weight;
-            dest[1] += src[1] * weight;
-            dest[2] += src[2] * weight;
-            srcData += 3 * sizeof(float);
-        }
+            ApplyMorphDeltas(destData + buffer->GetElementOffset(SEM_POSITION), vertexSize, morphRangeStart, indices, deltas, count,
+                weight);
+        deltas += 3 * count;
+    }
+    if (morph.elementMask_ & MASK_NORMAL)
+    {
         if (elementMask & MASK_NORMAL)
-        {
-            auto* dest = (float*)(destData + vertexIndex * vertexSize + normalOffset);
-            auto* src = (float*)srcData;
-            dest[0] += src[0] * weight;
-            dest[1] += src[1] * weight;
-            dest[2] += src[2] * weight;
-            srcData += 3 * sizeof(float);
-        }
+            ApplyMorphDeltas(destData + buffer->GetElementOffset(SEM_NORMAL), vertexSize, morphRangeStart, indices, deltas, count,
+                weight);
+        deltas += 3 * count;
+    }
+    if (morph.elementMask_ & MASK_TANGENT)
+    {
         if (elementMask & MASK_TANGENT)
-        {
-            auto* dest = (float*)(destData + vertexIndex * vertexSize + tangentOffset);
-            auto* src = (float*)srcData;
-            dest[0] += src[0] * weight;
-            dest[1] += src[1] * weight;
-            dest[2] += src[2] * weight;
-            srcData += 3 * sizeof(float);
-        }
+            ApplyMorphDeltas(destData + buffer->GetElementOffset(SEM_TANGENT), vertexSize, morphRangeStart, indices, deltas, count,
+                weight);
     }
 }
 
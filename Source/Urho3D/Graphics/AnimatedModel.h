@@ -55,10 +55,16 @@ public:
     bool LoadJSON(const JSONValue& source) override;
     /// Apply attribute changes that can not be applied immediately. Called after scene load or a network update.
     void ApplyAttributes() override;
+    /// Set whether attributes are being loaded from file data outside Load(). Bone nodes are then not created.
+    void SetLoading(bool enable) override { loading_ = enable; }
     /// Process octree raycast. May be called from a worker thread.
     void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results) override;
     /// Update before octree reinsertion. Is called from a worker thread.
     void Update(const RenderFrameInfo& frame) override;
+    /// Return whether the pose buffer should be evaluated in the octree's animation phase.
+    bool HasPendingAnimation() const override;
+    /// Evaluate animations into the pose buffer before the update. Is called from a worker thread.
+    AnimationEvaluation EvaluateAnimation(const RenderFrameInfo& frame) override;
     /// Calculate distance and prepare batches for rendering. May be called from worker thread(s), possibly re-entrantly.
     void UpdateBatches(const RenderFrameInfo& frame) override;
     /// Prepare geometry for rendering. Called from a worker thread if possible (no GPU update.)
@@ -86,8 +92,16 @@ public:
     void RemoveAllAnimationStates();
     /// Set animation LOD bias.
     void SetAnimationLodBias(float bias);
+    /// Set whether to interpolate the pose buffer between the evaluations skipped by animation LOD. The pose lags behind by one LOD interval.
+    void SetAnimationLodInterpolation(bool enable);
     /// Set whether to update animation and the bounding box when not visible. Recommended to enable for physically controlled models like ragdolls.
     void SetUpdateInvisible(bool enable);
+    /// Set whether to evaluate the skeleton into a pose buffer instead of a scene node per bone. In this mode only the bones requested with CreateBoneNode() have scene nodes.
+    void SetUsePoseBuffer(bool enable);
+    /// Create a scene node for a bone in pose buffer mode, or return the existing node. The node is a child of the model's node and follows the bone, or drives it if the bone's animation is disabled. Return null if the bone is not found.
+    Node* CreateBoneNode(const String& boneName);
+    /// Remove the scene node of a bone in pose buffer mode.
+    void RemoveBoneNode(const String& boneName);
     /// Set vertex morph weight by index.
     void SetMorphWeight(unsigned index, float weight);
     /// Set vertex morph weight by name.
@@ -120,9 +134,21 @@ public:
     /// Return animation LOD bias.
     float GetAnimationLodBias() const { return animationLodBias_; }
 
+    /// Return whether the pose buffer is interpolated between the evaluations skipped by animation LOD.
+    bool GetAnimationLodInterpolation() const { return animationLodInterpolation_; }
+
     /// Return whether to update animation when not visible.
     bool GetUpdateInvisible() const { return updateInvisible_; }
 
+    /// Return whether the skeleton is evaluated into a pose buffer.
+    bool GetUsePoseBuffer() const { return usePoseBuffer_; }
+
+    /// Return local bone transforms of the pose buffer.
+    const PODVector<BonePose>& GetBonePoses() const { return bonePoses_; }
+
+    /// Return model-space bone transforms of the pose buffer.
+    const PODVector<Matrix3x4>& GetPoseTransforms() const { return poseTransforms_; }
+
     /// Return all vertex morphs.
     const Vector<ModelMorph>& GetMorphs() const { return morphs_; }
 
@@ -181,8 +207,34 @@ private:
     void AssignBoneNodes();
     /// Finalize master model bone bounding boxes by merging from matching non-master bones.. Performed whenever any of the AnimatedModels in the same node changes its model.
     void FinalizeBoneBoundingBoxes();
-    /// Remove (old) skeleton root bone.
+    /// Remove (old) skeleton root bone, or the requested bone nodes in pose buffer mode.
     void RemoveRootBone();
+    /// Create scene nodes for the whole bone hierarchy.
+    void CreateBoneHierarchy();
+    /// Reset the pose buffer to the initial bone transforms and order the bones for evaluation.
+    void InitializePose();
+    /// Reset the animated bones of the pose buffer to the initial bone transforms.
+    void ResetPose();
+    /// Apply all animations to the pose buffer.
+    void EvaluatePose();
+    /// Blend the pose buffer between the last two evaluated poses.
+    void InterpolatePose(float t);
+    /// Calculate the model-space transforms of the pose buffer, reading the bone nodes that drive it.
+    void CalculatePoseTransforms();
+    /// Set the bone nodes that follow the pose buffer silently.
+    void UpdatePoseBoneNodes();
+    /// Mark the bone nodes and skinning dirty and update the bone bounding box after the pose buffer was evaluated.
+    void ApplyPose();
+    /// Recalculate the pose buffer after bone nodes that drive it have changed.
+    void ApplyPoseInputs();
+    /// Return whether a bone node change affects the pose buffer.
+    bool IsPoseInputChanged(Node* node) const;
+    /// Return the model whose pose buffer is used for skinning, or null if using bone nodes.
+    AnimatedModel* GetPoseSource() const;
+    /// Return a bone's model-space transform from a pose buffer, or null if not found.
+    const Matrix3x4* GetPoseTransform(const AnimatedModel* poseSource, unsigned index) const;
+    /// Map the bone indices to the master model's skeleton.
+    void SetMasterBoneIndices(const Skeleton& masterSkeleton);
     /// Mark animation and skinning to require an update.
     void MarkAnimationDirty();
     /// Mark animation and skinning to require a forced update (blending order changed.)
@@ -199,10 +251,16 @@ private:
     void CopyMorphVertices(void* destVertexData, void* srcVertexData, unsigned vertexCount, VertexBuffer* destBuffer, VertexBuffer* srcBuffer);
     /// Recalculate animations. Called from Update().
     void UpdateAnimation(const RenderFrameInfo& frame);
+    /// Decide the animation LOD distance if the model was not in view last frame. Return false if the animation should not be updated.
+    bool UpdateAnimationLodDistance(const RenderFrameInfo& frame);
+    /// Advance the animation LOD timer. Return true if it is time to apply the animations.
+    bool UpdateAnimationLodTimer(const RenderFrameInfo& frame);
     /// Recalculate skinning.
     void UpdateSkinning();
-    /// Reapply all vertex morphs.
+    /// Reapply all vertex morphs and upload the morphed vertices. Blends first unless already blended in the octree's animation phase.
     void UpdateMorphs();
+    /// Blend the vertex morphs into the shadow data of the morph vertex buffers without uploading. Only touches vertices that move in the previously or currently applied morphs.
+    void BlendMorphs();
     /// Apply a vertex morph.
     void ApplyMorph
         (VertexBuffer* buffer, void* destVertexData, unsigned morphRangeStart, const VertexBufferMorph& morph, float weight);
@@ -225,12 +283,28 @@ private:
     Vector<PODVector<Matrix3x4> > geometrySkinMatrices_;
     /// Subgeometry skinning matrix pointers, if more bones than skinning shader can manage.
     Vector<PODVector<Matrix3x4*> > geometrySkinMatrixPtrs_;
+    /// Local bone transforms in pose buffer mode.
+    PODVector<BonePose> bonePoses_;
+    /// Model-space bone transforms in pose buffer mode.
+    PODVector<Matrix3x4> poseTransforms_;
+    /// Bone evaluation order in pose buffer mode, parents before their children.
+    PODVector<unsigned> poseOrder_;
+    /// Bone indices in the master model's skeleton, used by non-master models to skin from the master's pose buffer.
+    PODVector<unsigned> masterBoneIndices_;
+    /// Per-morph flags of which morphs were applied in the last blend, so that only their vertices need to be restored.
+    PODVector<unsigned char> appliedMorphs_;
+    /// Second to last evaluated local bone transforms, interpolated from when using animation LOD interpolation.
+    PODVector<BonePose> lodStartPoses_;
+    /// Last evaluated local bone transforms, interpolated to when using animation LOD interpolation.
+    PODVector<BonePose> lodEndPoses_;
     /// Bounding box calculated from bones.
     BoundingBox boneBoundingBox_;
     /// Attribute buffer.
     mutable VectorBuffer attrBuffer_;
     /// The frame number animation LOD distance was last calculated on.
     unsigned animationLodFrameNumber_;
+    /// The frame number the pose buffer was last evaluated on in the octree's animation phase.
+    unsigned animationEvaluationFrameNumber_;
     /// Morph vertex element mask.
     unsigned morphElementMask_;
     /// Animation LOD bias.
@@ -247,6 +321,8 @@ private:
     bool animationOrderDirty_;
     /// Vertex morphs dirty flag.
     bool morphsDirty_;
+    /// Vertex morphs blended into the shadow data but not yet uploaded flag.
+    bool morphsBlended_;
     /// Skinning dirty flag.
     bool skinningDirty_;
     /// Bone bounding box dirty flag.
@@ -259,6 +335,14 @@ private:
     bool assignBonesPending_;
     /// Force animation update after becoming visible flag.
     bool forceAnimationUpdate_;
+    /// Pose buffer mode flag.
+    bool usePoseBuffer_;
+    /// Pose buffer needs update from bone nodes that drive it flag.
+    bool poseInputDirty_;
+    /// Pose buffer was evaluated in the animation phase and needs to be applied in the update flag.
+    bool poseApplyPending_;
+    /// Animation LOD interpolation flag.
+    bool animationLodInterpolation_;
 };
 
 }
@@ -30,6 +30,7 @@
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
 #include "../IO/Serializer.h"
+#include "../Math/BoundingBox.h"
 #include "../Resource/ResourceCache.h"
 #include "../Resource/XMLFile.h"
 #include "../Resource/JSONFile.h"
@@ -39,6 +40,10 @@
 namespace Urho3D
 {
 
+static const float MAX_QUANTIZED_VALUE = 65535.0f;
+static const float MAX_QUANTIZED_ROTATION = 32767.0f;
+static const float SQRT_TWO = 1.41421356f;
+
 inline bool CompareTriggers(AnimationTriggerPoint& lhs, AnimationTriggerPoint& rhs)
 {
     return lhs.time_ < rhs.time_;
@@ -49,6 +54,100 @@ inline bool CompareKeyFrames(AnimationKeyFrame& lhs, AnimationKeyFrame& rhs)
     return lhs.time_ < rhs.time_;
 }
 
+static unsigned short QuantizeValue(float value, float min, float step)
+{
+    return (unsigned short)(step > 0.0f ? Clamp(RoundToInt((value - min) / step), 0, (int)MAX_QUANTIZED_VALUE) : 0);
+}
+
+static void EncodeRotation(const Quaternion& rotation, unsigned short* dest)
+{
+    Quaternion normalized = rotation.Normalized();
+    float components[4] = { normalized.w_, normalized.x_, normalized.y_, normalized.z_ };
+
+    // Leave out the largest component, which is restored from the unit length. Flip the sign so that it is positive
+    unsigned largest = 0;
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (Abs(components[i]) > Abs(components[largest]))
+            largest = i;
+    }
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    // The remaining components are within +-1/sqrt(2)
+    unsigned j = 0;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i != largest)
+        {
+            float value = components[i] * sign * SQRT_TWO * 0.5f + 0.5f;
+            dest[j++] = (unsigned short)Clamp(RoundToInt(value * MAX_QUANTIZED_ROTATION), 0, (int)MAX_QUANTIZED_ROTATION);
+        }
+    }
+
+    // Store the index of the largest component in the high bits of the first two values
+    dest[0] |= (largest & 1u) << 15u;
+    dest[1] |= (largest >> 1u) << 15u;
+}
+
+static Quaternion DecodeRotation(const unsigned short* src)
+{
+    unsigned largest = (src[0] >> 15u) | ((src[1] >> 15u) << 1u);
+    float values[3];
+    float lengthSquared = 0.0f;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        values[i] = ((src[i] & 0x7fffu) * (2.0f / MAX_QUANTIZED_ROTATION) - 1.0f) / SQRT_TWO;
+        lengthSquared += values[i] * values[i];
+    }
+
+    float components[4];
+    unsigned j = 0;
+    for (unsigned i = 0; i < 4; ++i)
+        components[i] = i == largest ? sqrtf(Max(1.0f - lengthSquared, 0.0f)) : values[j++];
+
+    return Quaternion(components[0], components[1], components[2], components[3]);
+}
+
+static bool IsKeyFrameReproduced(const AnimationKeyFrame& start, const AnimationKeyFrame& end, const AnimationKeyFrame& keyFrame,
+    unsigned char channelMask, float positionError, float rotationError, float scaleError)
+{
+    float timeInterval = end.time_ - start.time_;
+    float t = timeInterval > 0.0f ? (keyFrame.time_ - start.time_) / timeInterval : 1.0f;
+
+    if ((channelMask & CHANNEL_POSITION) && (start.position_.Lerp(end.position_, t) - keyFrame.position_).Length() > positionError)
+        return false;
+    if ((channelMask & CHANNEL_ROTATION) &&
+        2.0f * Acos(Abs(start.rotation_.Slerp(end.rotation_, t).DotProduct(keyFrame.rotation_.Normalized()))) > rotationError)
+        return false;
+    if ((channelMask & CHANNEL_SCALE) && (start.scale_.Lerp(end.scale_, t) - keyFrame.scale_).Length() > scaleError)
+        return false;
+
+    return true;
+}
+
+void AnimationCompressedKeys::GetKey(unsigned index, unsigned char channelMask, Vector3& position, Quaternion& rotation,
+    Vector3& scale) const
+{
+    const unsigned short* src = values_.Buffer() + index * stride_;
+
+    if (channelMask & CHANNEL_POSITION)
+    {
+        position = Vector3(positionMin_.x_ + src[0] * positionStep_.x_, positionMin_.y_ + src[1] * positionStep_.y_,
+            positionMin_.z_ + src[2] * positionStep_.z_);
+        src += 3;
+    }
+    if (channelMask & CHANNEL_ROTATION)
+    {
+        rotation = DecodeRotation(src);
+        src += 3;
+    }
+    if (channelMask & CHANNEL_SCALE)
+    {
+        scale = Vector3(scaleMin_.x_ + src[0] * scaleStep_.x_, scaleMin_.y_ + src[1] * scaleStep_.y_,
+            scaleMin_.z_ + src[2] * scaleStep_.z_);
+    }
+}
+
 void AnimationTrack::SetKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame)
 {
     if (index < keyFrames_.Size())
@@ -62,6 +161,7 @@ void AnimationTrack::SetKeyFrame(unsigned index, const AnimationKeyFrame& keyFra
 
 void AnimationTrack::AddKeyFrame(const AnimationKeyFrame& keyFrame)
 {
+    compressedKeys_ = AnimationCompressedKeys();
     bool needSort = keyFrames_.Size() ? keyFrames_.Back().time_ > keyFrame.time_ : false;
     keyFrames_.Push(keyFrame);
     if (needSort)
@@ -70,6 +170,7 @@ void AnimationTrack::AddKeyFrame(const AnimationKeyFrame& keyFrame)
 
 void AnimationTrack::InsertKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame)
 {
+    compressedKeys_ = AnimationCompressedKeys();
     keyFrames_.Insert(index, keyFrame);
     Urho3D::Sort(keyFrames_.Begin(), keyFrames_.End(), CompareKeyFrames);
 }
@@ -82,6 +183,98 @@ void AnimationTrack::RemoveKeyFrame(unsigned index)
 void AnimationTrack::RemoveAllKeyFrames()
 {
     keyFrames_.Clear();
+    compressedKeys_ = AnimationCompressedKeys();
+}
+
+void AnimationTrack::Compress(float positionError, float rotationError, float scaleError)
+{
+    if (keyFrames_.Empty())
+        return;
+
+    // Keep the first and last keyframes, and those that interpolating between the kept neighbours does not reproduce
+    PODVector<unsigned> keptFrames;
+    unsigned numFrames = keyFrames_.Size();
+    keptFrames.Push(0);
+    for (unsigned i = 1; i + 1 < numFrames; ++i)
+    {
+        const AnimationKeyFrame& start = keyFrames_[keptFrames.Back()];
+        const AnimationKeyFrame& end = keyFrames_[i + 1];
+        for (unsigned j = keptFrames.Back() + 1; j <= i; ++j)
+        {
+            if (!IsKeyFrameReproduced(start, end, keyFrames_[j], channelMask_, positionError, rotationError, scaleError))
+            {
+                keptFrames.Push(i);
+                break;
+            }
+        }
+    }
+    if (numFrames > 1)
+        keptFrames.Push(numFrames - 1);
+
+    // Quantize positions and scales within their range over the kept keyframes
+    AnimationCompressedKeys keys;
+    BoundingBox positionRange;
+    BoundingBox scaleRange;
+    for (unsigned i = 0; i < keptFrames.Size(); ++i)
+    {
+        positionRange.Merge(keyFrames_[keptFrames[i]].position_);
+        scaleRange.Merge(keyFrames_[keptFrames[i]].scale_);
+    }
+
+    keys.timeStart_ = keyFrames_[keptFrames.Front()].time_;
+    keys.timeStep_ = (keyFrames_[keptFrames.Back()].time_ - keys.timeStart_) / MAX_QUANTIZED_VALUE;
+    if (channelMask_ & CHANNEL_POSITION)
+    {
+        keys.positionMin_ = positionRange.min_;
+        keys.positionStep_ = (positionRange.max_ - positionRange.min_) / MAX_QUANTIZED_VALUE;
+        keys.stride_ += 3;
+    }
+    if (channelMask_ & CHANNEL_ROTATION)
+        keys.stride_ += 3;
+    if (channelMask_ & CHANNEL_SCALE)
+    {
+        keys.scaleMin_ = scaleRange.min_;
+        keys.scaleStep_ = (scaleRange.max_ - scaleRange.min_) / MAX_QUANTIZED_VALUE;
+        keys.stride_ += 3;
+    }
+
+    keys.times_.Resize(keptFrames.Size());
+    keys.values_.Resize(keptFrames.Size() * keys.stride_);
+    for (unsigned i = 0; i < keptFrames.Size(); ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames_[keptFrames[i]];
+        keys.times_[i] = QuantizeValue(keyFrame.time_, keys.timeStart_, keys.timeStep_);
+
+        // On long tracks the time step may exceed the key interval. Sampling would then see a zero interval between keys,
+        // so keep the track uncompressed
+        if (i && keys.times_[i] <= keys.times_[i - 1] && keyFrame.time_ > keyFrames_[keptFrames[i - 1]].time_)
+            return;
+
+        unsigned short* dest = keys.values_.Buffer() + i * keys.stride_;
+        if (channelMask_ & CHANNEL_POSITION)
+        {
+            dest[0] = QuantizeValue(keyFrame.position_.x_, keys.positionMin_.x_, keys.positionStep_.x_);
+            dest[1] = QuantizeValue(keyFrame.position_.y_, keys.positionMin_.y_, keys.positionStep_.y_);
+            dest[2] = QuantizeValue(keyFrame.position_.z_, keys.positionMin_.z_, keys.positionStep_.z_);
+            dest += 3;
+        }
+        if (channelMask_ & CHANNEL_ROTATION)
+        {
+            EncodeRotation(keyFrame.rotation_, dest);
+            dest += 3;
+        }
+        if (channelMask_ & CHANNEL_SCALE)
+        {
+            dest[0] = QuantizeValue(keyFrame.scale_.x_, keys.scaleMin_.x_, keys.scaleStep_.x_);
+            dest[1] = QuantizeValue(keyFrame.scale_.y_, keys.scaleMin_.y_, keys.scaleStep_.y_);
+            dest[2] = QuantizeValue(keyFrame.scale_.z_, keys.scaleMin_.z_, keys.scaleStep_.z_);
+        }
+    }
+
+    compressedKeys_ = keys;
+    // Release the keyframe memory
+    Vector<AnimationKeyFrame> emptyKeyFrames;
+    keyFrames_.Swap(emptyKeyFrames);
 }
 
 AnimationKeyFrame* AnimationTrack::GetKeyFrame(unsigned index)
@@ -94,6 +287,19 @@ void AnimationTrack::GetKeyFrameIndex(float time, unsigned& index) const
     if (time < 0.0f)
         time = 0.0f;
 
+    if (IsCompressed())
+    {
+        unsigned numKeys = compressedKeys_.GetNumKeys();
+        if (index >= numKeys)
+            index = numKeys - 1;
+
+        while (index && time < compressedKeys_.GetTime(index))
+            --index;
+        while (index < numKeys - 1 && time >= compressedKeys_.GetTime(index + 1))
+            ++index;
+        return;
+    }
+
     if (index >= keyFrames_.Size())
         index = keyFrames_.Size() - 1;
 
@@ -106,6 +312,80 @@ void AnimationTrack::GetKeyFrameIndex(float time, unsigned& index) const
         ++index;
 }
 
+bool AnimationTrack::Sample(float time, float length, bool looped, unsigned& index, Vector3& position, Quaternion& rotation,
+    Vector3& scale) const
+{
+    unsigned numKeyFrames = IsCompressed() ? compressedKeys_.GetNumKeys() : keyFrames_.Size();
+    if (!numKeyFrames)
+        return false;
+
+    GetKeyFrameIndex(time, index);
+
+    // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
+    unsigned nextIndex = index + 1;
+    bool interpolate = true;
+    if (nextIndex >= numKeyFrames)
+    {
+        if (!looped)
+        {
+            nextIndex = index;
+            interpolate = false;
+        }
+        else
+            nextIndex = 0;
+    }
+
+    float keyTime;
+    float nextKeyTime = 0.0f;
+    Vector3 nextPosition;
+    Quaternion nextRotation;
+    Vector3 nextScale;
+
+    if (IsCompressed())
+    {
+        keyTime = compressedKeys_.GetTime(index);
+        compressedKeys_.GetKey(index, channelMask_, position, rotation, scale);
+        if (interpolate)
+        {
+            nextKeyTime = compressedKeys_.GetTime(nextIndex);
+            compressedKeys_.GetKey(nextIndex, channelMask_, nextPosition, nextRotation, nextScale);
+        }
+    }
+    else
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames_[index];
+        keyTime = keyFrame.time_;
+        position = keyFrame.position_;
+        rotation = keyFrame.rotation_;
+        scale = keyFrame.scale_;
+        if (interpolate)
+        {
+            const AnimationKeyFrame& nextKeyFrame = keyFrames_[nextIndex];
+            nextKeyTime = nextKeyFrame.time_;
+            nextPosition = nextKeyFrame.position_;
+            nextRotation = nextKeyFrame.rotation_;
+            nextScale = nextKeyFrame.scale_;
+        }
+    }
+
+    if (interpolate)
+    {
+        float timeInterval = nextKeyTime - keyTime;
+        if (timeInterval < 0.0f)
+            timeInterval += length;
+        float t = timeInterval > 0.0f ? (time - keyTime) / timeInterval : 1.0f;
+
+        if (channelMask_ & CHANNEL_POSITION)
+            position = position.Lerp(nextPosition, t);
+        if (channelMask_ & CHANNEL_ROTATION)
+            rotation = rotation.Slerp(nextRotation, t);
+        if (channelMask_ & CHANNEL_SCALE)
+            scale = scale.Lerp(nextScale, t);
+    }
+
+    return true;
+}
+
 Animation::Animation(Context* context) :
     ResourceWithMetadata(context),
     length_(0.f)
@@ -123,12 +403,14 @@ bool Animation::BeginLoad(Deserializer& source)
 {
     unsigned memoryUse = sizeof(Animation);
 
-    // Check ID
-    if (source.ReadFileID() != "UANI")
+    // Check ID. Files with compressed tracks have a different ID
+    String fileID = source.ReadFileID();
+    if (fileID != "UANI" && fileID != "UANC")
     {
         URHO3D_LOGERROR(source.GetName() + " is not a valid animation file");
         return false;
     }
+    bool hasCompressedTracks = fileID == "UANC";
 
     // Read name and length
     animationName_ = source.ReadString();
@@ -145,6 +427,35 @@ bool Animation::BeginLoad(Deserializer& source)
         AnimationTrack* newTrack = CreateTrack(source.ReadString());
         newTrack->channelMask_ = source.ReadUByte();
 
+        if (hasCompressedTracks && source.ReadBool())
+        {
+            AnimationCompressedKeys& keys = newTrack->compressedKeys_;
+            unsigned numKeys = source.ReadUInt();
+            keys.timeStart_ = source.ReadFloat();
+            keys.timeStep_ = source.ReadFloat();
+            if (newTrack->channelMask_ & CHANNEL_POSITION)
+            {
+                keys.positionMin_ = source.ReadVector3();
+                keys.positionStep_ = source.ReadVector3();
+                keys.stride_ += 3;
+            }
+            if (newTrack->channelMask_ & CHANNEL_ROTATION)
+                keys.stride_ += 3;
+            if (newTrack->channelMask_ & CHANNEL_SCALE)
+            {
+                keys.scaleMin_ = source.ReadVector3();
+                keys.scaleStep_ = source.ReadVector3();
+                keys.stride_ += 3;
+            }
+
+            keys.times_.Resize(numKeys);
+            keys.values_.Resize(numKeys * keys.stride_);
+            source.Read(keys.times_.Buffer(), keys.times_.Size() * sizeof(unsigned short));
+            source.Read(keys.values_.Buffer(), keys.values_.Size() * sizeof(unsigned short));
+            memoryUse += keys.GetMemoryUse();
+            continue;
+        }
+
         unsigned keyFrames = source.ReadUInt();
         newTrack->keyFrames_.Resize(keyFrames);
         memoryUse += keyFrames * sizeof(AnimationKeyFrame);
@@ -223,8 +534,18 @@ bool Animation::BeginLoad(Deserializer& source)
 
 bool Animation::Save(Serializer& dest) const
 {
+    bool hasCompressedTracks = false;
+    for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        if (i->second_.IsCompressed())
+        {
+            hasCompressedTracks = true;
+            break;
+        }
+    }
+
     // Write ID, name and length
-    dest.WriteFileID("UANI");
+    dest.WriteFileID(hasCompressedTracks ? "UANC" : "UANI");
     dest.WriteString(animationName_);
     dest.WriteFloat(length_);
 
@@ -235,6 +556,32 @@ bool Animation::Save(Serializer& dest) const
         const AnimationTrack& track = i->second_;
         dest.WriteString(track.name_);
         dest.WriteUByte(track.channelMask_);
+
+        if (hasCompressedTracks)
+        {
+            dest.WriteBool(track.IsCompressed());
+            if (track.IsCompressed())
+            {
+                const AnimationCompressedKeys& keys = track.compressedKeys_;
+                dest.WriteUInt(keys.times_.Size());
+                dest.WriteFloat(keys.timeStart_);
+                dest.WriteFloat(keys.timeStep_);
+                if (track.channelMask_ & CHANNEL_POSITION)
+                {
+                    dest.WriteVector3(keys.positionMin_);
+                    dest.WriteVector3(keys.positionStep_);
+                }
+                if (track.channelMask_ & CHANNEL_SCALE)
+                {
+                    dest.WriteVector3(keys.scaleMin_);
+                    dest.WriteVector3(keys.scaleStep_);
+                }
+                dest.Write(keys.times_.Buffer(), keys.times_.Size() * sizeof(unsigned short));
+                dest.Write(keys.values_.Buffer(), keys.values_.Size() * sizeof(unsigned short));
+                continue;
+            }
+        }
+
         dest.WriteUInt(track.keyFrames_.Size());
 
         // Write keyframes of the track
@@ -366,6 +713,23 @@ void Animation::SetNumTriggers(unsigned num)
     triggers_.Resize(num);
 }
 
+void Animation::Compress(float positionError, float rotationError, float scaleError)
+{
+    unsigned oldMemoryUse = 0;
+    unsigned newMemoryUse = 0;
+    for (HashMap<StringHash, AnimationTrack>::Iterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        AnimationTrack& track = i->second_;
+        oldMemoryUse += track.GetKeyFrameMemoryUse();
+        track.Compress(positionError, rotationError, scaleError);
+        newMemoryUse += track.GetKeyFrameMemoryUse();
+    }
+
+    // Dynamically created tracks are not included in the memory use, so only adjust if it covers the old keyframes
+    if (GetMemoryUse() >= oldMemoryUse)
+        SetMemoryUse(GetMemoryUse() - oldMemoryUse + newMemoryUse);
+}
+
 SharedPtr<Animation> Animation::Clone(const String& cloneName) const
 {
     SharedPtr<Animation> ret(new Animation(context_));
@@ -50,6 +50,48 @@ struct AnimationKeyFrame
     Vector3 scale_;
 };
 
+/// Quantized and key-reduced keyframes of an animation track. Positions and scales are stored as 16-bit values within the track's value range, rotations as the three smallest quaternion components with 15 bits each.
+struct URHO3D_API AnimationCompressedKeys
+{
+    /// Construct.
+    AnimationCompressedKeys() :
+        timeStart_(0.0f),
+        timeStep_(0.0f),
+        positionStep_(Vector3::ZERO),
+        scaleStep_(Vector3::ZERO),
+        stride_(0)
+    {
+    }
+
+    /// Return key time at index.
+    float GetTime(unsigned index) const { return timeStart_ + times_[index] * timeStep_; }
+    /// Decode the channels of the key at index.
+    void GetKey(unsigned index, unsigned char channelMask, Vector3& position, Quaternion& rotation, Vector3& scale) const;
+    /// Return number of keys.
+    unsigned GetNumKeys() const { return times_.Size(); }
+    /// Return memory use in bytes.
+    unsigned GetMemoryUse() const { return sizeof(AnimationCompressedKeys) + (times_.Size() + values_.Size()) * sizeof(unsigned short); }
+
+    /// Key times quantized over the time range.
+    PODVector<unsigned short> times_;
+    /// Quantized position, rotation and scale of each key, for the channels included in the track.
+    PODVector<unsigned short> values_;
+    /// Time of the first key.
+    float timeStart_;
+    /// Time quantization step.
+    float timeStep_;
+    /// Position range minimum.
+    Vector3 positionMin_;
+    /// Position quantization step.
+    Vector3 positionStep_;
+    /// Scale range minimum.
+    Vector3 scaleMin_;
+    /// Scale quantization step.
+    Vector3 scaleStep_;
+    /// Number of values per key.
+    unsigned stride_;
+};
+
 /// Skeletal animation track, stores keyframes of a single bone.
 struct URHO3D_API AnimationTrack
 {
@@ -70,12 +112,28 @@ struct URHO3D_API AnimationTrack
     /// Remove all keyframes.
     void RemoveAllKeyFrames();
 
-    /// Return keyframe at index, or null if not found.
+    /// Reduce the keyframes to those that linear interpolation can not reproduce within the error bounds, quantize them and release the uncompressed keyframes. Rotation error is in degrees. The track is left uncompressed if distinct key times would quantize to the same value. Modifying the keyframes afterwards discards the compressed keys.
+    void Compress(float positionError, float rotationError, float scaleError);
+
+    /// Return keyframe at index, or null if not found. Compressed keys can not be accessed as keyframes.
     AnimationKeyFrame* GetKeyFrame(unsigned index);
-    /// Return number of keyframes.
+    /// Return number of keyframes. Zero if compressed.
     unsigned GetNumKeyFrames() const { return keyFrames_.Size(); }
+    /// Return number of compressed keys. Zero if not compressed.
+    unsigned GetNumCompressedKeys() const { return IsCompressed() ? compressedKeys_.GetNumKeys() : 0; }
     /// Return keyframe index based on time and previous index.
     void GetKeyFrameIndex(float time, unsigned& index) const;
+    /// Sample the channels included in the track at time, interpolating between keyframes. The keyframe index is cached between calls. If looped, interpolate from the last keyframe to the first over the animation length. Return false if there are no keyframes.
+    bool Sample(float time, float length, bool looped, unsigned& index, Vector3& position, Quaternion& rotation, Vector3& scale) const;
+
+    /// Return whether the keyframes are compressed.
+    bool IsCompressed() const { return keyFrames_.Empty() && compressedKeys_.GetNumKeys(); }
+
+    /// Return memory use of the keyframes in bytes.
+    unsigned GetKeyFrameMemoryUse() const
+    {
+        return IsCompressed() ? compressedKeys_.GetMemoryUse() : keyFrames_.Size() * sizeof(AnimationKeyFrame);
+    }
 
     /// Bone or scene node name.
     String name_;
@@ -85,6 +143,8 @@ struct URHO3D_API AnimationTrack
     unsigned char channelMask_;
     /// Keyframes.
     Vector<AnimationKeyFrame> keyFrames_;
+    /// Compressed keyframes.
+    AnimationCompressedKeys compressedKeys_;
 };
 
 /// %Animation trigger point.
@@ -146,6 +206,8 @@ public:
     void RemoveAllTriggers();
     /// Resize trigger point vector.
     void SetNumTriggers(unsigned num);
+    /// Compress all tracks within the given error bounds. Rotation error is in degrees.
+    void Compress(float positionError, float rotationError, float scaleError);
     /// Clone the animation.
     SharedPtr<Animation> Clone(const String& cloneName = String::EMPTY) const;
 
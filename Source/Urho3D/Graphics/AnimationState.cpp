@@ -33,9 +33,29 @@
 namespace Urho3D
 {
 
+/// Return whether a bone is the ancestor bone or its descendant, following the skeleton's parent indices.
+static bool IsBoneInHierarchy(const Skeleton& skeleton, unsigned index, unsigned ancestorIndex)
+{
+    const Vector<Bone>& bones = skeleton.GetBones();
+
+    // Limit the walk to the number of bones in case the parent indices form a cycle
+    for (unsigned i = 0; i < bones.Size() && index < bones.Size(); ++i)
+    {
+        if (index == ancestorIndex)
+            return true;
+        unsigned parentIndex = bones[index].parentIndex_;
+        if (parentIndex == index)
+            break;
+        index = parentIndex;
+    }
+
+    return false;
+}
+
 AnimationStateTrack::AnimationStateTrack() :
     track_(nullptr),
     bone_(nullptr),
+    boneIndex_(M_MAX_UNSIGNED),
     weight_(1.0f),
     keyFrame_(0)
 {
@@ -51,7 +71,8 @@ AnimationState::AnimationState(AnimatedModel* model, Animation* animation) :
     weight_(0.0f),
     time_(0.0f),
     layer_(0),
-    blendingMode_(ABM_LERP)
+    blendingMode_(ABM_LERP),
+    poseTracks_(false)
 {
     // Set default start bone (use all tracks.)
     SetStartBone(nullptr);
@@ -65,7 +86,8 @@ AnimationState::AnimationState(Node* node, Animation* animation) :
     weight_(1.0f),
     time_(0.0f),
     layer_(0),
-    blendingMode_(ABM_LERP)
+    blendingMode_(ABM_LERP),
+    poseTracks_(false)
 {
     if (animation_)
     {
@@ -116,18 +138,24 @@ void AnimationState::SetStartBone(Bone* startBone)
         startBone = rootBone;
     }
 
+    // In pose buffer mode the tracks refer to the bones of the pose buffer instead of their scene nodes
+    bool usePoseBuffer = model_->GetUsePoseBuffer();
+
     // Do not reassign if the start bone did not actually change, and we already have valid bone nodes
-    if (startBone == startBone_ && !stateTracks_.Empty())
+    if (startBone == startBone_ && !stateTracks_.Empty() && poseTracks_ == usePoseBuffer)
         return;
 
     startBone_ = startBone;
+    poseTracks_ = usePoseBuffer;
 
     const HashMap<StringHash, AnimationTrack>& tracks = animation_->GetTracks();
     stateTracks_.Clear();
 
-    if (!startBone->node_)
+    if (!startBone->node_ && !usePoseBuffer)
         return;
 
+    unsigned startBoneIndex = skeleton.GetBoneIndex(startBone);
+
     for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks.Begin(); i != tracks.End(); ++i)
     {
         AnimationStateTrack stateTrack;
@@ -139,6 +167,12 @@ void AnimationState::SetStartBone(Bone* startBone)
 
         if (nameHash == startBone->nameHash_)
             trackBone = startBone;
+        else if (usePoseBuffer)
+        {
+            Bone* bone = skeleton.GetBone(nameHash);
+            if (bone && IsBoneInHierarchy(skeleton, skeleton.GetBoneIndex(bone), startBoneIndex))
+                trackBone = bone;
+        }
         else
         {
             Node* trackBoneNode = startBone->node_->GetChild(nameHash, true);
@@ -146,10 +180,12 @@ void AnimationState::SetStartBone(Bone* startBone)
                 trackBone = skeleton.GetBone(nameHash);
         }
 
-        if (trackBone && trackBone->node_)
+        if (trackBone && (trackBone->node_ || usePoseBuffer))
         {
             stateTrack.bone_ = trackBone;
-            stateTrack.node_ = trackBone->node_;
+            stateTrack.boneIndex_ = skeleton.GetBoneIndex(trackBone);
+            if (!usePoseBuffer)
+                stateTrack.node_ = trackBone->node_;
             stateTracks_.Push(stateTrack);
         }
     }
@@ -229,6 +265,20 @@ void AnimationState::SetBoneWeight(unsigned index, float weight, bool recursive)
                     SetBoneWeight(childTrackIndex, weight, true);
             }
         }
+        // In pose buffer mode there are no bone nodes, so find the child bones from the skeleton
+        else if (model_ && stateTracks_[index].bone_)
+        {
+            unsigned boneIndex = stateTracks_[index].boneIndex_;
+            const Vector<Bone>& bones = model_->GetSkeleton().GetBones();
+            for (unsigned i = 0; i < bones.Size(); ++i)
+            {
+                if (i == boneIndex || bones[i].parentIndex_ != boneIndex)
+                    continue;
+                unsigned childTrackIndex = GetTrackIndex(bones[i].nameHash_);
+                if (childTrackIndex != M_MAX_UNSIGNED)
+                    SetBoneWeight(childTrackIndex, weight, true);
+            }
+        }
     }
 }
 
@@ -405,8 +455,9 @@ unsigned AnimationState::GetTrackIndex(const String& name) const
 {
     for (unsigned i = 0; i < stateTracks_.Size(); ++i)
     {
+        const Bone* bone = stateTracks_[i].bone_;
         Node* node = stateTracks_[i].node_;
-        if (node && node->GetName() == name)
+        if ((bone && bone->name_ == name) || (!bone && node && node->GetName() == name))
             return i;
     }
 
@@ -428,8 +479,9 @@ unsigned AnimationState::GetTrackIndex(StringHash nameHash) const
 {
     for (unsigned i = 0; i < stateTracks_.Size(); ++i)
     {
+        const Bone* bone = stateTracks_[i].bone_;
         Node* node = stateTracks_[i].node_;
-        if (node && node->GetNameHash() == nameHash)
+        if ((bone && bone->nameHash_ == nameHash) || (!bone && node && node->GetNameHash() == nameHash))
             return i;
     }
 
@@ -454,6 +506,10 @@ void AnimationState::Apply()
 
 void AnimationState::ApplyToModel()
 {
+    // In pose buffer mode, write to the model's pose buffer instead of the bone nodes
+    PODVector<BonePose>& poses = model_->bonePoses_;
+    bool usePoseBuffer = poseTracks_ && model_->GetUsePoseBuffer();
+
     for (Vector<AnimationStateTrack>::Iterator i = stateTracks_.Begin(); i != stateTracks_.End(); ++i)
     {
         AnimationStateTrack& stateTrack = *i;
@@ -463,7 +519,13 @@ void AnimationState::ApplyToModel()
         if (Equals(finalWeight, 0.0f) || !stateTrack.bone_->animated_)
             continue;
 
-        ApplyTrack(stateTrack, finalWeight, true);
+        if (usePoseBuffer)
+        {
+            if (stateTrack.boneIndex_ < poses.Size())
+                ApplyTrack(stateTrack, finalWeight, true, &poses[stateTrack.boneIndex_]);
+        }
+        else
+            ApplyTrack(stateTrack, finalWeight, true, nullptr);
     }
 }
 
@@ -471,84 +533,49 @@ void AnimationState::ApplyToNodes()
 {
     // When applying to a node hierarchy, can only use full weight (nothing to blend to)
     for (Vector<AnimationStateTrack>::Iterator i = stateTracks_.Begin(); i != stateTracks_.End(); ++i)
-        ApplyTrack(*i, 1.0f, false);
+        ApplyTrack(*i, 1.0f, false, nullptr);
 }
 
-void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent)
+void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent, BonePose* pose)
 {
     const AnimationTrack* track = stateTrack.track_;
     Node* node = stateTrack.node_;
 
-    if (track->keyFrames_.Empty() || !node)
+    if (!node && !pose)
         return;
 
-    unsigned& frame = stateTrack.keyFrame_;
-    track->GetKeyFrameIndex(time_, frame);
-
-    // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
-    unsigned nextFrame = frame + 1;
-    bool interpolate = true;
-    if (nextFrame >= track->keyFrames_.Size())
-    {
-        if (!looped_)
-        {
-            nextFrame = frame;
-            interpolate = false;
-        }
-        else
-            nextFrame = 0;
-    }
-
-    const AnimationKeyFrame* keyFrame = &track->keyFrames_[frame];
-    unsigned char channelMask = track->channelMask_;
-
+    // Sample the track, decoding compressed keyframes on the fly
     Vector3 newPosition;
     Quaternion newRotation;
     Vector3 newScale;
+    if (!track->Sample(time_, animation_->GetLength(), looped_, stateTrack.keyFrame_, newPosition, newRotation, newScale))
+        return;
 
-    if (interpolate)
-    {
-        const AnimationKeyFrame* nextKeyFrame = &track->keyFrames_[nextFrame];
-        float timeInterval = nextKeyFrame->time_ - keyFrame->time_;
-        if (timeInterval < 0.0f)
-            timeInterval += animation_->GetLength();
-        float t = timeInterval > 0.0f ? (time_ - keyFrame->time_) / timeInterval : 1.0f;
+    unsigned char channelMask = track->channelMask_;
 
-        if (channelMask & CHANNEL_POSITION)
-            newPosition = keyFrame->position_.Lerp(nextKeyFrame->position_, t);
-        if (channelMask & CHANNEL_ROTATION)
-            newRotation = keyFrame->rotation_.Slerp(nextKeyFrame->rotation_, t);
-        if (channelMask & CHANNEL_SCALE)
-            newScale = keyFrame->scale_.Lerp(nextKeyFrame->scale_, t);
-    }
-    else
-    {
-        if (channelMask & CHANNEL_POSITION)
-            newPosition = keyFrame->position_;
-        if (channelMask & CHANNEL_ROTATION)
-            newRotation = keyFrame->rotation_;
-        if (channelMask & CHANNEL_SCALE)
-            newScale = keyFrame->scale_;
-    }
+    // Blend with the current transform, which is either in the pose buffer or in the scene node
+    const Vector3& position = pose ? pose->position_ : node->GetPosition();
+    const Quaternion& rotation = pose ? pose->rotation_ : node->GetRotation();
+    const Vector3& scale = pose ? pose->scale_ : node->GetScale();
 
     if (blendingMode_ == ABM_ADDITIVE) // not ABM_LERP
     {
         if (channelMask & CHANNEL_POSITION)
         {
             Vector3 delta = newPosition - stateTrack.bone_->initialPosition_;
-            newPosition = node->GetPosition() + delta * weight;
+            newPosition = position + delta * weight;
         }
         if (channelMask & CHANNEL_ROTATION)
         {
             Quaternion delta = newRotation * stateTrack.bone_->initialRotation_.Inverse();
-            newRotation = (delta * node->GetRotation()).Normalized();
+            newRotation = (delta * rotation).Normalized();
             if (!Equals(weight, 1.0f))
-                newRotation = node->GetRotation().Slerp(newRotation, weight);
+                newRotation = rotation.Slerp(newRotation, weight);
         }
         if (channelMask & CHANNEL_SCALE)
         {
             Vector3 delta = newScale - stateTrack.bone_->initialScale_;
-            newScale = node->GetScale() + delta * weight;
+            newScale = scale + delta * weight;
         }
     }
     else
@@ -556,15 +583,24 @@ void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, b
         if (!Equals(weight, 1.0f)) // not full weight
         {
             if (channelMask & CHANNEL_POSITION)
-                newPosition = node->GetPosition().Lerp(newPosition, weight);
+                newPosition = position.Lerp(newPosition, weight);
             if (channelMask & CHANNEL_ROTATION)
-                newRotation = node->GetRotation().Slerp(newRotation, weight);
+                newRotation = rotation.Slerp(newRotation, weight);
             if (channelMask & CHANNEL_SCALE)
-                newScale = node->GetScale().Lerp(newScale, weight);
+                newScale = scale.Lerp(newScale, weight);
         }
     }
 
-    if (silent)
+    if (pose)
+    {
+        if (channelMask & CHANNEL_POSITION)
+            pose->position_ = newPosition;
+        if (channelMask & CHANNEL_ROTATION)
+            pose->rotation_ = newRotation;
+        if (channelMask & CHANNEL_SCALE)
+            pose->scale_ = newScale;
+    }
+    else if (silent)
     {
         if (channelMask & CHANNEL_POSITION)
             node->SetPositionSilent(newPosition);
@@ -37,6 +37,7 @@ class Serializer;
 class Skeleton;
 struct AnimationTrack;
 struct Bone;
+struct BonePose;
 
 /// %Animation blending mode.
 enum AnimationBlendMode
@@ -59,6 +60,8 @@ struct AnimationStateTrack
     const AnimationTrack* track_;
     /// Bone pointer.
     Bone* bone_;
+    /// Bone index in the skeleton.
+    unsigned boneIndex_;
     /// Scene node pointer.
     WeakPtr<Node> node_;
     /// Blending weight.
@@ -152,8 +155,8 @@ private:
     void ApplyToModel();
     /// Apply animation to a scene node hierarchy.
     void ApplyToNodes();
-    /// Apply track.
-    void ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent);
+    /// Apply track to the bone's scene node, or to a pose buffer entry if given.
+    void ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent, BonePose* pose);
 
     /// Animated model (model mode.)
     WeakPtr<AnimatedModel> model_;
@@ -175,6 +178,8 @@ private:
     unsigned char layer_;
     /// Blending mode.
     AnimationBlendMode blendingMode_;
+    /// Tracks assigned for the animated model's pose buffer mode flag.
+    bool poseTracks_;
 };
 
 }
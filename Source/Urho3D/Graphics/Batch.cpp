@@ -22,11 +22,13 @@
 
 #include "../Precompiled.h"
 
+#include "../Core/Profiler.h"
 #include "../Graphics/Camera.h"
 #include "../Graphics/Geometry.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/GraphicsImpl.h"
 #include "../Graphics/Material.h"
+#include "../Graphics/RenderCommandBuffer.h"
 #include "../Graphics/Renderer.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Technique.h"
@@ -80,6 +82,55 @@ inline bool CompareBatchGroupOrder(BatchGroup* lhs, BatchGroup* rhs)
     return lhs->renderOrder_ < rhs->renderOrder_;
 }
 
+inline void SetCullMode(Graphics* /*graphics*/, Renderer* renderer, CullMode mode, Camera* camera)
+{
+    renderer->SetCullMode(mode, camera);
+}
+
+inline void SetCullMode(RenderCommandBuffer* buffer, Renderer* /*renderer*/, CullMode mode, Camera* camera)
+{
+    buffer->SetCullMode(mode, camera);
+}
+
+inline void SetViewShaderParameters(Graphics* /*graphics*/, View* view, Camera* camera)
+{
+    view->SetViewShaderParameters(camera);
+}
+
+inline void SetViewShaderParameters(RenderCommandBuffer* buffer, View* /*view*/, Camera* camera)
+{
+    buffer->SetViewShaderParameters(camera);
+}
+
+inline void OptimizeLightByScissor(Graphics* /*graphics*/, Renderer* renderer, Light* light, Camera* camera)
+{
+    renderer->OptimizeLightByScissor(light, camera);
+}
+
+inline void OptimizeLightByScissor(RenderCommandBuffer* buffer, Renderer* /*renderer*/, Light* light, Camera* camera)
+{
+    buffer->OptimizeLightByScissor(light, camera);
+}
+
+inline void SetInstancedVertexBuffers(Graphics* graphics, Geometry* geometry, VertexBuffer* instanceBuffer, unsigned instanceOffset)
+{
+    // Get the geometry vertex buffers, then add the instancing stream buffer
+    // Hack: use a const_cast to avoid dynamic allocation of new temp vectors
+    auto& vertexBuffers = const_cast<Vector<SharedPtr<VertexBuffer> >&>(
+        geometry->GetVertexBuffers());
+    vertexBuffers.Push(SharedPtr<VertexBuffer>(instanceBuffer));
+    graphics->SetVertexBuffers(vertexBuffers, instanceOffset);
+    // Remove the instancing buffer & element mask now
+    vertexBuffers.Pop();
+}
+
+inline void SetInstancedVertexBuffers(RenderCommandBuffer* buffer, Geometry* geometry, VertexBuffer* instanceBuffer,
+    unsigned instanceOffset)
+{
+    // The geometry's vertex buffer vector must not be modified, as it may be recorded from several threads at once
+    buffer->SetVertexBuffers(geometry->GetVertexBuffers(), instanceBuffer, instanceOffset);
+}
+
 void CalculateShadowMatrix(Matrix4& dest, LightBatchQueue* queue, unsigned split, Renderer* renderer)
 {
     Camera* shadowCamera = queue->shadowSplits_[split].shadowCamera_;
@@ -176,11 +227,15 @@ void Batch::CalculateSortKey()
 }
 
 void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite) const
+{
+    Prepare(view->GetGraphics(), view, camera, setModelTransform, allowDepthWrite);
+}
+
+template <class T> void Batch::Prepare(T* graphics, View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite) const
 {
     if (!vertexShader_ || !pixelShader_)
         return;
 
-    Graphics* graphics = view->GetGraphics();
     Renderer* renderer = view->GetRenderer();
     Node* cameraNode = camera ? camera->GetNode() : nullptr;
     Light* light = lightQueue_ ? lightQueue_->light_ : nullptr;
@@ -210,7 +265,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
         if (effectiveCullMode == MAX_CULLMODES)
             effectiveCullMode = isShadowPass ? material_->GetShadowCullMode() : material_->GetCullMode();
 
-        renderer->SetCullMode(effectiveCullMode, camera);
+        SetCullMode(graphics, renderer, effectiveCullMode, camera);
         if (!isShadowPass)
         {
             const BiasParameters& depthBias = material_->GetDepthBias();
@@ -223,21 +278,8 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
         graphics->SetDepthWrite(pass_->GetDepthWrite() && allowDepthWrite);
     }
 
-    // Set global (per-frame) shader parameters
-    if (graphics->NeedParameterUpdate(SP_FRAME, nullptr))
-        view->SetGlobalShaderParameters();
-
-    // Set camera & viewport shader parameters
-    auto cameraHash = (unsigned)(size_t)camera;
-    IntRect viewport = graphics->GetViewport();
-    IntVector2 viewSize = IntVector2(viewport.Width(), viewport.Height());
-    auto viewportHash = (unsigned)viewSize.x_ | (unsigned)viewSize.y_ << 16u;
-    if (graphics->NeedParameterUpdate(SP_CAMERA, reinterpret_cast<const void*>(cameraHash + viewportHash)))
-    {
-        view->SetCameraShaderParameters(camera);
-        // During renderpath commands the G-Buffer or viewport texture is assumed to always be viewport-sized
-        view->SetGBufferShaderParameters(viewSize, IntRect(0, 0, viewSize.x_, viewSize.y_));
-    }
+    // Set global (per-frame), camera & viewport shader parameters
+    SetViewShaderParameters(graphics, view, camera);
 
     // Set model or skinning transforms
     if (setModelTransform && graphics->NeedParameterUpdate(SP_OBJECT, worldTransform_))
@@ -597,11 +639,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     if (material_)
     {
         if (graphics->NeedParameterUpdate(SP_MATERIAL, reinterpret_cast<const void*>(material_->GetShaderParameterHash())))
-        {
-            const HashMap<StringHash, MaterialShaderParameter>& parameters = material_->GetShaderParameters();
-            for (HashMap<StringHash, MaterialShaderParameter>::ConstIterator i = parameters.Begin(); i != parameters.End(); ++i)
-                graphics->SetShaderParameter(i->first_, i->second_.value_);
-        }
+            graphics->SetShaderParameters(material_->GetShaderParameterBlock());
 
         const HashMap<TextureUnit, SharedPtr<Texture> >& textures = material_->GetTextures();
         for (HashMap<TextureUnit, SharedPtr<Texture> >::ConstIterator i = textures.Begin(); i != textures.End(); ++i)
@@ -631,14 +669,29 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
             graphics->SetTexture(TU_LIGHTSHAPE, shapeTexture);
         }
     }
+    else if (view->GetLightClusters())
+    {
+        // Unlit batches of a clustered pass read the light clusters through the light ramp and shape units, which per-pixel
+        // lit batches use for their light textures
+        LightClusters* lightClusters = view->GetLightClusters();
+        if (graphics->HasTextureUnit(TU_LIGHTRAMP))
+            graphics->SetTexture(TU_LIGHTRAMP, lightClusters->GetClusterTexture());
+        if (graphics->HasTextureUnit(TU_LIGHTSHAPE))
+            graphics->SetTexture(TU_LIGHTSHAPE, lightClusters->GetLightTexture());
+    }
 }
 
 void Batch::Draw(View* view, Camera* camera, bool allowDepthWrite) const
+{
+    Draw(view->GetGraphics(), view, camera, allowDepthWrite);
+}
+
+template <class T> void Batch::Draw(T* graphics, View* view, Camera* camera, bool allowDepthWrite) const
 {
     if (!geometry_->IsEmpty())
     {
-        Prepare(view, camera, true, allowDepthWrite);
-        geometry_->Draw(view->GetGraphics());
+        Prepare(graphics, view, camera, true, allowDepthWrite);
+        geometry_->Draw(graphics);
     }
 }
 
@@ -649,7 +702,13 @@ void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned&
         return;
 
     startIndex_ = freeIndex;
-    unsigned char* buffer = static_cast<unsigned char*>(lockedData) + startIndex_ * stride;
+    WriteInstancingData(lockedData, stride);
+    freeIndex += instances_.Size();
+}
+
+void BatchGroup::WriteInstancingData(void* data, unsigned stride) const
+{
+    unsigned char* buffer = static_cast<unsigned char*>(data) + startIndex_ * stride;
 
     for (unsigned i = 0; i < instances_.Size(); ++i)
     {
@@ -661,13 +720,15 @@ void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned&
 
         buffer += stride;
     }
-
-    freeIndex += instances_.Size();
 }
 
 void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
 {
-    Graphics* graphics = view->GetGraphics();
+    Draw(view->GetGraphics(), view, camera, allowDepthWrite);
+}
+
+template <class T> void BatchGroup::Draw(T* graphics, View* view, Camera* camera, bool allowDepthWrite) const
+{
     Renderer* renderer = view->GetRenderer();
 
     if (instances_.Size() && !geometry_->IsEmpty())
@@ -676,7 +737,7 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
         VertexBuffer* instanceBuffer = renderer->GetInstancingBuffer();
         if (!instanceBuffer || geometryType_ != GEOM_INSTANCED || startIndex_ == M_MAX_UNSIGNED)
         {
-            Batch::Prepare(view, camera, false, allowDepthWrite);
+            Batch::Prepare(graphics, view, camera, false, allowDepthWrite);
 
             graphics->SetIndexBuffer(geometry_->GetIndexBuffer());
             graphics->SetVertexBuffers(geometry_->GetVertexBuffers());
@@ -692,21 +753,12 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
         }
         else
         {
-            Batch::Prepare(view, camera, false, allowDepthWrite);
-
-            // Get the geometry vertex buffers, then add the instancing stream buffer
-            // Hack: use a const_cast to avoid dynamic allocation of new temp vectors
-            auto& vertexBuffers = const_cast<Vector<SharedPtr<VertexBuffer> >&>(
-                geometry_->GetVertexBuffers());
-            vertexBuffers.Push(SharedPtr<VertexBuffer>(instanceBuffer));
+            Batch::Prepare(graphics, view, camera, false, allowDepthWrite);
 
             graphics->SetIndexBuffer(geometry_->GetIndexBuffer());
-            graphics->SetVertexBuffers(vertexBuffers, startIndex_);
+            SetInstancedVertexBuffers(graphics, geometry_, instanceBuffer, startIndex_);
             graphics->DrawInstanced(geometry_->GetPrimitiveType(), geometry_->GetIndexStart(), geometry_->GetIndexCount(),
                 geometry_->GetVertexStart(), geometry_->GetVertexCount(), instances_.Size());
-
-            // Remove the instancing buffer & element mask now
-            vertexBuffers.Pop();
         }
     }
 }
@@ -847,7 +899,19 @@ void BatchQueue::SetInstancingData(void* lockedData, unsigned stride, unsigned&
 
 void BatchQueue::Draw(View* view, Camera* camera, bool markToStencil, bool usingLightOptimization, bool allowDepthWrite) const
 {
-    Graphics* graphics = view->GetGraphics();
+    Draw(view->GetGraphics(), view, camera, markToStencil, usingLightOptimization, allowDepthWrite);
+}
+
+void BatchQueue::Record(View* view, Camera* camera, RenderCommandBuffer* buffer, bool markToStencil, bool usingLightOptimization) const
+{
+    URHO3D_PROFILE(RecordBatchQueue);
+
+    Draw(buffer, view, camera, markToStencil, usingLightOptimization, true);
+}
+
+template <class T> void BatchQueue::Draw(T* graphics, View* view, Camera* camera, bool markToStencil, bool usingLightOptimization,
+    bool allowDepthWrite) const
+{
     Renderer* renderer = view->GetRenderer();
 
     // If View has set up its own light optimizations, do not disturb the stencil/scissor test settings
@@ -867,7 +931,7 @@ void BatchQueue::Draw(View* view, Camera* camera, bool markToStencil, bool using
         if (markToStencil)
             graphics->SetStencilTest(true, CMP_ALWAYS, OP_REF, OP_KEEP, OP_KEEP, group->lightMask_);
 
-        group->Draw(view, camera, allowDepthWrite);
+        group->Draw(graphics, view, camera, allowDepthWrite);
     }
     // Non-instanced
     for (PODVector<Batch*>::ConstIterator i = sortedBatches_.Begin(); i != sortedBatches_.End(); ++i)
@@ -879,12 +943,12 @@ void BatchQueue::Draw(View* view, Camera* camera, bool markToStencil, bool using
         {
             // If drawing an alpha batch, we can optimize fillrate by scissor test
             if (!batch->isBase_ && batch->lightQueue_)
-                renderer->OptimizeLightByScissor(batch->lightQueue_->light_, camera);
+                OptimizeLightByScissor(graphics, renderer, batch->lightQueue_->light_, camera);
             else
                 graphics->SetScissorTest(false);
         }
 
-        batch->Draw(view, camera, allowDepthWrite);
+        batch->Draw(graphics, view, camera, allowDepthWrite);
     }
 }
 
@@ -39,6 +39,7 @@ class Light;
 class Material;
 class Matrix3x4;
 class Pass;
+class RenderCommandBuffer;
 class ShaderVariation;
 class Texture2D;
 class VertexBuffer;
@@ -73,6 +74,10 @@ struct Batch
     void Prepare(View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite) const;
     /// Prepare and draw.
     void Draw(View* view, Camera* camera, bool allowDepthWrite) const;
+    /// Prepare for rendering to either the graphics subsystem or a render command buffer.
+    template <class T> void Prepare(T* graphics, View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite) const;
+    /// Prepare and draw to either the graphics subsystem or a render command buffer.
+    template <class T> void Draw(T* graphics, View* view, Camera* camera, bool allowDepthWrite) const;
 
     /// State sorting key.
     unsigned long long sortKey_{};
@@ -165,8 +170,12 @@ struct BatchGroup : public Batch
 
     /// Pre-set the instance data. Buffer must be big enough to hold all data.
     void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
+    /// Write the instance data at the start index. Safe to call from a worker thread for different groups.
+    void WriteInstancingData(void* data, unsigned stride) const;
     /// Prepare and draw.
     void Draw(View* view, Camera* camera, bool allowDepthWrite) const;
+    /// Prepare and draw to either the graphics subsystem or a render command buffer.
+    template <class T> void Draw(T* graphics, View* view, Camera* camera, bool allowDepthWrite) const;
 
     /// Instance data.
     PODVector<InstanceData> instances_;
@@ -238,6 +247,11 @@ public:
     void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
     /// Draw.
     void Draw(View* view, Camera* camera, bool markToStencil, bool usingLightOptimization, bool allowDepthWrite) const;
+    /// Record into a render command buffer. Safe to call from a worker thread. Depth write is masked when the buffer is replayed.
+    void Record(View* view, Camera* camera, RenderCommandBuffer* buffer, bool markToStencil, bool usingLightOptimization) const;
+    /// Draw to either the graphics subsystem or a render command buffer.
+    template <class T> void Draw(T* graphics, View* view, Camera* camera, bool markToStencil, bool usingLightOptimization,
+        bool allowDepthWrite) const;
     /// Return the combined amount of instances.
     unsigned GetNumInstances() const;
 
@@ -297,6 +311,10 @@ struct LightBatchQueue
     bool negative_;
     /// Shadow map depth texture.
     Texture2D* shadowMap_;
+    /// Shadow map kept between frames flag.
+    bool shadowMapCached_;
+    /// Shadow map contents reused from an earlier frame flag. The shadow map is not rendered and has no shadow batches.
+    bool shadowMapReused_;
     /// Lit geometry draw calls, base (replace blend mode)
     BatchQueue litBaseBatches_;
     /// Lit geometry draw calls, non-base (additive)
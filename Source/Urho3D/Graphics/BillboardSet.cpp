@@ -810,7 +810,7 @@ void BillboardSet::CalculateFixedScreenSize(const RenderFrameInfo& frame)
     {
         bufferDirty_ = true;
         forceUpdate_ = true;
-        worldBoundingBoxDirty_ = true;
+        MarkWorldBoundingBoxDirty();
     }
 }
 
@@ -33,6 +33,7 @@
 #include "../../Graphics/IndexBuffer.h"
 #include "../../Graphics/Renderer.h"
 #include "../../Graphics/Shader.h"
+#include "../../Graphics/ShaderParameterBlock.h"
 #include "../../Graphics/ShaderPrecache.h"
 #include "../../Graphics/ShaderProgram.h"
 #include "../../Graphics/Texture2D.h"
@@ -216,6 +217,8 @@ Graphics::Graphics(Context* context) :
 
 Graphics::~Graphics()
 {
+    CompleteShaderCompiles();
+
     {
         MutexLock lock(gpuObjectMutex_);
 
@@ -982,19 +985,15 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
 
     if (vs != vertexShader_)
     {
-        // Create the shader now if not yet created. If already attempted, do not retry
+        // Create the shader now if not yet created. If already attempted, do not retry unless still compiling in the background
         if (vs && !vs->GetGPUObject())
         {
-            if (vs->GetCompilerOutput().Empty())
+            if (IsShaderVariationPending(vs) || vs->GetCompilerOutput().Empty())
             {
                 URHO3D_PROFILE(CompileVertexShader);
 
-                bool success = vs->Create();
-                if (!success)
-                {
-                    URHO3D_LOGERROR("Failed to compile vertex shader " + vs->GetFullName() + ":\n" + vs->GetCompilerOutput());
+                if (!CreateShaderVariation(vs))
                     vs = nullptr;
-                }
             }
             else
                 vs = nullptr;
@@ -1009,16 +1008,12 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
     {
         if (ps && !ps->GetGPUObject())
         {
-            if (ps->GetCompilerOutput().Empty())
+            if (IsShaderVariationPending(ps) || ps->GetCompilerOutput().Empty())
             {
                 URHO3D_PROFILE(CompilePixelShader);
 
-                bool success = ps->Create();
-                if (!success)
-                {
-                    URHO3D_LOGERROR("Failed to compile pixel shader " + ps->GetFullName() + ":\n" + ps->GetCompilerOutput());
+                if (!CreateShaderVariation(ps))
                     ps = nullptr;
-                }
             }
             else
                 ps = nullptr;
@@ -1214,6 +1209,48 @@ void Graphics::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
     buffer->SetParameter(i->second_.offset_, sizeof(Matrix3x4), &matrix);
 }
 
+void Graphics::SetShaderParameters(const ShaderParameterBlock& block)
+{
+    if (!impl_->shaderProgram_ || block.IsEmpty())
+        return;
+
+    const PODVector<const ShaderParameter*>& layout = block.GetLayout(impl_->shaderProgram_, impl_->shaderProgram_->parameters_);
+    const PODVector<ShaderParameterBlockEntry>& entries = block.GetEntries();
+    const float* data = block.GetData();
+
+    for (unsigned i = 0; i < entries.Size(); ++i)
+    {
+        const ShaderParameter* info = layout[i];
+        if (!info)
+            continue;
+
+        const ShaderParameterBlockEntry& entry = entries[i];
+        const float* value = data + entry.offset_;
+        ConstantBuffer* buffer = info->bufferPtr_;
+        if (!buffer->IsDirty())
+            impl_->dirtyConstantBuffers_.Push(buffer);
+
+        switch (entry.type_)
+        {
+        case VAR_BOOL:
+            {
+                bool boolValue = *value != 0.0f;
+                buffer->SetParameter(info->offset_, sizeof(bool), &boolValue);
+            }
+            break;
+
+        case VAR_MATRIX3:
+            buffer->SetVector3ArrayParameter(info->offset_, 3, value);
+            break;
+
+        default:
+            // Integers are stored as their bit pattern, so they can be copied like floats
+            buffer->SetParameter(info->offset_, (unsigned)(entry.count_ * sizeof(float)), value);
+            break;
+        }
+    }
+}
+
 bool Graphics::NeedParameterUpdate(ShaderParameterGroup group, const void* source)
 {
     if ((unsigned)(size_t)shaderParameterSources_[group] == M_MAX_UNSIGNED || shaderParameterSources_[group] != source)
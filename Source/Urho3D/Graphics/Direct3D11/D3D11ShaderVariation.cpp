@@ -51,6 +51,11 @@ const char* ShaderVariation::elementSemanticNames[] =
     "OBJECTINDEX"
 };
 
+bool ShaderVariation::GetByteCodeSupport()
+{
+    return true;
+}
+
 void ShaderVariation::OnDeviceLost()
 {
     // No-op on Direct3D11
@@ -69,24 +74,35 @@ bool ShaderVariation::Create()
         return false;
     }
 
-    // Check for up-to-date bytecode on disk
-    String path, name, extension;
-    SplitPath(owner_->GetName(), path, name, extension);
-    extension = type_ == VS ? ".vs4" : ".ps4";
+    return CompileByteCode(owner_->GetSourceCode(type_), compilerOutput_) && CreateObject();
+}
+
+bool ShaderVariation::CompileByteCode(const String& sourceCode, String& compilerOutput)
+{
+    if (!graphics_ || !owner_)
+        return false;
 
-    String binaryShaderName = graphics_->GetShaderCacheDir() + name + "_" + StringHash(defines_).ToString() + extension;
+    // Check for bytecode on disk. The file name contains the content hash, so a file that exists is up to date
+    String binaryShaderName = GetCacheFileName(sourceCode, type_ == VS ? ".vs4" : ".ps4");
 
-    if (!LoadByteCode(binaryShaderName))
+    loadedFromCache_ = LoadByteCode(binaryShaderName);
+    if (!loadedFromCache_)
     {
-        // Compile shader if don't have valid bytecode
-        if (!Compile())
+        // Compile shader if don't have valid bytecode, then save it. This works also for sources in packages
+        if (!Compile(sourceCode, compilerOutput))
             return false;
-        // Save the bytecode after successful compile, but not if the source is from a package
-        if (owner_->GetTimeStamp())
-            SaveByteCode(binaryShaderName);
+        SaveByteCode(binaryShaderName);
     }
 
-    // Then create shader from the bytecode
+    return true;
+}
+
+bool ShaderVariation::CreateObject()
+{
+    if (!graphics_)
+        return false;
+
+    // Create shader from the bytecode
     ID3D11Device* device = graphics_->GetImpl()->GetDevice();
     if (type_ == VS)
     {
@@ -170,13 +186,6 @@ bool ShaderVariation::LoadByteCode(const String& binaryShaderName)
     if (!cache->Exists(binaryShaderName))
         return false;
 
-    FileSystem* fileSystem = owner_->GetSubsystem<FileSystem>();
-    unsigned sourceTimeStamp = owner_->GetTimeStamp();
-    // If source code is loaded from a package, its timestamp will be zero. Else check that binary is not older
-    // than source
-    if (sourceTimeStamp && fileSystem->GetLastModifiedTime(cache->GetResourceFileName(binaryShaderName)) < sourceTimeStamp)
-        return false;
-
     SharedPtr<File> file = cache->GetFile(binaryShaderName);
     if (!file || file->ReadFileID() != "USHD")
     {
@@ -232,9 +241,8 @@ bool ShaderVariation::LoadByteCode(const String& binaryShaderName)
     }
 }
 
-bool ShaderVariation::Compile()
+bool ShaderVariation::Compile(const String& sourceCode, String& compilerOutput)
 {
-    const String& sourceCode = owner_->GetSourceCode(type_);
     Vector<String> defines = defines_.Split(' ');
 
     // Set the entrypoint, profile and flags according to the shader being compiled
@@ -303,7 +311,7 @@ bool ShaderVariation::Compile()
     if (FAILED(hr))
     {
         // Do not include end zero unnecessarily
-        compilerOutput_ = String((const char*)errorMsgs->GetBufferPointer(), (unsigned)errorMsgs->GetBufferSize() - 1);
+        compilerOutput = String((const char*)errorMsgs->GetBufferPointer(), (unsigned)errorMsgs->GetBufferSize() - 1);
     }
     else
     {
@@ -164,6 +164,32 @@ bool VertexBuffer::SetDataRange(const void* data, unsigned start, unsigned count
     return true;
 }
 
+bool VertexBuffer::SetDataRangeNoOverwrite(const void* data, unsigned start, unsigned count)
+{
+    // Range errors are reported by SetDataRange()
+    if (!object_.ptr_ || !dynamic_ || !data || !count || start + count > vertexCount_)
+        return SetDataRange(data, start, count);
+
+    if (shadowData_ && shadowData_.Get() + start * vertexSize_ != data)
+        memcpy(shadowData_.Get() + start * vertexSize_, data, count * vertexSize_);
+
+    D3D11_MAPPED_SUBRESOURCE mappedData;
+    mappedData.pData = nullptr;
+
+    HRESULT hr = graphics_->GetImpl()->GetDeviceContext()->Map((ID3D11Buffer*)object_.ptr_, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0,
+        &mappedData);
+    if (FAILED(hr) || !mappedData.pData)
+    {
+        URHO3D_LOGD3DERROR("Failed to map vertex buffer", hr);
+        return false;
+    }
+
+    // The whole buffer is mapped, so offset to the start of the range
+    memcpy((unsigned char*)mappedData.pData + start * vertexSize_, data, count * vertexSize_);
+    graphics_->GetImpl()->GetDeviceContext()->Unmap((ID3D11Buffer*)object_.ptr_, 0);
+    return true;
+}
+
 void* VertexBuffer::Lock(unsigned start, unsigned count, bool discard)
 {
     if (lockState_ != LOCK_NONE)
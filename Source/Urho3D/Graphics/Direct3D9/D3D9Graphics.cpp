@@ -30,6 +30,7 @@
 #include "../../Graphics/GraphicsImpl.h"
 #include "../../Graphics/IndexBuffer.h"
 #include "../../Graphics/Shader.h"
+#include "../../Graphics/ShaderParameterBlock.h"
 #include "../../Graphics/ShaderPrecache.h"
 #include "../../Graphics/ShaderProgram.h"
 #include "../../Graphics/Texture2D.h"
@@ -269,6 +270,8 @@ Graphics::Graphics(Context* context) :
 
 Graphics::~Graphics()
 {
+    CompleteShaderCompiles();
+
     {
         MutexLock lock(gpuObjectMutex_);
 
@@ -1119,19 +1122,15 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
 
     if (vs != vertexShader_)
     {
-        // Create the shader now if not yet created. If already attempted, do not retry
+        // Create the shader now if not yet created. If already attempted, do not retry unless still compiling in the background
         if (vs && !vs->GetGPUObject())
         {
-            if (vs->GetCompilerOutput().Empty())
+            if (IsShaderVariationPending(vs) || vs->GetCompilerOutput().Empty())
             {
                 URHO3D_PROFILE(CompileVertexShader);
 
-                bool success = vs->Create();
-                if (!success)
-                {
-                    URHO3D_LOGERROR("Failed to compile vertex shader " + vs->GetFullName() + ":\n" + vs->GetCompilerOutput());
+                if (!CreateShaderVariation(vs))
                     vs = nullptr;
-                }
             }
             else
                 vs = nullptr;
@@ -1152,16 +1151,12 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
     {
         if (ps && !ps->GetGPUObject())
         {
-            if (ps->GetCompilerOutput().Empty())
+            if (IsShaderVariationPending(ps) || ps->GetCompilerOutput().Empty())
             {
                 URHO3D_PROFILE(CompilePixelShader);
 
-                bool success = ps->Create();
-                if (!success)
-                {
-                    URHO3D_LOGERROR("Failed to compile pixel shader " + ps->GetFullName() + ":\n" + ps->GetCompilerOutput());
+                if (!CreateShaderVariation(ps))
                     ps = nullptr;
-                }
             }
             else
                 ps = nullptr;
@@ -1358,6 +1353,77 @@ void Graphics::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
         impl_->device_->SetPixelShaderConstantF(i->second_.register_, matrix.Data(), 3);
 }
 
+void Graphics::SetShaderParameters(const ShaderParameterBlock& block)
+{
+    if (!impl_->shaderProgram_ || block.IsEmpty())
+        return;
+
+    const PODVector<const ShaderParameter*>& layout = block.GetLayout(impl_->shaderProgram_, impl_->shaderProgram_->parameters_);
+    const PODVector<ShaderParameterBlockEntry>& entries = block.GetEntries();
+    const float* data = block.GetData();
+    Vector4 paddedVector;
+    Matrix3x4 paddedMatrix;
+
+    for (unsigned i = 0; i < entries.Size(); ++i)
+    {
+        const ShaderParameter* info = layout[i];
+        if (!info)
+            continue;
+
+        const ShaderParameterBlockEntry& entry = entries[i];
+        const float* value = data + entry.offset_;
+        unsigned rows = entry.count_ / 4;
+
+        switch (entry.type_)
+        {
+        case VAR_BOOL:
+            {
+                BOOL boolValue = *value != 0.0f;
+                if (info->type_ == VS)
+                    impl_->device_->SetVertexShaderConstantB(info->register_, &boolValue, 1);
+                else
+                    impl_->device_->SetPixelShaderConstantB(info->register_, &boolValue, 1);
+            }
+            continue;
+
+        case VAR_INT:
+            {
+                int intValue;
+                memcpy(&intValue, value, sizeof intValue);
+                if (info->type_ == VS)
+                    impl_->device_->SetVertexShaderConstantI(info->register_, &intValue, 1);
+                else
+                    impl_->device_->SetPixelShaderConstantI(info->register_, &intValue, 1);
+            }
+            continue;
+
+        case VAR_FLOAT:
+        case VAR_VECTOR2:
+        case VAR_VECTOR3:
+            // Pad to a full register
+            paddedVector = Vector4::ZERO;
+            memcpy(&paddedVector.x_, value, entry.count_ * sizeof(float));
+            value = paddedVector.Data();
+            rows = 1;
+            break;
+
+        case VAR_MATRIX3:
+            paddedMatrix = Matrix3x4(*reinterpret_cast<const Matrix3*>(value));
+            value = paddedMatrix.Data();
+            rows = 3;
+            break;
+
+        default:
+            break;
+        }
+
+        if (info->type_ == VS)
+            impl_->device_->SetVertexShaderConstantF(info->register_, value, rows);
+        else
+            impl_->device_->SetPixelShaderConstantF(info->register_, value, rows);
+    }
+}
+
 bool Graphics::NeedParameterUpdate(ShaderParameterGroup group, const void* source)
 {
     if ((unsigned)(size_t)shaderParameterSources_[group] == M_MAX_UNSIGNED || shaderParameterSources_[group] != source)
@@ -69,6 +69,11 @@ void CopyStrippedCode(PODVector<unsigned char>& byteCode, unsigned char* bufData
     }
 }
 
+bool ShaderVariation::GetByteCodeSupport()
+{
+    return true;
+}
+
 void ShaderVariation::OnDeviceLost()
 {
     // No-op on Direct3D9, shaders are preserved through a device loss & reset
@@ -87,24 +92,38 @@ bool ShaderVariation::Create()
         return false;
     }
 
-    // Check for up-to-date bytecode on disk
-    String path, name, extension;
-    SplitPath(owner_->GetName(), path, name, extension);
-    extension = type_ == VS ? ".vs3" : ".ps3";
+    return CompileByteCode(owner_->GetSourceCode(type_), compilerOutput_) && CreateObject();
+}
 
-    String binaryShaderName = graphics_->GetShaderCacheDir() + name + "_" + StringHash(defines_).ToString() + extension;
+bool ShaderVariation::CompileByteCode(const String& sourceCode, String& compilerOutput)
+{
+    if (!graphics_ || !owner_)
+        return false;
+
+    // Check for bytecode on disk. The file name contains the content hash, so a file that exists is up to date
+    String binaryShaderName = GetCacheFileName(sourceCode, type_ == VS ? ".vs3" : ".ps3");
 
-    if (!LoadByteCode(binaryShaderName))
+    loadedFromCache_ = LoadByteCode(binaryShaderName);
+    if (!loadedFromCache_)
     {
-        // Compile shader if don't have valid bytecode
-        if (!Compile())
+        // Compile shader if don't have valid bytecode, then save it. This works also for sources in packages
+        if (!Compile(sourceCode, compilerOutput))
             return false;
-        // Save the bytecode after successful compile, but not if the source is from a package
-        if (owner_->GetTimeStamp())
-            SaveByteCode(binaryShaderName);
+        SaveByteCode(binaryShaderName);
     }
 
-    // Then create shader from the bytecode
+    return true;
+}
+
+bool ShaderVariation::CreateObject()
+{
+    if (!graphics_ || byteCode_.Empty())
+    {
+        compilerOutput_ = "Could not create shader, empty bytecode";
+        return false;
+    }
+
+    // Create shader from the bytecode
     IDirect3DDevice9* device = graphics_->GetImpl()->GetDevice();
     if (type_ == VS)
     {
@@ -174,13 +193,6 @@ bool ShaderVariation::LoadByteCode(const String& binaryShaderName)
     if (!cache->Exists(binaryShaderName))
         return false;
 
-    FileSystem* fileSystem = owner_->GetSubsystem<FileSystem>();
-    unsigned sourceTimeStamp = owner_->GetTimeStamp();
-    // If source code is loaded from a package, its timestamp will be zero. Else check that binary is not older
-    // than source
-    if (sourceTimeStamp && fileSystem->GetLastModifiedTime(cache->GetResourceFileName(binaryShaderName)) < sourceTimeStamp)
-        return false;
-
     SharedPtr<File> file = cache->GetFile(binaryShaderName);
     if (!file || file->ReadFileID() != "USHD")
     {
@@ -232,9 +244,8 @@ bool ShaderVariation::LoadByteCode(const String& binaryShaderName)
     }
 }
 
-bool ShaderVariation::Compile()
+bool ShaderVariation::Compile(const String& sourceCode, String& compilerOutput)
 {
-    const String& sourceCode = owner_->GetSourceCode(type_);
     Vector<String> defines = defines_.Split(' ');
 
     // Set the entrypoint, profile and flags according to the shader being compiled
@@ -301,7 +312,7 @@ bool ShaderVariation::Compile()
     if (FAILED(hr))
     {
         // Do not include end zero unnecessarily
-        compilerOutput_ = String((const char*)errorMsgs->GetBufferPointer(), (unsigned)errorMsgs->GetBufferSize() - 1);
+        compilerOutput = String((const char*)errorMsgs->GetBufferPointer(), (unsigned)errorMsgs->GetBufferSize() - 1);
     }
     else
     {
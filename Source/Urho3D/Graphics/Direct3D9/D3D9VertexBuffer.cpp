@@ -160,6 +160,28 @@ bool VertexBuffer::SetDataRange(const void* data, unsigned start, unsigned count
     return true;
 }
 
+bool VertexBuffer::SetDataRangeNoOverwrite(const void* data, unsigned start, unsigned count)
+{
+    // Range errors are reported by SetDataRange()
+    if (!object_.ptr_ || !dynamic_ || !data || !count || start + count > vertexCount_ || graphics_->IsDeviceLost())
+        return SetDataRange(data, start, count);
+
+    if (shadowData_ && shadowData_.Get() + start * vertexSize_ != data)
+        memcpy(shadowData_.Get() + start * vertexSize_, data, count * vertexSize_);
+
+    void* hwData = nullptr;
+    HRESULT hr = ((IDirect3DVertexBuffer9*)object_.ptr_)->Lock(start * vertexSize_, count * vertexSize_, &hwData, D3DLOCK_NOOVERWRITE);
+    if (FAILED(hr))
+    {
+        URHO3D_LOGD3DERROR("Could not lock vertex buffer", hr);
+        return false;
+    }
+
+    memcpy(hwData, data, count * vertexSize_);
+    ((IDirect3DVertexBuffer9*)object_.ptr_)->Unlock();
+    return true;
+}
+
 void* VertexBuffer::Lock(unsigned start, unsigned count, bool discard)
 {
     if (lockState_ != LOCK_NONE)
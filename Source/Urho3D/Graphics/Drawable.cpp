@@ -64,15 +64,19 @@ Drawable::Drawable(Context* context, unsigned char drawableFlags) :
     castShadows_(false),
     occluder_(false),
     occludee_(true),
+    static_(false),
+    inStaticBVH_(false),
     updateQueued_(false),
     zoneDirty_(false),
     octant_(nullptr),
+    octantIndex_(0),
     zone_(nullptr),
     viewMask_(DEFAULT_VIEWMASK),
     lightMask_(DEFAULT_LIGHTMASK),
     shadowMask_(DEFAULT_SHADOWMASK),
     zoneMask_(DEFAULT_ZONEMASK),
     viewFrameNumber_(0),
+    updateFrameNumber_(0),
     distance_(0.0f),
     lodDistance_(0.0f),
     drawDistance_(0.0f),
@@ -103,6 +107,7 @@ void Drawable::RegisterObject(Context* context)
     URHO3D_ATTRIBUTE("Light Mask", int, lightMask_, DEFAULT_LIGHTMASK, AM_DEFAULT);
     URHO3D_ATTRIBUTE("Shadow Mask", int, shadowMask_, DEFAULT_SHADOWMASK, AM_DEFAULT);
     URHO3D_ACCESSOR_ATTRIBUTE("Zone Mask", GetZoneMask, SetZoneMask, unsigned, DEFAULT_ZONEMASK, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Static", IsStatic, SetStatic, bool, false, AM_DEFAULT);
 }
 
 void Drawable::OnSetEnabled()
@@ -191,6 +196,9 @@ void Drawable::SetLodBias(float bias)
 void Drawable::SetViewMask(unsigned mask)
 {
     viewMask_ = mask;
+    // Queries read the view mask from the octant's cached data
+    if (octant_)
+        octant_->UpdateDrawableViewMask(this);
     MarkNetworkUpdate();
 }
 
@@ -244,6 +252,18 @@ void Drawable::SetOccludee(bool enable)
     }
 }
 
+void Drawable::SetStatic(bool enable)
+{
+    if (enable != static_)
+    {
+        static_ = enable;
+        // Reinsert to octree to move between the octants and the static bounding volume hierarchy
+        if (octant_ && !updateQueued_)
+            octant_->GetRoot()->QueueUpdate(this);
+        MarkNetworkUpdate();
+    }
+}
+
 void Drawable::MarkForUpdate()
 {
     if (!updateQueued_ && octant_)
@@ -373,7 +393,7 @@ void Drawable::OnSceneSet(Scene* scene)
 
 void Drawable::OnMarkedDirty(Node* node)
 {
-    worldBoundingBoxDirty_ = true;
+    MarkWorldBoundingBoxDirty();
     if (!updateQueued_ && octant_)
         octant_->GetRoot()->QueueUpdate(this);
 
@@ -382,6 +402,13 @@ void Drawable::OnMarkedDirty(Node* node)
         zoneDirty_ = true;
 }
 
+void Drawable::MarkWorldBoundingBoxDirty()
+{
+    worldBoundingBoxDirty_ = true;
+    if (octant_)
+        octant_->InvalidateDrawableBox(this);
+}
+
 void Drawable::AddToOctree()
 {
     // Do not add to octree when disabled
@@ -393,7 +420,10 @@ void Drawable::AddToOctree()
     {
         auto* octree = scene->GetComponent<Octree>();
         if (octree)
+        {
+            octree->CancelRemoval(this);
             octree->InsertDrawable(this);
+        }
         else
             URHO3D_LOGERROR("No Octree component in scene, drawable will not render");
     }
@@ -409,6 +439,17 @@ void Drawable::RemoveFromOctree()
     if (octant_)
     {
         Octree* octree = octant_->GetRoot();
+
+        // When the scene is detaching a batch of nodes, let the octree remove all of them in one pass. Not possible when
+        // being destroyed, as the octree would be left with a dangling pointer
+        Scene* scene = octree->GetScene();
+        if (scene && scene->IsBatchRemoving() && Refs())
+        {
+            OnRemoveFromOctree();
+            octree->QueueRemoval(this);
+            return;
+        }
+
         if (updateQueued_)
             octree->CancelUpdate(this);
 
@@ -416,6 +457,7 @@ void Drawable::RemoveFromOctree()
         OnRemoveFromOctree();
 
         octant_->RemoveDrawable(this);
+        octree->CancelRemoval(this);
     }
 }
 
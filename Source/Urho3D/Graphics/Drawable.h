@@ -62,6 +62,15 @@ enum UpdateGeometryType
     UPDATE_WORKER_THREAD
 };
 
+/// Result of a drawable's animation evaluation in the octree's animation phase.
+enum AnimationEvaluation
+{
+    ANIMATION_NOT_EVALUATED = 0,
+    ANIMATION_EVALUATED,
+    ANIMATION_INTERPOLATED,
+    ANIMATION_SKIPPED
+};
+
 /// Rendering frame update parameters.
 struct RenderFrameInfo
 {
@@ -111,6 +120,7 @@ class URHO3D_API Drawable : public Component
 
     friend class Octant;
     friend class Octree;
+    friend class StaticBVH;
     friend void UpdateDrawablesWork(const WorkItem* item, unsigned threadIndex);
 
 public:
@@ -127,6 +137,10 @@ public:
     virtual void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results);
     /// Update before octree reinsertion. Is called from a worker thread
     virtual void Update(const RenderFrameInfo& frame) { }
+    /// Return whether animation should be evaluated in the octree's animation phase before the update.
+    virtual bool HasPendingAnimation() const { return false; }
+    /// Evaluate animation before the update. Is called from a worker thread and must not modify scene nodes.
+    virtual AnimationEvaluation EvaluateAnimation(const RenderFrameInfo& frame) { return ANIMATION_NOT_EVALUATED; }
     /// Calculate distance and prepare batches for rendering. May be called from worker thread(s), possibly re-entrantly.
     virtual void UpdateBatches(const RenderFrameInfo& frame);
     /// Prepare geometry for rendering.
@@ -168,6 +182,8 @@ public:
     void SetOccluder(bool enable);
     /// Set occludee flag.
     void SetOccludee(bool enable);
+    /// Set static flag. Static occludees are stored in the octree's static bounding volume hierarchy instead of its octants, and should rarely move.
+    void SetStatic(bool enable);
     /// Mark for update and octree reinsertion. Update is automatically queued when the drawable's scene node moves or changes scale.
     void MarkForUpdate();
 
@@ -213,6 +229,9 @@ public:
     /// Return occludee flag.
     bool IsOccludee() const { return occludee_; }
 
+    /// Return static flag.
+    bool IsStatic() const { return static_; }
+
     /// Return whether is in view this frame from any viewport camera. Excludes shadow map cameras.
     bool IsInView() const;
     /// Return whether is in view of a specific camera this frame. Pass in a null camera to allow any camera, including shadow map cameras.
@@ -266,6 +285,9 @@ public:
     /// Return whether is in view on the current frame. Called by View.
     bool IsInView(const RenderFrameInfo& frame, bool anyCamera = false) const;
 
+    /// Return the frame number on which the octree last processed an update of the drawable, such as movement or animation.
+    unsigned GetUpdateFrameNumber() const { return updateFrameNumber_; }
+
     /// Return whether has a base pass.
     bool HasBasePass(unsigned batchIndex) const { return (basePassFlags_ & (1u << batchIndex)) != 0; }
 
@@ -311,6 +333,8 @@ protected:
     void OnMarkedDirty(Node* node) override;
     /// Recalculate the world-space bounding box.
     virtual void OnWorldBoundingBoxUpdate() = 0;
+    /// Mark the world-space bounding box for recalculation and invalidate the octant's cached copy of it.
+    void MarkWorldBoundingBoxDirty();
 
     /// Handle removal from octree.
     virtual void OnRemoveFromOctree() { }
@@ -339,12 +363,18 @@ protected:
     bool occluder_;
     /// Occludee flag.
     bool occludee_;
+    /// Static flag.
+    bool static_;
+    /// Stored in the octree's static bounding volume hierarchy flag.
+    bool inStaticBVH_;
     /// Octree update queued flag.
     bool updateQueued_;
     /// Zone inconclusive or dirtied flag.
     bool zoneDirty_;
     /// Octree octant.
     Octant* octant_;
+    /// Index in the octant's drawable and cached bounding box arrays.
+    unsigned octantIndex_;
     /// Current zone.
     Zone* zone_;
     /// View mask.
@@ -357,6 +387,8 @@ protected:
     unsigned zoneMask_;
     /// Last visible frame number.
     unsigned viewFrameNumber_;
+    /// Last frame number on which the octree processed an update.
+    unsigned updateFrameNumber_;
     /// Current distance to camera.
     float distance_;
     /// LOD scaled distance.
@@ -25,6 +25,7 @@
 #include "../Graphics/Geometry.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/IndexBuffer.h"
+#include "../Graphics/RenderCommandBuffer.h"
 #include "../Graphics/VertexBuffer.h"
 #include "../IO/Log.h"
 #include "../Math/Ray.h"
@@ -188,6 +189,21 @@ void Geometry::Draw(Graphics* graphics)
     }
 }
 
+void Geometry::Draw(RenderCommandBuffer* buffer)
+{
+    if (indexBuffer_ && indexCount_ > 0)
+    {
+        buffer->SetIndexBuffer(indexBuffer_);
+        buffer->SetVertexBuffers(vertexBuffers_);
+        buffer->Draw(primitiveType_, indexStart_, indexCount_, vertexStart_, vertexCount_);
+    }
+    else if (vertexCount_ > 0)
+    {
+        buffer->SetVertexBuffers(vertexBuffers_);
+        buffer->Draw(primitiveType_, vertexStart_, vertexCount_);
+    }
+}
+
 VertexBuffer* Geometry::GetVertexBuffer(unsigned index) const
 {
     return index < vertexBuffers_.Size() ? vertexBuffers_[index] : nullptr;
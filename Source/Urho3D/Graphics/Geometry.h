@@ -32,6 +32,7 @@ namespace Urho3D
 class IndexBuffer;
 class Ray;
 class Graphics;
+class RenderCommandBuffer;
 class VertexBuffer;
 
 /// Defines one or more vertex buffers, an index buffer and a draw range.
@@ -66,6 +67,8 @@ public:
     void SetRawIndexData(const SharedArrayPtr<unsigned char>& data, unsigned indexSize);
     /// Draw.
     void Draw(Graphics* graphics);
+    /// Record drawing into a render command buffer.
+    void Draw(RenderCommandBuffer* buffer);
 
     /// Return all vertex buffers.
     const Vector<SharedPtr<VertexBuffer> >& GetVertexBuffers() const { return vertexBuffers_; }
@@ -39,21 +39,22 @@
 #include "../Graphics/ParticleEmitter.h"
 #include "../Graphics/RibbonTrail.h"
 #include "../Graphics/Shader.h"
+#include "../Graphics/ShaderCache.h"
 #include "../Graphics/ShaderPrecache.h"
+#include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Skybox.h"
 #include "../Graphics/StaticModelGroup.h"
 #include "../Graphics/Technique.h"
 #include "../Graphics/Terrain.h"
 #include "../Graphics/TerrainPatch.h"
-#ifdef _WIN32
 #include "../Graphics/Texture2D.h"
-#endif
 #include "../Graphics/Texture2DArray.h"
 #include "../Graphics/Texture3D.h"
 #include "../Graphics/TextureCube.h"
 #include "../Graphics/Zone.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
 
 #include <SDL/SDL.h>
 
@@ -167,6 +168,24 @@ void Graphics::SetShaderParameter(StringHash param, const Variant& value)
     }
 }
 
+ShaderVariation* Graphics::GetShader(ShaderType type, const String& name, ShaderDefineMask defines) const
+{
+    if (lastShaderName_ != name || !lastShader_)
+    {
+        auto* cache = GetSubsystem<ResourceCache>();
+
+        String fullShaderName = shaderPath_ + name + shaderExtension_;
+        // Try to reduce repeated error log prints because of missing shaders
+        if (lastShaderName_ == name && !cache->Exists(fullShaderName))
+            return nullptr;
+
+        lastShader_ = cache->GetResource<Shader>(fullShaderName);
+        lastShaderName_ = name;
+    }
+
+    return lastShader_ ? lastShader_->GetVariation(type, defines) : nullptr;
+}
+
 IntVector2 Graphics::GetWindowPosition() const
 {
     if (window_)
@@ -323,6 +342,34 @@ void Graphics::SetShaderCacheDir(const String& path)
         shaderCacheDir_ = AddTrailingSlash(trimmedPath);
 }
 
+bool Graphics::CreateShaderVariation(ShaderVariation* variation)
+{
+    auto* shaderCache = GetSubsystem<ShaderCache>();
+    bool success = shaderCache ? shaderCache->Request(variation) : variation->Create();
+
+    // A variation still compiling in the background is requested again on the next use. Its error is logged once finished
+    if (!success && (!shaderCache || !shaderCache->IsPending(variation)))
+    {
+        URHO3D_LOGERROR("Failed to compile " + String(variation->GetShaderType() == VS ? "vertex" : "pixel") + " shader " +
+            variation->GetFullName() + ":\n" + variation->GetCompilerOutput());
+    }
+
+    return success;
+}
+
+bool Graphics::IsShaderVariationPending(ShaderVariation* variation) const
+{
+    auto* shaderCache = GetSubsystem<ShaderCache>();
+    return shaderCache && shaderCache->IsPending(variation);
+}
+
+void Graphics::CompleteShaderCompiles()
+{
+    auto* shaderCache = GetSubsystem<ShaderCache>();
+    if (shaderCache)
+        shaderCache->Complete();
+}
+
 void Graphics::AddGPUObject(GPUObject* object)
 {
     MutexLock lock(gpuObjectMutex_);
@@ -46,6 +46,7 @@ class GPUObject;
 class GraphicsImpl;
 class RenderSurface;
 class Shader;
+class ShaderParameterBlock;
 class ShaderPrecache;
 class ShaderProgram;
 class ShaderVariation;
@@ -178,6 +179,8 @@ public:
     void SetShaderParameter(StringHash param, const Matrix3x4& matrix);
     /// Set shader constant from a variant. Supported variant types: bool, float, vector2, vector3, vector4, color.
     void SetShaderParameter(StringHash param, const Variant& value);
+    /// Set all shader constants of a parameter block. The parameters are located through the block's cached layout for the current shader program.
+    void SetShaderParameters(const ShaderParameterBlock& block);
     /// Check whether a shader parameter group needs update. Does not actually check whether parameters exist in the shaders.
     bool NeedParameterUpdate(ShaderParameterGroup group, const void* source);
     /// Check whether a shader parameter exists on the currently set shaders.
@@ -390,6 +393,8 @@ public:
     ShaderVariation* GetShader(ShaderType type, const String& name, const String& defines = String::EMPTY) const;
     /// Return a shader variation by name and defines.
     ShaderVariation* GetShader(ShaderType type, const char* name, const char* defines) const;
+    /// Return a shader variation by name and define mask.
+    ShaderVariation* GetShader(ShaderType type, const String& name, ShaderDefineMask defines) const;
     /// Return current vertex buffer by index.
     VertexBuffer* GetVertexBuffer(unsigned index) const;
 
@@ -613,6 +618,12 @@ private:
     void SetTextureUnitMappings();
     /// Process dirtied state before draw.
     void PrepareDraw();
+    /// Create a shader variation through the shader cache subsystem if it exists. Return false if failed, which is logged, or if still compiling in the background.
+    bool CreateShaderVariation(ShaderVariation* variation);
+    /// Return whether a shader variation is being compiled in the background by the shader cache subsystem.
+    bool IsShaderVariationPending(ShaderVariation* variation) const;
+    /// Finish background shader compiles before the shader variations are released.
+    void CompleteShaderCompiles();
     /// Create intermediate texture for multisampled backbuffer resolve. No-op if already exists.
     void CreateResolveTexture();
     /// Clean up all framebuffers. Called when destroying the context. Used only on OpenGL.
@@ -300,6 +300,9 @@ enum ShaderType
     PS,
 };
 
+/// Bitmask of registered shader defines. Addresses a shader variation without define strings.
+typedef unsigned long long ShaderDefineMask;
+
 /// Shader parameter groups for determining need to update. On APIs that support constant buffers, these correspond to different constant buffers.
 enum ShaderParameterGroup
 {
@@ -397,6 +400,7 @@ extern URHO3D_API const StringHash VSP_SKINMATRICES;
 extern URHO3D_API const StringHash VSP_VERTEXLIGHTS;
 extern URHO3D_API const StringHash PSP_AMBIENTCOLOR;
 extern URHO3D_API const StringHash PSP_CAMERAPOS;
+extern URHO3D_API const StringHash PSP_CLUSTERPARAMS;
 extern URHO3D_API const StringHash PSP_DELTATIME;
 extern URHO3D_API const StringHash PSP_DEPTHRECONSTRUCT;
 extern URHO3D_API const StringHash PSP_ELAPSEDTIME;
@@ -459,6 +463,7 @@ static const unsigned MASK_OBJECTINDEX = 0x2000;
 static const int MAX_RENDERTARGETS = 4;
 static const int MAX_VERTEX_STREAMS = 4;
 static const int MAX_CONSTANT_REGISTERS = 256;
+static const unsigned MAX_SHADER_DEFINES = 64;
 
 static const int BITS_PER_COMPONENT = 8;
 }
@@ -0,0 +1,439 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
+#include "../Graphics/Camera.h"
+#include "../Graphics/Graphics.h"
+#include "../Graphics/LightClusters.h"
+#include "../Graphics/Light.h"
+#include "../Graphics/Texture2D.h"
+#include "../Scene/Node.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Normalized depth below which all geometry falls into the first depth slice.
+static const float CLUSTER_MIN_DEPTH = 0.001f;
+
+void AssignLightClustersWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* clusters = reinterpret_cast<LightClusters*>(item->aux_);
+    auto* start = reinterpret_cast<LightClusterSlice*>(item->start_);
+    auto* end = reinterpret_cast<LightClusterSlice*>(item->end_);
+
+    while (start != end)
+        clusters->AssignSlice(*start++);
+}
+
+LightClusters::LightClusters(Context* context) :
+    Object(context),
+    minDepth_(CLUSTER_MIN_DEPTH),
+    nearClip_(0.0f),
+    farClip_(1.0f),
+    orthographic_(false),
+    numLightReferences_(0),
+    shaderParameters_(Vector4::ZERO)
+{
+    slices_.Resize(NUM_CLUSTERS_Z);
+    for (unsigned i = 0; i < NUM_CLUSTERS_Z; ++i)
+    {
+        LightClusterSlice& slice = slices_[i];
+        slice.index_ = i;
+        memset(slice.counts_, 0, sizeof slice.counts_);
+        memset(slice.offsets_, 0, sizeof slice.offsets_);
+    }
+}
+
+LightClusters::~LightClusters() = default;
+
+void LightClusters::Assign(Camera* camera, const PODVector<Light*>& lights)
+{
+    if (!camera)
+        return;
+
+    URHO3D_PROFILE(AssignLightClusters);
+
+    lights_.Clear();
+    for (PODVector<Light*>::ConstIterator i = lights.Begin(); i != lights.End() && lights_.Size() < MAX_CLUSTERED_LIGHTS; ++i)
+    {
+        if ((*i)->GetLightType() != LIGHT_DIRECTIONAL)
+            lights_.Push(*i);
+    }
+
+    view_ = camera->GetView();
+    projection_ = camera->GetProjection();
+    nearClip_ = camera->GetNearClip();
+    farClip_ = camera->GetFarClip();
+    orthographic_ = camera->IsOrthographic();
+    minDepth_ = Clamp(orthographic_ ? 0.0f : nearClip_ / farClip_, CLUSTER_MIN_DEPTH, 0.5f);
+
+    // The shader finds the depth slice as log(depth) * scale + bias from the normalized depth it already has
+    float logMinDepth = Ln(minDepth_);
+    shaderParameters_.x_ = -(float)NUM_CLUSTERS_Z / logMinDepth;
+    shaderParameters_.y_ = (float)NUM_CLUSTERS_Z;
+    shaderParameters_.w_ = 0.0f;
+
+    CalculateLightBounds();
+
+    // Assign the depth slices in worker threads. Each slice writes only its own light index list
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (queue)
+    {
+        int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
+        int slicesPerItem = Max((int)(slices_.Size() / numWorkItems), 1);
+
+        Vector<LightClusterSlice>::Iterator start = slices_.Begin();
+        for (int i = 0; i < numWorkItems && start != slices_.End(); ++i)
+        {
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->priority_ = M_MAX_UNSIGNED;
+            item->workFunction_ = AssignLightClustersWork;
+            item->aux_ = this;
+
+            Vector<LightClusterSlice>::Iterator end = slices_.End();
+            if (i < numWorkItems - 1 && end - start > slicesPerItem)
+                end = start + slicesPerItem;
+
+            item->start_ = &(*start);
+            item->end_ = &(*end);
+            queue->AddWorkItem(item);
+
+            start = end;
+        }
+
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+    {
+        for (unsigned i = 0; i < slices_.Size(); ++i)
+            AssignSlice(slices_[i]);
+    }
+
+    PackClusterData();
+    PackLightData();
+}
+
+void LightClusters::UpdateTextures()
+{
+    auto* graphics = GetSubsystem<Graphics>();
+    if (!graphics)
+        return;
+
+    unsigned height = clusterData_.Size() / (CLUSTER_TEXTURE_WIDTH * 4);
+    if (!clusterTexture_ || (unsigned)clusterTexture_->GetHeight() < height)
+    {
+        clusterTexture_ = new Texture2D(context_);
+        clusterTexture_->SetNumLevels(1);
+        clusterTexture_->SetFilterMode(FILTER_NEAREST);
+        clusterTexture_->SetAddressMode(COORD_U, ADDRESS_CLAMP);
+        clusterTexture_->SetAddressMode(COORD_V, ADDRESS_CLAMP);
+        clusterTexture_->SetSize(CLUSTER_TEXTURE_WIDTH, NextPowerOfTwo(height), Graphics::GetRGBAFloat32Format(), TEXTURE_DYNAMIC);
+    }
+    if (!lightTexture_)
+    {
+        lightTexture_ = new Texture2D(context_);
+        lightTexture_->SetNumLevels(1);
+        lightTexture_->SetFilterMode(FILTER_NEAREST);
+        lightTexture_->SetAddressMode(COORD_U, ADDRESS_CLAMP);
+        lightTexture_->SetAddressMode(COORD_V, ADDRESS_CLAMP);
+        lightTexture_->SetSize(CLUSTER_LIGHT_TEXELS, MAX_CLUSTERED_LIGHTS, Graphics::GetRGBAFloat32Format(), TEXTURE_DYNAMIC);
+    }
+
+    clusterTexture_->SetData(0, 0, 0, CLUSTER_TEXTURE_WIDTH, height, clusterData_.Buffer());
+    if (lights_.Size())
+        lightTexture_->SetData(0, 0, 0, CLUSTER_LIGHT_TEXELS, lights_.Size(), lightData_.Buffer());
+
+    // The cluster texture may have more rows than the data
+    shaderParameters_.z_ = 1.0f / (float)clusterTexture_->GetHeight();
+}
+
+unsigned LightClusters::GetClusterNumLights(unsigned x, unsigned y, unsigned z) const
+{
+    if (x >= NUM_CLUSTERS_X || y >= NUM_CLUSTERS_Y || z >= NUM_CLUSTERS_Z)
+        return 0;
+
+    return slices_[z].counts_[y * NUM_CLUSTERS_X + x];
+}
+
+unsigned LightClusters::GetClusterLightIndex(unsigned x, unsigned y, unsigned z, unsigned index) const
+{
+    if (index >= GetClusterNumLights(x, y, z))
+        return M_MAX_UNSIGNED;
+
+    const LightClusterSlice& slice = slices_[z];
+    return slice.lightIndices_[slice.offsets_[y * NUM_CLUSTERS_X + x] + index];
+}
+
+void LightClusters::CalculateLightBounds()
+{
+    lightBounds_.Resize(lights_.Size());
+
+    for (unsigned i = 0; i < lights_.Size(); ++i)
+    {
+        Light* light = lights_[i];
+        Node* lightNode = light->GetNode();
+        LightBounds& bounds = lightBounds_[i];
+        float range = light->GetRange();
+        Vector3 center = lightNode->GetWorldPosition();
+        float radius = range;
+
+        // Bound the lit part of a spot light, which is the cone clipped by the range sphere
+        if (light->GetLightType() == LIGHT_SPOT)
+        {
+            float halfFov = light->GetFov() * 0.5f;
+            if (halfFov < 90.0f)
+            {
+                Vector3 direction = lightNode->GetWorldDirection();
+                if (halfFov > 45.0f)
+                {
+                    center += direction * range * Cos(halfFov);
+                    radius = range * Sin(halfFov);
+                }
+                else
+                {
+                    radius = range / (2.0f * Cos(halfFov));
+                    center += direction * radius;
+                }
+            }
+        }
+
+        bounds.center_ = view_ * center;
+        bounds.radius_ = radius;
+
+        // Leave out lights in front of the near plane or beyond the far plane
+        float minZ = bounds.center_.z_ - radius;
+        float maxZ = bounds.center_.z_ + radius;
+        if (maxZ < nearClip_ || minZ > farClip_)
+        {
+            bounds.min_[2] = 1;
+            bounds.max_[2] = 0;
+            continue;
+        }
+
+        bounds.min_[2] = GetSlice(minZ);
+        bounds.max_[2] = GetSlice(maxZ);
+
+        // If the sphere crosses the near plane its projection is unbounded, so cover the whole screen. Otherwise project the
+        // corners of its view-space bounding box
+        if (!orthographic_ && minZ <= nearClip_)
+        {
+            bounds.min_[0] = 0;
+            bounds.min_[1] = 0;
+            bounds.max_[0] = NUM_CLUSTERS_X - 1;
+            bounds.max_[1] = NUM_CLUSTERS_Y - 1;
+            continue;
+        }
+
+        Vector2 minNdc(M_INFINITY, M_INFINITY);
+        Vector2 maxNdc(-M_INFINITY, -M_INFINITY);
+        for (unsigned j = 0; j < 8; ++j)
+        {
+            Vector3 corner(bounds.center_.x_ + ((j & 1u) ? radius : -radius), bounds.center_.y_ + ((j & 2u) ? radius : -radius),
+                bounds.center_.z_ + ((j & 4u) ? radius : -radius));
+            Vector4 clip = projection_ * Vector4(corner, 1.0f);
+            Vector2 ndc(clip.x_ / clip.w_, clip.y_ / clip.w_);
+            minNdc = Vector2(Min(minNdc.x_, ndc.x_), Min(minNdc.y_, ndc.y_));
+            maxNdc = Vector2(Max(maxNdc.x_, ndc.x_), Max(maxNdc.y_, ndc.y_));
+        }
+
+        if (maxNdc.x_ < -1.0f || maxNdc.y_ < -1.0f || minNdc.x_ > 1.0f || minNdc.y_ > 1.0f)
+        {
+            bounds.min_[2] = 1;
+            bounds.max_[2] = 0;
+            continue;
+        }
+
+        bounds.min_[0] = Clamp(FloorToInt((minNdc.x_ * 0.5f + 0.5f) * NUM_CLUSTERS_X), 0, (int)NUM_CLUSTERS_X - 1);
+        bounds.min_[1] = Clamp(FloorToInt((minNdc.y_ * 0.5f + 0.5f) * NUM_CLUSTERS_Y), 0, (int)NUM_CLUSTERS_Y - 1);
+        bounds.max_[0] = Clamp(FloorToInt((maxNdc.x_ * 0.5f + 0.5f) * NUM_CLUSTERS_X), 0, (int)NUM_CLUSTERS_X - 1);
+        bounds.max_[1] = Clamp(FloorToInt((maxNdc.y_ * 0.5f + 0.5f) * NUM_CLUSTERS_Y), 0, (int)NUM_CLUSTERS_Y - 1);
+    }
+}
+
+void LightClusters::AssignSlice(LightClusterSlice& slice) const
+{
+    auto z = (int)slice.index_;
+    float sliceNear = GetSliceDepth(slice.index_);
+    float sliceFar = GetSliceDepth(slice.index_ + 1);
+
+    slice.lightIndices_.Clear();
+
+    // Gather the lights whose depth range covers the slice
+    PODVector<unsigned> sliceLights;
+    for (unsigned i = 0; i < lightBounds_.Size(); ++i)
+    {
+        const LightBounds& bounds = lightBounds_[i];
+        if (z >= bounds.min_[2] && z <= bounds.max_[2])
+            sliceLights.Push(i);
+    }
+
+    for (unsigned y = 0; y < NUM_CLUSTERS_Y; ++y)
+    {
+        float ndcY0 = (float)y / NUM_CLUSTERS_Y * 2.0f - 1.0f;
+        float ndcY1 = (float)(y + 1) / NUM_CLUSTERS_Y * 2.0f - 1.0f;
+
+        for (unsigned x = 0; x < NUM_CLUSTERS_X; ++x)
+        {
+            unsigned tile = y * NUM_CLUSTERS_X + x;
+            slice.offsets_[tile] = slice.lightIndices_.Size();
+            slice.counts_[tile] = 0;
+
+            if (sliceLights.Empty())
+                continue;
+
+            float ndcX0 = (float)x / NUM_CLUSTERS_X * 2.0f - 1.0f;
+            float ndcX1 = (float)(x + 1) / NUM_CLUSTERS_X * 2.0f - 1.0f;
+
+            // Calculate the view-space bounding box of the cluster by unprojecting the tile corners at the slice depths.
+            // The projection has no skew, so only the diagonal, offset and w terms are needed
+            BoundingBox box;
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                float viewZ = j ? sliceFar : sliceNear;
+                float w = projection_.m32_ * viewZ + projection_.m33_;
+                float x0 = (ndcX0 * w - projection_.m02_ * viewZ - projection_.m03_) / projection_.m00_;
+                float x1 = (ndcX1 * w - projection_.m02_ * viewZ - projection_.m03_) / projection_.m00_;
+                float y0 = (ndcY0 * w - projection_.m12_ * viewZ - projection_.m13_) / projection_.m11_;
+                float y1 = (ndcY1 * w - projection_.m12_ * viewZ - projection_.m13_) / projection_.m11_;
+                box.Merge(Vector3(x0, y0, viewZ));
+                box.Merge(Vector3(x1, y1, viewZ));
+            }
+
+            for (PODVector<unsigned>::ConstIterator i = sliceLights.Begin(); i != sliceLights.End(); ++i)
+            {
+                const LightBounds& bounds = lightBounds_[*i];
+                if ((int)x < bounds.min_[0] || (int)x > bounds.max_[0] || (int)y < bounds.min_[1] || (int)y > bounds.max_[1])
+                    continue;
+
+                Vector3 closest = VectorMax(box.min_, VectorMin(bounds.center_, box.max_));
+                if ((closest - bounds.center_).LengthSquared() > bounds.radius_ * bounds.radius_)
+                    continue;
+
+                slice.lightIndices_.Push(*i);
+                if (++slice.counts_[tile] >= MAX_LIGHTS_PER_CLUSTER)
+                    break;
+            }
+        }
+    }
+}
+
+void LightClusters::PackClusterData()
+{
+    unsigned numTexels = NUM_CLUSTERS;
+    numLightReferences_ = 0;
+    for (unsigned i = 0; i < slices_.Size(); ++i)
+    {
+        const LightClusterSlice& slice = slices_[i];
+        for (unsigned j = 0; j < NUM_CLUSTERS_X * NUM_CLUSTERS_Y; ++j)
+            numTexels += (slice.counts_[j] + 3) / 4;
+        numLightReferences_ += slice.lightIndices_.Size();
+    }
+
+    unsigned height = (numTexels + CLUSTER_TEXTURE_WIDTH - 1) / CLUSTER_TEXTURE_WIDTH;
+    clusterData_.Resize(height * CLUSTER_TEXTURE_WIDTH * 4);
+    memset(clusterData_.Buffer(), 0, clusterData_.Size() * sizeof(float));
+    shaderParameters_.z_ = 1.0f / (float)height;
+
+    // The cluster index matches the shader: slice, then tile row, then tile column
+    float* data = clusterData_.Buffer();
+    unsigned texel = NUM_CLUSTERS;
+    for (unsigned i = 0; i < slices_.Size(); ++i)
+    {
+        const LightClusterSlice& slice = slices_[i];
+        for (unsigned j = 0; j < NUM_CLUSTERS_X * NUM_CLUSTERS_Y; ++j)
+        {
+            unsigned count = slice.counts_[j];
+            float* entry = data + (i * NUM_CLUSTERS_X * NUM_CLUSTERS_Y + j) * 4;
+            entry[0] = (float)texel;
+            entry[1] = (float)count;
+
+            const unsigned* indices = slice.lightIndices_.Buffer() + slice.offsets_[j];
+            float* dest = data + texel * 4;
+            for (unsigned k = 0; k < count; ++k)
+                dest[k] = (float)indices[k];
+
+            texel += (count + 3) / 4;
+        }
+    }
+}
+
+void LightClusters::PackLightData()
+{
+    lightData_.Resize(lights_.Size() * CLUSTER_LIGHT_TEXELS);
+
+    for (unsigned i = 0; i < lights_.Size(); ++i)
+    {
+        Light* light = lights_[i];
+        Node* lightNode = light->GetNode();
+        Vector4* dest = &lightData_[i * CLUSTER_LIGHT_TEXELS];
+
+        // Same attenuation and spot cone as vertex lights, but a point light's cutoff passes every direction
+        float invRange = 1.0f / Max(light->GetRange(), M_EPSILON);
+        float cutoff = -2.0f;
+        float invCutoff = 1.0f;
+        if (light->GetLightType() == LIGHT_SPOT)
+        {
+            cutoff = Cos(light->GetFov() * 0.5f);
+            invCutoff = 1.0f / Max(1.0f - cutoff, M_EPSILON);
+        }
+
+        float fade = 1.0f;
+        float fadeEnd = light->GetDrawDistance();
+        float fadeStart = light->GetFadeDistance();
+        if (fadeEnd > 0.0f && fadeStart > 0.0f && fadeStart < fadeEnd)
+            fade = Min(1.0f - (light->GetDistance() - fadeStart) / (fadeEnd - fadeStart), 1.0f);
+
+        Color color = light->GetEffectiveColor() * fade;
+        dest[0] = Vector4(lightNode->GetWorldPosition(), invRange);
+        dest[1] = Vector4(color.r_, color.g_, color.b_, light->GetEffectiveSpecularIntensity());
+        dest[2] = Vector4(-lightNode->GetWorldDirection(), cutoff);
+        dest[3] = Vector4(invCutoff, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+int LightClusters::GetSlice(float viewZ) const
+{
+    float depth = orthographic_ ? (viewZ - nearClip_) / (farClip_ - nearClip_) : viewZ / farClip_;
+    if (depth <= minDepth_)
+        return 0;
+
+    return Clamp(FloorToInt(Ln(depth) * shaderParameters_.x_ + shaderParameters_.y_), 0, (int)NUM_CLUSTERS_Z - 1);
+}
+
+float LightClusters::GetSliceDepth(unsigned slice) const
+{
+    if (!slice)
+        return nearClip_;
+    if (slice >= NUM_CLUSTERS_Z)
+        return farClip_;
+
+    float depth = Pow(minDepth_, 1.0f - (float)slice / NUM_CLUSTERS_Z);
+    return orthographic_ ? nearClip_ + depth * (farClip_ - nearClip_) : depth * farClip_;
+}
+
+}
@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Core/Object.h"
+#include "../Math/Matrix3x4.h"
+#include "../Math/Matrix4.h"
+#include "../Math/Vector4.h"
+
+namespace Urho3D
+{
+
+class Camera;
+class Light;
+class Texture2D;
+struct WorkItem;
+
+/// Number of light clusters horizontally.
+static const unsigned NUM_CLUSTERS_X = 16;
+/// Number of light clusters vertically.
+static const unsigned NUM_CLUSTERS_Y = 8;
+/// Number of light clusters in depth.
+static const unsigned NUM_CLUSTERS_Z = 24;
+/// Total number of light clusters.
+static const unsigned NUM_CLUSTERS = NUM_CLUSTERS_X * NUM_CLUSTERS_Y * NUM_CLUSTERS_Z;
+/// Maximum number of lights assigned to clusters per view. Must match MAX_CLUSTERED_LIGHTS in the ClusteredLighting shaders.
+static const unsigned MAX_CLUSTERED_LIGHTS = 256;
+/// Maximum number of lights per cluster. The lights sorted first are kept. Must match MAX_LIGHTS_PER_CLUSTER in the ClusteredLighting shaders.
+static const unsigned MAX_LIGHTS_PER_CLUSTER = 64;
+/// Width of the cluster data texture in texels.
+static const unsigned CLUSTER_TEXTURE_WIDTH = 1024;
+/// Texels of light data per clustered light.
+static const unsigned CLUSTER_LIGHT_TEXELS = 4;
+
+/// Depth slice of light clusters, assigned in one work item.
+struct LightClusterSlice
+{
+    /// Slice index.
+    unsigned index_;
+    /// Light count of each cluster in the slice.
+    unsigned counts_[NUM_CLUSTERS_X * NUM_CLUSTERS_Y];
+    /// Offset of each cluster's light indices in the slice's index list.
+    unsigned offsets_[NUM_CLUSTERS_X * NUM_CLUSTERS_Y];
+    /// Light indices of all clusters in the slice.
+    PODVector<unsigned> lightIndices_;
+};
+
+/// Clustered light assignment for single-pass forward lighting. Divides the view frustum into screen tiles and exponential depth slices, and assigns point and spot lights to the clusters they touch in worker threads. The results are packed into a cluster data texture, where the first texels hold the light index offset and count of each cluster followed by the light indices four per texel, and a light data texture.
+class URHO3D_API LightClusters : public Object
+{
+    URHO3D_OBJECT(LightClusters, Object);
+
+    friend void AssignLightClustersWork(const WorkItem* item, unsigned threadIndex);
+
+public:
+    /// Construct.
+    explicit LightClusters(Context* context);
+    /// Destruct.
+    ~LightClusters() override;
+
+    /// Assign lights to the clusters of a camera. Lights beyond the maximum count and directional lights are ignored. Lights should be sorted by importance, as the first ones are kept if a cluster overflows.
+    void Assign(Camera* camera, const PODVector<Light*>& lights);
+    /// Upload the assignment to the cluster textures. Does nothing without the graphics subsystem.
+    void UpdateTextures();
+
+    /// Return number of assigned lights.
+    unsigned GetNumLights() const { return lights_.Size(); }
+
+    /// Return assigned light by index.
+    Light* GetLight(unsigned index) const { return index < lights_.Size() ? lights_[index] : nullptr; }
+
+    /// Return number of lights in a cluster.
+    unsigned GetClusterNumLights(unsigned x, unsigned y, unsigned z) const;
+    /// Return light index of a cluster by its index in the cluster.
+    unsigned GetClusterLightIndex(unsigned x, unsigned y, unsigned z, unsigned index) const;
+
+    /// Return total number of light references in all clusters.
+    unsigned GetNumLightReferences() const { return numLightReferences_; }
+
+    /// Return packed cluster data, four floats per texel.
+    const PODVector<float>& GetClusterData() const { return clusterData_; }
+
+    /// Return packed light data, CLUSTER_LIGHT_TEXELS vectors per light.
+    const PODVector<Vector4>& GetLightData() const { return lightData_; }
+
+    /// Return the shader parameters of the cluster lookup: depth slice scale and bias for the logarithm of the normalized depth, and inverse cluster data texture height.
+    const Vector4& GetShaderParameters() const { return shaderParameters_; }
+
+    /// Return the cluster data texture.
+    Texture2D* GetClusterTexture() const { return clusterTexture_; }
+
+    /// Return the light data texture.
+    Texture2D* GetLightTexture() const { return lightTexture_; }
+
+private:
+    /// Calculate the view-space bounding sphere and cluster ranges of the lights.
+    void CalculateLightBounds();
+    /// Assign the lights of one depth slice. Called from worker threads.
+    void AssignSlice(LightClusterSlice& slice) const;
+    /// Pack the slices into the cluster data.
+    void PackClusterData();
+    /// Pack the light parameters into the light data.
+    void PackLightData();
+    /// Return the depth slice of a view-space depth.
+    int GetSlice(float viewZ) const;
+    /// Return the view-space depth of a depth slice boundary.
+    float GetSliceDepth(unsigned slice) const;
+
+    /// View-space bounding sphere and cluster range of an assigned light.
+    struct LightBounds
+    {
+        /// Sphere center.
+        Vector3 center_;
+        /// Sphere radius.
+        float radius_;
+        /// First cluster horizontally, vertically and in depth.
+        int min_[3];
+        /// Last cluster horizontally, vertically and in depth.
+        int max_[3];
+    };
+
+    /// Assigned lights.
+    PODVector<Light*> lights_;
+    /// Bounds of the assigned lights.
+    PODVector<LightBounds> lightBounds_;
+    /// Depth slices.
+    Vector<LightClusterSlice> slices_;
+    /// Packed cluster data.
+    PODVector<float> clusterData_;
+    /// Packed light data.
+    PODVector<Vector4> lightData_;
+    /// Camera view matrix.
+    Matrix3x4 view_;
+    /// Camera projection matrix.
+    Matrix4 projection_;
+    /// Normalized depth of the first depth slice boundary.
+    float minDepth_;
+    /// Camera near clip distance.
+    float nearClip_;
+    /// Camera far clip distance.
+    float farClip_;
+    /// Orthographic camera flag.
+    bool orthographic_;
+    /// Total number of light references in all clusters.
+    unsigned numLightReferences_;
+    /// Cluster lookup shader parameters.
+    Vector4 shaderParameters_;
+    /// Cluster data texture.
+    SharedPtr<Texture2D> clusterTexture_;
+    /// Light data texture.
+    SharedPtr<Texture2D> lightTexture_;
+};
+
+}
@@ -40,6 +40,54 @@
 namespace Urho3D
 {
 
+static void BuildMorphDeltas(VertexBufferMorph& morph)
+{
+    unsigned numElements = 0;
+    if (morph.elementMask_ & MASK_POSITION)
+        ++numElements;
+    if (morph.elementMask_ & MASK_NORMAL)
+        ++numElements;
+    if (morph.elementMask_ & MASK_TANGENT)
+        ++numElements;
+    unsigned numValues = numElements * 3;
+    unsigned vertexSize = sizeof(unsigned) + numValues * sizeof(float);
+
+    // Leave out the vertices whose deltas are all zero
+    PODVector<unsigned> movingVertices;
+    const unsigned char* src = morph.morphData_.Get();
+    for (unsigned i = 0; src && i < morph.vertexCount_; ++i)
+    {
+        const auto* values = (const float*)(src + i * vertexSize + sizeof(unsigned));
+        for (unsigned j = 0; j < numValues; ++j)
+        {
+            if (values[j] != 0.0f)
+            {
+                movingVertices.Push(i);
+                break;
+            }
+        }
+    }
+
+    morph.deltaCount_ = movingVertices.Size();
+    morph.deltaIndices_.Reset();
+    morph.deltas_.Reset();
+    if (!morph.deltaCount_)
+        return;
+
+    morph.deltaIndices_ = new unsigned[morph.deltaCount_];
+    morph.deltas_ = new float[morph.deltaCount_ * numValues];
+
+    for (unsigned i = 0; i < morph.deltaCount_; ++i)
+    {
+        const unsigned char* vertex = src + movingVertices[i] * vertexSize;
+        morph.deltaIndices_[i] = *((const unsigned*)vertex);
+
+        const auto* values = (const float*)(vertex + sizeof(unsigned));
+        for (unsigned j = 0; j < numValues; ++j)
+            morph.deltas_[j * morph.deltaCount_ + i] = values[j];
+    }
+}
+
 unsigned LookupVertexBuffer(VertexBuffer* buffer, const Vector<SharedPtr<VertexBuffer> >& buffers)
 {
     for (unsigned i = 0; i < buffers.Size(); ++i)
@@ -284,9 +332,11 @@ bool Model::BeginLoad(Deserializer& source)
             newBuffer.morphData_ = new unsigned char[newBuffer.dataSize_];
 
             source.Read(&newBuffer.morphData_[0], newBuffer.vertexCount_ * vertexSize);
+            BuildMorphDeltas(newBuffer);
 
             newMorph.buffers_[bufferIndex] = newBuffer;
             memoryUse += sizeof(VertexBufferMorph) + newBuffer.vertexCount_ * vertexSize;
+            memoryUse += newBuffer.deltaCount_ * vertexSize;
         }
 
         morphs_.Push(newMorph);
@@ -612,6 +662,12 @@ void Model::SetGeometryBoneMappings(const Vector<PODVector<unsigned> >& geometry
 void Model::SetMorphs(const Vector<ModelMorph>& morphs)
 {
     morphs_ = morphs;
+
+    for (Vector<ModelMorph>::Iterator i = morphs_.Begin(); i != morphs_.End(); ++i)
+    {
+        for (HashMap<unsigned, VertexBufferMorph>::Iterator j = i->buffers_.Begin(); j != i->buffers_.End(); ++j)
+            BuildMorphDeltas(j->second_);
+    }
 }
 
 SharedPtr<Model> Model::Clone(const String& cloneName) const
@@ -712,7 +768,7 @@ SharedPtr<Model> Model::Clone(const String& cloneName) const
     }
 
 
-    // Deep copy the morph data (if any) to allow modifying it
+    // Deep copy the morph data and delta streams (if any) to allow modifying them
     for (Vector<ModelMorph>::Iterator i = ret->morphs_.Begin(); i != ret->morphs_.End(); ++i)
     {
         ModelMorph& morph = *i;
@@ -725,6 +781,16 @@ SharedPtr<Model> Model::Clone(const String& cloneName) const
                 memcpy(cloneData.Get(), vbMorph.morphData_.Get(), vbMorph.dataSize_);
                 vbMorph.morphData_ = cloneData;
             }
+            if (vbMorph.deltaCount_)
+            {
+                unsigned numValues = CountSetBits(vbMorph.elementMask_ & (MASK_POSITION | MASK_NORMAL | MASK_TANGENT)) * 3;
+                SharedArrayPtr<unsigned> cloneIndices(new unsigned[vbMorph.deltaCount_]);
+                SharedArrayPtr<float> cloneDeltas(new float[vbMorph.deltaCount_ * numValues]);
+                memcpy(cloneIndices.Get(), vbMorph.deltaIndices_.Get(), vbMorph.deltaCount_ * sizeof(unsigned));
+                memcpy(cloneDeltas.Get(), vbMorph.deltas_.Get(), vbMorph.deltaCount_ * numValues * sizeof(float));
+                vbMorph.deltaIndices_ = cloneIndices;
+                vbMorph.deltas_ = cloneDeltas;
+            }
         }
     }
 
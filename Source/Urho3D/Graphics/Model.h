@@ -48,6 +48,12 @@ struct VertexBufferMorph
     unsigned dataSize_;
     /// Morphed vertices. Stored packed as <index, data> pairs.
     SharedArrayPtr<unsigned char> morphData_;
+    /// Number of vertices that actually move. The delta streams are built from the packed data when the model is loaded or its morphs are set.
+    unsigned deltaCount_{};
+    /// Indices of the vertices that actually move.
+    SharedArrayPtr<unsigned> deltaIndices_;
+    /// Deltas of the vertices that actually move as structure-of-arrays streams: X, Y and Z of the position, normal and tangent in the element mask, deltaCount_ values each.
+    SharedArrayPtr<float> deltas_;
 };
 
 /// Definition of a model's vertex morph.
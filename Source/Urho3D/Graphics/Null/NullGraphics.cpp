@@ -0,0 +1,1539 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../../Precompiled.h"
+
+#include "../../Core/Context.h"
+#include "../../Core/Profiler.h"
+#include "../../Graphics/ConstantBuffer.h"
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsEvents.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/IndexBuffer.h"
+#include "../../Graphics/Shader.h"
+#include "../../Graphics/ShaderParameterBlock.h"
+#include "../../Graphics/ShaderPrecache.h"
+#include "../../Graphics/ShaderProgram.h"
+#include "../../Graphics/Texture2D.h"
+#include "../../Graphics/TextureCube.h"
+#include "../../Graphics/VertexBuffer.h"
+#include "../../IO/Log.h"
+#include "../../Resource/Image.h"
+#include "../../Resource/ResourceCache.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+static unsigned GetPrimitiveCount(unsigned elementCount, PrimitiveType type)
+{
+    switch (type)
+    {
+    case TRIANGLE_LIST:
+        return elementCount / 3;
+
+    case LINE_LIST:
+        return elementCount / 2;
+
+    case POINT_LIST:
+        return elementCount;
+
+    case TRIANGLE_STRIP:
+    case TRIANGLE_FAN:
+        return elementCount > 2 ? elementCount - 2 : 0;
+
+    case LINE_STRIP:
+        return elementCount > 1 ? elementCount - 1 : 0;
+    }
+
+    return 0;
+}
+
+const Vector2 Graphics::pixelUVOffset(0.0f, 0.0f);
+bool Graphics::gl3Support = false;
+
+Graphics::Graphics(Context* context) :
+    Object(context),
+    impl_(new GraphicsImpl()),
+    shaderPath_("Shaders/HLSL/"),
+    shaderExtension_(".hlsl"),
+    orientations_("LandscapeLeft LandscapeRight"),
+    apiName_("Null")
+{
+    SetTextureUnitMappings();
+    ResetCachedState();
+
+    // Register Graphics library object factories
+    RegisterGraphicsLibrary(context_);
+}
+
+Graphics::~Graphics()
+{
+    CompleteShaderCompiles();
+
+    {
+        MutexLock lock(gpuObjectMutex_);
+
+        // Release all GPU objects that still exist
+        for (PODVector<GPUObject*>::Iterator i = gpuObjects_.Begin(); i != gpuObjects_.End(); ++i)
+            (*i)->Release();
+        gpuObjects_.Clear();
+    }
+
+    impl_->shaderPrograms_.Clear();
+    impl_->allConstantBuffers_.Clear();
+
+    delete impl_;
+    impl_ = nullptr;
+}
+
+bool Graphics::SetMode(int width, int height, bool fullscreen, bool borderless, bool resizable, float pixelRatio, bool vsync, bool tripleBuffer,
+    int multiSample, int monitor, int refreshRate)
+{
+    URHO3D_PROFILE(SetScreenMode);
+
+    // There is no window to maximize or desktop mode to match, so use the predefined default window size for zero dimensions
+    if (!width || !height)
+    {
+        width = 1024;
+        height = 768;
+    }
+
+    // Fullscreen or Borderless can not be resizable
+    if (fullscreen || borderless)
+        resizable = false;
+
+    // Borderless cannot be fullscreen, they are mutually exclusive
+    if (borderless)
+        fullscreen = false;
+
+    multiSample = Clamp(multiSample, 1, 16);
+
+    // If nothing changes, do not reset the state
+    if (impl_->initialized_ && width == width_ && height == height_ && fullscreen == fullscreen_ && borderless == borderless_ &&
+        resizable == resizable_ && vsync == vsync_ && tripleBuffer == tripleBuffer_ && pixelRatio == pixelToDevicePixelRatio_ &&
+        multiSample == multiSample_)
+        return true;
+
+    if (!impl_->initialized_)
+    {
+        CheckFeatureSupport();
+        impl_->initialized_ = true;
+    }
+
+    width_ = width;
+    height_ = height;
+    fullscreen_ = fullscreen;
+    borderless_ = borderless;
+    resizable_ = resizable;
+    pixelToDevicePixelRatio_ = pixelRatio;
+    vsync_ = vsync;
+    tripleBuffer_ = tripleBuffer;
+    multiSample_ = multiSample;
+    monitor_ = monitor;
+    refreshRate_ = refreshRate;
+
+    ResetRenderTargets();
+
+#ifdef URHO3D_LOGGING
+    String msg;
+    msg.AppendWithFormat("Set null screen mode %dx%d", width_, height_);
+    if (multiSample_ > 1)
+        msg.AppendWithFormat(" multisample %d", multiSample_);
+    URHO3D_LOGINFO(msg);
+#endif
+
+    using namespace ScreenMode;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_WIDTH] = width_;
+    eventData[P_HEIGHT] = height_;
+    eventData[P_FULLSCREEN] = fullscreen_;
+    eventData[P_BORDERLESS] = borderless_;
+    eventData[P_RESIZABLE] = resizable_;
+    eventData[P_PIXELRATIO] = pixelToDevicePixelRatio_;
+    eventData[P_MONITOR] = monitor_;
+    eventData[P_REFRESHRATE] = refreshRate_;
+    SendEvent(E_SCREENMODE, eventData);
+
+    return true;
+}
+
+bool Graphics::SetMode(int width, int height)
+{
+    return SetMode(width, height, fullscreen_, borderless_, resizable_, pixelToDevicePixelRatio_, vsync_, tripleBuffer_, multiSample_, monitor_, refreshRate_);
+}
+
+void Graphics::SetSRGB(bool enable)
+{
+    sRGB_ = enable && sRGBWriteSupport_;
+}
+
+void Graphics::SetDither(bool enable)
+{
+    // No effect on the null backend
+}
+
+void Graphics::SetFlushGPU(bool enable)
+{
+    flushGPU_ = enable;
+}
+
+void Graphics::SetForceGL2(bool enable)
+{
+    // No effect on the null backend
+}
+
+void Graphics::Close()
+{
+    impl_->initialized_ = false;
+}
+
+bool Graphics::TakeScreenShot(Image& destImage)
+{
+    if (!IsInitialized())
+        return false;
+
+    // Nothing is rasterized, so the screenshot is always black
+    destImage.SetSize(width_, height_, 3);
+    memset(destImage.GetData(), 0, (size_t)(width_ * height_ * 3));
+    return true;
+}
+
+bool Graphics::BeginFrame()
+{
+    if (!IsInitialized())
+        return false;
+
+    // Set default rendertarget and depth buffer
+    ResetRenderTargets();
+
+    // Cleanup textures from previous frame
+    for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
+        SetTexture(i, nullptr);
+
+    numPrimitives_ = 0;
+    numBatches_ = 0;
+    impl_->ResetStatistics();
+
+    SendEvent(E_BEGINRENDERING);
+    return true;
+}
+
+void Graphics::EndFrame()
+{
+    if (!IsInitialized())
+        return;
+
+    {
+        URHO3D_PROFILE(Present);
+
+        SendEvent(E_ENDRENDERING);
+    }
+
+    // Clean up too large scratch buffers
+    CleanupScratchBuffers();
+}
+
+void Graphics::Clear(unsigned flags, const Color& color, float depth, unsigned stencil)
+{
+    PrepareDraw();
+}
+
+bool Graphics::ResolveToTexture(Texture2D* destination, const IntRect& viewport)
+{
+    return destination && destination->GetRenderSurface();
+}
+
+bool Graphics::ResolveToTexture(Texture2D* texture)
+{
+    if (!texture)
+        return false;
+    RenderSurface* surface = texture->GetRenderSurface();
+    if (!surface)
+        return false;
+
+    texture->SetResolveDirty(false);
+    surface->SetResolveDirty(false);
+    return true;
+}
+
+bool Graphics::ResolveToTexture(TextureCube* texture)
+{
+    if (!texture)
+        return false;
+
+    texture->SetResolveDirty(false);
+    for (unsigned i = 0; i < MAX_CUBEMAP_FACES; ++i)
+        texture->GetRenderSurface((CubeMapFace)i)->SetResolveDirty(false);
+
+    return true;
+}
+
+void Graphics::Draw(PrimitiveType type, unsigned vertexStart, unsigned vertexCount)
+{
+    if (!vertexCount || !impl_->shaderProgram_)
+        return;
+
+    PrepareDraw();
+
+    numPrimitives_ += GetPrimitiveCount(vertexCount, fillMode_ == FILL_POINT ? POINT_LIST : type);
+    ++numBatches_;
+}
+
+void Graphics::Draw(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount)
+{
+    if (!vertexCount || !impl_->shaderProgram_)
+        return;
+
+    PrepareDraw();
+
+    numPrimitives_ += GetPrimitiveCount(indexCount, fillMode_ == FILL_POINT ? POINT_LIST : type);
+    ++numBatches_;
+}
+
+void Graphics::Draw(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned baseVertexIndex, unsigned minVertex, unsigned vertexCount)
+{
+    if (!vertexCount || !impl_->shaderProgram_)
+        return;
+
+    PrepareDraw();
+
+    numPrimitives_ += GetPrimitiveCount(indexCount, fillMode_ == FILL_POINT ? POINT_LIST : type);
+    ++numBatches_;
+}
+
+void Graphics::DrawInstanced(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount,
+    unsigned instanceCount)
+{
+    if (!indexCount || !instanceCount || !impl_->shaderProgram_)
+        return;
+
+    PrepareDraw();
+
+    numPrimitives_ += instanceCount * GetPrimitiveCount(indexCount, fillMode_ == FILL_POINT ? POINT_LIST : type);
+    ++numBatches_;
+}
+
+void Graphics::DrawInstanced(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned baseVertexIndex, unsigned minVertex,
+    unsigned vertexCount, unsigned instanceCount)
+{
+    if (!indexCount || !instanceCount || !impl_->shaderProgram_)
+        return;
+
+    PrepareDraw();
+
+    numPrimitives_ += instanceCount * GetPrimitiveCount(indexCount, fillMode_ == FILL_POINT ? POINT_LIST : type);
+    ++numBatches_;
+}
+
+void Graphics::SetVertexBuffer(VertexBuffer* buffer)
+{
+    // Note: this is not multi-instance safe
+    static PODVector<VertexBuffer*> vertexBuffers(1);
+    vertexBuffers[0] = buffer;
+    SetVertexBuffers(vertexBuffers);
+}
+
+bool Graphics::SetVertexBuffers(const PODVector<VertexBuffer*>& buffers, unsigned instanceOffset)
+{
+    if (buffers.Size() > MAX_VERTEX_STREAMS)
+    {
+        URHO3D_LOGERROR("Too many vertex buffers");
+        return false;
+    }
+
+    for (unsigned i = 0; i < MAX_VERTEX_STREAMS; ++i)
+    {
+        VertexBuffer* buffer = i < buffers.Size() ? buffers[i] : nullptr;
+        bool changed = false;
+
+        if (buffer)
+        {
+            const PODVector<VertexElement>& elements = buffer->GetElements();
+            // Check if buffer has per-instance data
+            bool hasInstanceData = elements.Size() && elements[0].perInstance_;
+            unsigned offset = hasInstanceData ? instanceOffset * buffer->GetVertexSize() : 0;
+
+            if (buffer != vertexBuffers_[i] || offset != impl_->vertexOffsets_[i])
+            {
+                vertexBuffers_[i] = buffer;
+                impl_->vertexOffsets_[i] = offset;
+                changed = true;
+            }
+        }
+        else if (vertexBuffers_[i])
+        {
+            vertexBuffers_[i] = nullptr;
+            impl_->vertexOffsets_[i] = 0;
+            changed = true;
+        }
+
+        if (changed)
+        {
+            impl_->vertexBuffersDirty_ = true;
+
+            if (impl_->firstDirtyVB_ == M_MAX_UNSIGNED)
+                impl_->firstDirtyVB_ = impl_->lastDirtyVB_ = i;
+            else
+            {
+                if (i < impl_->firstDirtyVB_)
+                    impl_->firstDirtyVB_ = i;
+                if (i > impl_->lastDirtyVB_)
+                    impl_->lastDirtyVB_ = i;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Graphics::SetVertexBuffers(const Vector<SharedPtr<VertexBuffer> >& buffers, unsigned instanceOffset)
+{
+    return SetVertexBuffers(reinterpret_cast<const PODVector<VertexBuffer*>&>(buffers), instanceOffset);
+}
+
+void Graphics::SetIndexBuffer(IndexBuffer* buffer)
+{
+    if (buffer != indexBuffer_)
+    {
+        indexBuffer_ = buffer;
+        ++impl_->numBufferChanges_;
+    }
+}
+
+void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
+{
+    // Switch to the clip plane variations if necessary
+    if (useClipPlane_)
+    {
+        if (vs)
+            vs = vs->GetOwner()->GetVariation(VS, vs->GetDefinesClipPlane());
+        if (ps)
+            ps = ps->GetOwner()->GetVariation(PS, ps->GetDefinesClipPlane());
+    }
+
+    if (vs == vertexShader_ && ps == pixelShader_)
+        return;
+
+    if (vs != vertexShader_)
+    {
+        // Create the shader now if not yet created. If already attempted, do not retry unless still compiling in the background
+        if (vs && !vs->GetGPUObject())
+        {
+            if (IsShaderVariationPending(vs) || vs->GetCompilerOutput().Empty())
+            {
+                URHO3D_PROFILE(CompileVertexShader);
+
+                if (!CreateShaderVariation(vs))
+                    vs = nullptr;
+            }
+            else
+                vs = nullptr;
+        }
+
+        vertexShader_ = vs;
+    }
+
+    if (ps != pixelShader_)
+    {
+        if (ps && !ps->GetGPUObject())
+        {
+            if (IsShaderVariationPending(ps) || ps->GetCompilerOutput().Empty())
+            {
+                URHO3D_PROFILE(CompilePixelShader);
+
+                if (!CreateShaderVariation(ps))
+                    ps = nullptr;
+            }
+            else
+                ps = nullptr;
+        }
+
+        pixelShader_ = ps;
+    }
+
+    if (vertexShader_ && pixelShader_)
+    {
+        Pair<ShaderVariation*, ShaderVariation*> key = MakePair(vertexShader_, pixelShader_);
+        ShaderProgramMap::Iterator i = impl_->shaderPrograms_.Find(key);
+        if (i != impl_->shaderPrograms_.End())
+            impl_->shaderProgram_ = i->second_.Get();
+        else
+        {
+            ShaderProgram* newProgram = impl_->shaderPrograms_[key] = new ShaderProgram(this, vertexShader_, pixelShader_);
+            impl_->shaderProgram_ = newProgram;
+        }
+
+        // A real device would rebind the constant buffers, so all parameter groups need to be resent
+        ClearParameterSources();
+        ++impl_->numShaderChanges_;
+    }
+    else
+        impl_->shaderProgram_ = nullptr;
+
+    // Store shader combination if shader dumping in progress
+    if (shaderPrecache_)
+        shaderPrecache_->StoreShaders(vertexShader_, pixelShader_);
+
+    // Update clip plane parameter if necessary
+    if (useClipPlane_)
+        SetShaderParameter(VSP_CLIPPLANE, clipPlane_);
+}
+
+void Graphics::SetShaderParameter(StringHash param, const float* data, unsigned count)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, float value)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, int value)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, bool value)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Color& color)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Vector2& vector)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Matrix3& matrix)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Vector3& vector)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Matrix4& matrix)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Vector4& vector)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
+{
+    if (impl_->shaderProgram_)
+        ++impl_->numParameterUpdates_;
+}
+
+void Graphics::SetShaderParameters(const ShaderParameterBlock& block)
+{
+    ShaderProgram* program = impl_->shaderProgram_;
+    if (!program || block.IsEmpty())
+        return;
+
+    const PODVector<const ShaderParameter*>* layout = &block.GetLayout(program, program->parameters_);
+    const PODVector<ShaderParameterBlockEntry>& entries = block.GetEntries();
+
+    // Every shader parameter is assumed to be in use. Add the ones the program has not seen yet, then resolve the layouts again
+    bool added = false;
+    for (unsigned i = 0; i < entries.Size(); ++i)
+    {
+        if (!(*layout)[i])
+        {
+            program->parameters_[entries[i].name_];
+            added = true;
+        }
+    }
+    if (added)
+    {
+        ShaderParameterBlock::InvalidateLayouts();
+        layout = &block.GetLayout(program, program->parameters_);
+    }
+
+    for (unsigned i = 0; i < entries.Size(); ++i)
+    {
+        if ((*layout)[i])
+            ++impl_->numParameterUpdates_;
+    }
+}
+
+bool Graphics::NeedParameterUpdate(ShaderParameterGroup group, const void* source)
+{
+    if ((unsigned)(size_t)shaderParameterSources_[group] == M_MAX_UNSIGNED || shaderParameterSources_[group] != source)
+    {
+        shaderParameterSources_[group] = source;
+        return true;
+    }
+    else
+        return false;
+}
+
+bool Graphics::HasShaderParameter(StringHash param)
+{
+    // Shaders are not compiled, so there is no reflection data. Treat every parameter as used so that the CPU side does
+    // the same (worst case) amount of work as with real shaders
+    return impl_->shaderProgram_ != nullptr;
+}
+
+bool Graphics::HasTextureUnit(TextureUnit unit)
+{
+    return (vertexShader_ && vertexShader_->HasTextureUnit(unit)) || (pixelShader_ && pixelShader_->HasTextureUnit(unit));
+}
+
+void Graphics::ClearParameterSource(ShaderParameterGroup group)
+{
+    shaderParameterSources_[group] = (const void*)M_MAX_UNSIGNED;
+}
+
+void Graphics::ClearParameterSources()
+{
+    for (unsigned i = 0; i < MAX_SHADER_PARAMETER_GROUPS; ++i)
+        shaderParameterSources_[i] = (const void*)M_MAX_UNSIGNED;
+}
+
+void Graphics::ClearTransformSources()
+{
+    shaderParameterSources_[SP_CAMERA] = (const void*)M_MAX_UNSIGNED;
+    shaderParameterSources_[SP_OBJECT] = (const void*)M_MAX_UNSIGNED;
+}
+
+void Graphics::SetTexture(unsigned index, Texture* texture)
+{
+    if (index >= MAX_TEXTURE_UNITS)
+        return;
+
+    // Check if texture is currently bound as a rendertarget. In that case, use its backup texture, or blank if not defined
+    if (texture)
+    {
+        if (renderTargets_[0] && renderTargets_[0]->GetParentTexture() == texture)
+            texture = texture->GetBackupTexture();
+        else
+        {
+            // Resolve multisampled texture now as necessary
+            if (texture->GetMultiSample() > 1 && texture->GetAutoResolve() && texture->IsResolveDirty())
+            {
+                if (texture->GetType() == Texture2D::GetTypeStatic())
+                    ResolveToTexture(static_cast<Texture2D*>(texture));
+                if (texture->GetType() == TextureCube::GetTypeStatic())
+                    ResolveToTexture(static_cast<TextureCube*>(texture));
+            }
+        }
+
+        if (texture && texture->GetLevelsDirty())
+            texture->RegenerateLevels();
+    }
+
+    if (texture && texture->GetParametersDirty())
+    {
+        texture->UpdateParameters();
+        textures_[index] = nullptr; // Force reassign
+    }
+
+    if (texture != textures_[index])
+    {
+        if (impl_->firstDirtyTexture_ == M_MAX_UNSIGNED)
+            impl_->firstDirtyTexture_ = impl_->lastDirtyTexture_ = index;
+        else
+        {
+            if (index < impl_->firstDirtyTexture_)
+                impl_->firstDirtyTexture_ = index;
+            if (index > impl_->lastDirtyTexture_)
+                impl_->lastDirtyTexture_ = index;
+        }
+
+        textures_[index] = texture;
+        impl_->texturesDirty_ = true;
+    }
+}
+
+void Graphics::SetTextureForUpdate(Texture* texture)
+{
+    // No-op on the null backend
+}
+
+void Graphics::SetDefaultTextureFilterMode(TextureFilterMode mode)
+{
+    if (mode != defaultTextureFilterMode_)
+    {
+        defaultTextureFilterMode_ = mode;
+        SetTextureParametersDirty();
+    }
+}
+
+void Graphics::SetDefaultTextureAnisotropy(unsigned level)
+{
+    level = Max(level, 1U);
+
+    if (level != defaultTextureAnisotropy_)
+    {
+        defaultTextureAnisotropy_ = level;
+        SetTextureParametersDirty();
+    }
+}
+
+void Graphics::Restore()
+{
+    // No-op on the null backend
+}
+
+void Graphics::SetTextureParametersDirty()
+{
+    MutexLock lock(gpuObjectMutex_);
+
+    for (PODVector<GPUObject*>::Iterator i = gpuObjects_.Begin(); i != gpuObjects_.End(); ++i)
+    {
+        Texture* texture = dynamic_cast<Texture*>(*i);
+        if (texture)
+            texture->SetParametersDirty();
+    }
+}
+
+void Graphics::ResetRenderTargets()
+{
+    for (unsigned i = 0; i < MAX_RENDERTARGETS; ++i)
+        SetRenderTarget(i, (RenderSurface*)nullptr);
+    SetDepthStencil((RenderSurface*)nullptr);
+    SetViewport(IntRect(0, 0, width_, height_));
+}
+
+void Graphics::ResetRenderTarget(unsigned index)
+{
+    SetRenderTarget(index, (RenderSurface*)nullptr);
+}
+
+void Graphics::ResetDepthStencil()
+{
+    SetDepthStencil((RenderSurface*)nullptr);
+}
+
+void Graphics::SetRenderTarget(unsigned index, RenderSurface* renderTarget)
+{
+    if (index >= MAX_RENDERTARGETS)
+        return;
+
+    if (renderTarget != renderTargets_[index])
+    {
+        renderTargets_[index] = renderTarget;
+        impl_->renderTargetsDirty_ = true;
+
+        // If the rendertarget is also bound as a texture, replace with backup texture or null
+        if (renderTarget)
+        {
+            Texture* parentTexture = renderTarget->GetParentTexture();
+
+            for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
+            {
+                if (textures_[i] == parentTexture)
+                    SetTexture(i, textures_[i]->GetBackupTexture());
+            }
+
+            // If multisampled, mark the texture & surface needing resolve
+            if (parentTexture->GetMultiSample() > 1 && parentTexture->GetAutoResolve())
+            {
+                parentTexture->SetResolveDirty(true);
+                renderTarget->SetResolveDirty(true);
+            }
+
+            // If mipmapped, mark the levels needing regeneration
+            if (parentTexture->GetLevels() > 1)
+                parentTexture->SetLevelsDirty();
+        }
+    }
+}
+
+void Graphics::SetRenderTarget(unsigned index, Texture2D* texture)
+{
+    RenderSurface* renderTarget = nullptr;
+    if (texture)
+        renderTarget = texture->GetRenderSurface();
+
+    SetRenderTarget(index, renderTarget);
+}
+
+void Graphics::SetDepthStencil(RenderSurface* depthStencil)
+{
+    if (depthStencil != depthStencil_)
+    {
+        depthStencil_ = depthStencil;
+        impl_->renderTargetsDirty_ = true;
+    }
+}
+
+void Graphics::SetDepthStencil(Texture2D* texture)
+{
+    RenderSurface* depthStencil = nullptr;
+    if (texture)
+        depthStencil = texture->GetRenderSurface();
+
+    SetDepthStencil(depthStencil);
+    // Constant depth bias depends on the bitdepth
+    impl_->rasterizerStateDirty_ = true;
+}
+
+void Graphics::SetViewport(const IntRect& rect)
+{
+    IntVector2 size = GetRenderTargetDimensions();
+
+    IntRect rectCopy = rect;
+
+    if (rectCopy.right_ <= rectCopy.left_)
+        rectCopy.right_ = rectCopy.left_ + 1;
+    if (rectCopy.bottom_ <= rectCopy.top_)
+        rectCopy.bottom_ = rectCopy.top_ + 1;
+    rectCopy.left_ = Clamp(rectCopy.left_, 0, size.x_);
+    rectCopy.top_ = Clamp(rectCopy.top_, 0, size.y_);
+    rectCopy.right_ = Clamp(rectCopy.right_, 0, size.x_);
+    rectCopy.bottom_ = Clamp(rectCopy.bottom_, 0, size.y_);
+
+    viewport_ = rectCopy;
+
+    // Disable scissor test, needs to be re-enabled by the user
+    SetScissorTest(false);
+}
+
+void Graphics::SetBlendMode(BlendMode mode, bool alphaToCoverage)
+{
+    if (mode != blendMode_ || alphaToCoverage != alphaToCoverage_)
+    {
+        blendMode_ = mode;
+        alphaToCoverage_ = alphaToCoverage;
+        impl_->blendStateDirty_ = true;
+    }
+}
+
+void Graphics::SetColorWrite(bool enable)
+{
+    if (enable != colorWrite_)
+    {
+        colorWrite_ = enable;
+        impl_->blendStateDirty_ = true;
+    }
+}
+
+void Graphics::SetCullMode(CullMode mode)
+{
+    if (mode != cullMode_)
+    {
+        cullMode_ = mode;
+        impl_->rasterizerStateDirty_ = true;
+    }
+}
+
+void Graphics::SetDepthBias(float constantBias, float slopeScaledBias)
+{
+    if (constantBias != constantDepthBias_ || slopeScaledBias != slopeScaledDepthBias_)
+    {
+        constantDepthBias_ = constantBias;
+        slopeScaledDepthBias_ = slopeScaledBias;
+        impl_->rasterizerStateDirty_ = true;
+    }
+}
+
+void Graphics::SetDepthTest(CompareMode mode)
+{
+    if (mode != depthTestMode_)
+    {
+        depthTestMode_ = mode;
+        impl_->depthStateDirty_ = true;
+    }
+}
+
+void Graphics::SetDepthWrite(bool enable)
+{
+    if (enable != depthWrite_)
+    {
+        depthWrite_ = enable;
+        impl_->depthStateDirty_ = true;
+    }
+}
+
+void Graphics::SetFillMode(FillMode mode)
+{
+    if (mode != fillMode_)
+    {
+        fillMode_ = mode;
+        impl_->rasterizerStateDirty_ = true;
+    }
+}
+
+void Graphics::SetLineAntiAlias(bool enable)
+{
+    if (enable != lineAntiAlias_)
+    {
+        lineAntiAlias_ = enable;
+        impl_->rasterizerStateDirty_ = true;
+    }
+}
+
+void Graphics::SetScissorTest(bool enable, const Rect& rect, bool borderInclusive)
+{
+    // During some light rendering loops, a full rect is toggled on/off repeatedly.
+    // Disable scissor in that case to reduce state changes
+    if (rect.min_.x_ <= 0.0f && rect.min_.y_ <= 0.0f && rect.max_.x_ >= 1.0f && rect.max_.y_ >= 1.0f)
+        enable = false;
+
+    if (enable)
+    {
+        IntVector2 rtSize(GetRenderTargetDimensions());
+        IntVector2 viewSize(viewport_.Size());
+        IntVector2 viewPos(viewport_.left_, viewport_.top_);
+        IntRect intRect;
+        int expand = borderInclusive ? 1 : 0;
+
+        intRect.left_ = Clamp((int)((rect.min_.x_ + 1.0f) * 0.5f * viewSize.x_) + viewPos.x_, 0, rtSize.x_ - 1);
+        intRect.top_ = Clamp((int)((-rect.max_.y_ + 1.0f) * 0.5f * viewSize.y_) + viewPos.y_, 0, rtSize.y_ - 1);
+        intRect.right_ = Clamp((int)((rect.max_.x_ + 1.0f) * 0.5f * viewSize.x_) + viewPos.x_ + expand, 0, rtSize.x_);
+        intRect.bottom_ = Clamp((int)((-rect.min_.y_ + 1.0f) * 0.5f * viewSize.y_) + viewPos.y_ + expand, 0, rtSize.y_);
+
+        if (intRect.right_ == intRect.left_)
+            intRect.right_++;
+        if (intRect.bottom_ == intRect.top_)
+            intRect.bottom_++;
+
+        if (intRect.right_ < intRect.left_ || intRect.bottom_ < intRect.top_)
+            enable = false;
+
+        if (enable && intRect != scissorRect_)
+        {
+            scissorRect_ = intRect;
+            impl_->scissorRectDirty_ = true;
+        }
+    }
+
+    if (enable != scissorTest_)
+    {
+        scissorTest_ = enable;
+        impl_->rasterizerStateDirty_ = true;
+    }
+}
+
+void Graphics::SetScissorTest(bool enable, const IntRect& rect)
+{
+    IntVector2 rtSize(GetRenderTargetDimensions());
+    IntVector2 viewPos(viewport_.left_, viewport_.top_);
+
+    if (enable)
+    {
+        IntRect intRect;
+        intRect.left_ = Clamp(rect.left_ + viewPos.x_, 0, rtSize.x_ - 1);
+        intRect.top_ = Clamp(rect.top_ + viewPos.y_, 0, rtSize.y_ - 1);
+        intRect.right_ = Clamp(rect.right_ + viewPos.x_, 0, rtSize.x_);
+        intRect.bottom_ = Clamp(rect.bottom_ + viewPos.y_, 0, rtSize.y_);
+
+        if (intRect.right_ == intRect.left_)
+            intRect.right_++;
+        if (intRect.bottom_ == intRect.top_)
+            intRect.bottom_++;
+
+        if (intRect.right_ < intRect.left_ || intRect.bottom_ < intRect.top_)
+            enable = false;
+
+        if (enable && intRect != scissorRect_)
+        {
+            scissorRect_ = intRect;
+            impl_->scissorRectDirty_ = true;
+        }
+    }
+
+    if (enable != scissorTest_)
+    {
+        scissorTest_ = enable;
+        impl_->rasterizerStateDirty_ = true;
+    }
+}
+
+void Graphics::SetStencilTest(bool enable, CompareMode mode, StencilOp pass, StencilOp fail, StencilOp zFail, unsigned stencilRef,
+    unsigned compareMask, unsigned writeMask)
+{
+    if (enable != stencilTest_)
+    {
+        stencilTest_ = enable;
+        impl_->depthStateDirty_ = true;
+    }
+
+    if (enable)
+    {
+        if (mode != stencilTestMode_)
+        {
+            stencilTestMode_ = mode;
+            impl_->depthStateDirty_ = true;
+        }
+        if (pass != stencilPass_)
+        {
+            stencilPass_ = pass;
+            impl_->depthStateDirty_ = true;
+        }
+        if (fail != stencilFail_)
+        {
+            stencilFail_ = fail;
+            impl_->depthStateDirty_ = true;
+        }
+        if (zFail != stencilZFail_)
+        {
+            stencilZFail_ = zFail;
+            impl_->depthStateDirty_ = true;
+        }
+        if (compareMask != stencilCompareMask_)
+        {
+            stencilCompareMask_ = compareMask;
+            impl_->depthStateDirty_ = true;
+        }
+        if (writeMask != stencilWriteMask_)
+        {
+            stencilWriteMask_ = writeMask;
+            impl_->depthStateDirty_ = true;
+        }
+        if (stencilRef != stencilRef_)
+        {
+            stencilRef_ = stencilRef;
+            impl_->stencilRefDirty_ = true;
+            impl_->depthStateDirty_ = true;
+        }
+    }
+}
+
+void Graphics::SetClipPlane(bool enable, const Plane& clipPlane, const Matrix3x4& view, const Matrix4& projection)
+{
+    useClipPlane_ = enable;
+
+    if (enable)
+    {
+        Matrix4 viewProj = projection * view;
+        clipPlane_ = clipPlane.Transformed(viewProj).ToVector4();
+        SetShaderParameter(VSP_CLIPPLANE, clipPlane_);
+    }
+}
+
+bool Graphics::IsInitialized() const
+{
+    return impl_->initialized_;
+}
+
+PODVector<int> Graphics::GetMultiSampleLevels() const
+{
+    PODVector<int> ret;
+    for (int i = 1; i <= 16; i *= 2)
+        ret.Push(i);
+
+    return ret;
+}
+
+unsigned Graphics::GetFormat(CompressedFormat format) const
+{
+    switch (format)
+    {
+    case CF_RGBA:
+        return NULL_FORMAT_RGBA8;
+
+    case CF_DXT1:
+        return NULL_FORMAT_BC1;
+
+    case CF_DXT3:
+        return NULL_FORMAT_BC2;
+
+    case CF_DXT5:
+        return NULL_FORMAT_BC3;
+
+    default:
+        return 0;
+    }
+}
+
+ShaderVariation* Graphics::GetShader(ShaderType type, const String& name, const String& defines) const
+{
+    return GetShader(type, name.CString(), defines.CString());
+}
+
+ShaderVariation* Graphics::GetShader(ShaderType type, const char* name, const char* defines) const
+{
+    if (lastShaderName_ != name || !lastShader_)
+    {
+        auto* cache = GetSubsystem<ResourceCache>();
+
+        String fullShaderName = shaderPath_ + name + shaderExtension_;
+        // Try to reduce repeated error log prints because of missing shaders
+        if (lastShaderName_ == name && !cache->Exists(fullShaderName))
+            return nullptr;
+
+        lastShader_ = cache->GetResource<Shader>(fullShaderName);
+        lastShaderName_ = name;
+    }
+
+    return lastShader_ ? lastShader_->GetVariation(type, defines) : nullptr;
+}
+
+VertexBuffer* Graphics::GetVertexBuffer(unsigned index) const
+{
+    return index < MAX_VERTEX_STREAMS ? vertexBuffers_[index] : nullptr;
+}
+
+ShaderProgram* Graphics::GetShaderProgram() const
+{
+    return impl_->shaderProgram_;
+}
+
+TextureUnit Graphics::GetTextureUnit(const String& name)
+{
+    HashMap<String, TextureUnit>::Iterator i = textureUnits_.Find(name);
+    if (i != textureUnits_.End())
+        return i->second_;
+    else
+        return MAX_TEXTURE_UNITS;
+}
+
+const String& Graphics::GetTextureUnitName(TextureUnit unit)
+{
+    for (HashMap<String, TextureUnit>::Iterator i = textureUnits_.Begin(); i != textureUnits_.End(); ++i)
+    {
+        if (i->second_ == unit)
+            return i->first_;
+    }
+    return String::EMPTY;
+}
+
+Texture* Graphics::GetTexture(unsigned index) const
+{
+    return index < MAX_TEXTURE_UNITS ? textures_[index] : nullptr;
+}
+
+RenderSurface* Graphics::GetRenderTarget(unsigned index) const
+{
+    return index < MAX_RENDERTARGETS ? renderTargets_[index] : nullptr;
+}
+
+IntVector2 Graphics::GetRenderTargetDimensions() const
+{
+    int width, height;
+
+    if (renderTargets_[0])
+    {
+        width = renderTargets_[0]->GetWidth();
+        height = renderTargets_[0]->GetHeight();
+    }
+    else if (depthStencil_) // Depth-only rendering
+    {
+        width = depthStencil_->GetWidth();
+        height = depthStencil_->GetHeight();
+    }
+    else
+    {
+        width = width_;
+        height = height_;
+    }
+
+    return IntVector2(width, height);
+}
+
+bool Graphics::GetDither() const
+{
+    return false;
+}
+
+bool Graphics::IsDeviceLost() const
+{
+    // The null backend has no device that could be lost
+    return false;
+}
+
+void Graphics::OnWindowResized()
+{
+    // No window on the null backend
+}
+
+void Graphics::OnWindowMoved()
+{
+    // No window on the null backend
+}
+
+void Graphics::CleanupShaderPrograms(ShaderVariation* variation)
+{
+    for (ShaderProgramMap::Iterator i = impl_->shaderPrograms_.Begin(); i != impl_->shaderPrograms_.End();)
+    {
+        if (i->first_.first_ == variation || i->first_.second_ == variation)
+            i = impl_->shaderPrograms_.Erase(i);
+        else
+            ++i;
+    }
+
+    if (vertexShader_ == variation || pixelShader_ == variation)
+        impl_->shaderProgram_ = nullptr;
+}
+
+void Graphics::CleanupRenderSurface(RenderSurface* surface)
+{
+    // No-op on the null backend
+}
+
+ConstantBuffer* Graphics::GetOrCreateConstantBuffer(ShaderType type, unsigned index, unsigned size)
+{
+    // Ensure that different shader types and index slots get unique buffers, even if the size is same
+    unsigned key = type | (index << 1) | (size << 4);
+    ConstantBufferMap::Iterator i = impl_->allConstantBuffers_.Find(key);
+    if (i != impl_->allConstantBuffers_.End())
+        return i->second_.Get();
+    else
+    {
+        SharedPtr<ConstantBuffer> newConstantBuffer(new ConstantBuffer(context_));
+        newConstantBuffer->SetSize(size);
+        impl_->allConstantBuffers_[key] = newConstantBuffer;
+        return newConstantBuffer.Get();
+    }
+}
+
+unsigned Graphics::GetAlphaFormat()
+{
+    return NULL_FORMAT_A8;
+}
+
+unsigned Graphics::GetLuminanceFormat()
+{
+    return NULL_FORMAT_R8;
+}
+
+unsigned Graphics::GetLuminanceAlphaFormat()
+{
+    return NULL_FORMAT_RG8;
+}
+
+unsigned Graphics::GetRGBFormat()
+{
+    return NULL_FORMAT_RGBA8;
+}
+
+unsigned Graphics::GetRGBAFormat()
+{
+    return NULL_FORMAT_RGBA8;
+}
+
+unsigned Graphics::GetRGBA16Format()
+{
+    return NULL_FORMAT_RGBA16;
+}
+
+unsigned Graphics::GetRGBAFloat16Format()
+{
+    return NULL_FORMAT_RGBA16F;
+}
+
+unsigned Graphics::GetRGBAFloat32Format()
+{
+    return NULL_FORMAT_RGBA32F;
+}
+
+unsigned Graphics::GetRG16Format()
+{
+    return NULL_FORMAT_RG16;
+}
+
+unsigned Graphics::GetRGFloat16Format()
+{
+    return NULL_FORMAT_RG16F;
+}
+
+unsigned Graphics::GetRGFloat32Format()
+{
+    return NULL_FORMAT_RG32F;
+}
+
+unsigned Graphics::GetFloat16Format()
+{
+    return NULL_FORMAT_R16F;
+}
+
+unsigned Graphics::GetFloat32Format()
+{
+    return NULL_FORMAT_R32F;
+}
+
+unsigned Graphics::GetLinearDepthFormat()
+{
+    return NULL_FORMAT_R32F;
+}
+
+unsigned Graphics::GetDepthStencilFormat()
+{
+    return NULL_FORMAT_D24S8;
+}
+
+unsigned Graphics::GetReadableDepthFormat()
+{
+    return NULL_FORMAT_D24S8;
+}
+
+unsigned Graphics::GetFormat(const String& formatName)
+{
+    String nameLower = formatName.ToLower().Trimmed();
+
+    if (nameLower == "a")
+        return GetAlphaFormat();
+    if (nameLower == "l")
+        return GetLuminanceFormat();
+    if (nameLower == "la")
+        return GetLuminanceAlphaFormat();
+    if (nameLower == "rgb")
+        return GetRGBFormat();
+    if (nameLower == "rgba")
+        return GetRGBAFormat();
+    if (nameLower == "rgba16")
+        return GetRGBA16Format();
+    if (nameLower == "rgba16f")
+        return GetRGBAFloat16Format();
+    if (nameLower == "rgba32f")
+        return GetRGBAFloat32Format();
+    if (nameLower == "rg16")
+        return GetRG16Format();
+    if (nameLower == "rg16f")
+        return GetRGFloat16Format();
+    if (nameLower == "rg32f")
+        return GetRGFloat32Format();
+    if (nameLower == "r16f")
+        return GetFloat16Format();
+    if (nameLower == "r32f" || nameLower == "float")
+        return GetFloat32Format();
+    if (nameLower == "lineardepth" || nameLower == "depth")
+        return GetLinearDepthFormat();
+    if (nameLower == "d24s8")
+        return GetDepthStencilFormat();
+    if (nameLower == "readabledepth" || nameLower == "hwdepth")
+        return GetReadableDepthFormat();
+
+    return GetRGBFormat();
+}
+
+unsigned Graphics::GetMaxBones()
+{
+    return 128;
+}
+
+bool Graphics::GetGL3Support()
+{
+    return gl3Support;
+}
+
+void Graphics::CheckFeatureSupport()
+{
+    // Report the Direct3D11 feature set, so that the renderer takes the same code paths
+    anisotropySupport_ = true;
+    dxtTextureSupport_ = true;
+    lightPrepassSupport_ = true;
+    deferredSupport_ = true;
+    hardwareShadowSupport_ = true;
+    instancingSupport_ = true;
+    shadowMapFormat_ = NULL_FORMAT_D16;
+    hiresShadowMapFormat_ = NULL_FORMAT_D32;
+    dummyColorFormat_ = NULL_FORMAT_UNKNOWN;
+    sRGBSupport_ = true;
+    sRGBWriteSupport_ = true;
+}
+
+void Graphics::ResetCachedState()
+{
+    for (unsigned i = 0; i < MAX_VERTEX_STREAMS; ++i)
+    {
+        vertexBuffers_[i] = nullptr;
+        impl_->vertexOffsets_[i] = 0;
+    }
+
+    for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
+        textures_[i] = nullptr;
+
+    for (unsigned i = 0; i < MAX_RENDERTARGETS; ++i)
+        renderTargets_[i] = nullptr;
+
+    depthStencil_ = nullptr;
+    viewport_ = IntRect(0, 0, width_, height_);
+
+    indexBuffer_ = nullptr;
+    vertexDeclarationHash_ = 0;
+    primitiveType_ = 0;
+    vertexShader_ = nullptr;
+    pixelShader_ = nullptr;
+    blendMode_ = BLEND_REPLACE;
+    alphaToCoverage_ = false;
+    colorWrite_ = true;
+    cullMode_ = CULL_CCW;
+    constantDepthBias_ = 0.0f;
+    slopeScaledDepthBias_ = 0.0f;
+    depthTestMode_ = CMP_LESSEQUAL;
+    depthWrite_ = true;
+    fillMode_ = FILL_SOLID;
+    lineAntiAlias_ = false;
+    scissorTest_ = false;
+    scissorRect_ = IntRect::ZERO;
+    stencilTest_ = false;
+    stencilTestMode_ = CMP_ALWAYS;
+    stencilPass_ = OP_KEEP;
+    stencilFail_ = OP_KEEP;
+    stencilZFail_ = OP_KEEP;
+    stencilRef_ = 0;
+    stencilCompareMask_ = M_MAX_UNSIGNED;
+    stencilWriteMask_ = M_MAX_UNSIGNED;
+    useClipPlane_ = false;
+    impl_->shaderProgram_ = nullptr;
+    impl_->renderTargetsDirty_ = true;
+    impl_->texturesDirty_ = true;
+    impl_->vertexBuffersDirty_ = true;
+    impl_->blendStateDirty_ = true;
+    impl_->depthStateDirty_ = true;
+    impl_->rasterizerStateDirty_ = true;
+    impl_->scissorRectDirty_ = true;
+    impl_->stencilRefDirty_ = true;
+    impl_->blendStateHash_ = M_MAX_UNSIGNED;
+    impl_->depthStateHash_ = M_MAX_UNSIGNED;
+    impl_->rasterizerStateHash_ = M_MAX_UNSIGNED;
+    impl_->firstDirtyTexture_ = impl_->lastDirtyTexture_ = M_MAX_UNSIGNED;
+    impl_->firstDirtyVB_ = impl_->lastDirtyVB_ = M_MAX_UNSIGNED;
+}
+
+void Graphics::PrepareDraw()
+{
+    // Apply the dirtied state the same way as the Direct3D11 backend, but only count the device calls that would be made
+    if (impl_->renderTargetsDirty_)
+    {
+        ++impl_->numRenderTargetChanges_;
+        impl_->renderTargetsDirty_ = false;
+    }
+
+    if (impl_->texturesDirty_ && impl_->firstDirtyTexture_ < M_MAX_UNSIGNED)
+    {
+        impl_->numTextureChanges_ += impl_->lastDirtyTexture_ - impl_->firstDirtyTexture_ + 1;
+        impl_->firstDirtyTexture_ = impl_->lastDirtyTexture_ = M_MAX_UNSIGNED;
+        impl_->texturesDirty_ = false;
+    }
+
+    if (impl_->vertexBuffersDirty_ && impl_->firstDirtyVB_ < M_MAX_UNSIGNED)
+    {
+        impl_->numBufferChanges_ += impl_->lastDirtyVB_ - impl_->firstDirtyVB_ + 1;
+        impl_->firstDirtyVB_ = impl_->lastDirtyVB_ = M_MAX_UNSIGNED;
+        impl_->vertexBuffersDirty_ = false;
+    }
+
+    if (impl_->blendStateDirty_)
+    {
+        unsigned newBlendStateHash = (unsigned)((colorWrite_ ? 1 : 0) | (alphaToCoverage_ ? 2 : 0) | (blendMode_ << 2));
+        if (newBlendStateHash != impl_->blendStateHash_)
+        {
+            ++impl_->numStateChanges_;
+            impl_->blendStateHash_ = newBlendStateHash;
+        }
+
+        impl_->blendStateDirty_ = false;
+    }
+
+    if (impl_->depthStateDirty_)
+    {
+        unsigned newDepthStateHash =
+            (depthWrite_ ? 1 : 0) | (stencilTest_ ? 2 : 0) | (depthTestMode_ << 2) | ((stencilCompareMask_ & 0xff) << 5) |
+            ((stencilWriteMask_ & 0xff) << 13) | (stencilTestMode_ << 21) |
+            ((stencilFail_ + stencilZFail_ * 5 + stencilPass_ * 25) << 24);
+        if (newDepthStateHash != impl_->depthStateHash_ || impl_->stencilRefDirty_)
+        {
+            ++impl_->numStateChanges_;
+            impl_->depthStateHash_ = newDepthStateHash;
+        }
+
+        impl_->depthStateDirty_ = false;
+        impl_->stencilRefDirty_ = false;
+    }
+
+    if (impl_->rasterizerStateDirty_)
+    {
+        unsigned depthBits = 24;
+        if (depthStencil_ && depthStencil_->GetParentTexture()->GetFormat() == NULL_FORMAT_D16)
+            depthBits = 16;
+        int scaledDepthBias = (int)(constantDepthBias_ * (1 << depthBits));
+
+        unsigned newRasterizerStateHash =
+            (scissorTest_ ? 1 : 0) | (lineAntiAlias_ ? 2 : 0) | (fillMode_ << 2) | (cullMode_ << 4) |
+            ((scaledDepthBias & 0x1fff) << 6) | (((int)(slopeScaledDepthBias_ * 100.0f) & 0x1fff) << 19);
+        if (newRasterizerStateHash != impl_->rasterizerStateHash_)
+        {
+            ++impl_->numStateChanges_;
+            impl_->rasterizerStateHash_ = newRasterizerStateHash;
+        }
+
+        impl_->rasterizerStateDirty_ = false;
+    }
+
+    if (impl_->scissorRectDirty_)
+    {
+        ++impl_->numStateChanges_;
+        impl_->scissorRectDirty_ = false;
+    }
+}
+
+void Graphics::SetTextureUnitMappings()
+{
+    textureUnits_["DiffMap"] = TU_DIFFUSE;
+    textureUnits_["DiffCubeMap"] = TU_DIFFUSE;
+    textureUnits_["NormalMap"] = TU_NORMAL;
+    textureUnits_["SpecMap"] = TU_SPECULAR;
+    textureUnits_["EmissiveMap"] = TU_EMISSIVE;
+    textureUnits_["EnvMap"] = TU_ENVIRONMENT;
+    textureUnits_["EnvCubeMap"] = TU_ENVIRONMENT;
+    textureUnits_["LightRampMap"] = TU_LIGHTRAMP;
+    textureUnits_["LightSpotMap"] = TU_LIGHTSHAPE;
+    textureUnits_["LightCubeMap"] = TU_LIGHTSHAPE;
+    textureUnits_["ShadowMap"] = TU_SHADOWMAP;
+    textureUnits_["FaceSelectCubeMap"] = TU_FACESELECT;
+    textureUnits_["IndirectionCubeMap"] = TU_INDIRECTION;
+    textureUnits_["VolumeMap"] = TU_VOLUMEMAP;
+    textureUnits_["ZoneCubeMap"] = TU_ZONE;
+    textureUnits_["ZoneVolumeMap"] = TU_ZONE;
+}
+
+void Graphics::MarkFBODirty()
+{
+}
+
+void Graphics::SetVBO(unsigned object)
+{
+}
+
+void Graphics::SetUBO(unsigned object)
+{
+}
+
+}
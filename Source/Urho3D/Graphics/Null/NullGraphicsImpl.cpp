@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../../Precompiled.h"
+
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsImpl.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+GraphicsImpl::GraphicsImpl() :
+    initialized_(false),
+    renderTargetsDirty_(true),
+    texturesDirty_(true),
+    vertexBuffersDirty_(true),
+    blendStateDirty_(true),
+    depthStateDirty_(true),
+    rasterizerStateDirty_(true),
+    scissorRectDirty_(true),
+    stencilRefDirty_(true),
+    blendStateHash_(M_MAX_UNSIGNED),
+    depthStateHash_(M_MAX_UNSIGNED),
+    rasterizerStateHash_(M_MAX_UNSIGNED),
+    firstDirtyTexture_(M_MAX_UNSIGNED),
+    lastDirtyTexture_(M_MAX_UNSIGNED),
+    firstDirtyVB_(M_MAX_UNSIGNED),
+    lastDirtyVB_(M_MAX_UNSIGNED),
+    shaderProgram_(nullptr)
+{
+    for (unsigned i = 0; i < MAX_VERTEX_STREAMS; ++i)
+        vertexOffsets_[i] = 0;
+
+    ResetStatistics();
+}
+
+void GraphicsImpl::ResetStatistics()
+{
+    numRenderTargetChanges_ = 0;
+    numTextureChanges_ = 0;
+    numShaderChanges_ = 0;
+    numBufferChanges_ = 0;
+    numStateChanges_ = 0;
+    numParameterUpdates_ = 0;
+    numDataUploads_ = 0;
+    dataUploadSize_ = 0;
+}
+
+}
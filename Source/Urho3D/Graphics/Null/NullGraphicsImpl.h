@@ -0,0 +1,161 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../../Graphics/ConstantBuffer.h"
+#include "../../Graphics/GraphicsDefs.h"
+#include "../../Graphics/ShaderProgram.h"
+
+namespace Urho3D
+{
+
+/// Texture formats of the null graphics backend. Used only for texture data size calculations.
+enum NullTextureFormat
+{
+    NULL_FORMAT_UNKNOWN = 0,
+    NULL_FORMAT_A8,
+    NULL_FORMAT_R8,
+    NULL_FORMAT_RG8,
+    NULL_FORMAT_RGBA8,
+    NULL_FORMAT_RG16,
+    NULL_FORMAT_RGBA16,
+    NULL_FORMAT_R16F,
+    NULL_FORMAT_RG16F,
+    NULL_FORMAT_RGBA16F,
+    NULL_FORMAT_R32F,
+    NULL_FORMAT_RG32F,
+    NULL_FORMAT_RGBA32F,
+    NULL_FORMAT_D16,
+    NULL_FORMAT_D24S8,
+    NULL_FORMAT_D32,
+    NULL_FORMAT_BC1,
+    NULL_FORMAT_BC2,
+    NULL_FORMAT_BC3
+};
+
+using ShaderProgramMap = HashMap<Pair<ShaderVariation*, ShaderVariation*>, SharedPtr<ShaderProgram> >;
+using ConstantBufferMap = HashMap<unsigned, SharedPtr<ConstantBuffer> >;
+
+/// %Graphics implementation for the null backend. Records the state changes that a real device would receive.
+class URHO3D_API GraphicsImpl
+{
+    friend class Graphics;
+
+public:
+    /// Construct.
+    GraphicsImpl();
+
+    /// Reset the per-frame statistics. Called at the start of each frame.
+    void ResetStatistics();
+
+    /// Return number of rendertarget and depth-stencil binding changes this frame.
+    unsigned GetNumRenderTargetChanges() const { return numRenderTargetChanges_; }
+
+    /// Return number of texture unit binding changes this frame.
+    unsigned GetNumTextureChanges() const { return numTextureChanges_; }
+
+    /// Return number of shader program changes this frame.
+    unsigned GetNumShaderChanges() const { return numShaderChanges_; }
+
+    /// Return number of vertex and index buffer binding changes this frame.
+    unsigned GetNumBufferChanges() const { return numBufferChanges_; }
+
+    /// Return number of blend, depth-stencil, rasterizer and scissor state changes this frame.
+    unsigned GetNumStateChanges() const { return numStateChanges_; }
+
+    /// Return number of shader parameter updates this frame.
+    unsigned GetNumParameterUpdates() const { return numParameterUpdates_; }
+
+    /// Return number of buffer and texture data uploads this frame.
+    unsigned GetNumDataUploads() const { return numDataUploads_; }
+
+    /// Return number of bytes in buffer and texture data uploads this frame.
+    unsigned GetDataUploadSize() const { return dataUploadSize_; }
+
+    /// Record a buffer or texture data upload. Called by GPU objects.
+    void RecordDataUpload(unsigned size)
+    {
+        ++numDataUploads_;
+        dataUploadSize_ += size;
+    }
+
+private:
+    /// Screen mode set flag.
+    bool initialized_;
+    /// Rendertargets dirty flag.
+    bool renderTargetsDirty_;
+    /// Textures dirty flag.
+    bool texturesDirty_;
+    /// Vertex buffers dirty flag.
+    bool vertexBuffersDirty_;
+    /// Blend state dirty flag.
+    bool blendStateDirty_;
+    /// Depth state dirty flag.
+    bool depthStateDirty_;
+    /// Rasterizer state dirty flag.
+    bool rasterizerStateDirty_;
+    /// Scissor rect dirty flag.
+    bool scissorRectDirty_;
+    /// Stencil ref dirty flag.
+    bool stencilRefDirty_;
+    /// Hash of current blend state.
+    unsigned blendStateHash_;
+    /// Hash of current depth state.
+    unsigned depthStateHash_;
+    /// Hash of current rasterizer state.
+    unsigned rasterizerStateHash_;
+    /// First dirtied texture unit.
+    unsigned firstDirtyTexture_;
+    /// Last dirtied texture unit.
+    unsigned lastDirtyTexture_;
+    /// First dirtied vertex buffer.
+    unsigned firstDirtyVB_;
+    /// Last dirtied vertex buffer.
+    unsigned lastDirtyVB_;
+    /// Vertex stream offsets per buffer.
+    unsigned vertexOffsets_[MAX_VERTEX_STREAMS];
+    /// Constant buffer search map.
+    ConstantBufferMap allConstantBuffers_;
+    /// Shader programs.
+    ShaderProgramMap shaderPrograms_;
+    /// Shader program in use.
+    ShaderProgram* shaderProgram_;
+    /// Rendertarget and depth-stencil binding changes this frame.
+    unsigned numRenderTargetChanges_;
+    /// Texture unit binding changes this frame.
+    unsigned numTextureChanges_;
+    /// Shader program changes this frame.
+    unsigned numShaderChanges_;
+    /// Vertex and index buffer binding changes this frame.
+    unsigned numBufferChanges_;
+    /// Render state changes this frame.
+    unsigned numStateChanges_;
+    /// Shader parameter updates this frame.
+    unsigned numParameterUpdates_;
+    /// Buffer and texture data uploads this frame.
+    unsigned numDataUploads_;
+    /// Bytes uploaded this frame.
+    unsigned dataUploadSize_;
+};
+
+}
@@ -0,0 +1,260 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../../Precompiled.h"
+
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/Shader.h"
+#include "../../Graphics/VertexBuffer.h"
+#include "../../IO/File.h"
+#include "../../IO/FileSystem.h"
+#include "../../IO/Log.h"
+#include "../../Resource/ResourceCache.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+const char* ShaderVariation::elementSemanticNames[] =
+{
+    "POSITION",
+    "NORMAL",
+    "BINORMAL",
+    "TANGENT",
+    "TEXCOORD",
+    "COLOR",
+    "BLENDWEIGHT",
+    "BLENDINDICES",
+    "OBJECTINDEX"
+};
+
+void ShaderVariation::OnDeviceLost()
+{
+    // No-op on the null backend
+}
+
+bool ShaderVariation::Create()
+{
+    Release();
+
+    if (!graphics_)
+        return false;
+
+    if (!owner_)
+    {
+        compilerOutput_ = "Owner shader has expired";
+        return false;
+    }
+
+    return CompileByteCode(owner_->GetSourceCode(type_), compilerOutput_) && CreateObject();
+}
+
+bool ShaderVariation::CompileByteCode(const String& sourceCode, String& compilerOutput)
+{
+    if (!graphics_ || !owner_)
+        return false;
+
+    // Use the shader cache like the Direct3D backends do, so that the cache logic can be exercised without a GPU
+    String binaryShaderName = GetCacheFileName(sourceCode, type_ == VS ? ".vsn" : ".psn");
+
+    loadedFromCache_ = LoadByteCode(binaryShaderName);
+    if (!loadedFromCache_)
+    {
+        if (!Compile(sourceCode, compilerOutput))
+            return false;
+        SaveByteCode(binaryShaderName);
+    }
+
+    return true;
+}
+
+bool ShaderVariation::CreateObject()
+{
+    if (!graphics_ || byteCode_.Empty())
+    {
+        compilerOutput_ = "Could not create shader, empty bytecode";
+        return false;
+    }
+
+    // The source is not compiled, so there is no reflection data. Assume that all texture units are sampled
+    for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
+        useTextureUnits_[i] = true;
+
+    // Use the variation itself as the object handle so that it reads as created
+    object_.ptr_ = this;
+
+    // The bytecode is not needed after creation
+    byteCode_.Clear();
+    byteCode_.Reserve(0);
+
+    return true;
+}
+
+bool ShaderVariation::GetByteCodeSupport()
+{
+    return true;
+}
+
+void ShaderVariation::Release()
+{
+    if (object_.ptr_)
+    {
+        if (!graphics_)
+            return;
+
+        graphics_->CleanupShaderPrograms(this);
+
+        if (type_ == VS)
+        {
+            if (graphics_->GetVertexShader() == this)
+                graphics_->SetShaders(nullptr, nullptr);
+        }
+        else
+        {
+            if (graphics_->GetPixelShader() == this)
+                graphics_->SetShaders(nullptr, nullptr);
+        }
+
+        object_.ptr_ = nullptr;
+    }
+
+    compilerOutput_.Clear();
+
+    for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
+        useTextureUnits_[i] = false;
+    for (unsigned i = 0; i < MAX_SHADER_PARAMETER_GROUPS; ++i)
+        constantBufferSizes_[i] = 0;
+    parameters_.Clear();
+    byteCode_.Clear();
+    elementHash_ = 0;
+}
+
+void ShaderVariation::SetDefines(const String& defines)
+{
+    defines_ = defines;
+
+    // Internal mechanism for appending the CLIPPLANE define, prevents runtime (every frame) string manipulation
+    definesClipPlane_ = defines;
+    if (!definesClipPlane_.EndsWith(" CLIPPLANE"))
+        definesClipPlane_ += " CLIPPLANE";
+}
+
+bool ShaderVariation::LoadByteCode(const String& binaryShaderName)
+{
+    ResourceCache* cache = owner_->GetSubsystem<ResourceCache>();
+    if (!cache->Exists(binaryShaderName))
+        return false;
+
+    SharedPtr<File> file = cache->GetFile(binaryShaderName);
+    if (!file || file->ReadFileID() != "USHD")
+    {
+        URHO3D_LOGERROR(binaryShaderName + " is not a valid shader bytecode file");
+        return false;
+    }
+
+    /*unsigned short shaderType = */file->ReadUShort();
+    /*unsigned short shaderModel = */file->ReadUShort();
+
+    unsigned byteCodeSize = file->ReadUInt();
+    if (byteCodeSize)
+    {
+        byteCode_.Resize(byteCodeSize);
+        file->Read(&byteCode_[0], byteCodeSize);
+
+        if (type_ == VS)
+            URHO3D_LOGDEBUG("Loaded cached vertex shader " + GetFullName());
+        else
+            URHO3D_LOGDEBUG("Loaded cached pixel shader " + GetFullName());
+
+        return true;
+    }
+    else
+    {
+        URHO3D_LOGERROR(binaryShaderName + " has zero length bytecode");
+        return false;
+    }
+}
+
+bool ShaderVariation::Compile(const String& sourceCode, String& compilerOutput)
+{
+    // There is no shader compiler, so the bytecode is the source code preceded by the define directives
+    String code;
+    Vector<String> defines = defines_.Split(' ');
+    defines.Push(type_ == VS ? "COMPILEVS" : "COMPILEPS");
+    defines.Push("MAXBONES=" + String(Graphics::GetMaxBones()));
+
+    for (unsigned i = 0; i < defines.Size(); ++i)
+    {
+        String define = defines[i];
+        define.Replace('=', ' ');
+        code += "#define " + define + "\n";
+    }
+    code += sourceCode;
+
+    byteCode_.Resize(code.Length());
+    if (!code.Empty())
+        memcpy(&byteCode_[0], code.CString(), code.Length());
+
+    if (type_ == VS)
+        URHO3D_LOGDEBUG("Compiled vertex shader " + GetFullName());
+    else
+        URHO3D_LOGDEBUG("Compiled pixel shader " + GetFullName());
+
+    return true;
+}
+
+void ShaderVariation::SaveByteCode(const String& binaryShaderName)
+{
+    ResourceCache* cache = owner_->GetSubsystem<ResourceCache>();
+    FileSystem* fileSystem = owner_->GetSubsystem<FileSystem>();
+
+    // Filename may or may not be inside the resource system
+    String fullName = binaryShaderName;
+    if (!IsAbsolutePath(fullName))
+    {
+        // If not absolute, use the resource dir of the shader
+        String shaderFileName = cache->GetResourceFileName(owner_->GetName());
+        if (shaderFileName.Empty())
+            return;
+        fullName = shaderFileName.Substring(0, shaderFileName.Find(owner_->GetName())) + binaryShaderName;
+    }
+    String path = GetPath(fullName);
+    if (!fileSystem->DirExists(path))
+        fileSystem->CreateDir(path);
+
+    SharedPtr<File> file(new File(owner_->GetContext(), fullName, FILE_WRITE));
+    if (!file->IsOpen())
+        return;
+
+    file->WriteFileID("USHD");
+    file->WriteShort((unsigned short)type_);
+    file->WriteShort(0);
+
+    file->WriteUInt(byteCode_.Size());
+    if (byteCode_.Size())
+        file->Write(&byteCode_[0], byteCode_.Size());
+}
+
+}
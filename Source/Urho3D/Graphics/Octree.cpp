@@ -45,6 +45,7 @@ namespace Urho3D
 
 static const float DEFAULT_OCTREE_SIZE = 1000.0f;
 static const int DEFAULT_OCTREE_LEVELS = 8;
+static const unsigned MIN_THREADED_REINSERTIONS = 256;
 
 extern const char* SUBSYSTEM_CATEGORY;
 
@@ -63,6 +64,29 @@ void UpdateDrawablesWork(const WorkItem* item, unsigned threadIndex)
     }
 }
 
+void EvaluateAnimationsWork(const WorkItem* item, unsigned threadIndex)
+{
+    const RenderFrameInfo& frame = *(reinterpret_cast<RenderFrameInfo*>(item->aux_));
+    auto* start = reinterpret_cast<AnimationJob*>(item->start_);
+    auto* end = reinterpret_cast<AnimationJob*>(item->end_);
+
+    while (start != end)
+    {
+        start->result_ = start->drawable_->EvaluateAnimation(frame);
+        ++start;
+    }
+}
+
+void ReinsertDrawablesWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* octant = reinterpret_cast<Octant*>(item->aux_);
+    auto** start = reinterpret_cast<Drawable**>(item->start_);
+    auto** end = reinterpret_cast<Drawable**>(item->end_);
+
+    while (start != end)
+        octant->InsertDrawable(*start++);
+}
+
 inline bool CompareRayQueryResults(const RayQueryResult& lhs, const RayQueryResult& rhs)
 {
     return lhs.distance_ < rhs.distance_;
@@ -84,11 +108,11 @@ Octant::~Octant()
         // Remove the drawables (if any) from this octant to the root octant
         for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
         {
-            (*i)->SetOctant(root_);
-            root_->drawables_.Push(*i);
+            root_->AddDrawable(*i);
             root_->QueueUpdate(*i);
         }
         drawables_.Clear();
+        drawableData_.Clear();
         numDrawables_ = 0;
     }
 
@@ -135,34 +159,158 @@ void Octant::InsertDrawable(Drawable* drawable)
 {
     const BoundingBox& box = drawable->GetWorldBoundingBox();
 
-    // If root octant, insert all non-occludees here, so that octant occlusion does not hide the drawable.
-    // Also if drawable is outside the root octant bounds, insert to root
-    bool insertHere;
-    if (this == root_)
-        insertHere = !drawable->IsOccludee() || cullingBox_.IsInside(box) != INSIDE || CheckDrawableFit(box);
-    else
-        insertHere = CheckDrawableFit(box);
+    // Static occludees go to the root's static bounding volume hierarchy. Non-occludees are excluded so that node
+    // occlusion can not hide them
+    if (this == root_ && drawable->IsStatic() && drawable->IsOccludee())
+    {
+        if (drawable->inStaticBVH_ && drawable->octant_ == this)
+            root_->staticBVH_->UpdateDrawable(drawable);
+        else
+        {
+            if (drawable->octant_)
+                drawable->octant_->RemoveDrawable(drawable, false);
+            drawable->SetOctant(this);
+            root_->staticBVH_->AddDrawable(drawable);
+        }
+        return;
+    }
 
-    if (insertHere)
+    if (CheckDrawableInsert(drawable, box))
     {
         Octant* oldOctant = drawable->octant_;
-        if (oldOctant != this)
+        if (oldOctant != this || drawable->inStaticBVH_)
         {
-            // Add first, then remove, because drawable count going to zero deletes the octree branch in question
-            AddDrawable(drawable);
             if (oldOctant)
                 oldOctant->RemoveDrawable(drawable, false);
+            AddDrawable(drawable);
         }
+        else
+            UpdateDrawableBox(drawable);
     }
     else
+        GetOrCreateChild(GetChildIndex(box.Center()))->InsertDrawable(drawable);
+}
+
+bool Octant::CheckDrawableInsert(Drawable* drawable, const BoundingBox& box) const
+{
+    // If root octant, insert all non-occludees here, so that octant occlusion does not hide the drawable.
+    // Also if drawable is outside the root octant bounds, insert to root
+    if (this == root_)
+        return !drawable->IsOccludee() || cullingBox_.IsInside(box) != INSIDE || CheckDrawableFit(box);
+    else
+        return CheckDrawableFit(box);
+}
+
+void Octant::AddDrawable(Drawable* drawable)
+{
+    drawable->SetOctant(this);
+    drawable->octantIndex_ = drawables_.Size();
+    drawables_.Push(drawable);
+    drawableData_.Push(drawable);
+    MarkDrawableCountsDirty();
+}
+
+void Octant::RemoveDrawable(Drawable* drawable, bool resetOctant)
+{
+    if (drawable->inStaticBVH_)
     {
-        Vector3 boxCenter = box.Center();
-        unsigned x = boxCenter.x_ < center_.x_ ? 0 : 1;
-        unsigned y = boxCenter.y_ < center_.y_ ? 0 : 2;
-        unsigned z = boxCenter.z_ < center_.z_ ? 0 : 4;
+        if (root_)
+            root_->staticBVH_->RemoveDrawable(drawable);
+        if (resetOctant)
+            drawable->SetOctant(nullptr);
+        return;
+    }
 
-        GetOrCreateChild(x + y + z)->InsertDrawable(drawable);
+    unsigned index = drawable->octantIndex_;
+    if (index >= drawables_.Size() || drawables_[index] != drawable)
+        return;
+
+    // Move the last drawable to the vacated slot so that removal does not need to search or shift the arrays
+    unsigned last = drawables_.Size() - 1;
+    if (index != last)
+    {
+        drawables_[index] = drawables_[last];
+        drawableData_.Copy(index, last);
+        drawables_[index]->octantIndex_ = index;
     }
+    drawables_.Pop();
+    drawableData_.Pop();
+
+    if (resetOctant)
+        drawable->SetOctant(nullptr);
+    MarkDrawableCountsDirty();
+}
+
+void Octant::RemoveDrawables(const HashSet<Drawable*>& drawables)
+{
+    unsigned numKept = 0;
+    for (unsigned i = 0; i < drawables_.Size(); ++i)
+    {
+        Drawable* drawable = drawables_[i];
+        if (drawables.Contains(drawable))
+            drawable->SetOctant(nullptr);
+        else
+        {
+            drawables_[numKept] = drawable;
+            drawableData_.Copy(numKept, i);
+            drawable->octantIndex_ = numKept++;
+        }
+    }
+
+    if (numKept < drawables_.Size())
+    {
+        drawables_.Resize(numKept);
+        drawableData_.Resize(numKept);
+        MarkDrawableCountsDirty();
+    }
+}
+
+void Octant::InvalidateDrawableBox(Drawable* drawable)
+{
+    if (drawable->inStaticBVH_)
+    {
+        if (root_)
+            root_->staticBVH_->InvalidateDrawableBox(drawable);
+    }
+    else if (drawable->octantIndex_ < drawableData_.Size())
+        drawableData_.InvalidateBox(drawable->octantIndex_);
+}
+
+void Octant::UpdateDrawableViewMask(Drawable* drawable)
+{
+    if (drawable->inStaticBVH_)
+    {
+        if (root_)
+            root_->staticBVH_->UpdateDrawableViewMask(drawable);
+    }
+    else if (drawable->octantIndex_ < drawableData_.Size())
+        drawableData_.viewMasks_[drawable->octantIndex_] = drawable->GetViewMask();
+}
+
+void Octant::MarkDrawableCountsDirty()
+{
+    // Checked first, as worker threads reinserting drawables call this while the flag is already set
+    if (root_ && !root_->drawableCountsDirty_)
+        root_->drawableCountsDirty_ = true;
+}
+
+unsigned Octant::UpdateDrawableCounts()
+{
+    numDrawables_ = drawables_.Size();
+
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+    {
+        if (children_[i])
+        {
+            unsigned childDrawables = children_[i]->UpdateDrawableCounts();
+            if (childDrawables)
+                numDrawables_ += childDrawables;
+            else
+                DeleteChild(i);
+        }
+    }
+
+    return numDrawables_;
 }
 
 bool Octant::CheckDrawableFit(const BoundingBox& box) const
@@ -196,6 +344,8 @@ void Octant::ResetRoot()
     // The whole octree is being destroyed, just detach the drawables
     for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
         (*i)->SetOctant(nullptr);
+    drawables_.Clear();
+    drawableData_.Clear();
 
     for (auto& child : children_)
     {
@@ -224,13 +374,14 @@ void Octant::Initialize(const BoundingBox& box)
     center_ = box.Center();
     halfSize_ = 0.5f * box.Size();
     cullingBox_ = BoundingBox(worldBoundingBox_.min_ - halfSize_, worldBoundingBox_.max_ + halfSize_);
+    cullCache_ = OctantCullCache();
 }
 
 void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
 {
     if (this != root_)
     {
-        Intersection res = query.TestOctant(cullingBox_, inside);
+        Intersection res = query.TestOctantCached(this, inside);
         if (res == INSIDE)
             inside = true;
         else if (res == OUTSIDE)
@@ -244,7 +395,7 @@ void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
     {
         auto** start = const_cast<Drawable**>(&drawables_[0]);
         Drawable** end = start + drawables_.Size();
-        query.TestDrawables(start, end, inside);
+        query.TestCachedDrawables(start, end, drawableData_, 0, inside);
     }
 
     for (auto child : children_)
@@ -254,6 +405,34 @@ void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
     }
 }
 
+void Octant::GetDrawablesInternal(MultiFrustumOctreeQuery& query, unsigned activeMask, unsigned insideMask) const
+{
+    if (this != root_)
+    {
+        // Cull the frustums this octant is outside of. Frustums it is inside of are not tested again further down
+        unsigned testMask = activeMask & ~insideMask;
+        if (testMask)
+        {
+            activeMask &= ~query.TestBox(cullingBox_, testMask, insideMask);
+            if (!activeMask)
+                return;
+        }
+    }
+
+    if (drawables_.Size())
+    {
+        auto** start = const_cast<Drawable**>(&drawables_[0]);
+        Drawable** end = start + drawables_.Size();
+        query.TestDrawables(start, end, drawableData_, 0, activeMask, insideMask);
+    }
+
+    for (auto child : children_)
+    {
+        if (child)
+            child->GetDrawablesInternal(query, activeMask, insideMask);
+    }
+}
+
 void Octant::GetDrawablesInternal(RayOctreeQuery& query) const
 {
     float octantDist = query.ray_.HitDistance(cullingBox_);
@@ -311,7 +490,12 @@ void Octant::GetDrawablesOnlyInternal(RayOctreeQuery& query, PODVector<Drawable*
 Octree::Octree(Context* context) :
     Component(context),
     Octant(BoundingBox(-DEFAULT_OCTREE_SIZE, DEFAULT_OCTREE_SIZE), 0, nullptr, this),
-    numLevels_(DEFAULT_OCTREE_LEVELS)
+    staticBVH_(new StaticBVH(context)),
+    numLevels_(DEFAULT_OCTREE_LEVELS),
+    numAnimationsEvaluated_(0),
+    numAnimationsInterpolated_(0),
+    numAnimationsSkipped_(0),
+    drawableCountsDirty_(false)
 {
     // If the engine is running headless, subscribe to RenderUpdate events for manually updating the octree
     // to allow raycasts and animation update
@@ -323,6 +507,7 @@ Octree::~Octree()
 {
     // Reset root pointer from all child octants now so that they do not move their drawables to root
     drawableUpdates_.Clear();
+    staticBVH_->RemoveAllDrawables();
     ResetRoot();
 }
 
@@ -359,6 +544,7 @@ void Octree::SetSize(const BoundingBox& box, unsigned numLevels)
     Initialize(box);
     numDrawables_ = drawables_.Size();
     numLevels_ = Max(numLevels, 1U);
+    drawableCountsDirty_ = false;
 }
 
 void Octree::Update(const RenderFrameInfo& frame)
@@ -369,6 +555,9 @@ void Octree::Update(const RenderFrameInfo& frame)
         return;
     }
 
+    // Evaluate animations into the drawables' own data first, so that the update only needs to apply the results
+    EvaluateAnimations(frame);
+
     // Let drawables update themselves before reinsertion. This can be used for animation
     if (!drawableUpdates_.Empty())
     {
@@ -443,35 +632,128 @@ void Octree::Update(const RenderFrameInfo& frame)
     {
         URHO3D_PROFILE(ReinsertToOctree);
 
+        reinsertions_.Clear();
         for (PODVector<Drawable*>::Iterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
         {
             Drawable* drawable = *i;
             drawable->updateQueued_ = false;
+            drawable->updateFrameNumber_ = frame.frameNumber_;
             Octant* octant = drawable->GetOctant();
             const BoundingBox& box = drawable->GetWorldBoundingBox();
 
             // Skip if no octant or does not belong to this octree anymore
             if (!octant || octant->GetRoot() != this)
                 continue;
-            // Skip if still fits the current octant
-            if (drawable->IsOccludee() && octant->GetCullingBox().IsInside(box) == INSIDE && octant->CheckDrawableFit(box))
+            // Static occludees only update the static bounding volume hierarchy, which is cheap to do serially
+            if (drawable->IsStatic() && drawable->IsOccludee())
+            {
+                InsertDrawable(drawable);
                 continue;
+            }
+            if (drawable->inStaticBVH_)
+            {
+                reinsertions_.Push(drawable);
+                continue;
+            }
+            // If still fits the current octant, only refresh the cached bounding box
+            if (drawable->IsOccludee() && octant->GetCullingBox().IsInside(box) == INSIDE && octant->CheckDrawableFit(box))
+                octant->UpdateDrawableBox(drawable);
+            else
+                reinsertions_.Push(drawable);
+        }
 
-            InsertDrawable(drawable);
+        ReinsertDrawables();
 
 #ifdef _DEBUG
-            // Verify that the drawable will be culled correctly
-            octant = drawable->GetOctant();
+        // Verify that the drawables will be culled correctly
+        for (PODVector<Drawable*>::Iterator i = reinsertions_.Begin(); i != reinsertions_.End(); ++i)
+        {
+            Drawable* drawable = *i;
+            Octant* octant = drawable->GetOctant();
+            const BoundingBox& box = drawable->GetWorldBoundingBox();
             if (octant != this && octant->GetCullingBox().IsInside(box) != INSIDE)
             {
                 URHO3D_LOGERROR("Drawable is not fully inside its octant's culling bounds: drawable box " + box.ToString() +
                          " octant box " + octant->GetCullingBox().ToString());
             }
-#endif
         }
+#endif
     }
 
     drawableUpdates_.Clear();
+
+    staticBVH_->Update();
+
+    // Recalculate the drawable counts and prune empty octants once, instead of on each insertion and removal
+    if (drawableCountsDirty_)
+    {
+        URHO3D_PROFILE(UpdateOctreeDrawableCounts);
+
+        UpdateDrawableCounts();
+        drawableCountsDirty_ = false;
+    }
+}
+
+void Octree::ReinsertDrawables()
+{
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (reinsertions_.Size() < MIN_THREADED_REINSERTIONS || !queue || !queue->GetNumThreads())
+    {
+        for (PODVector<Drawable*>::Iterator i = reinsertions_.Begin(); i != reinsertions_.End(); ++i)
+            InsertDrawable(*i);
+        return;
+    }
+
+    // Remove the drawables from their old octants first, so that each worker thread only modifies the octants of its
+    // own root child subtree. Removal and the root-level decisions are cheap, the recursive insertion is the costly part
+    unsigned childCounts[NUM_OCTANTS + 1] = {};
+    for (PODVector<Drawable*>::Iterator i = reinsertions_.Begin(); i != reinsertions_.End(); ++i)
+    {
+        Drawable* drawable = *i;
+        drawable->GetOctant()->RemoveDrawable(drawable);
+
+        const BoundingBox& box = drawable->GetWorldBoundingBox();
+        if (CheckDrawableInsert(drawable, box))
+            AddDrawable(drawable);
+        else
+            ++childCounts[GetChildIndex(box.Center())];
+    }
+
+    // Sort the rest by root child octant
+    unsigned offsets[NUM_OCTANTS + 1];
+    offsets[0] = 0;
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+        offsets[i + 1] = offsets[i] + childCounts[i];
+
+    threadedReinsertions_.Resize(offsets[NUM_OCTANTS]);
+    unsigned writeOffsets[NUM_OCTANTS];
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+        writeOffsets[i] = offsets[i];
+    for (PODVector<Drawable*>::Iterator i = reinsertions_.Begin(); i != reinsertions_.End(); ++i)
+    {
+        Drawable* drawable = *i;
+        if (!drawable->GetOctant())
+            threadedReinsertions_[writeOffsets[GetChildIndex(drawable->GetWorldBoundingBox().Center())]++] = drawable;
+    }
+
+    // Make sure the drawable counts are dirty before the worker threads run, so that they only read the flag
+    MarkDrawableCountsDirty();
+
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+    {
+        if (!childCounts[i])
+            continue;
+
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = ReinsertDrawablesWork;
+        item->aux_ = GetOrCreateChild(i);
+        item->start_ = &threadedReinsertions_[offsets[i]];
+        item->end_ = &threadedReinsertions_[0] + offsets[i + 1];
+        queue->AddWorkItem(item);
+    }
+
+    queue->Complete(M_MAX_UNSIGNED);
 }
 
 void Octree::AddManualDrawable(Drawable* drawable)
@@ -496,6 +778,17 @@ void Octree::GetDrawables(OctreeQuery& query) const
 {
     query.result_.Clear();
     GetDrawablesInternal(query, false);
+    staticBVH_->GetDrawables(query);
+}
+
+void Octree::GetDrawables(MultiFrustumOctreeQuery& query) const
+{
+    query.ClearResults();
+    if (!query.GetNumFrustums())
+        return;
+
+    GetDrawablesInternal(query, query.GetFrustumMask(), 0);
+    staticBVH_->GetDrawables(query);
 }
 
 void Octree::Raycast(RayOctreeQuery& query) const
@@ -504,6 +797,7 @@ void Octree::Raycast(RayOctreeQuery& query) const
 
     query.result_.Clear();
     GetDrawablesInternal(query);
+    staticBVH_->Raycast(query);
     Sort(query.result_.Begin(), query.result_.End(), CompareRayQueryResults);
 }
 
@@ -514,6 +808,7 @@ void Octree::RaycastSingle(RayOctreeQuery& query) const
     query.result_.Clear();
     rayQueryDrawables_.Clear();
     GetDrawablesOnlyInternal(query, rayQueryDrawables_);
+    staticBVH_->GetDrawablesOnly(query, rayQueryDrawables_);
 
     // Sort by increasing hit distance to AABB
     for (PODVector<Drawable*>::Iterator i = rayQueryDrawables_.Begin(); i != rayQueryDrawables_.End(); ++i)
@@ -547,6 +842,72 @@ void Octree::RaycastSingle(RayOctreeQuery& query) const
     }
 }
 
+void Octree::EvaluateAnimations(const RenderFrameInfo& frame)
+{
+    numAnimationsEvaluated_ = 0;
+    numAnimationsInterpolated_ = 0;
+    numAnimationsSkipped_ = 0;
+
+    animationJobs_.Clear();
+    for (PODVector<Drawable*>::ConstIterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
+    {
+        Drawable* drawable = *i;
+        if (drawable && drawable->HasPendingAnimation())
+        {
+            AnimationJob job;
+            job.drawable_ = drawable;
+            job.result_ = ANIMATION_NOT_EVALUATED;
+            animationJobs_.Push(job);
+        }
+    }
+
+    if (animationJobs_.Empty())
+        return;
+
+    URHO3D_PROFILE(EvaluateAnimations);
+
+    // Evaluate in worker threads. The drawables only write their own data, but may read scene nodes, so notify the scene
+    // that a threaded update is going on like in the drawable update
+    Scene* scene = GetScene();
+    auto* queue = GetSubsystem<WorkQueue>();
+    scene->BeginThreadedUpdate();
+
+    int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
+    int jobsPerItem = Max((int)(animationJobs_.Size() / numWorkItems), 1);
+
+    PODVector<AnimationJob>::Iterator start = animationJobs_.Begin();
+    for (int i = 0; i < numWorkItems && start != animationJobs_.End(); ++i)
+    {
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = EvaluateAnimationsWork;
+        item->aux_ = const_cast<RenderFrameInfo*>(&frame);
+
+        PODVector<AnimationJob>::Iterator end = animationJobs_.End();
+        if (i < numWorkItems - 1 && end - start > jobsPerItem)
+            end = start + jobsPerItem;
+
+        item->start_ = &(*start);
+        item->end_ = &(*end);
+        queue->AddWorkItem(item);
+
+        start = end;
+    }
+
+    queue->Complete(M_MAX_UNSIGNED);
+    scene->EndThreadedUpdate();
+
+    for (PODVector<AnimationJob>::ConstIterator i = animationJobs_.Begin(); i != animationJobs_.End(); ++i)
+    {
+        if (i->result_ == ANIMATION_EVALUATED)
+            ++numAnimationsEvaluated_;
+        else if (i->result_ == ANIMATION_INTERPOLATED)
+            ++numAnimationsInterpolated_;
+        else if (i->result_ == ANIMATION_SKIPPED)
+            ++numAnimationsSkipped_;
+    }
+}
+
 void Octree::QueueUpdate(Drawable* drawable)
 {
     Scene* scene = GetScene();
@@ -569,12 +930,81 @@ void Octree::CancelUpdate(Drawable* drawable)
     drawable->updateQueued_ = false;
 }
 
+void Octree::QueueRemoval(Drawable* drawable)
+{
+    queuedRemovals_.Insert(drawable);
+}
+
+void Octree::CancelRemoval(Drawable* drawable)
+{
+    queuedRemovals_.Erase(drawable);
+}
+
 void Octree::DrawDebugGeometry(bool depthTest)
 {
     auto* debug = GetComponent<DebugRenderer>();
     DrawDebugGeometry(debug, depthTest);
 }
 
+void Octree::OnSceneSet(Scene* scene)
+{
+    if (scene)
+        SubscribeToEvent(scene, E_SCENEBATCHREMOVED, URHO3D_HANDLER(Octree, HandleSceneBatchRemoved));
+    else
+        UnsubscribeFromEvent(E_SCENEBATCHREMOVED);
+}
+
+void Octree::HandleSceneBatchRemoved(StringHash eventType, VariantMap& eventData)
+{
+    RemoveQueuedDrawables();
+}
+
+void Octree::RemoveQueuedDrawables()
+{
+    if (queuedRemovals_.Empty())
+        return;
+
+    URHO3D_PROFILE(RemoveQueuedDrawables);
+
+    // Gather the affected octants and cancel pending reinsertions in one pass each
+    HashSet<Octant*> octants;
+    bool cancelUpdates = false;
+    for (HashSet<Drawable*>::ConstIterator i = queuedRemovals_.Begin(); i != queuedRemovals_.End(); ++i)
+    {
+        Drawable* drawable = *i;
+        if (drawable->inStaticBVH_)
+        {
+            staticBVH_->RemoveDrawable(drawable);
+            drawable->SetOctant(nullptr);
+        }
+        else if (drawable->octant_)
+            octants.Insert(drawable->octant_);
+        if (drawable->updateQueued_)
+        {
+            drawable->updateQueued_ = false;
+            cancelUpdates = true;
+        }
+    }
+
+    if (cancelUpdates)
+    {
+        unsigned numKept = 0;
+        for (unsigned i = 0; i < drawableUpdates_.Size(); ++i)
+        {
+            Drawable* drawable = drawableUpdates_[i];
+            if (!queuedRemovals_.Contains(drawable))
+                drawableUpdates_[numKept++] = drawable;
+        }
+        drawableUpdates_.Resize(numKept);
+    }
+
+    // Octants are only pruned during the octree update, so the gathered octants stay valid
+    for (HashSet<Octant*>::ConstIterator i = octants.Begin(); i != octants.End(); ++i)
+        (*i)->RemoveDrawables(queuedRemovals_);
+
+    queuedRemovals_.Clear();
+}
+
 void Octree::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
 {
     // When running in headless mode, update the Octree manually during the RenderUpdate event
@@ -22,10 +22,12 @@
 
 #pragma once
 
+#include "../Container/HashSet.h"
 #include "../Container/List.h"
 #include "../Core/Mutex.h"
 #include "../Graphics/Drawable.h"
 #include "../Graphics/OctreeQuery.h"
+#include "../Graphics/StaticBVH.h"
 
 namespace Urho3D
 {
@@ -35,6 +37,26 @@ class Octree;
 static const int NUM_OCTANTS = 8;
 static const unsigned ROOT_INDEX = M_MAX_UNSIGNED;
 
+/// Octant culling result cached between frames by a coherent culling query.
+struct OctantCullCache
+{
+    /// Identifier of the query owner that cached the result, or zero if none.
+    unsigned owner_{};
+    /// Accumulated frustum movement of the owner until which the result stays valid.
+    double validUntil_{};
+    /// Cached intersection result.
+    Intersection result_{INTERSECTS};
+};
+
+/// %Drawable whose animation is evaluated in the octree's animation phase.
+struct AnimationJob
+{
+    /// Drawable.
+    Drawable* drawable_;
+    /// Evaluation result.
+    AnimationEvaluation result_;
+};
+
 /// %Octree octant
 class URHO3D_API Octant
 {
@@ -52,25 +74,27 @@ public:
     void InsertDrawable(Drawable* drawable);
     /// Check if a drawable object fits.
     bool CheckDrawableFit(const BoundingBox& box) const;
-
-    /// Add a drawable object to this octant.
-    void AddDrawable(Drawable* drawable)
+    /// Check if a drawable object should be inserted to this octant rather than to a child octant.
+    bool CheckDrawableInsert(Drawable* drawable, const BoundingBox& box) const;
+    /// Return the index of the child octant containing a point.
+    unsigned GetChildIndex(const Vector3& position) const
     {
-        drawable->SetOctant(this);
-        drawables_.Push(drawable);
-        IncDrawableCount();
+        return (position.x_ < center_.x_ ? 0 : 1) + (position.y_ < center_.y_ ? 0 : 2) + (position.z_ < center_.z_ ? 0 : 4);
     }
 
+    /// Add a drawable object to this octant.
+    void AddDrawable(Drawable* drawable);
     /// Remove a drawable object from this octant.
-    void RemoveDrawable(Drawable* drawable, bool resetOctant = true)
-    {
-        if (drawables_.Remove(drawable))
-        {
-            if (resetOctant)
-                drawable->SetOctant(nullptr);
-            DecDrawableCount();
-        }
-    }
+    void RemoveDrawable(Drawable* drawable, bool resetOctant = true);
+    /// Remove a set of drawable objects from this octant in one pass.
+    void RemoveDrawables(const HashSet<Drawable*>& drawables);
+    /// Store the current world bounding box of a drawable object in this octant.
+    void UpdateDrawableBox(Drawable* drawable) { drawableData_.SetBox(drawable->octantIndex_, drawable->GetWorldBoundingBox()); }
+
+    /// Invalidate the cached world bounding box of a drawable object, so that queries read it from the drawable until the next octree update.
+    void InvalidateDrawableBox(Drawable* drawable);
+    /// Store the current view mask of a drawable object in this octant.
+    void UpdateDrawableViewMask(Drawable* drawable);
 
     /// Return world-space bounding box.
     const BoundingBox& GetWorldBoundingBox() const { return worldBoundingBox_; }
@@ -78,6 +102,9 @@ public:
     /// Return bounding box used for fitting drawable objects.
     const BoundingBox& GetCullingBox() const { return cullingBox_; }
 
+    /// Return the culling result cached between frames. May be modified by coherent culling queries from the main thread.
+    OctantCullCache& GetCullCache() const { return cullCache_; }
+
     /// Return subdivision level.
     unsigned GetLevel() const { return level_; }
 
@@ -87,10 +114,13 @@ public:
     /// Return octree root.
     Octree* GetRoot() const { return root_; }
 
-    /// Return number of drawables.
+    /// Return cached query data of the drawable objects in this octant, in the same order as the drawables.
+    const DrawableQueryData& GetDrawableQueryData() const { return drawableData_; }
+
+    /// Return number of drawables in this octant and child octants, as of the last octree update.
     unsigned GetNumDrawables() const { return numDrawables_; }
 
-    /// Return true if there are no drawable objects in this octant and child octants.
+    /// Return true if there were no drawable objects in this octant and child octants as of the last octree update.
     bool IsEmpty() { return numDrawables_ == 0; }
 
     /// Reset root pointer recursively. Called when the whole octree is being destroyed.
@@ -105,32 +135,15 @@ protected:
     void GetDrawablesInternal(OctreeQuery& query, bool inside) const;
     /// Return drawable objects by a ray query, called internally.
     void GetDrawablesInternal(RayOctreeQuery& query) const;
+    /// Return drawable objects by a multiple frustum query, called internally. The masks hold the frustums the octant may intersect and the frustums it is known to be inside of.
+    void GetDrawablesInternal(MultiFrustumOctreeQuery& query, unsigned activeMask, unsigned insideMask) const;
     /// Return drawable objects only for a threaded ray query, called internally.
     void GetDrawablesOnlyInternal(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const;
 
-    /// Increase drawable object count recursively.
-    void IncDrawableCount()
-    {
-        ++numDrawables_;
-        if (parent_)
-            parent_->IncDrawableCount();
-    }
-
-    /// Decrease drawable object count recursively and remove octant if it becomes empty.
-    void DecDrawableCount()
-    {
-        Octant* parent = parent_;
-
-        --numDrawables_;
-        if (!numDrawables_)
-        {
-            if (parent)
-                parent->DeleteChild(index_);
-        }
-
-        if (parent)
-            parent->DecDrawableCount();
-    }
+    /// Mark the drawable object counts of the octree dirty.
+    void MarkDrawableCountsDirty();
+    /// Recalculate drawable object counts recursively and delete child octants that have become empty. Return the count.
+    unsigned UpdateDrawableCounts();
 
     /// World bounding box.
     BoundingBox worldBoundingBox_;
@@ -138,6 +151,8 @@ protected:
     BoundingBox cullingBox_;
     /// Drawable objects.
     PODVector<Drawable*> drawables_;
+    /// Cached bounding boxes, flags and view masks of the drawable objects, stored contiguously for the queries.
+    DrawableQueryData drawableData_;
     /// Child octants.
     Octant* children_[NUM_OCTANTS]{};
     /// World bounding box center.
@@ -154,6 +169,8 @@ protected:
     Octree* root_;
     /// Octant index relative to its siblings or ROOT_INDEX for root octant
     unsigned index_;
+    /// Culling result cached between frames.
+    mutable OctantCullCache cullCache_;
 };
 
 /// %Octree component. Should be added only to the root scene node
@@ -161,6 +178,8 @@ class URHO3D_API Octree : public Component, public Octant
 {
     URHO3D_OBJECT(Octree, Component);
 
+    friend class Octant;
+
 public:
     /// Construct.
     explicit Octree(Context* context);
@@ -183,6 +202,8 @@ public:
 
     /// Return drawable objects by a query.
     void GetDrawables(OctreeQuery& query) const;
+    /// Return drawable objects by a multiple frustum query, traversing the octree once for all frustums.
+    void GetDrawables(MultiFrustumOctreeQuery& query) const;
     /// Return drawable objects by a ray query.
     void Raycast(RayOctreeQuery& query) const;
     /// Return the closest drawable object by a ray query.
@@ -191,16 +212,44 @@ public:
     /// Return subdivision levels.
     unsigned GetNumLevels() const { return numLevels_; }
 
+    /// Return the bounding volume hierarchy of static drawable objects.
+    StaticBVH* GetStaticBVH() const { return staticBVH_; }
+
+    /// Return number of drawables whose animation was fully evaluated during the last update.
+    unsigned GetNumAnimationsEvaluated() const { return numAnimationsEvaluated_; }
+
+    /// Return number of drawables whose animation was interpolated between evaluations during the last update.
+    unsigned GetNumAnimationsInterpolated() const { return numAnimationsInterpolated_; }
+
+    /// Return number of drawables whose animation was skipped by animation LOD or visibility during the last update.
+    unsigned GetNumAnimationsSkipped() const { return numAnimationsSkipped_; }
+
     /// Mark drawable object as requiring an update and a reinsertion.
     void QueueUpdate(Drawable* drawable);
     /// Cancel drawable object's update.
     void CancelUpdate(Drawable* drawable);
+    /// Queue drawable object for removal at the end of the scene's batch node removal.
+    void QueueRemoval(Drawable* drawable);
+    /// Cancel drawable object's queued removal.
+    void CancelRemoval(Drawable* drawable);
     /// Visualize the component as debug geometry.
     void DrawDebugGeometry(bool depthTest);
 
+protected:
+    /// Handle scene being assigned.
+    void OnSceneSet(Scene* scene) override;
+
 private:
     /// Handle render update in case of headless execution.
     void HandleRenderUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle the scene finishing a batch node removal.
+    void HandleSceneBatchRemoved(StringHash eventType, VariantMap& eventData);
+    /// Remove drawable objects queued during a batch node removal.
+    void RemoveQueuedDrawables();
+    /// Reinsert drawable objects that no longer fit their octants, in worker threads per root child subtree if there are enough of them.
+    void ReinsertDrawables();
+    /// Evaluate the animations of the drawables queued for update in worker threads.
+    void EvaluateAnimations(const RenderFrameInfo& frame);
     /// Update octree size.
     void UpdateOctreeSize() { SetSize(worldBoundingBox_, numLevels_); }
 
@@ -208,12 +257,30 @@ private:
     PODVector<Drawable*> drawableUpdates_;
     /// Drawable objects that were inserted during threaded update phase.
     PODVector<Drawable*> threadedDrawableUpdates_;
+    /// Drawable objects queued for removal during a batch node removal.
+    HashSet<Drawable*> queuedRemovals_;
+    /// Drawables whose animation is evaluated during the octree update.
+    PODVector<AnimationJob> animationJobs_;
     /// Mutex for octree reinsertions.
     Mutex octreeMutex_;
     /// Ray query temporary list of drawables.
     mutable PODVector<Drawable*> rayQueryDrawables_;
+    /// Drawable objects that no longer fit their octants during the octree update.
+    PODVector<Drawable*> reinsertions_;
+    /// Drawable objects to reinsert in worker threads, sorted by root child octant.
+    PODVector<Drawable*> threadedReinsertions_;
+    /// Bounding volume hierarchy of static drawable objects.
+    SharedPtr<StaticBVH> staticBVH_;
     /// Subdivision level.
     unsigned numLevels_;
+    /// Number of animations evaluated during the last update.
+    unsigned numAnimationsEvaluated_;
+    /// Number of animations interpolated during the last update.
+    unsigned numAnimationsInterpolated_;
+    /// Number of animations skipped during the last update.
+    unsigned numAnimationsSkipped_;
+    /// Drawable object counts need recalculation flag.
+    bool drawableCountsDirty_;
 };
 
 }
@@ -22,13 +22,88 @@
 
 #include "../Precompiled.h"
 
+#include "../Graphics/Octree.h"
 #include "../Graphics/OctreeQuery.h"
 
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Urho3D
 {
 
+void DrawableQueryData::Push(Drawable* drawable)
+{
+    const BoundingBox& box = drawable->GetWorldBoundingBox();
+    boxMin_.Push(box.min_);
+    boxMax_.Push(box.max_);
+    drawableFlags_.Push(drawable->GetDrawableFlags());
+    viewMasks_.Push(drawable->GetViewMask());
+}
+
+void DrawableQueryData::Push(const DrawableQueryData& src, unsigned index)
+{
+    boxMin_.Push(src.boxMin_[index]);
+    boxMax_.Push(src.boxMax_[index]);
+    drawableFlags_.Push(src.drawableFlags_[index]);
+    viewMasks_.Push(src.viewMasks_[index]);
+}
+
+void DrawableQueryData::Pop()
+{
+    boxMin_.Pop();
+    boxMax_.Pop();
+    drawableFlags_.Pop();
+    viewMasks_.Pop();
+}
+
+void DrawableQueryData::Copy(unsigned dest, unsigned src)
+{
+    boxMin_[dest] = boxMin_[src];
+    boxMax_[dest] = boxMax_[src];
+    drawableFlags_[dest] = drawableFlags_[src];
+    viewMasks_[dest] = viewMasks_[src];
+}
+
+void DrawableQueryData::Resize(unsigned size)
+{
+    boxMin_.Resize(size);
+    boxMax_.Resize(size);
+    drawableFlags_.Resize(size);
+    viewMasks_.Resize(size);
+}
+
+void DrawableQueryData::Reserve(unsigned size)
+{
+    boxMin_.Reserve(size);
+    boxMax_.Reserve(size);
+    drawableFlags_.Reserve(size);
+    viewMasks_.Reserve(size);
+}
+
+void DrawableQueryData::Clear()
+{
+    boxMin_.Clear();
+    boxMax_.Clear();
+    drawableFlags_.Clear();
+    viewMasks_.Clear();
+}
+
+void DrawableQueryData::Swap(DrawableQueryData& rhs)
+{
+    boxMin_.Swap(rhs.boxMin_);
+    boxMax_.Swap(rhs.boxMax_);
+    drawableFlags_.Swap(rhs.drawableFlags_);
+    viewMasks_.Swap(rhs.viewMasks_);
+}
+
+Intersection OctreeQuery::TestOctantCached(const Octant* octant, bool inside)
+{
+    return TestOctant(octant->GetCullingBox(), inside);
+}
+
 Intersection PointOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -51,6 +126,21 @@ void PointOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool insi
     }
 }
 
+void PointOctreeQuery::TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+    bool inside)
+{
+    for (unsigned i = first; start != end; ++i)
+    {
+        Drawable* drawable = *start++;
+
+        if ((data.drawableFlags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_))
+        {
+            if (inside || data.GetBox(i, drawable).IsInside(point_))
+                result_.Push(drawable);
+        }
+    }
+}
+
 Intersection SphereOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -73,6 +163,21 @@ void SphereOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool ins
     }
 }
 
+void SphereOctreeQuery::TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+    bool inside)
+{
+    for (unsigned i = first; start != end; ++i)
+    {
+        Drawable* drawable = *start++;
+
+        if ((data.drawableFlags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_))
+        {
+            if (inside || sphere_.IsInsideFast(data.GetBox(i, drawable)))
+                result_.Push(drawable);
+        }
+    }
+}
+
 Intersection BoxOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -95,6 +200,21 @@ void BoxOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool inside
     }
 }
 
+void BoxOctreeQuery::TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+    bool inside)
+{
+    for (unsigned i = first; start != end; ++i)
+    {
+        Drawable* drawable = *start++;
+
+        if ((data.drawableFlags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_))
+        {
+            if (inside || box_.IsInsideFast(data.GetBox(i, drawable)))
+                result_.Push(drawable);
+        }
+    }
+}
+
 Intersection FrustumOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -117,6 +237,167 @@ void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool in
     }
 }
 
+/// Number of planes per frustum in the multiple frustum query plane data, rounded up to a multiple of four.
+static const unsigned QUERY_FRUSTUM_PLANES = 8;
+/// Number of floats per frustum in the multiple frustum query plane data: normal, distance and absolute normal for each plane.
+static const unsigned QUERY_FRUSTUM_STRIDE = QUERY_FRUSTUM_PLANES * 7;
+
+MultiFrustumOctreeQuery::MultiFrustumOctreeQuery(unsigned char drawableFlags) :
+    drawableFlags_(drawableFlags)
+{
+}
+
+unsigned MultiFrustumOctreeQuery::AddFrustum(const Frustum& frustum, unsigned viewMask)
+{
+    unsigned index = viewMasks_.Size();
+    if (index >= MAX_QUERY_FRUSTUMS)
+        return M_MAX_UNSIGNED;
+
+    viewMasks_.Push(viewMask);
+    if (results_.Size() <= index)
+        results_.Resize(index + 1);
+    results_[index].Clear();
+
+    planeData_.Resize(planeData_.Size() + QUERY_FRUSTUM_STRIDE);
+    float* data = &planeData_[index * QUERY_FRUSTUM_STRIDE];
+    for (unsigned i = 0; i < QUERY_FRUSTUM_PLANES; ++i)
+    {
+        // The padding planes have a zero normal and a large distance so that every box is inside them
+        Plane plane;
+        plane.normal_ = plane.absNormal_ = Vector3::ZERO;
+        plane.d_ = M_LARGE_VALUE;
+        if (i < NUM_FRUSTUM_PLANES)
+            plane = frustum.planes_[i];
+
+        data[i] = plane.normal_.x_;
+        data[QUERY_FRUSTUM_PLANES + i] = plane.normal_.y_;
+        data[QUERY_FRUSTUM_PLANES * 2 + i] = plane.normal_.z_;
+        data[QUERY_FRUSTUM_PLANES * 3 + i] = plane.d_;
+        data[QUERY_FRUSTUM_PLANES * 4 + i] = plane.absNormal_.x_;
+        data[QUERY_FRUSTUM_PLANES * 5 + i] = plane.absNormal_.y_;
+        data[QUERY_FRUSTUM_PLANES * 6 + i] = plane.absNormal_.z_;
+    }
+
+    return index;
+}
+
+void MultiFrustumOctreeQuery::Clear()
+{
+    ClearResults();
+    viewMasks_.Clear();
+    planeData_.Clear();
+}
+
+void MultiFrustumOctreeQuery::ClearResults()
+{
+    // Keep the result vectors allocated for reuse
+    for (unsigned i = 0; i < results_.Size(); ++i)
+        results_[i].Clear();
+}
+
+unsigned MultiFrustumOctreeQuery::TestBox(const BoundingBox& box, unsigned mask, unsigned& insideMask) const
+{
+    Vector3 center = box.Center();
+    Vector3 edge = center - box.min_;
+    unsigned outsideMask = 0;
+
+#ifdef URHO3D_SSE
+    __m128 centerX = _mm_set1_ps(center.x_);
+    __m128 centerY = _mm_set1_ps(center.y_);
+    __m128 centerZ = _mm_set1_ps(center.z_);
+    __m128 edgeX = _mm_set1_ps(edge.x_);
+    __m128 edgeY = _mm_set1_ps(edge.y_);
+    __m128 edgeZ = _mm_set1_ps(edge.z_);
+#endif
+
+    for (unsigned i = 0; mask; ++i, mask >>= 1)
+    {
+        if (!(mask & 1))
+            continue;
+
+        const float* data = &planeData_[i * QUERY_FRUSTUM_STRIDE];
+        bool outside = false;
+        bool allInside = true;
+
+        // Same arithmetic as Frustum::IsInside(), evaluated for four planes at a time
+#ifdef URHO3D_SSE
+        for (unsigned j = 0; j < QUERY_FRUSTUM_PLANES; j += 4)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_loadu_ps(data + j), centerX),
+                _mm_mul_ps(_mm_loadu_ps(data + QUERY_FRUSTUM_PLANES + j), centerY)),
+                _mm_mul_ps(_mm_loadu_ps(data + QUERY_FRUSTUM_PLANES * 2 + j), centerZ)),
+                _mm_loadu_ps(data + QUERY_FRUSTUM_PLANES * 3 + j));
+            __m128 absDist = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_loadu_ps(data + QUERY_FRUSTUM_PLANES * 4 + j), edgeX),
+                _mm_mul_ps(_mm_loadu_ps(data + QUERY_FRUSTUM_PLANES * 5 + j), edgeY)),
+                _mm_mul_ps(_mm_loadu_ps(data + QUERY_FRUSTUM_PLANES * 6 + j), edgeZ));
+
+            if (_mm_movemask_ps(_mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), absDist))))
+                outside = true;
+            if (_mm_movemask_ps(_mm_cmplt_ps(dist, absDist)))
+                allInside = false;
+        }
+#else
+        for (unsigned j = 0; j < NUM_FRUSTUM_PLANES; ++j)
+        {
+            float dist = data[j] * center.x_ + data[QUERY_FRUSTUM_PLANES + j] * center.y_ +
+                data[QUERY_FRUSTUM_PLANES * 2 + j] * center.z_ + data[QUERY_FRUSTUM_PLANES * 3 + j];
+            float absDist = data[QUERY_FRUSTUM_PLANES * 4 + j] * edge.x_ + data[QUERY_FRUSTUM_PLANES * 5 + j] * edge.y_ +
+                data[QUERY_FRUSTUM_PLANES * 6 + j] * edge.z_;
+
+            if (dist < -absDist)
+            {
+                outside = true;
+                break;
+            }
+            else if (dist < absDist)
+                allInside = false;
+        }
+#endif
+
+        if (outside)
+            outsideMask |= 1u << i;
+        else if (allInside)
+            insideMask |= 1u << i;
+    }
+
+    return outsideMask;
+}
+
+void MultiFrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+    unsigned activeMask, unsigned insideMask)
+{
+    unsigned numFrustums = viewMasks_.Size();
+
+    for (unsigned i = first; start != end; ++i)
+    {
+        Drawable* drawable = *start++;
+        if (!(data.drawableFlags_[i] & drawableFlags_))
+            continue;
+
+        unsigned drawableViewMask = data.viewMasks_[i];
+        unsigned mask = 0;
+        for (unsigned j = 0; j < numFrustums; ++j)
+        {
+            if (viewMasks_[j] & drawableViewMask)
+                mask |= 1u << j;
+        }
+        mask &= activeMask;
+
+        if (mask & ~insideMask)
+        {
+            unsigned ignored = 0;
+            mask &= ~TestBox(data.GetBox(i, drawable), mask & ~insideMask, ignored);
+        }
+
+        for (unsigned j = 0; mask; ++j, mask >>= 1)
+        {
+            if (mask & 1)
+                results_[j].Push(drawable);
+        }
+    }
+}
 
 Intersection AllContentOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
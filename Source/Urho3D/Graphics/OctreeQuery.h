@@ -33,6 +33,61 @@ namespace Urho3D
 
 class Drawable;
 class Node;
+class Octant;
+
+/// Query data of drawable objects, cached by an octant or the static BVH in structure of arrays layout and in the same order as the drawables, so that queries can reject drawables without dereferencing them. An invalidated bounding box means the drawable's own bounding box must be used.
+struct URHO3D_API DrawableQueryData
+{
+    /// Add a drawable's current data.
+    void Push(Drawable* drawable);
+    /// Add an entry copied from another instance.
+    void Push(const DrawableQueryData& src, unsigned index);
+    /// Remove the last entry.
+    void Pop();
+    /// Copy an entry to another index.
+    void Copy(unsigned dest, unsigned src);
+    /// Resize. New entries are undefined.
+    void Resize(unsigned size);
+    /// Reserve space for entries.
+    void Reserve(unsigned size);
+    /// Remove all entries.
+    void Clear();
+    /// Swap contents with another instance.
+    void Swap(DrawableQueryData& rhs);
+    /// Store a bounding box.
+    void SetBox(unsigned index, const BoundingBox& box)
+    {
+        boxMin_[index] = box.min_;
+        boxMax_[index] = box.max_;
+    }
+    /// Invalidate a bounding box.
+    void InvalidateBox(unsigned index)
+    {
+        boxMin_[index] = Vector3(M_INFINITY, M_INFINITY, M_INFINITY);
+        boxMax_[index] = Vector3(-M_INFINITY, -M_INFINITY, -M_INFINITY);
+    }
+
+    /// Return whether a bounding box is valid.
+    bool IsBoxDefined(unsigned index) const { return boxMin_[index].x_ != M_INFINITY; }
+    /// Return a bounding box. Undefined if it has been invalidated.
+    BoundingBox GetBox(unsigned index) const { return BoundingBox(boxMin_[index], boxMax_[index]); }
+    /// Return a bounding box if valid, otherwise the drawable's own bounding box.
+    BoundingBox GetBox(unsigned index, Drawable* drawable) const
+    {
+        return IsBoxDefined(index) ? BoundingBox(boxMin_[index], boxMax_[index]) : drawable->GetWorldBoundingBox();
+    }
+    /// Return number of entries.
+    unsigned Size() const { return drawableFlags_.Size(); }
+
+    /// World bounding box minimum coordinates.
+    PODVector<Vector3> boxMin_;
+    /// World bounding box maximum coordinates.
+    PODVector<Vector3> boxMax_;
+    /// Drawable flags.
+    PODVector<unsigned char> drawableFlags_;
+    /// View masks.
+    PODVector<unsigned> viewMasks_;
+};
 
 /// Base class for octree queries.
 class URHO3D_API OctreeQuery
@@ -56,8 +111,15 @@ public:
 
     /// Intersection test for an octant.
     virtual Intersection TestOctant(const BoundingBox& box, bool inside) = 0;
+    /// Intersection test for an octant's culling box, given the octant so that the result can be cached between frames. By default calls TestOctant().
+    virtual Intersection TestOctantCached(const Octant* octant, bool inside);
     /// Intersection test for drawables.
     virtual void TestDrawables(Drawable** start, Drawable** end, bool inside) = 0;
+    /// Intersection test for drawables using the query data cached by the octant, where the first drawable has the given data index. By default ignores the cached data.
+    virtual void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first, bool inside)
+    {
+        TestDrawables(start, end, inside);
+    }
 
     /// Result vector reference.
     PODVector<Drawable*>& result_;
@@ -83,6 +145,9 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using cached query data.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override;
 
     /// Point.
     Vector3 point_;
@@ -104,6 +169,9 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using cached query data.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override;
 
     /// Sphere.
     Sphere sphere_;
@@ -125,6 +193,9 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using cached query data.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override;
 
     /// Bounding box.
     BoundingBox box_;
@@ -151,6 +222,50 @@ public:
     Frustum frustum_;
 };
 
+/// Maximum number of frustums in a multiple frustum octree query.
+static const unsigned MAX_QUERY_FRUSTUMS = 32;
+
+/// %Frustum octree query for several frustums at once, for example the cull cameras of several views of the same scene. Each octant is tested against all the frustums it is not yet known to be inside or outside of during one traversal, and drawables are returned in a separate list per frustum, in the same order a single frustum query would return them.
+class URHO3D_API MultiFrustumOctreeQuery
+{
+public:
+    /// Construct with query parameters.
+    explicit MultiFrustumOctreeQuery(unsigned char drawableFlags = DRAWABLE_ANY);
+
+    /// Prevent copy construction.
+    MultiFrustumOctreeQuery(const MultiFrustumOctreeQuery& rhs) = delete;
+    /// Prevent assignment.
+    MultiFrustumOctreeQuery& operator =(const MultiFrustumOctreeQuery& rhs) = delete;
+
+    /// Add a frustum with its view mask. Return the frustum index, or M_MAX_UNSIGNED if the maximum number of frustums has been reached.
+    unsigned AddFrustum(const Frustum& frustum, unsigned viewMask = DEFAULT_VIEWMASK);
+    /// Remove all frustums and results.
+    void Clear();
+    /// Clear the result lists but keep the frustums.
+    void ClearResults();
+    /// Test a bounding box against the frustums in a bitmask. Return the bitmask of frustums the box is outside of, and add the frustums it is completely inside of to the inside mask.
+    unsigned TestBox(const BoundingBox& box, unsigned mask, unsigned& insideMask) const;
+    /// Intersection test for drawables with their cached query data, where the first drawable has the given data index. Drawables are tested against the frustums in the active mask that are not in the inside mask.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first, unsigned activeMask,
+        unsigned insideMask);
+
+    /// Return number of frustums.
+    unsigned GetNumFrustums() const { return viewMasks_.Size(); }
+    /// Return bitmask of all frustums.
+    unsigned GetFrustumMask() const { return viewMasks_.Size() < 32 ? (1u << viewMasks_.Size()) - 1 : M_MAX_UNSIGNED; }
+
+    /// Result vectors, one per frustum.
+    Vector<PODVector<Drawable*> > results_;
+    /// View masks of the frustums.
+    PODVector<unsigned> viewMasks_;
+    /// Drawable flags to include.
+    unsigned char drawableFlags_;
+
+private:
+    /// Frustum planes in structure of arrays layout for testing four planes at a time. Each frustum has eight planes of which the last two never cull.
+    PODVector<float> planeData_;
+};
+
 /// General octree query result. Used for Lua bindings only.
 struct URHO3D_API OctreeQueryResult
 {
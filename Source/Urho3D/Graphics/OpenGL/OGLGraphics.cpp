@@ -33,6 +33,7 @@
 #include "../../Graphics/IndexBuffer.h"
 #include "../../Graphics/RenderSurface.h"
 #include "../../Graphics/Shader.h"
+#include "../../Graphics/ShaderParameterBlock.h"
 #include "../../Graphics/ShaderPrecache.h"
 #include "../../Graphics/ShaderProgram.h"
 #include "../../Graphics/ShaderVariation.h"
@@ -1034,14 +1035,11 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
         {
             URHO3D_PROFILE(CompileVertexShader);
 
-            bool success = vs->Create();
+            bool success = CreateShaderVariation(vs);
             if (success)
                 URHO3D_LOGDEBUG("Compiled vertex shader " + vs->GetFullName());
             else
-            {
-                URHO3D_LOGERROR("Failed to compile vertex shader " + vs->GetFullName() + ":\n" + vs->GetCompilerOutput());
                 vs = nullptr;
-            }
         }
         else
             vs = nullptr;
@@ -1053,14 +1051,11 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
         {
             URHO3D_PROFILE(CompilePixelShader);
 
-            bool success = ps->Create();
+            bool success = CreateShaderVariation(ps);
             if (success)
                 URHO3D_LOGDEBUG("Compiled pixel shader " + ps->GetFullName());
             else
-            {
-                URHO3D_LOGERROR("Failed to compile pixel shader " + ps->GetFullName() + ":\n" + ps->GetCompilerOutput());
                 ps = nullptr;
-            }
         }
         else
             ps = nullptr;
@@ -1467,6 +1462,141 @@ void Graphics::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
     }
 }
 
+void Graphics::SetShaderParameters(const ShaderParameterBlock& block)
+{
+    if (!impl_->shaderProgram_ || block.IsEmpty())
+        return;
+
+    const PODVector<const ShaderParameter*>& layout = block.GetLayout(impl_->shaderProgram_, impl_->shaderProgram_->GetParameters());
+    const PODVector<ShaderParameterBlockEntry>& entries = block.GetEntries();
+    const float* data = block.GetData();
+    Matrix4 fullMatrix;
+
+    for (unsigned i = 0; i < entries.Size(); ++i)
+    {
+        const ShaderParameter* info = layout[i];
+        if (!info)
+            continue;
+
+        const ShaderParameterBlockEntry& entry = entries[i];
+        const float* value = data + entry.offset_;
+        unsigned count = entry.count_;
+
+        // Expand to a full Matrix4
+        if (entry.type_ == VAR_MATRIX3X4)
+        {
+            fullMatrix = reinterpret_cast<const Matrix3x4*>(value)->ToMatrix4();
+            value = fullMatrix.Data();
+            count = 16;
+        }
+
+        if (info->bufferPtr_)
+        {
+            ConstantBuffer* buffer = info->bufferPtr_;
+            if (!buffer->IsDirty())
+                impl_->dirtyConstantBuffers_.Push(buffer);
+
+            switch (entry.type_)
+            {
+            case VAR_BOOL:
+                {
+                    bool boolValue = *value != 0.0f;
+                    buffer->SetParameter(info->offset_, sizeof(bool), &boolValue);
+                }
+                break;
+
+            case VAR_MATRIX3:
+                buffer->SetVector3ArrayParameter(info->offset_, 3, value);
+                break;
+
+            default:
+                // Integers are stored as their bit pattern, so they can be copied like floats
+                buffer->SetParameter(info->offset_, (unsigned)(count * sizeof(float)), value);
+                break;
+            }
+            continue;
+        }
+
+        if (entry.type_ == VAR_BOOL)
+        {
+            glUniform1i(info->location_, *value != 0.0f ? 1 : 0);
+            continue;
+        }
+        if (entry.type_ == VAR_INT)
+        {
+            int intValue;
+            memcpy(&intValue, value, sizeof intValue);
+            glUniform1i(info->location_, intValue);
+            continue;
+        }
+
+        // Check the uniform type to avoid mismatch. Typed values set one element, raw float arrays as many as they fill
+        unsigned components;
+        switch (info->glType_)
+        {
+        case GL_FLOAT:
+            components = 1;
+            break;
+
+        case GL_FLOAT_VEC2:
+            components = 2;
+            break;
+
+        case GL_FLOAT_VEC3:
+            components = 3;
+            break;
+
+        case GL_FLOAT_VEC4:
+            components = 4;
+            break;
+
+        case GL_FLOAT_MAT3:
+            components = 9;
+            break;
+
+        case GL_FLOAT_MAT4:
+            components = 16;
+            break;
+
+        default:
+            continue;
+        }
+
+        if (components > count)
+            continue;
+        GLsizei elements = entry.type_ == VAR_BUFFER ? (GLsizei)(count / components) : 1;
+
+        switch (info->glType_)
+        {
+        case GL_FLOAT:
+            glUniform1fv(info->location_, elements, value);
+            break;
+
+        case GL_FLOAT_VEC2:
+            glUniform2fv(info->location_, elements, value);
+            break;
+
+        case GL_FLOAT_VEC3:
+            glUniform3fv(info->location_, elements, value);
+            break;
+
+        case GL_FLOAT_VEC4:
+            glUniform4fv(info->location_, elements, value);
+            break;
+
+        case GL_FLOAT_MAT3:
+            glUniformMatrix3fv(info->location_, elements, GL_FALSE, value);
+            break;
+
+        case GL_FLOAT_MAT4:
+            glUniformMatrix4fv(info->location_, elements, GL_FALSE, value);
+            break;
+
+        default: break;
+        }
+    }
+}
+
 bool Graphics::NeedParameterUpdate(ShaderParameterGroup group, const void* source)
 {
     return impl_->shaderProgram_ ? impl_->shaderProgram_->NeedParameterUpdate(group, source) : false;
@@ -25,6 +25,7 @@
 #include "../../Graphics/ConstantBuffer.h"
 #include "../../Graphics/Graphics.h"
 #include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/ShaderParameterBlock.h"
 #include "../../Graphics/ShaderProgram.h"
 #include "../../Graphics/ShaderVariation.h"
 #include "../../IO/Log.h"
@@ -100,6 +101,8 @@ void ShaderProgram::Release()
         object_.name_ = 0;
         linkerOutput_.Clear();
         shaderParameters_.Clear();
+        // The program may be relinked in place, so parameter locations resolved against it become stale
+        ShaderParameterBlock::InvalidateLayouts();
         vertexAttributes_.Clear();
         usedVertexAttributes_ = 0;
 
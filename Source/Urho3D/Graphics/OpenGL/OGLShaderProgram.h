@@ -64,6 +64,9 @@ public:
     /// Return the info for a shader parameter, or null if does not exist.
     const ShaderParameter* GetParameter(StringHash param) const;
 
+    /// Return all shader parameters.
+    const HashMap<StringHash, ShaderParameter>& GetParameters() const { return shaderParameters_; }
+
     /// Return linker output.
     const String& GetLinkerOutput() const { return linkerOutput_; }
 
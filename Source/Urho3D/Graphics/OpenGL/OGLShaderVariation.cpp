@@ -187,6 +187,23 @@ bool ShaderVariation::Create()
     return object_.name_ != 0;
 }
 
+bool ShaderVariation::CompileByteCode(const String& sourceCode, String& compilerOutput)
+{
+    // The driver compiles from source when the shader object is created, so there is no bytecode to cache
+    loadedFromCache_ = false;
+    return true;
+}
+
+bool ShaderVariation::CreateObject()
+{
+    return Create();
+}
+
+bool ShaderVariation::GetByteCodeSupport()
+{
+    return false;
+}
+
 void ShaderVariation::SetDefines(const String& defines)
 {
     defines_ = defines;
@@ -194,7 +211,7 @@ void ShaderVariation::SetDefines(const String& defines)
 
 // These methods are no-ops for OpenGL
 bool ShaderVariation::LoadByteCode(const String& binaryShaderName) { return false; }
-bool ShaderVariation::Compile() { return false; }
+bool ShaderVariation::Compile(const String& sourceCode, String& compilerOutput) { return false; }
 void ShaderVariation::ParseParameters(unsigned char* bufData, unsigned bufSize) {}
 void ShaderVariation::SaveByteCode(const String& binaryShaderName) {}
 void ShaderVariation::CalculateConstantBufferSizes() {}
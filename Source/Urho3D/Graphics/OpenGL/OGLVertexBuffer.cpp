@@ -159,6 +159,12 @@ bool VertexBuffer::SetDataRange(const void* data, unsigned start, unsigned count
     return true;
 }
 
+bool VertexBuffer::SetDataRangeNoOverwrite(const void* data, unsigned start, unsigned count)
+{
+    // Buffer updates are ordered by the driver, and persistent mapping is not used
+    return SetDataRange(data, start, count);
+}
+
 void* VertexBuffer::Lock(unsigned start, unsigned count, bool discard)
 {
     if (lockState_ != LOCK_NONE)
@@ -0,0 +1,739 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Profiler.h"
+#include "../Graphics/Camera.h"
+#include "../Graphics/Graphics.h"
+#include "../Graphics/RenderCommandBuffer.h"
+#include "../Graphics/Renderer.h"
+#include "../Graphics/ShaderParameterBlock.h"
+#include "../Graphics/View.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const unsigned STATE_SHADERS = 0x1;
+static const unsigned STATE_BLENDMODE = 0x2;
+static const unsigned STATE_CULLMODE = 0x4;
+static const unsigned STATE_DEPTHBIAS = 0x8;
+static const unsigned STATE_DEPTHTEST = 0x10;
+static const unsigned STATE_DEPTHWRITE = 0x20;
+static const unsigned STATE_FILLMODE = 0x40;
+static const unsigned STATE_LINEANTIALIAS = 0x80;
+static const unsigned STATE_SCISSOROFF = 0x100;
+static const unsigned STATE_STENCILTEST = 0x200;
+static const unsigned STATE_INDEXBUFFER = 0x400;
+
+template <class T> inline T* GetCommandObject(const RecordedCommand& command, unsigned index)
+{
+    return static_cast<T*>(command.objects_[index]);
+}
+
+RenderCommandBuffer::RenderCommandBuffer() :
+    openParameterGroup_(M_MAX_UNSIGNED),
+    numFilteredCommands_(0),
+    knownStates_(0),
+    knownParameterSources_(0),
+    knownTextures_(0),
+    vertexShader_(nullptr),
+    pixelShader_(nullptr),
+    blendMode_(BLEND_REPLACE),
+    alphaToCoverage_(false),
+    cullMode_(CULL_CCW),
+    constantDepthBias_(0.0f),
+    slopeScaledDepthBias_(0.0f),
+    depthTestMode_(CMP_LESSEQUAL),
+    depthWrite_(true),
+    fillMode_(FILL_SOLID),
+    lineAntiAlias_(false),
+    indexBuffer_(nullptr),
+    lastVertexBuffers_(M_MAX_UNSIGNED)
+{
+    for (unsigned& value : stencilTest_)
+        value = 0;
+    for (auto& source : parameterSources_)
+        source = nullptr;
+    for (auto& texture : textures_)
+        texture = nullptr;
+}
+
+void RenderCommandBuffer::Clear()
+{
+    commands_.Clear();
+    data_.Clear();
+    vertexBuffers_.Clear();
+    openParameterGroup_ = M_MAX_UNSIGNED;
+    numFilteredCommands_ = 0;
+    knownStates_ = 0;
+    knownParameterSources_ = 0;
+    knownTextures_ = 0;
+    blendMode_ = BLEND_REPLACE;
+    lastVertexBuffers_ = M_MAX_UNSIGNED;
+}
+
+void RenderCommandBuffer::Replay(View* view, bool allowDepthWrite)
+{
+    URHO3D_PROFILE(ReplayRenderCommands);
+
+    Graphics* graphics = view->GetGraphics();
+    Renderer* renderer = view->GetRenderer();
+
+    CloseParameterGroup();
+
+    for (unsigned i = 0; i < commands_.Size(); ++i)
+    {
+        const RecordedCommand& command = commands_[i];
+        const unsigned* values = command.values_;
+
+        switch (command.type_)
+        {
+        case RC_SHADERS:
+            graphics->SetShaders(GetCommandObject<ShaderVariation>(command, 0), GetCommandObject<ShaderVariation>(command, 1));
+            break;
+
+        case RC_BLENDMODE:
+            graphics->SetBlendMode((BlendMode)values[0], values[1] != 0);
+            break;
+
+        case RC_CULLMODE:
+            graphics->SetCullMode((CullMode)values[0]);
+            break;
+
+        case RC_DEPTHBIAS:
+            graphics->SetDepthBias(data_[values[0]], data_[values[0] + 1]);
+            break;
+
+        case RC_DEPTHTEST:
+            graphics->SetDepthTest((CompareMode)values[0]);
+            break;
+
+        case RC_DEPTHWRITE:
+            graphics->SetDepthWrite(values[0] != 0 && allowDepthWrite);
+            break;
+
+        case RC_FILLMODE:
+            graphics->SetFillMode((FillMode)values[0]);
+            break;
+
+        case RC_LINEANTIALIAS:
+            graphics->SetLineAntiAlias(values[0] != 0);
+            break;
+
+        case RC_SCISSORTEST:
+            if (values[0])
+            {
+                const float* rect = data_.Buffer() + values[2];
+                graphics->SetScissorTest(true, Rect(rect[0], rect[1], rect[2], rect[3]), values[1] != 0);
+            }
+            else
+                graphics->SetScissorTest(false);
+            break;
+
+        case RC_STENCILTEST:
+            graphics->SetStencilTest(values[0] != 0, (CompareMode)values[1], (StencilOp)values[2], (StencilOp)values[3],
+                (StencilOp)values[4], values[5], values[6], values[7]);
+            break;
+
+        case RC_LIGHTSCISSOR:
+            renderer->OptimizeLightByScissor(GetCommandObject<Light>(command, 0), GetCommandObject<Camera>(command, 1));
+            break;
+
+        case RC_PARAMETERGROUP:
+            // Skip the group's parameters if the graphics subsystem already has them
+            if (!graphics->NeedParameterUpdate((ShaderParameterGroup)values[0], command.objects_[0]))
+                i += values[1];
+            break;
+
+        case RC_VIEWPARAMETERS:
+            view->SetViewShaderParameters(GetCommandObject<Camera>(command, 0));
+            break;
+
+        case RC_SHADERPARAMETER:
+            {
+                StringHash param(values[0]);
+                const float* data = data_.Buffer() + values[2];
+
+                switch (values[1])
+                {
+                case VAR_BOOL:
+                    graphics->SetShaderParameter(param, *data != 0.0f);
+                    break;
+
+                case VAR_INT:
+                    {
+                        int value;
+                        memcpy(&value, data, sizeof value);
+                        graphics->SetShaderParameter(param, value);
+                    }
+                    break;
+
+                case VAR_FLOAT:
+                    graphics->SetShaderParameter(param, *data);
+                    break;
+
+                case VAR_VECTOR2:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Vector2*>(data));
+                    break;
+
+                case VAR_VECTOR3:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Vector3*>(data));
+                    break;
+
+                case VAR_VECTOR4:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Vector4*>(data));
+                    break;
+
+                case VAR_COLOR:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Color*>(data));
+                    break;
+
+                case VAR_MATRIX3:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Matrix3*>(data));
+                    break;
+
+                case VAR_MATRIX3X4:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Matrix3x4*>(data));
+                    break;
+
+                case VAR_MATRIX4:
+                    graphics->SetShaderParameter(param, *reinterpret_cast<const Matrix4*>(data));
+                    break;
+
+                default:
+                    graphics->SetShaderParameter(param, data, values[3]);
+                    break;
+                }
+            }
+            break;
+
+        case RC_SHADERPARAMETERBLOCK:
+            graphics->SetShaderParameters(*GetCommandObject<const ShaderParameterBlock>(command, 0));
+            break;
+
+        case RC_TEXTURE:
+            if (graphics->HasTextureUnit((TextureUnit)values[0]))
+                graphics->SetTexture(values[0], GetCommandObject<Texture>(command, 0));
+            break;
+
+        case RC_INDEXBUFFER:
+            graphics->SetIndexBuffer(GetCommandObject<IndexBuffer>(command, 0));
+            break;
+
+        case RC_VERTEXBUFFERS:
+            replayVertexBuffers_.Resize(values[1]);
+            for (unsigned j = 0; j < values[1]; ++j)
+                replayVertexBuffers_[j] = vertexBuffers_[values[0] + j];
+            graphics->SetVertexBuffers(replayVertexBuffers_, values[2]);
+            break;
+
+        case RC_DRAW:
+            graphics->Draw((PrimitiveType)values[0], values[1], values[2]);
+            break;
+
+        case RC_DRAWINDEXED:
+            graphics->Draw((PrimitiveType)values[0], values[1], values[2], values[3], values[4]);
+            break;
+
+        case RC_DRAWINSTANCED:
+            graphics->DrawInstanced((PrimitiveType)values[0], values[1], values[2], values[3], values[4], values[5]);
+            break;
+        }
+    }
+}
+
+void RenderCommandBuffer::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
+{
+    if ((knownStates_ & STATE_SHADERS) && vs == vertexShader_ && ps == pixelShader_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_SHADERS);
+    command.objects_[0] = vs;
+    command.objects_[1] = ps;
+    vertexShader_ = vs;
+    pixelShader_ = ps;
+    knownStates_ |= STATE_SHADERS;
+
+    // Parameter sources and texture unit usage depend on the shaders
+    ResetShaderState();
+}
+
+void RenderCommandBuffer::SetBlendMode(BlendMode mode, bool alphaToCoverage)
+{
+    if ((knownStates_ & STATE_BLENDMODE) && mode == blendMode_ && alphaToCoverage == alphaToCoverage_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_BLENDMODE);
+    command.values_[0] = mode;
+    command.values_[1] = alphaToCoverage ? 1 : 0;
+    blendMode_ = mode;
+    alphaToCoverage_ = alphaToCoverage;
+    knownStates_ |= STATE_BLENDMODE;
+}
+
+void RenderCommandBuffer::SetCullMode(CullMode mode, Camera* camera)
+{
+    // If a camera is specified, check whether it reverses culling due to vertical flipping or reflection
+    if (camera && camera->GetReverseCulling())
+    {
+        if (mode == CULL_CW)
+            mode = CULL_CCW;
+        else if (mode == CULL_CCW)
+            mode = CULL_CW;
+    }
+
+    if ((knownStates_ & STATE_CULLMODE) && mode == cullMode_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_CULLMODE);
+    command.values_[0] = mode;
+    cullMode_ = mode;
+    knownStates_ |= STATE_CULLMODE;
+}
+
+void RenderCommandBuffer::SetDepthBias(float constantBias, float slopeScaledBias)
+{
+    if ((knownStates_ & STATE_DEPTHBIAS) && constantBias == constantDepthBias_ && slopeScaledBias == slopeScaledDepthBias_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_DEPTHBIAS);
+    command.values_[0] = data_.Size();
+    data_.Push(constantBias);
+    data_.Push(slopeScaledBias);
+    constantDepthBias_ = constantBias;
+    slopeScaledDepthBias_ = slopeScaledBias;
+    knownStates_ |= STATE_DEPTHBIAS;
+}
+
+void RenderCommandBuffer::SetDepthTest(CompareMode mode)
+{
+    if ((knownStates_ & STATE_DEPTHTEST) && mode == depthTestMode_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_DEPTHTEST);
+    command.values_[0] = mode;
+    depthTestMode_ = mode;
+    knownStates_ |= STATE_DEPTHTEST;
+}
+
+void RenderCommandBuffer::SetDepthWrite(bool enable)
+{
+    if ((knownStates_ & STATE_DEPTHWRITE) && enable == depthWrite_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_DEPTHWRITE);
+    command.values_[0] = enable ? 1 : 0;
+    depthWrite_ = enable;
+    knownStates_ |= STATE_DEPTHWRITE;
+}
+
+void RenderCommandBuffer::SetFillMode(FillMode mode)
+{
+    if ((knownStates_ & STATE_FILLMODE) && mode == fillMode_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_FILLMODE);
+    command.values_[0] = mode;
+    fillMode_ = mode;
+    knownStates_ |= STATE_FILLMODE;
+}
+
+void RenderCommandBuffer::SetLineAntiAlias(bool enable)
+{
+    if ((knownStates_ & STATE_LINEANTIALIAS) && enable == lineAntiAlias_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_LINEANTIALIAS);
+    command.values_[0] = enable ? 1 : 0;
+    lineAntiAlias_ = enable;
+    knownStates_ |= STATE_LINEANTIALIAS;
+}
+
+void RenderCommandBuffer::SetScissorTest(bool enable, const Rect& rect, bool borderInclusive)
+{
+    // Only a disabled scissor test is tracked, as enabled scissor rects depend on the viewport at replay time
+    if (!enable && (knownStates_ & STATE_SCISSOROFF))
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_SCISSORTEST);
+    command.values_[0] = enable ? 1 : 0;
+    command.values_[1] = borderInclusive ? 1 : 0;
+    if (enable)
+    {
+        command.values_[2] = data_.Size();
+        data_.Push(rect.min_.x_);
+        data_.Push(rect.min_.y_);
+        data_.Push(rect.max_.x_);
+        data_.Push(rect.max_.y_);
+        knownStates_ &= ~STATE_SCISSOROFF;
+    }
+    else
+        knownStates_ |= STATE_SCISSOROFF;
+}
+
+void RenderCommandBuffer::SetStencilTest(bool enable, CompareMode mode, StencilOp pass, StencilOp fail, StencilOp zFail,
+    unsigned stencilRef, unsigned compareMask, unsigned writeMask)
+{
+    const unsigned values[] = {enable ? 1u : 0u, (unsigned)mode, (unsigned)pass, (unsigned)fail, (unsigned)zFail, stencilRef,
+        compareMask, writeMask};
+
+    if ((knownStates_ & STATE_STENCILTEST) && !memcmp(values, stencilTest_, sizeof values))
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_STENCILTEST);
+    memcpy(command.values_, values, sizeof values);
+    memcpy(stencilTest_, values, sizeof values);
+    knownStates_ |= STATE_STENCILTEST;
+}
+
+void RenderCommandBuffer::OptimizeLightByScissor(Light* light, Camera* camera)
+{
+    RecordedCommand& command = AddCommand(RC_LIGHTSCISSOR);
+    command.objects_[0] = light;
+    command.objects_[1] = camera;
+
+    // The resulting scissor test is only known on replay
+    knownStates_ &= ~STATE_SCISSOROFF;
+}
+
+bool RenderCommandBuffer::NeedParameterUpdate(ShaderParameterGroup group, const void* source)
+{
+    // If the same source was recorded for the group with the current shaders, the graphics subsystem will skip it anyway
+    if ((knownParameterSources_ & (1u << group)) && parameterSources_[group] == source)
+    {
+        ++numFilteredCommands_;
+        return false;
+    }
+
+    RecordedCommand& command = AddCommand(RC_PARAMETERGROUP);
+    command.values_[0] = group;
+    command.objects_[0] = const_cast<void*>(source);
+    openParameterGroup_ = commands_.Size() - 1;
+    parameterSources_[group] = source;
+    knownParameterSources_ |= 1u << group;
+    return true;
+}
+
+void RenderCommandBuffer::SetViewShaderParameters(Camera* camera)
+{
+    RecordedCommand& command = AddCommand(RC_VIEWPARAMETERS);
+    command.objects_[0] = camera;
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const float* data, unsigned count)
+{
+    AddShaderParameter(param, VAR_BUFFER, data, count);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, float value)
+{
+    AddShaderParameter(param, VAR_FLOAT, &value, 1);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, int value)
+{
+    float data;
+    memcpy(&data, &value, sizeof data);
+    AddShaderParameter(param, VAR_INT, &data, 1);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, bool value)
+{
+    float data = value ? 1.0f : 0.0f;
+    AddShaderParameter(param, VAR_BOOL, &data, 1);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Color& color)
+{
+    AddShaderParameter(param, VAR_COLOR, color.Data(), 4);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Vector2& vector)
+{
+    AddShaderParameter(param, VAR_VECTOR2, vector.Data(), 2);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Matrix3& matrix)
+{
+    AddShaderParameter(param, VAR_MATRIX3, matrix.Data(), 9);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Vector3& vector)
+{
+    AddShaderParameter(param, VAR_VECTOR3, vector.Data(), 3);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Matrix4& matrix)
+{
+    AddShaderParameter(param, VAR_MATRIX4, matrix.Data(), 16);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Vector4& vector)
+{
+    AddShaderParameter(param, VAR_VECTOR4, vector.Data(), 4);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
+{
+    AddShaderParameter(param, VAR_MATRIX3X4, matrix.Data(), 12);
+}
+
+void RenderCommandBuffer::SetShaderParameter(StringHash param, const Variant& value)
+{
+    switch (value.GetType())
+    {
+    case VAR_BOOL:
+        SetShaderParameter(param, value.GetBool());
+        break;
+
+    case VAR_INT:
+        SetShaderParameter(param, value.GetInt());
+        break;
+
+    case VAR_FLOAT:
+    case VAR_DOUBLE:
+        SetShaderParameter(param, value.GetFloat());
+        break;
+
+    case VAR_VECTOR2:
+        SetShaderParameter(param, value.GetVector2());
+        break;
+
+    case VAR_VECTOR3:
+        SetShaderParameter(param, value.GetVector3());
+        break;
+
+    case VAR_VECTOR4:
+        SetShaderParameter(param, value.GetVector4());
+        break;
+
+    case VAR_COLOR:
+        SetShaderParameter(param, value.GetColor());
+        break;
+
+    case VAR_MATRIX3:
+        SetShaderParameter(param, value.GetMatrix3());
+        break;
+
+    case VAR_MATRIX3X4:
+        SetShaderParameter(param, value.GetMatrix3x4());
+        break;
+
+    case VAR_MATRIX4:
+        SetShaderParameter(param, value.GetMatrix4());
+        break;
+
+    case VAR_BUFFER:
+        {
+            const PODVector<unsigned char>& buffer = value.GetBuffer();
+            if (buffer.Size() >= sizeof(float))
+                SetShaderParameter(param, reinterpret_cast<const float*>(&buffer[0]), buffer.Size() / sizeof(float));
+        }
+        break;
+
+    default:
+        // Unsupported parameter type, do nothing
+        break;
+    }
+}
+
+void RenderCommandBuffer::SetShaderParameters(const ShaderParameterBlock& block)
+{
+    RecordedCommand& command = AddCommand(RC_SHADERPARAMETERBLOCK);
+    command.objects_[0] = const_cast<ShaderParameterBlock*>(&block);
+}
+
+void RenderCommandBuffer::SetTexture(unsigned index, Texture* texture)
+{
+    if (index >= MAX_TEXTURE_UNITS)
+        return;
+
+    if ((knownTextures_ & (1u << index)) && textures_[index] == texture)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_TEXTURE);
+    command.values_[0] = index;
+    command.objects_[0] = texture;
+    textures_[index] = texture;
+    knownTextures_ |= 1u << index;
+}
+
+void RenderCommandBuffer::SetIndexBuffer(IndexBuffer* buffer)
+{
+    if ((knownStates_ & STATE_INDEXBUFFER) && buffer == indexBuffer_)
+    {
+        ++numFilteredCommands_;
+        return;
+    }
+
+    RecordedCommand& command = AddCommand(RC_INDEXBUFFER);
+    command.objects_[0] = buffer;
+    indexBuffer_ = buffer;
+    knownStates_ |= STATE_INDEXBUFFER;
+}
+
+void RenderCommandBuffer::SetVertexBuffers(const Vector<SharedPtr<VertexBuffer> >& buffers, unsigned instanceOffset)
+{
+    SetVertexBuffers(buffers, nullptr, instanceOffset);
+}
+
+void RenderCommandBuffer::SetVertexBuffers(const Vector<SharedPtr<VertexBuffer> >& buffers, VertexBuffer* instanceBuffer,
+    unsigned instanceOffset)
+{
+    unsigned start = vertexBuffers_.Size();
+    for (unsigned i = 0; i < buffers.Size(); ++i)
+        vertexBuffers_.Push(buffers[i].Get());
+    if (instanceBuffer)
+        vertexBuffers_.Push(instanceBuffer);
+    unsigned count = vertexBuffers_.Size() - start;
+
+    if (lastVertexBuffers_ != M_MAX_UNSIGNED)
+    {
+        const RecordedCommand& last = commands_[lastVertexBuffers_];
+        if (last.values_[1] == count && last.values_[2] == instanceOffset &&
+            (!count || !memcmp(&vertexBuffers_[last.values_[0]], &vertexBuffers_[start], count * sizeof(VertexBuffer*))))
+        {
+            vertexBuffers_.Resize(start);
+            ++numFilteredCommands_;
+            return;
+        }
+    }
+
+    RecordedCommand& command = AddCommand(RC_VERTEXBUFFERS);
+    command.values_[0] = start;
+    command.values_[1] = count;
+    command.values_[2] = instanceOffset;
+    lastVertexBuffers_ = commands_.Size() - 1;
+}
+
+void RenderCommandBuffer::Draw(PrimitiveType type, unsigned vertexStart, unsigned vertexCount)
+{
+    RecordedCommand& command = AddCommand(RC_DRAW);
+    command.values_[0] = type;
+    command.values_[1] = vertexStart;
+    command.values_[2] = vertexCount;
+}
+
+void RenderCommandBuffer::Draw(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount)
+{
+    RecordedCommand& command = AddCommand(RC_DRAWINDEXED);
+    command.values_[0] = type;
+    command.values_[1] = indexStart;
+    command.values_[2] = indexCount;
+    command.values_[3] = minVertex;
+    command.values_[4] = vertexCount;
+}
+
+void RenderCommandBuffer::DrawInstanced(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex,
+    unsigned vertexCount, unsigned instanceCount)
+{
+    RecordedCommand& command = AddCommand(RC_DRAWINSTANCED);
+    command.values_[0] = type;
+    command.values_[1] = indexStart;
+    command.values_[2] = indexCount;
+    command.values_[3] = minVertex;
+    command.values_[4] = vertexCount;
+    command.values_[5] = instanceCount;
+}
+
+unsigned RenderCommandBuffer::GetDataSize() const
+{
+    return commands_.Size() * sizeof(RecordedCommand) + data_.Size() * sizeof(float) + vertexBuffers_.Size() * sizeof(VertexBuffer*);
+}
+
+RecordedCommand& RenderCommandBuffer::AddCommand(RecordedCommandType type)
+{
+    if (type != RC_SHADERPARAMETER && type != RC_SHADERPARAMETERBLOCK)
+        CloseParameterGroup();
+
+    commands_.Push(RecordedCommand());
+    RecordedCommand& command = commands_.Back();
+    command.type_ = type;
+    return command;
+}
+
+void RenderCommandBuffer::AddShaderParameter(StringHash param, VariantType type, const float* data, unsigned count)
+{
+    RecordedCommand& command = AddCommand(RC_SHADERPARAMETER);
+    command.values_[0] = param.Value();
+    command.values_[1] = type;
+    command.values_[2] = data_.Size();
+    command.values_[3] = count;
+
+    unsigned offset = data_.Size();
+    data_.Resize(offset + count);
+    if (count)
+        memcpy(&data_[offset], data, count * sizeof(float));
+}
+
+void RenderCommandBuffer::CloseParameterGroup()
+{
+    if (openParameterGroup_ != M_MAX_UNSIGNED)
+    {
+        commands_[openParameterGroup_].values_[1] = commands_.Size() - openParameterGroup_ - 1;
+        openParameterGroup_ = M_MAX_UNSIGNED;
+    }
+}
+
+void RenderCommandBuffer::ResetShaderState()
+{
+    knownParameterSources_ = 0;
+    knownTextures_ = 0;
+}
+
+}
@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Ptr.h"
+#include "../Core/Variant.h"
+#include "../Graphics/GraphicsDefs.h"
+#include "../Math/Rect.h"
+
+namespace Urho3D
+{
+
+class Camera;
+class Color;
+class IndexBuffer;
+class Light;
+class Matrix3;
+class Matrix3x4;
+class Matrix4;
+class ShaderParameterBlock;
+class ShaderVariation;
+class Texture;
+class Vector2;
+class Vector3;
+class Vector4;
+class VertexBuffer;
+class View;
+
+/// Type of a command recorded into a render command buffer.
+enum RecordedCommandType
+{
+    RC_SHADERS = 0,
+    RC_BLENDMODE,
+    RC_CULLMODE,
+    RC_DEPTHBIAS,
+    RC_DEPTHTEST,
+    RC_DEPTHWRITE,
+    RC_FILLMODE,
+    RC_LINEANTIALIAS,
+    RC_SCISSORTEST,
+    RC_STENCILTEST,
+    RC_LIGHTSCISSOR,
+    RC_PARAMETERGROUP,
+    RC_VIEWPARAMETERS,
+    RC_SHADERPARAMETER,
+    RC_SHADERPARAMETERBLOCK,
+    RC_TEXTURE,
+    RC_INDEXBUFFER,
+    RC_VERTEXBUFFERS,
+    RC_DRAW,
+    RC_DRAWINDEXED,
+    RC_DRAWINSTANCED
+};
+
+/// Command recorded into a render command buffer. Arguments are stored in generic fields whose meaning depends on the command type; float data lives in the command buffer's data arena.
+struct RecordedCommand
+{
+    /// Command type.
+    RecordedCommandType type_;
+    /// Integer arguments.
+    unsigned values_[8];
+    /// Object arguments.
+    void* objects_[2];
+};
+
+/// Render command list that records the graphics calls of batch queues as a POD stream, so that queues can be recorded in worker threads and replayed on the main thread. Exposes the subset of the Graphics API used by batch rendering.
+class URHO3D_API RenderCommandBuffer
+{
+public:
+    /// Construct.
+    RenderCommandBuffer();
+
+    /// Clear all recorded commands and forget the tracked state.
+    void Clear();
+    /// Issue the recorded commands to the graphics subsystem of the view. Depth writes are masked with the allow flag.
+    void Replay(View* view, bool allowDepthWrite);
+
+    /// Record shaders.
+    void SetShaders(ShaderVariation* vs, ShaderVariation* ps);
+    /// Record blending and alpha-to-coverage modes.
+    void SetBlendMode(BlendMode mode, bool alphaToCoverage = false);
+    /// Record hardware culling mode, reversed if the camera reverses culling.
+    void SetCullMode(CullMode mode, Camera* camera);
+    /// Record depth bias.
+    void SetDepthBias(float constantBias, float slopeScaledBias);
+    /// Record depth compare.
+    void SetDepthTest(CompareMode mode);
+    /// Record depth write on/off. Masked with the allow flag on replay.
+    void SetDepthWrite(bool enable);
+    /// Record polygon fill mode.
+    void SetFillMode(FillMode mode);
+    /// Record line antialiasing on/off.
+    void SetLineAntiAlias(bool enable);
+    /// Record scissor test.
+    void SetScissorTest(bool enable, const Rect& rect = Rect::FULL, bool borderInclusive = true);
+    /// Record stencil test.
+    void SetStencilTest
+        (bool enable, CompareMode mode = CMP_ALWAYS, StencilOp pass = OP_KEEP, StencilOp fail = OP_KEEP, StencilOp zFail = OP_KEEP,
+            unsigned stencilRef = 0, unsigned compareMask = M_MAX_UNSIGNED, unsigned writeMask = M_MAX_UNSIGNED);
+    /// Record a light scissor optimization, which is evaluated by the renderer on replay.
+    void OptimizeLightByScissor(Light* light, Camera* camera);
+
+    /// Begin a shader parameter group. Return false if the group is known to be up to date, in which case its parameters should not be recorded. The actual check against the graphics subsystem is made on replay.
+    bool NeedParameterUpdate(ShaderParameterGroup group, const void* source);
+    /// Record setting the global, camera and viewport shader parameters of the view if they need update.
+    void SetViewShaderParameters(Camera* camera);
+    /// Record shader float constants.
+    void SetShaderParameter(StringHash param, const float* data, unsigned count);
+    /// Record shader float constant.
+    void SetShaderParameter(StringHash param, float value);
+    /// Record shader integer constant.
+    void SetShaderParameter(StringHash param, int value);
+    /// Record shader boolean constant.
+    void SetShaderParameter(StringHash param, bool value);
+    /// Record shader color constant.
+    void SetShaderParameter(StringHash param, const Color& color);
+    /// Record shader 2D vector constant.
+    void SetShaderParameter(StringHash param, const Vector2& vector);
+    /// Record shader 3x3 matrix constant.
+    void SetShaderParameter(StringHash param, const Matrix3& matrix);
+    /// Record shader 3D vector constant.
+    void SetShaderParameter(StringHash param, const Vector3& vector);
+    /// Record shader 4x4 matrix constant.
+    void SetShaderParameter(StringHash param, const Matrix4& matrix);
+    /// Record shader 4D vector constant.
+    void SetShaderParameter(StringHash param, const Vector4& vector);
+    /// Record shader 3x4 matrix constant.
+    void SetShaderParameter(StringHash param, const Matrix3x4& matrix);
+    /// Record shader constant from a variant.
+    void SetShaderParameter(StringHash param, const Variant& value);
+    /// Record setting all shader constants of a parameter block. The block is referenced, not copied, so it must stay unchanged until replay.
+    void SetShaderParameters(const ShaderParameterBlock& block);
+    /// Return true. Parameters missing from the shaders are ignored on replay.
+    bool HasShaderParameter(StringHash /*param*/) const { return true; }
+    /// Return true. Textures are only bound on replay if the shaders use the texture unit.
+    bool HasTextureUnit(TextureUnit /*unit*/) const { return true; }
+    /// Record texture.
+    void SetTexture(unsigned index, Texture* texture);
+
+    /// Record index buffer.
+    void SetIndexBuffer(IndexBuffer* buffer);
+    /// Record multiple vertex buffers.
+    void SetVertexBuffers(const Vector<SharedPtr<VertexBuffer> >& buffers, unsigned instanceOffset = 0);
+    /// Record multiple vertex buffers followed by an instancing buffer.
+    void SetVertexBuffers(const Vector<SharedPtr<VertexBuffer> >& buffers, VertexBuffer* instanceBuffer, unsigned instanceOffset);
+    /// Record non-indexed draw.
+    void Draw(PrimitiveType type, unsigned vertexStart, unsigned vertexCount);
+    /// Record indexed draw.
+    void Draw(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount);
+    /// Record indexed, instanced draw.
+    void DrawInstanced(PrimitiveType type, unsigned indexStart, unsigned indexCount, unsigned minVertex, unsigned vertexCount,
+        unsigned instanceCount);
+
+    /// Return the last recorded blend mode.
+    BlendMode GetBlendMode() const { return blendMode_; }
+
+    /// Return recorded commands.
+    const PODVector<RecordedCommand>& GetCommands() const { return commands_; }
+
+    /// Return number of recorded commands.
+    unsigned GetNumCommands() const { return commands_.Size(); }
+
+    /// Return number of commands dropped as redundant during recording.
+    unsigned GetNumFilteredCommands() const { return numFilteredCommands_; }
+
+    /// Return size of the recorded command stream and its data in bytes.
+    unsigned GetDataSize() const;
+
+    /// Return whether no commands have been recorded.
+    bool IsEmpty() const { return commands_.Empty(); }
+
+private:
+    /// Add a command and close the open parameter group if it does not set shader parameters.
+    RecordedCommand& AddCommand(RecordedCommandType type);
+    /// Add a shader parameter command and copy its data to the arena.
+    void AddShaderParameter(StringHash param, VariantType type, const float* data, unsigned count);
+    /// Close the open parameter group by storing its command count.
+    void CloseParameterGroup();
+    /// Forget the tracked shader parameter sources and textures. Called when shaders change.
+    void ResetShaderState();
+
+    /// Command stream.
+    PODVector<RecordedCommand> commands_;
+    /// Float data arena for shader parameters and render state arguments.
+    PODVector<float> data_;
+    /// Vertex buffer list arena.
+    PODVector<VertexBuffer*> vertexBuffers_;
+    /// Vertex buffers being bound during replay.
+    PODVector<VertexBuffer*> replayVertexBuffers_;
+    /// Index of the open parameter group command, or M_MAX_UNSIGNED if none.
+    unsigned openParameterGroup_;
+    /// Number of commands dropped as redundant.
+    unsigned numFilteredCommands_;
+    /// Bitmask of render states whose last recorded value is known.
+    unsigned knownStates_;
+    /// Bitmask of shader parameter groups whose last recorded source is known.
+    unsigned knownParameterSources_;
+    /// Bitmask of texture units whose last recorded texture is known.
+    unsigned knownTextures_;
+    /// Last recorded vertex shader.
+    ShaderVariation* vertexShader_;
+    /// Last recorded pixel shader.
+    ShaderVariation* pixelShader_;
+    /// Last recorded blend mode.
+    BlendMode blendMode_;
+    /// Last recorded alpha-to-coverage mode.
+    bool alphaToCoverage_;
+    /// Last recorded culling mode.
+    CullMode cullMode_;
+    /// Last recorded constant depth bias.
+    float constantDepthBias_;
+    /// Last recorded slope scaled depth bias.
+    float slopeScaledDepthBias_;
+    /// Last recorded depth compare mode.
+    CompareMode depthTestMode_;
+    /// Last recorded depth write mode.
+    bool depthWrite_;
+    /// Last recorded polygon fill mode.
+    FillMode fillMode_;
+    /// Last recorded line antialiasing mode.
+    bool lineAntiAlias_;
+    /// Last recorded stencil test arguments.
+    unsigned stencilTest_[8];
+    /// Last recorded shader parameter sources.
+    const void* parameterSources_[MAX_SHADER_PARAMETER_GROUPS];
+    /// Last recorded textures.
+    Texture* textures_[MAX_TEXTURE_UNITS];
+    /// Last recorded index buffer.
+    IndexBuffer* indexBuffer_;
+    /// Index of the last recorded vertex buffer list command, or M_MAX_UNSIGNED if none.
+    unsigned lastVertexBuffers_;
+};
+
+}
@@ -182,6 +182,8 @@ struct URHO3D_API RenderPathCommand
     bool useLitBase_{true};
     /// Vertex lights flag.
     bool vertexLights_{};
+    /// Clustered forward lights flag.
+    bool clusteredLights_{};
     /// Event name.
     String eventName_;
 };
@@ -36,6 +36,7 @@
 #include "../Graphics/Octree.h"
 #include "../Graphics/Renderer.h"
 #include "../Graphics/RenderPath.h"
+#include "../Graphics/Shader.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Technique.h"
 #include "../Graphics/Texture2D.h"
@@ -255,6 +256,9 @@ static const unsigned MAX_BUFFER_AGE = 1000;
 
 static const int MAX_EXTRA_INSTANCING_BUFFER_ELEMENTS = 4;
 
+/// Number of frames of peak instance data the instancing buffer ring is grown to hold.
+static const unsigned INSTANCING_BUFFER_FRAMES = 3;
+
 inline PODVector<VertexElement> CreateInstancingBufferElements(unsigned numExtraElements)
 {
     static const unsigned NUM_INSTANCEMATRIX_ELEMENTS = 3;
@@ -272,6 +276,8 @@ Renderer::Renderer(Context* context) :
 {
     SubscribeToEvent(E_SCREENMODE, URHO3D_HANDLER(Renderer, HandleScreenMode));
 
+    RegisterShaderDefines();
+
     // Try to initialize right now, but skip if screen mode is not yet set
     Initialize();
 }
@@ -378,11 +384,9 @@ void Renderer::SetShadowMapSize(int size)
 
 void Renderer::SetShadowQuality(ShadowQuality quality)
 {
-    if (!graphics_)
-        return;
-
+    // Before initialization the quality is stored as is, and validated once the graphics subsystem is known
     // If no hardware PCF, do not allow to select one-sample quality
-    if (!graphics_->GetHardwareShadowSupport())
+    if (graphics_ && !graphics_->GetHardwareShadowSupport())
     {
         if (quality == SHADOWQUALITY_SIMPLE_16BIT)
             quality = SHADOWQUALITY_PCF_16BIT;
@@ -391,7 +395,7 @@ void Renderer::SetShadowQuality(ShadowQuality quality)
             quality = SHADOWQUALITY_PCF_24BIT;
     }
     // if high resolution is not allowed
-    if (!graphics_->GetHiresShadowMapFormat())
+    if (graphics_ && !graphics_->GetHiresShadowMapFormat())
     {
         if (quality == SHADOWQUALITY_SIMPLE_24BIT)
             quality = SHADOWQUALITY_SIMPLE_16BIT;
@@ -444,6 +448,13 @@ void Renderer::SetReuseShadowMaps(bool enable)
     reuseShadowMaps_ = enable;
 }
 
+void Renderer::SetShadowMapCaching(bool enable)
+{
+    shadowMapCaching_ = enable;
+    if (!shadowMapCaching_)
+        cachedShadowMaps_.Clear();
+}
+
 void Renderer::SetMaxShadowMaps(int shadowMaps)
 {
     if (shadowMaps < 1)
@@ -524,6 +535,21 @@ void Renderer::SetThreadedOcclusion(bool enable)
     }
 }
 
+void Renderer::SetCoherentCulling(bool enable)
+{
+    coherentCulling_ = enable;
+}
+
+void Renderer::SetSharedCulling(bool enable)
+{
+    sharedCulling_ = enable;
+}
+
+void Renderer::SetCommandRecording(bool enable)
+{
+    commandRecording_ = enable;
+}
+
 void Renderer::ReloadShaders()
 {
     shadersDirty_ = true;
@@ -628,6 +654,50 @@ unsigned Renderer::GetNumShadowMaps(bool allViews) const
     return numShadowMaps;
 }
 
+unsigned Renderer::GetNumReusedShadowMaps(bool allViews) const
+{
+    unsigned numShadowMaps = 0;
+    unsigned lastView = allViews ? views_.Size() : 1;
+
+    for (unsigned i = 0; i < lastView; ++i)
+    {
+        View* view = GetActualView(views_[i]);
+        if (!view)
+            continue;
+
+        const Vector<LightBatchQueue>& lightQueues = view->GetLightQueues();
+        for (Vector<LightBatchQueue>::ConstIterator i = lightQueues.Begin(); i != lightQueues.End(); ++i)
+        {
+            if (i->shadowMap_ && i->shadowMapReused_)
+                ++numShadowMaps;
+        }
+    }
+
+    return numShadowMaps;
+}
+
+unsigned Renderer::GetNumRerenderedShadowMaps(bool allViews) const
+{
+    unsigned numShadowMaps = 0;
+    unsigned lastView = allViews ? views_.Size() : 1;
+
+    for (unsigned i = 0; i < lastView; ++i)
+    {
+        View* view = GetActualView(views_[i]);
+        if (!view)
+            continue;
+
+        const Vector<LightBatchQueue>& lightQueues = view->GetLightQueues();
+        for (Vector<LightBatchQueue>::ConstIterator i = lightQueues.Begin(); i != lightQueues.End(); ++i)
+        {
+            if (i->shadowMap_ && i->shadowMapCached_ && !i->shadowMapReused_)
+                ++numShadowMaps;
+        }
+    }
+
+    return numShadowMaps;
+}
+
 unsigned Renderer::GetNumOccluders(bool allViews) const
 {
     unsigned numOccluders = 0;
@@ -645,6 +715,55 @@ unsigned Renderer::GetNumOccluders(bool allViews) const
     return numOccluders;
 }
 
+unsigned Renderer::GetNumTestedOctants(bool allViews) const
+{
+    unsigned numOctants = 0;
+    unsigned lastView = allViews ? views_.Size() : 1;
+
+    for (unsigned i = 0; i < lastView; ++i)
+    {
+        View* view = GetActualView(views_[i]);
+        if (!view)
+            continue;
+
+        numOctants += view->GetNumTestedOctants();
+    }
+
+    return numOctants;
+}
+
+unsigned Renderer::GetNumReusedOctants(bool allViews) const
+{
+    unsigned numOctants = 0;
+    unsigned lastView = allViews ? views_.Size() : 1;
+
+    for (unsigned i = 0; i < lastView; ++i)
+    {
+        View* view = GetActualView(views_[i]);
+        if (!view)
+            continue;
+
+        numOctants += view->GetNumReusedOctants();
+    }
+
+    return numOctants;
+}
+
+unsigned Renderer::GetNumSharedCullViews(bool allViews) const
+{
+    unsigned numViews = 0;
+    unsigned lastView = allViews ? views_.Size() : 1;
+
+    for (unsigned i = 0; i < lastView; ++i)
+    {
+        View* view = GetActualView(views_[i]);
+        if (view && view->IsCullingShared())
+            ++numViews;
+    }
+
+    return numViews;
+}
+
 void Renderer::Update(float timeStep)
 {
     URHO3D_PROFILE(UpdateViews);
@@ -664,6 +783,20 @@ void Renderer::Update(float timeStep)
     numShadowCameras_ = 0;
     numOcclusionBuffers_ = 0;
     updatedOctrees_.Clear();
+    if (!cachedShadowMaps_.Empty())
+        RemoveUnusedCachedShadowMaps();
+
+    // Begin a new frame in the instancing buffer ring. Grow it first if the previous frame did not fit
+    if (instancingDemand_)
+    {
+        ResizeInstancingBuffer(instancingDemand_ * INSTANCING_BUFFER_FRAMES);
+        instancingDemand_ = 0;
+    }
+    instancingWrapped_ = false;
+    numInstancesAllocated_ = 0;
+    instancingUploadSize_ = 0;
+    sharedCullCameras_.Clear();
+    sharedCullOctree_ = nullptr;
 
     // Reload shaders now if needed
     if (shadersDirty_)
@@ -836,61 +969,8 @@ Geometry* Renderer::GetQuadGeometry()
 
 Texture2D* Renderer::GetShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight)
 {
-    LightType type = light->GetLightType();
-    const FocusParameters& parameters = light->GetShadowFocus();
-    float size = (float)shadowMapSize_ * light->GetShadowResolution();
-    // Automatically reduce shadow map size when far away
-    if (parameters.autoSize_ && type != LIGHT_DIRECTIONAL)
-    {
-        const Matrix3x4& view = camera->GetView();
-        const Matrix4& projection = camera->GetProjection();
-        BoundingBox lightBox;
-        float lightPixels;
-
-        if (type == LIGHT_POINT)
-        {
-            // Calculate point light pixel size from the projection of its diagonal
-            Vector3 center = view * light->GetNode()->GetWorldPosition();
-            float extent = 0.58f * light->GetRange();
-            lightBox.Define(center + Vector3(extent, extent, extent), center - Vector3(extent, extent, extent));
-        }
-        else
-        {
-            // Calculate spot light pixel size from the projection of its frustum far vertices
-            Frustum lightFrustum = light->GetViewSpaceFrustum(view);
-            lightBox.Define(&lightFrustum.vertices_[4], 4);
-        }
-
-        Vector2 projectionSize = lightBox.Projected(projection).Size();
-        lightPixels = Max(0.5f * (float)viewWidth * projectionSize.x_, 0.5f * (float)viewHeight * projectionSize.y_);
-
-        // Clamp pixel amount to a sufficient minimum to avoid self-shadowing artifacts due to loss of precision
-        if (lightPixels < SHADOW_MIN_PIXELS)
-            lightPixels = SHADOW_MIN_PIXELS;
-
-        size = Min(size, lightPixels);
-    }
-
-    /// \todo Allow to specify maximum shadow maps per resolution, as smaller shadow maps take less memory
-    int width = NextPowerOfTwo((unsigned)size);
-    int height = width;
-
-    // Adjust the size for directional or point light shadow map atlases
-    if (type == LIGHT_DIRECTIONAL)
-    {
-        auto numSplits = (unsigned)light->GetNumShadowSplits();
-        if (numSplits > 1)
-            width *= 2;
-        if (numSplits > 2)
-            height *= 2;
-    }
-    else if (type == LIGHT_POINT)
-    {
-        width *= 2;
-        height *= 3;
-    }
-
-    int searchKey = width << 16u | height;
+    IntVector2 size = GetShadowMapSize(light, camera, viewWidth, viewHeight);
+    int searchKey = size.x_ << 16u | size.y_;
     if (shadowMaps_.Contains(searchKey))
     {
         // If shadow maps are reused, always return the first
@@ -910,88 +990,92 @@ Texture2D* Renderer::GetShadowMap(Light* light, Camera* camera, unsigned viewWid
         }
     }
 
-    // Find format and usage of the shadow map
-    unsigned shadowMapFormat = 0;
-    TextureUsage shadowMapUsage = TEXTURE_DEPTHSTENCIL;
-    int multiSample = 1;
+    // If failed to create, store a null pointer so that we will not retry
+    SharedPtr<Texture2D> newShadowMap = CreateShadowMap(size.x_, size.y_);
+    shadowMaps_[searchKey].Push(newShadowMap);
+    if (!reuseShadowMaps_)
+        shadowMapAllocations_[searchKey].Push(light);
 
-    switch (shadowQuality_)
-    {
-    case SHADOWQUALITY_SIMPLE_16BIT:
-    case SHADOWQUALITY_PCF_16BIT:
-        shadowMapFormat = graphics_->GetShadowMapFormat();
-        break;
+    return newShadowMap;
+}
 
-    case SHADOWQUALITY_SIMPLE_24BIT:
-    case SHADOWQUALITY_PCF_24BIT:
-        shadowMapFormat = graphics_->GetHiresShadowMapFormat();
-        break;
+/// Return the cached shadow map key of a light as seen from a view camera.
+static ShadowMapCacheKey GetShadowMapCacheKey(Light* light, Camera* camera)
+{
+    ShadowMapCacheKey key;
+    key.light_ = light;
+    key.camera_ = camera;
+    key.viewMask_ = camera ? camera->GetViewMask() : DEFAULT_VIEWMASK;
+    return key;
+}
 
-    case SHADOWQUALITY_VSM:
-    case SHADOWQUALITY_BLUR_VSM:
-        shadowMapFormat = graphics_->GetRGFloat32Format();
-        shadowMapUsage = TEXTURE_RENDERTARGET;
-        multiSample = vsmMultiSample_;
-        break;
+Texture2D* Renderer::GetCachedShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight)
+{
+    IntVector2 size = GetShadowMapSize(light, camera, viewWidth, viewHeight);
+    CachedShadowMap& entry = cachedShadowMaps_[GetShadowMapCacheKey(light, camera)];
+
+    // A destroyed light or camera may have left an entry at the same address
+    if (entry.light_ != light || entry.camera_ != camera)
+    {
+        entry = CachedShadowMap();
+        entry.light_ = light;
+        entry.camera_ = camera;
     }
 
-    if (!shadowMapFormat)
-        return nullptr;
+    // Resize only on the first use of the frame, as a view rendered earlier may still refer to the old shadow map
+    if (entry.size_ != size && (entry.useFrameNumber_ != frame_.frameNumber_ || !entry.shadowMap_))
+    {
+        entry.shadowMap_ = CreateShadowMap(size.x_, size.y_);
+        entry.size_ = size;
+        entry.valid_ = false;
+    }
 
-    SharedPtr<Texture2D> newShadowMap(new Texture2D(context_));
-    int retries = 3;
-    unsigned dummyColorFormat = graphics_->GetDummyColorFormat();
+    entry.useFrameNumber_ = frame_.frameNumber_;
+    return entry.shadowMap_;
+}
 
-    // Disable mipmaps from the shadow map
-    newShadowMap->SetNumLevels(1);
+bool Renderer::ReuseCachedShadowMap(Light* light, Camera* camera, const CachedShadowMap& contents, unsigned lastCasterUpdate)
+{
+    HashMap<ShadowMapCacheKey, CachedShadowMap>::Iterator i = cachedShadowMaps_.Find(GetShadowMapCacheKey(light, camera));
+    if (i == cachedShadowMaps_.End() || !i->second_.shadowMap_)
+        return false;
 
-    while (retries)
+    CachedShadowMap& entry = i->second_;
+    Texture2D* shadowMap = entry.shadowMap_;
+
+    bool reuse = entry.valid_ && !shadowMap->IsDataLost() && lastCasterUpdate <= entry.renderFrameNumber_ &&
+        contents.numSplits_ == entry.numSplits_ && contents.numCasters_ == entry.numCasters_ &&
+        contents.casterHash_ == entry.casterHash_ && contents.constantBias_ == entry.constantBias_ &&
+        contents.slopeScaledBias_ == entry.slopeScaledBias_;
+    for (unsigned j = 0; reuse && j < contents.numSplits_; ++j)
     {
-        if (!newShadowMap->SetSize(width, height, shadowMapFormat, shadowMapUsage, multiSample))
-        {
-            width >>= 1;
-            height >>= 1;
-            --retries;
-        }
-        else
-        {
-#ifndef GL_ES_VERSION_2_0
-            // OpenGL (desktop) and D3D11: shadow compare mode needs to be specifically enabled for the shadow map
-            newShadowMap->SetFilterMode(FILTER_BILINEAR);
-            newShadowMap->SetShadowCompare(shadowMapUsage == TEXTURE_DEPTHSTENCIL);
-#endif
-#ifndef URHO3D_OPENGL
-            // Direct3D9: when shadow compare must be done manually, use nearest filtering so that the filtering of point lights
-            // and other shadowed lights matches
-            newShadowMap->SetFilterMode(graphics_->GetHardwareShadowSupport() ? FILTER_BILINEAR : FILTER_NEAREST);
-#endif
-            // Create dummy color texture for the shadow map if necessary: Direct3D9, or OpenGL when working around an OS X +
-            // Intel driver bug
-            if (shadowMapUsage == TEXTURE_DEPTHSTENCIL && dummyColorFormat)
-            {
-                // If no dummy color rendertarget for this size exists yet, create one now
-                if (!colorShadowMaps_.Contains(searchKey))
-                {
-                    colorShadowMaps_[searchKey] = new Texture2D(context_);
-                    colorShadowMaps_[searchKey]->SetNumLevels(1);
-                    colorShadowMaps_[searchKey]->SetSize(width, height, dummyColorFormat, TEXTURE_RENDERTARGET);
-                }
-                // Link the color rendertarget to the shadow map
-                newShadowMap->GetRenderSurface()->SetLinkedRenderTarget(colorShadowMaps_[searchKey]->GetRenderSurface());
-            }
-            break;
-        }
+        if (contents.viewProj_[j] != entry.viewProj_[j])
+            reuse = false;
     }
 
-    // If failed to set size, store a null pointer so that we will not retry
-    if (!retries)
-        newShadowMap.Reset();
+    if (!reuse)
+    {
+        shadowMap->ClearDataLost();
+        for (unsigned j = 0; j < contents.numSplits_; ++j)
+            entry.viewProj_[j] = contents.viewProj_[j];
+        entry.numSplits_ = contents.numSplits_;
+        entry.casterHash_ = contents.casterHash_;
+        entry.numCasters_ = contents.numCasters_;
+        entry.constantBias_ = contents.constantBias_;
+        entry.slopeScaledBias_ = contents.slopeScaledBias_;
+        entry.renderFrameNumber_ = frame_.frameNumber_;
+        // Not valid until actually rendered
+        entry.valid_ = false;
+    }
 
-    shadowMaps_[searchKey].Push(newShadowMap);
-    if (!reuseShadowMaps_)
-        shadowMapAllocations_[searchKey].Push(light);
+    return reuse;
+}
 
-    return newShadowMap;
+void Renderer::MarkCachedShadowMapRendered(Light* light, Camera* camera)
+{
+    HashMap<ShadowMapCacheKey, CachedShadowMap>::Iterator i = cachedShadowMaps_.Find(GetShadowMapCacheKey(light, camera));
+    if (i != cachedShadowMaps_.End())
+        i->second_.valid_ = true;
 }
 
 Texture* Renderer::GetScreenBuffer(int width, int height, unsigned format, int multiSample, bool autoResolve, bool cubemap, bool filtered, bool srgb,
@@ -1152,6 +1236,32 @@ View* Renderer::GetPreparedView(Camera* camera)
     return i != preparedViews_.End() ? i->second_ : nullptr;
 }
 
+const PODVector<Drawable*>* Renderer::GetSharedCullDrawables(Octree* octree, Camera* camera)
+{
+    if (!sharedCulling_)
+        return nullptr;
+
+    // Cull a new group of views if this camera was not included in the last one, for example because its view was queued later
+    if (octree != sharedCullOctree_ || !sharedCullCameras_.Contains(camera))
+        PrepareSharedCulling(octree, camera);
+
+    PODVector<Camera*>::ConstIterator i = sharedCullCameras_.Find(camera);
+    if (i == sharedCullCameras_.End())
+        return nullptr;
+
+    // The camera may have changed since the group was culled, for example by a view event handler
+    unsigned index = (unsigned)(i - sharedCullCameras_.Begin());
+    const Frustum& frustum = camera->GetFrustum();
+    const Frustum& culledFrustum = sharedCullFrustums_[index];
+    for (unsigned j = 0; j < NUM_FRUSTUM_VERTICES; ++j)
+    {
+        if (frustum.vertices_[j] != culledFrustum.vertices_[j])
+            return nullptr;
+    }
+
+    return &sharedCullQuery_.results_[index];
+}
+
 View* Renderer::GetActualView(View* view)
 {
     if (view && view->GetSourceView())
@@ -1357,24 +1467,125 @@ bool Renderer::ResizeInstancingBuffer(unsigned numInstances)
     while (newSize < numInstances)
         newSize <<= 1;
 
+    // The previous data is lost, so restart the ring
+    instancingCursor_ = 0;
+    instancingFrameStart_ = 0;
+    instancingWrapped_ = false;
+    instancingDiscard_ = true;
+
     const PODVector<VertexElement> instancingBufferElements = CreateInstancingBufferElements(numExtraInstancingBufferElements_);
     if (!instancingBuffer_->SetSize(newSize, instancingBufferElements, true))
     {
         URHO3D_LOGERROR("Failed to resize instancing buffer to " + String(newSize));
         // If failed, try to restore the old size
         instancingBuffer_->SetSize(oldSize, instancingBufferElements, true);
+        instancingLimit_ = instancingBuffer_->GetVertexCount();
         return false;
     }
 
+    instancingLimit_ = newSize;
+
     URHO3D_LOGDEBUG("Resized instancing buffer to " + String(newSize));
     return true;
 }
 
-void Renderer::OptimizeLightByScissor(Light* light, Camera* camera)
+unsigned Renderer::AllocateInstances(unsigned numInstances)
 {
-    if (light && light->GetLightType() != LIGHT_DIRECTIONAL)
-        graphics_->SetScissorTest(true, GetLightScissor(light, camera));
-    else
+    if (!instancingBuffer_ || !dynamicInstancing_ || !numInstances)
+        return M_MAX_UNSIGNED;
+
+    // Allocations of this frame occupy the range from the frame start to the cursor, which may wrap around the buffer end.
+    // The range from the cursor to the limit has not been used since the buffer was last discarded, so it can be written
+    // without synchronizing with the GPU. Anything else is reused only after a wrap, which discards the buffer so that
+    // pending draws keep their data
+    if (!numInstancesAllocated_)
+        instancingFrameStart_ = instancingCursor_;
+
+    unsigned capacity = instancingBuffer_->GetVertexCount();
+    unsigned start = instancingCursor_;
+    bool wrap = false;
+    bool fits;
+
+    if (start + numInstances <= instancingLimit_)
+        fits = true;
+    else if (!instancingWrapped_)
+    {
+        start = 0;
+        wrap = true;
+        fits = numInstances <= (numInstancesAllocated_ ? instancingFrameStart_ : capacity);
+    }
+    else
+        fits = false;
+
+    if (!fits)
+    {
+        // Grow right away if nothing has been allocated this frame. Else the caller draws without instancing, and the
+        // buffer grows on the next frame
+        if (numInstancesAllocated_ || !ResizeInstancingBuffer(numInstances * INSTANCING_BUFFER_FRAMES))
+        {
+            instancingDemand_ = Max(instancingDemand_, numInstancesAllocated_) + numInstances;
+            return M_MAX_UNSIGNED;
+        }
+
+        start = 0;
+        wrap = false;
+    }
+
+    if (wrap)
+    {
+        // If this is the first allocation of the frame, the whole buffer is available. Else the data written earlier this
+        // frame is uploaded again after the discard and may be drawn from, so it must not be overwritten until the next wrap
+        if (numInstancesAllocated_)
+        {
+            instancingLimit_ = instancingFrameStart_;
+            instancingWrapped_ = true;
+        }
+        else
+        {
+            instancingLimit_ = capacity;
+            instancingFrameStart_ = 0;
+        }
+        instancingDiscard_ = true;
+        ++numInstancingBufferWraps_;
+    }
+
+    instancingCursor_ = start + numInstances;
+    numInstancesAllocated_ += numInstances;
+    return start;
+}
+
+void Renderer::CommitInstances(unsigned start, unsigned numInstances)
+{
+    if (!instancingBuffer_ || !numInstances)
+        return;
+
+    URHO3D_PROFILE(CommitInstances);
+
+    unsigned char* data = instancingBuffer_->GetShadowData();
+    unsigned vertexSize = instancingBuffer_->GetVertexSize();
+
+    if (instancingDiscard_ || instancingBuffer_->IsDataLost())
+    {
+        // After a wrap or resize, discard the buffer and upload all of it, as it also contains the data written earlier
+        // this frame
+        instancingBuffer_->SetData(data);
+        instancingBuffer_->ClearDataLost();
+        instancingUploadSize_ += instancingBuffer_->GetVertexCount() * vertexSize;
+        instancingDiscard_ = false;
+    }
+    else
+    {
+        // The range has not been used since the last discard, so no synchronization with the GPU is needed
+        instancingBuffer_->SetDataRangeNoOverwrite(data + start * vertexSize, start, numInstances);
+        instancingUploadSize_ += numInstances * vertexSize;
+    }
+}
+
+void Renderer::OptimizeLightByScissor(Light* light, Camera* camera)
+{
+    if (light && light->GetLightType() != LIGHT_DIRECTIONAL)
+        graphics_->SetScissorTest(true, GetLightScissor(light, camera));
+    else
         graphics_->SetScissorTest(false);
 }
 
@@ -1488,6 +1699,7 @@ void Renderer::UpdateQueuedViewport(unsigned index)
 
     View* view = viewport->GetView();
     assert(view);
+    currentViewportIndex_ = index;
     // Check if view can be defined successfully (has either valid scene, camera and octree, or no scene passes)
     if (!view->Define(renderTarget, viewport))
         return;
@@ -1524,6 +1736,67 @@ void Renderer::UpdateQueuedViewport(unsigned index)
     view->Update(frame_);
 }
 
+void Renderer::PrepareSharedCulling(Octree* octree, Camera* camera)
+{
+    sharedCullQuery_.Clear();
+    sharedCullCameras_.Clear();
+    sharedCullFrustums_.Clear();
+    sharedCullOctree_ = octree;
+
+    sharedCullCameras_.Push(camera);
+
+    // Gather the cull cameras of the views that are still to be updated. Views that were queued earlier have already culled
+    for (unsigned i = currentViewportIndex_ + 1; i < queuedViewports_.Size() && sharedCullCameras_.Size() < MAX_QUERY_FRUSTUMS; ++i)
+    {
+        const WeakPtr<RenderSurface>& renderTarget = queuedViewports_[i].first_;
+        const WeakPtr<Viewport>& viewport = queuedViewports_[i].second_;
+        if ((renderTarget.NotNull() && renderTarget.Expired()) || viewport.Expired())
+            continue;
+
+        Scene* scene = viewport->GetScene();
+        Camera* cullCamera = viewport->GetCullCamera() ? viewport->GetCullCamera() : viewport->GetCamera();
+        if (!scene || !cullCamera || !cullCamera->IsEnabledEffective() || sharedCullCameras_.Contains(cullCamera) ||
+            scene->GetComponent<Octree>() != octree)
+            continue;
+
+        // Apply the automatic aspect ratio now, as the view would do before culling. If the view size turns out different,
+        // the frustum check in GetSharedCullDrawables() makes the view cull by itself
+        if (cullCamera->GetAutoAspectRatio())
+        {
+            IntVector2 viewSize = viewport->GetRect().Size();
+            if (viewSize.x_ <= 0 || viewSize.y_ <= 0)
+            {
+                viewSize = renderTarget ? IntVector2(renderTarget->GetWidth(), renderTarget->GetHeight()) :
+                    IntVector2(graphics_->GetWidth(), graphics_->GetHeight());
+            }
+            if (viewSize.x_ > 0 && viewSize.y_ > 0)
+                cullCamera->SetAspectRatioInternal((float)viewSize.x_ / (float)viewSize.y_);
+        }
+
+        if (cullCamera->IsProjectionValid())
+            sharedCullCameras_.Push(cullCamera);
+    }
+
+    // Culling a single camera together gains nothing, so let the view use its own queries
+    if (sharedCullCameras_.Size() < 2)
+    {
+        sharedCullCameras_.Clear();
+        return;
+    }
+
+    URHO3D_PROFILE(SharedCulling);
+
+    for (unsigned i = 0; i < sharedCullCameras_.Size(); ++i)
+    {
+        Camera* cullCamera = sharedCullCameras_[i];
+        sharedCullFrustums_.Push(cullCamera->GetFrustum());
+        sharedCullQuery_.AddFrustum(cullCamera->GetFrustum(), cullCamera->GetViewMask());
+    }
+
+    sharedCullQuery_.drawableFlags_ = DRAWABLE_GEOMETRY | DRAWABLE_LIGHT | DRAWABLE_ZONE;
+    octree->GetDrawables(sharedCullQuery_);
+}
+
 void Renderer::PrepareViewRender()
 {
     ResetScreenBufferAllocations();
@@ -1570,6 +1843,17 @@ void Renderer::ResetShadowMapAllocations()
         i->second_.Clear();
 }
 
+void Renderer::RemoveUnusedCachedShadowMaps()
+{
+    for (HashMap<ShadowMapCacheKey, CachedShadowMap>::Iterator i = cachedShadowMaps_.Begin(); i != cachedShadowMaps_.End();)
+    {
+        if (i->second_.light_.Expired() || i->second_.camera_.Expired() || frame_.frameNumber_ - i->second_.useFrameNumber_ > SHADOW_MAP_CACHE_FRAMES)
+            i = cachedShadowMaps_.Erase(i);
+        else
+            ++i;
+    }
+}
+
 void Renderer::ResetScreenBufferAllocations()
 {
     for (HashMap<unsigned long long, unsigned>::Iterator i = screenBufferAllocations_.Begin(); i != screenBufferAllocations_.End(); ++i)
@@ -1645,6 +1929,26 @@ void Renderer::LoadPassShaders(Pass* pass, Vector<SharedPtr<ShaderVariation> >&
     vertexShaders.Clear();
     pixelShaders.Clear();
 
+    PODVector<ShaderDefineMask> vsDefines;
+    PODVector<ShaderDefineMask> psDefines;
+    if (GetPassShaderDefines(pass, queue.vsExtraDefines_, queue.psExtraDefines_, vsDefines, psDefines))
+    {
+        vertexShaders.Resize(vsDefines.Size());
+        for (unsigned j = 0; j < vsDefines.Size(); ++j)
+            vertexShaders[j] = graphics_->GetShader(VS, pass->GetVertexShader(), vsDefines[j]);
+        pixelShaders.Resize(psDefines.Size());
+        for (unsigned j = 0; j < psDefines.Size(); ++j)
+            pixelShaders[j] = graphics_->GetShader(PS, pass->GetPixelShader(), psDefines[j]);
+    }
+    else
+        LoadPassShadersByDefineStrings(pass, vertexShaders, pixelShaders, queue);
+
+    pass->MarkShadersLoaded(shadersChangedFrameNumber_);
+}
+
+void Renderer::LoadPassShadersByDefineStrings(Pass* pass, Vector<SharedPtr<ShaderVariation> >& vertexShaders,
+    Vector<SharedPtr<ShaderVariation> >& pixelShaders, const BatchQueue& queue)
+{
     String vsDefines = pass->GetEffectiveVertexShaderDefines();
     String psDefines = pass->GetEffectivePixelShaderDefines();
 
@@ -1735,8 +2039,142 @@ void Renderer::LoadPassShaders(Pass* pass, Vector<SharedPtr<ShaderVariation> >&
                 graphics_->GetShader(PS, pass->GetPixelShader(), psDefines + heightFogVariations[j]);
         }
     }
+}
 
-    pass->MarkShadersLoaded(shadersChangedFrameNumber_);
+bool Renderer::GetPassShaderDefines(Pass* pass, const String& vsExtraDefines, const String& psExtraDefines,
+    PODVector<ShaderDefineMask>& vsDefines, PODVector<ShaderDefineMask>& psDefines) const
+{
+    vsDefines.Clear();
+    psDefines.Clear();
+
+    ShaderDefineMask vsPassDefines;
+    ShaderDefineMask psPassDefines;
+    ShaderDefineMask vsQueueDefines;
+    ShaderDefineMask psQueueDefines;
+    ShaderDefineMask shadowDefines;
+    if (!Shader::GetDefineMask(pass->GetEffectiveVertexShaderDefines(), vsPassDefines) ||
+        !Shader::GetDefineMask(pass->GetEffectivePixelShaderDefines(), psPassDefines) ||
+        !Shader::GetDefineMask(vsExtraDefines, vsQueueDefines) ||
+        !Shader::GetDefineMask(psExtraDefines, psQueueDefines) ||
+        !Shader::GetDefineMask(GetShadowVariations(), shadowDefines))
+        return false;
+
+    vsPassDefines |= vsQueueDefines;
+    psPassDefines |= psQueueDefines;
+
+    // Add defines for VSM in the shadow pass if necessary
+    if (pass->GetName() == "shadow"
+        && (shadowQuality_ == SHADOWQUALITY_VSM || shadowQuality_ == SHADOWQUALITY_BLUR_VSM))
+    {
+        vsPassDefines |= vsmShadowDefines_;
+        psPassDefines |= vsmShadowDefines_;
+    }
+
+    if (pass->GetLightingMode() == LIGHTING_PERPIXEL)
+    {
+        // Forward pixel lit variations
+        vsDefines.Resize(MAX_GEOMETRYTYPES * MAX_LIGHT_VS_VARIATIONS);
+        psDefines.Resize(MAX_LIGHT_PS_VARIATIONS * 2);
+
+        for (unsigned j = 0; j < MAX_GEOMETRYTYPES * MAX_LIGHT_VS_VARIATIONS; ++j)
+        {
+            unsigned g = j / MAX_LIGHT_VS_VARIATIONS;
+            unsigned l = j % MAX_LIGHT_VS_VARIATIONS;
+            vsDefines[j] = vsPassDefines | lightVSDefines_[l] | geometryVSDefines_[g];
+        }
+        for (unsigned j = 0; j < MAX_LIGHT_PS_VARIATIONS * 2; ++j)
+        {
+            unsigned l = j % MAX_LIGHT_PS_VARIATIONS;
+            unsigned h = j / MAX_LIGHT_PS_VARIATIONS;
+            psDefines[j] = psPassDefines | lightPSDefines_[l] | (h ? heightFogDefines_ : 0);
+            if (l & LPS_SHADOW)
+                psDefines[j] |= shadowDefines;
+        }
+    }
+    else
+    {
+        // Vertex light variations
+        if (pass->GetLightingMode() == LIGHTING_PERVERTEX)
+        {
+            vsDefines.Resize(MAX_GEOMETRYTYPES * MAX_VERTEXLIGHT_VS_VARIATIONS);
+            for (unsigned j = 0; j < MAX_GEOMETRYTYPES * MAX_VERTEXLIGHT_VS_VARIATIONS; ++j)
+            {
+                unsigned g = j / MAX_VERTEXLIGHT_VS_VARIATIONS;
+                unsigned l = j % MAX_VERTEXLIGHT_VS_VARIATIONS;
+                vsDefines[j] = vsPassDefines | vertexLightVSDefines_[l] | geometryVSDefines_[g];
+            }
+        }
+        else
+        {
+            vsDefines.Resize(MAX_GEOMETRYTYPES);
+            for (unsigned j = 0; j < MAX_GEOMETRYTYPES; ++j)
+                vsDefines[j] = vsPassDefines | geometryVSDefines_[j];
+        }
+
+        psDefines.Resize(2);
+        psDefines[0] = psPassDefines;
+        psDefines[1] = psPassDefines | heightFogDefines_;
+    }
+
+    return true;
+}
+
+bool Renderer::GetPassShaderCombinations(Pass* pass, const String& vsExtraDefines, const String& psExtraDefines,
+    PODVector<Pair<ShaderDefineMask, ShaderDefineMask> >& dest) const
+{
+    dest.Clear();
+
+    PODVector<ShaderDefineMask> vsDefines;
+    PODVector<ShaderDefineMask> psDefines;
+    if (!GetPassShaderDefines(pass, vsExtraDefines, psExtraDefines, vsDefines, psDefines))
+        return false;
+
+    if (pass->GetLightingMode() == LIGHTING_PERPIXEL)
+    {
+        // Pair the light variations the same way as SetBatchShaders()
+        for (unsigned g = 0; g < MAX_GEOMETRYTYPES; ++g)
+        {
+            unsigned vsBase = g * MAX_LIGHT_VS_VARIATIONS;
+            for (unsigned psi = 0; psi < psDefines.Size(); ++psi)
+            {
+                unsigned l = psi % MAX_LIGHT_PS_VARIATIONS;
+                // Dir, spot and point lights, with point light masks using the point light vertex shader
+                unsigned lightType = Min(l & LPS_POINTMASK, (unsigned)LVS_POINT);
+                if (l & LPS_SHADOW)
+                {
+                    dest.Push(MakePair(vsDefines[vsBase + LVS_SHADOW + lightType], psDefines[psi]));
+                    dest.Push(MakePair(vsDefines[vsBase + LVS_SHADOWNORMALOFFSET + lightType], psDefines[psi]));
+                }
+                else
+                    dest.Push(MakePair(vsDefines[vsBase + lightType], psDefines[psi]));
+            }
+        }
+    }
+    else
+    {
+        for (unsigned vsi = 0; vsi < vsDefines.Size(); ++vsi)
+        {
+            for (unsigned psi = 0; psi < psDefines.Size(); ++psi)
+                dest.Push(MakePair(vsDefines[vsi], psDefines[psi]));
+        }
+    }
+
+    return true;
+}
+
+void Renderer::RegisterShaderDefines()
+{
+    // Register the engine's defines first, so that they always fit in define masks
+    for (unsigned i = 0; i < MAX_GEOMETRYTYPES; ++i)
+        Shader::GetDefineMask(geometryVSVariations[i], geometryVSDefines_[i]);
+    for (unsigned i = 0; i < MAX_LIGHT_VS_VARIATIONS; ++i)
+        Shader::GetDefineMask(lightVSVariations[i], lightVSDefines_[i]);
+    for (unsigned i = 0; i < MAX_VERTEXLIGHT_VS_VARIATIONS; ++i)
+        Shader::GetDefineMask(vertexLightVSVariations[i], vertexLightVSDefines_[i]);
+    for (unsigned i = 0; i < MAX_LIGHT_PS_VARIATIONS; ++i)
+        Shader::GetDefineMask(lightPSVariations[i], lightPSDefines_[i]);
+    Shader::GetDefineMask(heightFogVariations[1], heightFogDefines_);
+    Shader::GetDefineMask("VSM_SHADOW", vsmShadowDefines_);
 }
 
 void Renderer::ReleaseMaterialShaders()
@@ -1887,13 +2325,163 @@ void Renderer::CreateInstancingBuffer()
         return;
     }
 
+    // The shadow data is the CPU side of the instancing buffer ring, where views write their instances before committing them
     instancingBuffer_ = new VertexBuffer(context_);
+    instancingBuffer_->SetShadowed(true);
+    instancingCursor_ = 0;
+    instancingFrameStart_ = 0;
+    instancingWrapped_ = false;
+    instancingDiscard_ = true;
     const PODVector<VertexElement> instancingBufferElements = CreateInstancingBufferElements(numExtraInstancingBufferElements_);
     if (!instancingBuffer_->SetSize(INSTANCING_BUFFER_DEFAULT_SIZE, instancingBufferElements, true))
     {
         instancingBuffer_.Reset();
         dynamicInstancing_ = false;
     }
+    else
+        instancingLimit_ = INSTANCING_BUFFER_DEFAULT_SIZE;
+}
+
+IntVector2 Renderer::GetShadowMapSize(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight) const
+{
+    LightType type = light->GetLightType();
+    const FocusParameters& parameters = light->GetShadowFocus();
+    float size = (float)shadowMapSize_ * light->GetShadowResolution();
+    // Automatically reduce shadow map size when far away
+    if (parameters.autoSize_ && type != LIGHT_DIRECTIONAL)
+    {
+        const Matrix3x4& view = camera->GetView();
+        const Matrix4& projection = camera->GetProjection();
+        BoundingBox lightBox;
+        float lightPixels;
+
+        if (type == LIGHT_POINT)
+        {
+            // Calculate point light pixel size from the projection of its diagonal
+            Vector3 center = view * light->GetNode()->GetWorldPosition();
+            float extent = 0.58f * light->GetRange();
+            lightBox.Define(center + Vector3(extent, extent, extent), center - Vector3(extent, extent, extent));
+        }
+        else
+        {
+            // Calculate spot light pixel size from the projection of its frustum far vertices
+            Frustum lightFrustum = light->GetViewSpaceFrustum(view);
+            lightBox.Define(&lightFrustum.vertices_[4], 4);
+        }
+
+        Vector2 projectionSize = lightBox.Projected(projection).Size();
+        lightPixels = Max(0.5f * (float)viewWidth * projectionSize.x_, 0.5f * (float)viewHeight * projectionSize.y_);
+
+        // Clamp pixel amount to a sufficient minimum to avoid self-shadowing artifacts due to loss of precision
+        if (lightPixels < SHADOW_MIN_PIXELS)
+            lightPixels = SHADOW_MIN_PIXELS;
+
+        size = Min(size, lightPixels);
+    }
+
+    /// \todo Allow to specify maximum shadow maps per resolution, as smaller shadow maps take less memory
+    int width = NextPowerOfTwo((unsigned)size);
+    int height = width;
+
+    // Adjust the size for directional or point light shadow map atlases
+    if (type == LIGHT_DIRECTIONAL)
+    {
+        auto numSplits = (unsigned)light->GetNumShadowSplits();
+        if (numSplits > 1)
+            width *= 2;
+        if (numSplits > 2)
+            height *= 2;
+    }
+    else if (type == LIGHT_POINT)
+    {
+        width *= 2;
+        height *= 3;
+    }
+
+    return IntVector2(width, height);
+}
+
+SharedPtr<Texture2D> Renderer::CreateShadowMap(int width, int height)
+{
+    int searchKey = width << 16u | height;
+
+    // Find format and usage of the shadow map
+    unsigned shadowMapFormat = 0;
+    TextureUsage shadowMapUsage = TEXTURE_DEPTHSTENCIL;
+    int multiSample = 1;
+
+    switch (shadowQuality_)
+    {
+    case SHADOWQUALITY_SIMPLE_16BIT:
+    case SHADOWQUALITY_PCF_16BIT:
+        shadowMapFormat = graphics_->GetShadowMapFormat();
+        break;
+
+    case SHADOWQUALITY_SIMPLE_24BIT:
+    case SHADOWQUALITY_PCF_24BIT:
+        shadowMapFormat = graphics_->GetHiresShadowMapFormat();
+        break;
+
+    case SHADOWQUALITY_VSM:
+    case SHADOWQUALITY_BLUR_VSM:
+        shadowMapFormat = graphics_->GetRGFloat32Format();
+        shadowMapUsage = TEXTURE_RENDERTARGET;
+        multiSample = vsmMultiSample_;
+        break;
+    }
+
+    if (!shadowMapFormat)
+        return nullptr;
+
+    SharedPtr<Texture2D> newShadowMap(new Texture2D(context_));
+    int retries = 3;
+    unsigned dummyColorFormat = graphics_->GetDummyColorFormat();
+
+    // Disable mipmaps from the shadow map
+    newShadowMap->SetNumLevels(1);
+
+    while (retries)
+    {
+        if (!newShadowMap->SetSize(width, height, shadowMapFormat, shadowMapUsage, multiSample))
+        {
+            width >>= 1;
+            height >>= 1;
+            --retries;
+        }
+        else
+        {
+#ifndef GL_ES_VERSION_2_0
+            // OpenGL (desktop) and D3D11: shadow compare mode needs to be specifically enabled for the shadow map
+            newShadowMap->SetFilterMode(FILTER_BILINEAR);
+            newShadowMap->SetShadowCompare(shadowMapUsage == TEXTURE_DEPTHSTENCIL);
+#endif
+#ifndef URHO3D_OPENGL
+            // Direct3D9: when shadow compare must be done manually, use nearest filtering so that the filtering of point lights
+            // and other shadowed lights matches
+            newShadowMap->SetFilterMode(graphics_->GetHardwareShadowSupport() ? FILTER_BILINEAR : FILTER_NEAREST);
+#endif
+            // Create dummy color texture for the shadow map if necessary: Direct3D9, or OpenGL when working around an OS X +
+            // Intel driver bug
+            if (shadowMapUsage == TEXTURE_DEPTHSTENCIL && dummyColorFormat)
+            {
+                // If no dummy color rendertarget for this size exists yet, create one now
+                if (!colorShadowMaps_.Contains(searchKey))
+                {
+                    colorShadowMaps_[searchKey] = new Texture2D(context_);
+                    colorShadowMaps_[searchKey]->SetNumLevels(1);
+                    colorShadowMaps_[searchKey]->SetSize(width, height, dummyColorFormat, TEXTURE_RENDERTARGET);
+                }
+                // Link the color rendertarget to the shadow map
+                newShadowMap->GetRenderSurface()->SetLinkedRenderTarget(colorShadowMaps_[searchKey]->GetRenderSurface());
+            }
+            break;
+        }
+    }
+
+    if (!retries)
+        newShadowMap.Reset();
+
+    return newShadowMap;
 }
 
 void Renderer::ResetShadowMaps()
@@ -1901,6 +2489,7 @@ void Renderer::ResetShadowMaps()
     shadowMaps_.Clear();
     shadowMapAllocations_.Clear();
     colorShadowMaps_.Clear();
+    cachedShadowMaps_.Clear();
 }
 
 void Renderer::ResetBuffers()
@@ -1918,7 +2507,7 @@ String Renderer::GetShadowVariations() const
         #ifdef URHO3D_OPENGL
             return "SIMPLE_SHADOW ";
         #else
-            if (graphics_->GetHardwareShadowSupport())
+            if (!graphics_ || graphics_->GetHardwareShadowSupport())
                 return "SIMPLE_SHADOW ";
             else
                 return "SIMPLE_SHADOW SHADOWCMP ";
@@ -1929,7 +2518,7 @@ String Renderer::GetShadowVariations() const
         #ifdef URHO3D_OPENGL
             return "PCF_SHADOW ";
         #else
-            if (graphics_->GetHardwareShadowSupport())
+            if (!graphics_ || graphics_->GetHardwareShadowSupport())
                 return "PCF_SHADOW ";
             else
                 return "PCF_SHADOW SHADOWCMP ";
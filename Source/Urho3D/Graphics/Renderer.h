@@ -26,6 +26,7 @@
 #include "../Core/Mutex.h"
 #include "../Graphics/Batch.h"
 #include "../Graphics/Drawable.h"
+#include "../Graphics/OctreeQuery.h"
 #include "../Graphics/Viewport.h"
 #include "../Math/Color.h"
 
@@ -55,6 +56,7 @@ class Zone;
 struct BatchQueue;
 
 static const int SHADOW_MIN_PIXELS = 64;
+static const unsigned SHADOW_MAP_CACHE_FRAMES = 60;
 static const int INSTANCING_BUFFER_DEFAULT_SIZE = 1024;
 
 /// Light vertex shader variations.
@@ -169,6 +171,60 @@ enum DeferredLightPSVariation
     MAX_DEFERRED_LIGHT_PS_VARIATIONS
 };
 
+/// Key of a cached shadow map. Shadow casters are culled against the view camera's view mask and distance, so each combination has its own shadow map.
+struct ShadowMapCacheKey
+{
+    /// Test for equality with another key.
+    bool operator ==(const ShadowMapCacheKey& rhs) const
+    {
+        return light_ == rhs.light_ && camera_ == rhs.camera_ && viewMask_ == rhs.viewMask_;
+    }
+
+    /// Test for inequality with another key.
+    bool operator !=(const ShadowMapCacheKey& rhs) const { return !(*this == rhs); }
+
+    /// Return hash value for HashMap.
+    unsigned ToHash() const { return ((unsigned)(size_t)light_ * 31 + (unsigned)(size_t)camera_) * 31 + viewMask_; }
+
+    /// Light.
+    Light* light_;
+    /// View camera.
+    Camera* camera_;
+    /// View mask of the view camera.
+    unsigned viewMask_;
+};
+
+/// Shadow map of a point or spot light kept between frames, and the shadow cameras and casters it was rendered with.
+struct CachedShadowMap
+{
+    /// Light.
+    WeakPtr<Light> light_;
+    /// View camera.
+    WeakPtr<Camera> camera_;
+    /// Shadow map texture.
+    SharedPtr<Texture2D> shadowMap_;
+    /// Requested shadow map size. The texture may be smaller if creation failed at full size.
+    IntVector2 size_;
+    /// View-projection matrices of the shadow cameras.
+    Matrix4 viewProj_[MAX_CUBEMAP_FACES];
+    /// Number of shadow cameras.
+    unsigned numSplits_{};
+    /// Order-independent hash of the shadow casters.
+    unsigned long long casterHash_{};
+    /// Number of shadow casters.
+    unsigned numCasters_{};
+    /// Constant depth bias.
+    float constantBias_{};
+    /// Slope-scaled depth bias.
+    float slopeScaledBias_{};
+    /// Frame number on which the contents were last rendered.
+    unsigned renderFrameNumber_{};
+    /// Frame number on which the shadow map was last used.
+    unsigned useFrameNumber_{};
+    /// Contents rendered flag.
+    bool valid_{};
+};
+
 /// High-level rendering subsystem. Manages drawing of 3D views.
 class URHO3D_API Renderer : public Object
 {
@@ -222,6 +278,8 @@ public:
     void SetReuseShadowMaps(bool enable);
     /// Set maximum number of shadow maps created for one resolution. Only has effect if reuse of shadow maps is disabled.
     void SetMaxShadowMaps(int shadowMaps);
+    /// Set caching of point and spot light shadow maps between frames. Default false. When enabled, each shadowed point and spot light keeps its own shadow map, which is only re-rendered when the light or the shadow casters inside its range change.
+    void SetShadowMapCaching(bool enable);
     /// Set dynamic instancing on/off. When on (default), drawables using the same static-type geometry and material will be automatically combined to an instanced draw call.
     void SetDynamicInstancing(bool enable);
     /// Set number of extra instancing buffer elements. Default is 0. Extra 4-vectors are available through TEXCOORD7 and further.
@@ -238,6 +296,12 @@ public:
     void SetOccluderSizeThreshold(float screenSize);
     /// Set whether to thread occluder rendering. Default false.
     void SetThreadedOcclusion(bool enable);
+    /// Set whether views reuse octant culling results from earlier frames when the culling camera has moved little. Produces the same visible objects as full culling. Default false.
+    void SetCoherentCulling(bool enable);
+    /// Set whether views of the same scene are frustum culled together in one octree traversal. Produces the same visible objects as culling each view separately, but octants are not occlusion culled. Default false.
+    void SetSharedCulling(bool enable);
+    /// Set whether views record their scene passes into render command buffers in worker threads and replay them when rendering. Produces the same draw calls with redundant state changes dropped. Default false.
+    void SetCommandRecording(bool enable);
     /// Set shadow depth bias multiplier for mobile platforms to counteract possible worse shadow map precision. Default 1.0 (no effect.)
     void SetMobileShadowBiasMul(float mul);
     /// Set shadow depth bias addition for mobile platforms to counteract possible worse shadow map precision. Default 0.0 (no effect.)
@@ -304,6 +368,9 @@ public:
     /// Return maximum number of shadow maps per resolution.
     int GetMaxShadowMaps() const { return maxShadowMaps_; }
 
+    /// Return whether point and spot light shadow maps are cached between frames.
+    bool GetShadowMapCaching() const { return shadowMapCaching_; }
+
     /// Return whether dynamic instancing is in use.
     bool GetDynamicInstancing() const { return dynamicInstancing_; }
 
@@ -328,6 +395,15 @@ public:
     /// Return whether occlusion rendering is threaded.
     bool GetThreadedOcclusion() const { return threadedOcclusion_; }
 
+    /// Return whether views reuse octant culling results from earlier frames.
+    bool GetCoherentCulling() const { return coherentCulling_; }
+
+    /// Return whether views of the same scene are frustum culled together.
+    bool GetSharedCulling() const { return sharedCulling_; }
+
+    /// Return whether views record their scene passes into render command buffers.
+    bool GetCommandRecording() const { return commandRecording_; }
+
     /// Return shadow depth bias multiplier for mobile platforms.
     float GetMobileShadowBiasMul() const { return mobileShadowBiasMul_; }
 
@@ -352,8 +428,18 @@ public:
     unsigned GetNumLights(bool allViews = false) const;
     /// Return number of shadow maps rendered.
     unsigned GetNumShadowMaps(bool allViews = false) const;
+    /// Return number of shadow maps whose contents were reused from an earlier frame with shadow map caching.
+    unsigned GetNumReusedShadowMaps(bool allViews = false) const;
+    /// Return number of shadow maps that were re-rendered while being cached between frames.
+    unsigned GetNumRerenderedShadowMaps(bool allViews = false) const;
     /// Return number of occluders rendered.
     unsigned GetNumOccluders(bool allViews = false) const;
+    /// Return number of octants tested against the view frustum with coherent culling.
+    unsigned GetNumTestedOctants(bool allViews = false) const;
+    /// Return number of octants whose culling result was reused from an earlier frame with coherent culling.
+    unsigned GetNumReusedOctants(bool allViews = false) const;
+    /// Return number of views whose frustum culling was shared with other views.
+    unsigned GetNumSharedCullViews(bool allViews = false) const;
 
     /// Return the default zone.
     Zone* GetDefaultZone() const { return defaultZone_; }
@@ -376,6 +462,15 @@ public:
     /// Return the instancing vertex buffer
     VertexBuffer* GetInstancingBuffer() const { return dynamicInstancing_ ? instancingBuffer_.Get() : nullptr; }
 
+    /// Return number of instances allocated from the instancing buffer this frame.
+    unsigned GetInstancingBufferUsage() const { return numInstancesAllocated_; }
+
+    /// Return number of bytes uploaded to the instancing buffer this frame.
+    unsigned GetInstancingBufferUploadSize() const { return instancingUploadSize_; }
+
+    /// Return number of times the instancing buffer ring has wrapped around and been discarded.
+    unsigned GetNumInstancingBufferWraps() const { return numInstancingBufferWraps_; }
+
     /// Return the frame update parameters.
     const RenderFrameInfo& GetFrameInfo() const { return frame_; }
 
@@ -396,6 +491,12 @@ public:
     Geometry* GetQuadGeometry();
     /// Allocate a shadow map. If shadow map reuse is disabled, a different map is returned each time.
     Texture2D* GetShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight);
+    /// Return the shadow map kept between frames for a point or spot light, creating or resizing it as necessary.
+    Texture2D* GetCachedShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight);
+    /// Check whether the cached shadow map of a light was rendered with the same shadow cameras, casters and bias, and none of the casters has been updated since. If not, store them as the pending contents and return false.
+    bool ReuseCachedShadowMap(Light* light, Camera* camera, const CachedShadowMap& contents, unsigned lastCasterUpdate);
+    /// Mark the pending contents of a light's cached shadow map rendered.
+    void MarkCachedShadowMapRendered(Light* light, Camera* camera);
     /// Allocate a rendertarget or depth-stencil texture for deferred rendering or postprocessing. Should only be called during actual rendering, not before.
     Texture* GetScreenBuffer
         (int width, int height, unsigned format, int multiSample, bool autoResolve, bool cubemap, bool filtered, bool srgb, unsigned persistentKey = 0);
@@ -409,15 +510,27 @@ public:
     void StorePreparedView(View* view, Camera* camera);
     /// Return a prepared view if exists for the specified camera. Used to avoid duplicate view preparation CPU work.
     View* GetPreparedView(Camera* camera);
+    /// Return the geometries, lights and zones visible to a cull camera from a culling pass shared with the other views of the same octree queued for this frame, or null if shared culling is not in use.
+    const PODVector<Drawable*>* GetSharedCullDrawables(Octree* octree, Camera* camera);
     /// Choose shaders for a forward rendering batch. The related batch queue is provided in case it has extra shader compilation defines.
     void SetBatchShaders(Batch& batch, Technique* tech, bool allowShadows, const BatchQueue& queue);
     /// Choose shaders for a deferred light volume batch.
     void SetLightVolumeBatchShaders
         (Batch& batch, Camera* camera, const String& vsName, const String& psName, const String& vsDefines, const String& psDefines);
+    /// Return the define masks of the vertex and pixel shader variations of a pass, in the order of the pass shader vectors. Return false if the defines do not fit in define masks.
+    bool GetPassShaderDefines(Pass* pass, const String& vsExtraDefines, const String& psExtraDefines,
+        PODVector<ShaderDefineMask>& vsDefines, PODVector<ShaderDefineMask>& psDefines) const;
+    /// Enumerate the vertex and pixel shader define masks that a pass can be rendered with. Return false if the defines do not fit in define masks.
+    bool GetPassShaderCombinations(Pass* pass, const String& vsExtraDefines, const String& psExtraDefines,
+        PODVector<Pair<ShaderDefineMask, ShaderDefineMask> >& dest) const;
     /// Set cull mode while taking possible projection flipping into account.
     void SetCullMode(CullMode mode, Camera* camera);
     /// Ensure sufficient size of the instancing vertex buffer. Return true if successful.
     bool ResizeInstancingBuffer(unsigned numInstances);
+    /// Allocate a range of instances from the instancing buffer ring for the current frame. The range stays valid until the end of the frame. Return the start index, or M_MAX_UNSIGNED if the ring is full, in which case it grows on the next frame.
+    unsigned AllocateInstances(unsigned numInstances);
+    /// Upload an allocated range of instances after writing it to the instancing buffer's shadow data.
+    void CommitInstances(unsigned start, unsigned numInstances);
     /// Optimize a light by scissor rectangle.
     void OptimizeLightByScissor(Light* light, Camera* camera);
     /// Optimize a light by marking it to the stencil buffer and setting a stencil test.
@@ -435,6 +548,10 @@ private:
     void LoadShaders();
     /// Reload shaders for a material pass. The related batch queue is provided in case it has extra shader compilation defines.
     void LoadPassShaders(Pass* pass, Vector<SharedPtr<ShaderVariation> >& vertexShaders, Vector<SharedPtr<ShaderVariation> >& pixelShaders, const BatchQueue& queue);
+    /// Reload shaders for a material pass using define strings. Used when the defines do not fit in define masks.
+    void LoadPassShadersByDefineStrings(Pass* pass, Vector<SharedPtr<ShaderVariation> >& vertexShaders, Vector<SharedPtr<ShaderVariation> >& pixelShaders, const BatchQueue& queue);
+    /// Register the engine's shader defines and build the define masks of the shader variation tables.
+    void RegisterShaderDefines();
     /// Release shaders used in materials.
     void ReleaseMaterialShaders();
     /// Reload textures.
@@ -447,12 +564,20 @@ private:
     void SetIndirectionTextureData();
     /// Update a queued viewport for rendering.
     void UpdateQueuedViewport(unsigned index);
+    /// Cull the cameras of the queued viewports that view an octree, starting from a camera of the viewport being updated, in one octree traversal.
+    void PrepareSharedCulling(Octree* octree, Camera* camera);
     /// Prepare for rendering of a new view.
     void PrepareViewRender();
     /// Remove unused occlusion and screen buffers.
     void RemoveUnusedBuffers();
     /// Reset shadow map allocation counts.
     void ResetShadowMapAllocations();
+    /// Remove cached shadow maps of destroyed lights and lights that have not been shadowed for a while.
+    void RemoveUnusedCachedShadowMaps();
+    /// Return the shadow map size for a light, including the atlas layout of directional light splits and point light faces.
+    IntVector2 GetShadowMapSize(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight) const;
+    /// Create a shadow map texture. Return null if failed.
+    SharedPtr<Texture2D> CreateShadowMap(int width, int height);
     /// Reset screem buffer allocation counts.
     void ResetScreenBufferAllocations();
     /// Remove all shadow maps. Called when global shadow map resolution or format is changed.
@@ -504,6 +629,8 @@ private:
     HashMap<int, SharedPtr<Texture2D> > colorShadowMaps_;
     /// Shadow map allocations by resolution.
     HashMap<int, PODVector<Light*> > shadowMapAllocations_;
+    /// Shadow maps kept between frames by light, view camera and view mask.
+    HashMap<ShadowMapCacheKey, CachedShadowMap> cachedShadowMaps_;
     /// Instance of shadow map filter
     Object* shadowMapFilterInstance_{};
     /// Function pointer of shadow map filter
@@ -524,12 +651,34 @@ private:
     HashMap<Camera*, WeakPtr<View> > preparedViews_;
     /// Octrees that have been updated during the frame.
     HashSet<Octree*> updatedOctrees_;
+    /// Query for culling several views' cameras in one octree traversal.
+    MultiFrustumOctreeQuery sharedCullQuery_;
+    /// Cull cameras of the shared culling query in frustum order.
+    PODVector<Camera*> sharedCullCameras_;
+    /// Frustums of the shared culling query, used to check that a camera has not changed since.
+    Vector<Frustum> sharedCullFrustums_;
+    /// Octree of the shared culling query.
+    Octree* sharedCullOctree_{};
+    /// Index of the queued viewport being updated.
+    unsigned currentViewportIndex_{};
     /// Techniques for which missing shader error has been displayed.
     HashSet<Technique*> shaderErrorDisplayed_;
     /// Mutex for shadow camera allocation.
     Mutex rendererMutex_;
     /// Current variation names for deferred light volume shaders.
     Vector<String> deferredLightPSVariations_;
+    /// Define masks of the geometry type vertex shader variations.
+    ShaderDefineMask geometryVSDefines_[MAX_GEOMETRYTYPES]{};
+    /// Define masks of the per-pixel light vertex shader variations.
+    ShaderDefineMask lightVSDefines_[MAX_LIGHT_VS_VARIATIONS]{};
+    /// Define masks of the vertex light vertex shader variations.
+    ShaderDefineMask vertexLightVSDefines_[MAX_VERTEXLIGHT_VS_VARIATIONS]{};
+    /// Define masks of the per-pixel light pixel shader variations.
+    ShaderDefineMask lightPSDefines_[MAX_LIGHT_PS_VARIATIONS]{};
+    /// Define mask of the height fog pixel shader variation.
+    ShaderDefineMask heightFogDefines_{};
+    /// Define mask of the variance shadow map shadow pass.
+    ShaderDefineMask vsmShadowDefines_{};
     /// Frame info for rendering.
     RenderFrameInfo frame_;
     /// Texture anisotropy level.
@@ -588,12 +737,38 @@ private:
     bool drawShadows_{true};
     /// Shadow map reuse flag.
     bool reuseShadowMaps_{true};
+    /// Shadow map caching flag.
+    bool shadowMapCaching_{};
     /// Dynamic instancing flag.
     bool dynamicInstancing_{true};
     /// Number of extra instancing data elements.
     int numExtraInstancingBufferElements_{};
+    /// Instancing buffer ring write position.
+    unsigned instancingCursor_{};
+    /// Instancing buffer ring position of the first allocation this frame.
+    unsigned instancingFrameStart_{};
+    /// Instancing buffer ring position up to which can be written without discarding.
+    unsigned instancingLimit_{};
+    /// Number of instances that did not fit into the instancing buffer ring this frame, including the allocated ones. Zero if all fit.
+    unsigned instancingDemand_{};
+    /// Number of instances allocated this frame.
+    unsigned numInstancesAllocated_{};
+    /// Bytes uploaded to the instancing buffer this frame.
+    unsigned instancingUploadSize_{};
+    /// Number of instancing buffer ring wraps.
+    unsigned numInstancingBufferWraps_{};
+    /// Instancing buffer ring wrapped around this frame flag.
+    bool instancingWrapped_{};
+    /// Instancing buffer needs to be discarded and uploaded whole on the next commit flag.
+    bool instancingDiscard_{};
     /// Threaded occlusion rendering flag.
     bool threadedOcclusion_{};
+    /// Coherent culling flag.
+    bool coherentCulling_{};
+    /// Shared culling flag.
+    bool sharedCulling_{};
+    /// Command recording flag.
+    bool commandRecording_{};
     /// Shaders need reloading flag.
     bool shadersDirty_{true};
     /// Initialized flag.
@@ -25,6 +25,7 @@
 #include "../Core/Context.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/Shader.h"
+#include "../Graphics/ShaderCache.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../IO/Deserializer.h"
 #include "../IO/FileSystem.h"
@@ -36,6 +37,9 @@
 namespace Urho3D
 {
 
+HashMap<String, unsigned> Shader::defineBits;
+Vector<String> Shader::defineNames;
+
 void CommentOutFunction(String& code, const String& signature)
 {
     unsigned startPos = code.Find(signature);
@@ -111,6 +115,11 @@ bool Shader::BeginLoad(Deserializer& source)
 
 bool Shader::EndLoad()
 {
+    // Let background compiles of the old source finish before releasing their variations
+    auto* shaderCache = GetSubsystem<ShaderCache>();
+    if (shaderCache)
+        shaderCache->Complete();
+
     // If variations had already been created, release them and require recompile
     for (HashMap<StringHash, SharedPtr<ShaderVariation> >::Iterator i = vsVariations_.Begin(); i != vsVariations_.End(); ++i)
         i->second_->Release();
@@ -157,6 +166,63 @@ ShaderVariation* Shader::GetVariation(ShaderType type, const char* defines)
     return i->second_;
 }
 
+ShaderVariation* Shader::GetVariation(ShaderType type, ShaderDefineMask defines)
+{
+    HashMap<ShaderDefineMask, SharedPtr<ShaderVariation> >& variations(type == VS ? vsMaskVariations_ : psMaskVariations_);
+    HashMap<ShaderDefineMask, SharedPtr<ShaderVariation> >::Iterator i = variations.Find(defines);
+    if (i != variations.End())
+        return i->second_;
+
+    // First request with this mask: go through the string lookup once so that both paths share the variation
+    ShaderVariation* variation = GetVariation(type, GetDefines(defines));
+    variations.Insert(MakePair(defines, SharedPtr<ShaderVariation>(variation)));
+    return variation;
+}
+
+unsigned Shader::RegisterDefine(const String& define)
+{
+    String name = define.ToUpper();
+    HashMap<String, unsigned>::ConstIterator i = defineBits.Find(name);
+    if (i != defineBits.End())
+        return i->second_;
+
+    if (defineNames.Size() >= MAX_SHADER_DEFINES)
+        return M_MAX_UNSIGNED;
+
+    unsigned bit = defineNames.Size();
+    defineBits[name] = bit;
+    defineNames.Push(name);
+    return bit;
+}
+
+bool Shader::GetDefineMask(const String& defines, ShaderDefineMask& mask)
+{
+    mask = 0;
+    Vector<String> definesVec = defines.Split(' ');
+    for (unsigned i = 0; i < definesVec.Size(); ++i)
+    {
+        unsigned bit = RegisterDefine(definesVec[i]);
+        if (bit == M_MAX_UNSIGNED)
+            return false;
+        mask |= (ShaderDefineMask)1 << bit;
+    }
+
+    return true;
+}
+
+String Shader::GetDefines(ShaderDefineMask mask)
+{
+    Vector<String> definesVec;
+    for (unsigned i = 0; i < defineNames.Size(); ++i)
+    {
+        if (mask & ((ShaderDefineMask)1 << i))
+            definesVec.Push(defineNames[i]);
+    }
+
+    Sort(definesVec.Begin(), definesVec.End());
+    return String::Joined(definesVec, " ");
+}
+
 bool Shader::ProcessSource(String& code, Deserializer& source)
 {
     auto* cache = GetSubsystem<ResourceCache>();
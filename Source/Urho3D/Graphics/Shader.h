@@ -53,6 +53,8 @@ public:
     ShaderVariation* GetVariation(ShaderType type, const String& defines);
     /// Return a variation with defines. Separate multiple defines with spaces.
     ShaderVariation* GetVariation(ShaderType type, const char* defines);
+    /// Return a variation addressed by a define mask. Does not touch strings unless the variation has not been requested with the same mask before.
+    ShaderVariation* GetVariation(ShaderType type, ShaderDefineMask defines);
 
     /// Return either vertex or pixel shader source code.
     const String& GetSourceCode(ShaderType type) const { return type == VS ? vsSourceCode_ : psSourceCode_; }
@@ -60,6 +62,13 @@ public:
     /// Return the latest timestamp of the shader code and its includes.
     unsigned GetTimeStamp() const { return timeStamp_; }
 
+    /// Register a define and return its bit index in define masks, or M_MAX_UNSIGNED if all bits are in use. Defines are case-insensitive.
+    static unsigned RegisterDefine(const String& define);
+    /// Convert space-separated defines to a mask, registering new defines. Return false if they do not all fit in the mask.
+    static bool GetDefineMask(const String& defines, ShaderDefineMask& mask);
+    /// Return the normalized define string of a mask.
+    static String GetDefines(ShaderDefineMask mask);
+
 private:
     /// Process source code and include files. Return true if successful.
     bool ProcessSource(String& code, Deserializer& source);
@@ -76,10 +85,19 @@ private:
     HashMap<StringHash, SharedPtr<ShaderVariation> > vsVariations_;
     /// Pixel shader variations.
     HashMap<StringHash, SharedPtr<ShaderVariation> > psVariations_;
+    /// Vertex shader variations by define mask.
+    HashMap<ShaderDefineMask, SharedPtr<ShaderVariation> > vsMaskVariations_;
+    /// Pixel shader variations by define mask.
+    HashMap<ShaderDefineMask, SharedPtr<ShaderVariation> > psMaskVariations_;
     /// Source code timestamp.
     unsigned timeStamp_;
     /// Number of unique variations so far.
     unsigned numVariations_;
+
+    /// Bit indices of registered defines.
+    static HashMap<String, unsigned> defineBits;
+    /// Names of registered defines by bit index.
+    static Vector<String> defineNames;
 };
 
 }
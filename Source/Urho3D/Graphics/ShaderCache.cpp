@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
+#include "../Graphics/Shader.h"
+#include "../Graphics/ShaderCache.h"
+#include "../Graphics/ShaderVariation.h"
+#include "../IO/Log.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+ShaderCache::ShaderCache(Context* context) :
+    Object(context),
+    backgroundCompile_(false),
+    numCacheHits_(0),
+    numCacheMisses_(0),
+    numBackgroundCompiles_(0),
+    numPendingRequests_(0)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+    // The variations are not created anymore, as the graphics subsystem may already be gone
+    WaitForJobs();
+    jobs_.Clear();
+}
+
+void ShaderCache::SetBackgroundCompile(bool enable)
+{
+    if (!enable)
+        Complete();
+
+    backgroundCompile_ = enable;
+}
+
+bool ShaderCache::Request(ShaderVariation* variation)
+{
+    if (!variation)
+        return false;
+
+    HashMap<ShaderVariation*, SharedPtr<ShaderCompileJob> >::Iterator i = jobs_.Find(variation);
+    if (i != jobs_.End())
+    {
+        if (!i->second_->completed_)
+        {
+            ++numPendingRequests_;
+            return false;
+        }
+
+        SharedPtr<ShaderCompileJob> job = i->second_;
+        jobs_.Erase(i);
+        return Finish(job);
+    }
+
+    Shader* owner = variation->GetOwner();
+    auto* workQueue = GetSubsystem<WorkQueue>();
+    if (!backgroundCompile_ || !owner || !workQueue || !ShaderVariation::GetByteCodeSupport())
+    {
+        bool success = variation->Create();
+        UpdateStats(variation);
+        return success;
+    }
+
+    // Start from a released state, then load or compile the bytecode in a worker thread. The GPU object is created on
+    // the first request after the work item completes
+    variation->Release();
+
+    SharedPtr<ShaderCompileJob> job(new ShaderCompileJob());
+    job->variation_ = variation;
+    job->owner_ = owner;
+    job->sourceCode_ = owner->GetSourceCode(variation->GetShaderType());
+    jobs_[variation] = job;
+
+    ShaderCompileJob* jobPtr = job.Get();
+    workQueue->AddWorkItem([jobPtr]()
+    {
+        jobPtr->success_ = jobPtr->variation_->CompileByteCode(jobPtr->sourceCode_, jobPtr->compilerOutput_);
+        jobPtr->completed_ = true;
+    });
+
+    ++numBackgroundCompiles_;
+    ++numPendingRequests_;
+    return false;
+}
+
+void ShaderCache::Complete()
+{
+    if (jobs_.Empty())
+        return;
+
+    URHO3D_PROFILE(CompleteShaderCompiles);
+
+    WaitForJobs();
+
+    for (HashMap<ShaderVariation*, SharedPtr<ShaderCompileJob> >::Iterator i = jobs_.Begin(); i != jobs_.End(); ++i)
+    {
+        ShaderCompileJob* job = i->second_;
+        if (job->completed_ && !Finish(job))
+        {
+            ShaderVariation* variation = job->variation_;
+            URHO3D_LOGERROR("Failed to compile " + String(variation->GetShaderType() == VS ? "vertex" : "pixel") + " shader " +
+                variation->GetFullName() + ":\n" + variation->GetCompilerOutput());
+        }
+    }
+
+    jobs_.Clear();
+}
+
+void ShaderCache::ResetStats()
+{
+    numCacheHits_ = 0;
+    numCacheMisses_ = 0;
+    numBackgroundCompiles_ = 0;
+    numPendingRequests_ = 0;
+}
+
+void ShaderCache::WaitForJobs()
+{
+    if (jobs_.Empty())
+        return;
+
+    // If the work queue has already been destroyed, its worker threads have been joined and the remaining items dropped
+    auto* workQueue = GetSubsystem<WorkQueue>();
+    if (workQueue)
+        workQueue->Complete(0);
+}
+
+bool ShaderCache::Finish(ShaderCompileJob* job)
+{
+    ShaderVariation* variation = job->variation_;
+    if (!job->success_)
+        variation->SetCompilerOutput(job->compilerOutput_);
+    bool success = job->success_ && variation->CreateObject();
+    UpdateStats(variation);
+    return success;
+}
+
+void ShaderCache::UpdateStats(ShaderVariation* variation)
+{
+    if (variation->IsLoadedFromCache())
+        ++numCacheHits_;
+    else
+        ++numCacheMisses_;
+}
+
+}
@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Core/Object.h"
+
+namespace Urho3D
+{
+
+class Shader;
+class ShaderVariation;
+
+/// Background compile job of a shader variation.
+struct ShaderCompileJob : public RefCounted
+{
+    /// Variation being compiled.
+    SharedPtr<ShaderVariation> variation_;
+    /// Owner shader, kept alive during the compile.
+    SharedPtr<Shader> owner_;
+    /// Copy of the source code, so that the shader can be reloaded meanwhile.
+    String sourceCode_;
+    /// Compiler output of a failed compile. Kept here until the main thread finishes the job, as the variation may be read meanwhile.
+    String compilerOutput_;
+    /// Compile result.
+    bool success_{};
+    /// Completed flag.
+    volatile bool completed_{};
+};
+
+/// %Shader variation compile front-end. Variations are loaded from the content-hashed bytecode cache in the shader cache directory, or compiled and stored there. Optionally the loading and compiling is done on worker threads, and draws with the variation are skipped until it is ready.
+class URHO3D_API ShaderCache : public Object
+{
+    URHO3D_OBJECT(ShaderCache, Object);
+
+public:
+    /// Construct.
+    explicit ShaderCache(Context* context);
+    /// Destruct. Wait for background compiles to finish.
+    ~ShaderCache() override;
+
+    /// Set whether to compile variations on worker threads. Has no effect on OpenGL, where the driver compiles from source on the main thread.
+    void SetBackgroundCompile(bool enable);
+    /// Create a variation for use, or queue it for background compilation. Return true if created. Return false if still compiling, or if failed, in which case the compiler output is set.
+    bool Request(ShaderVariation* variation);
+    /// Finish all background compiles and create the variations.
+    void Complete();
+    /// Reset the statistics counters.
+    void ResetStats();
+
+    /// Return whether compiles variations on worker threads.
+    bool GetBackgroundCompile() const { return backgroundCompile_; }
+
+    /// Return whether a variation is being compiled in the background.
+    bool IsPending(ShaderVariation* variation) const { return jobs_.Contains(variation); }
+
+    /// Return number of variations being compiled in the background.
+    unsigned GetNumPending() const { return jobs_.Size(); }
+
+    /// Return number of variations whose bytecode was loaded from the cache.
+    unsigned GetNumCacheHits() const { return numCacheHits_; }
+
+    /// Return number of variations compiled from source.
+    unsigned GetNumCacheMisses() const { return numCacheMisses_; }
+
+    /// Return number of compiles queued to worker threads.
+    unsigned GetNumBackgroundCompiles() const { return numBackgroundCompiles_; }
+
+    /// Return number of requests that were not ready because the variation was still compiling.
+    unsigned GetNumPendingRequests() const { return numPendingRequests_; }
+
+private:
+    /// Wait for the queued compile work items to finish.
+    void WaitForJobs();
+    /// Create a variation from bytecode compiled in the background. Return true if successful.
+    bool Finish(ShaderCompileJob* job);
+    /// Update the cache statistics after compiling a variation.
+    void UpdateStats(ShaderVariation* variation);
+
+    /// Background compile jobs by variation.
+    HashMap<ShaderVariation*, SharedPtr<ShaderCompileJob> > jobs_;
+    /// Background compile flag.
+    bool backgroundCompile_;
+    /// Number of cache hits.
+    unsigned numCacheHits_;
+    /// Number of cache misses.
+    unsigned numCacheMisses_;
+    /// Number of background compiles.
+    unsigned numBackgroundCompiles_;
+    /// Number of requests for variations still compiling.
+    unsigned numPendingRequests_;
+};
+
+}
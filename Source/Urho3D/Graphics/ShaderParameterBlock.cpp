@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Graphics/ShaderParameterBlock.h"
+#include "../Graphics/ShaderVariation.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Maximum number of shader program layouts cached per block.
+static const unsigned MAX_CACHED_LAYOUTS = 4;
+
+unsigned ShaderParameterBlock::layoutGeneration = 0;
+
+ShaderParameterBlock::ShaderParameterBlock() :
+    signature_(0),
+    nextLayout_(0)
+{
+}
+
+void ShaderParameterBlock::Clear()
+{
+    entries_.Clear();
+    data_.Clear();
+    signature_ = 0;
+}
+
+void ShaderParameterBlock::AddParameter(StringHash name, const Variant& value)
+{
+    switch (value.GetType())
+    {
+    case VAR_BOOL:
+        {
+            float data = value.GetBool() ? 1.0f : 0.0f;
+            AddParameter(name, VAR_BOOL, &data, 1);
+        }
+        break;
+
+    case VAR_INT:
+        {
+            // Store the integer bit pattern as is
+            int intValue = value.GetInt();
+            float data;
+            memcpy(&data, &intValue, sizeof data);
+            AddParameter(name, VAR_INT, &data, 1);
+        }
+        break;
+
+    case VAR_FLOAT:
+    case VAR_DOUBLE:
+        {
+            float data = value.GetFloat();
+            AddParameter(name, VAR_FLOAT, &data, 1);
+        }
+        break;
+
+    case VAR_VECTOR2:
+        AddParameter(name, VAR_VECTOR2, value.GetVector2().Data(), 2);
+        break;
+
+    case VAR_VECTOR3:
+        AddParameter(name, VAR_VECTOR3, value.GetVector3().Data(), 3);
+        break;
+
+    case VAR_VECTOR4:
+        AddParameter(name, VAR_VECTOR4, value.GetVector4().Data(), 4);
+        break;
+
+    case VAR_COLOR:
+        AddParameter(name, VAR_COLOR, value.GetColor().Data(), 4);
+        break;
+
+    case VAR_MATRIX3:
+        AddParameter(name, VAR_MATRIX3, value.GetMatrix3().Data(), 9);
+        break;
+
+    case VAR_MATRIX3X4:
+        AddParameter(name, VAR_MATRIX3X4, value.GetMatrix3x4().Data(), 12);
+        break;
+
+    case VAR_MATRIX4:
+        AddParameter(name, VAR_MATRIX4, value.GetMatrix4().Data(), 16);
+        break;
+
+    case VAR_BUFFER:
+        {
+            const PODVector<unsigned char>& buffer = value.GetBuffer();
+            if (buffer.Size() >= sizeof(float))
+                AddParameter(name, VAR_BUFFER, reinterpret_cast<const float*>(&buffer[0]), buffer.Size() / sizeof(float));
+        }
+        break;
+
+    default:
+        // Unsupported parameter type, do nothing
+        break;
+    }
+}
+
+const PODVector<const ShaderParameter*>& ShaderParameterBlock::GetLayout(RefCounted* program,
+    const HashMap<StringHash, ShaderParameter>& parameters) const
+{
+    for (unsigned i = 0; i < layouts_.Size(); ++i)
+    {
+        ShaderParameterLayout& layout = layouts_[i];
+        if (layout.program_.Get() == program)
+        {
+            if (layout.signature_ != signature_ || layout.generation_ != layoutGeneration ||
+                layout.parameters_.Size() != entries_.Size())
+                break;
+            return layout.parameters_;
+        }
+    }
+
+    // Find the slot to (re)resolve: the program's stale layout, an expired or new slot, or the oldest one
+    unsigned index = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < layouts_.Size(); ++i)
+    {
+        if (layouts_[i].program_.Get() == program || layouts_[i].program_.Expired())
+        {
+            index = i;
+            break;
+        }
+    }
+    if (index == M_MAX_UNSIGNED)
+    {
+        if (layouts_.Size() < MAX_CACHED_LAYOUTS)
+        {
+            index = layouts_.Size();
+            layouts_.Resize(index + 1);
+        }
+        else
+        {
+            index = nextLayout_;
+            nextLayout_ = (nextLayout_ + 1) % MAX_CACHED_LAYOUTS;
+        }
+    }
+
+    ShaderParameterLayout& layout = layouts_[index];
+    layout.program_ = program;
+    layout.signature_ = signature_;
+    layout.generation_ = layoutGeneration;
+    layout.parameters_.Resize(entries_.Size());
+    for (unsigned i = 0; i < entries_.Size(); ++i)
+    {
+        HashMap<StringHash, ShaderParameter>::ConstIterator j = parameters.Find(entries_[i].name_);
+        layout.parameters_[i] = j != parameters.End() ? &j->second_ : nullptr;
+    }
+
+    return layout.parameters_;
+}
+
+void ShaderParameterBlock::InvalidateLayouts()
+{
+    ++layoutGeneration;
+}
+
+void ShaderParameterBlock::AddParameter(StringHash name, VariantType type, const float* data, unsigned count)
+{
+    ShaderParameterBlockEntry entry;
+    entry.name_ = name;
+    entry.type_ = type;
+    entry.offset_ = data_.Size();
+    entry.count_ = count;
+    entries_.Push(entry);
+
+    data_.Resize(entry.offset_ + count);
+    memcpy(&data_[entry.offset_], data, count * sizeof(float));
+
+    signature_ = SDBMHash(signature_, (unsigned char)type);
+    for (unsigned i = 0; i < sizeof(unsigned); ++i)
+        signature_ = SDBMHash(signature_, (unsigned char)(name.Value() >> (i * 8)));
+}
+
+}
@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/Ptr.h"
+#include "../Core/Variant.h"
+
+namespace Urho3D
+{
+
+struct ShaderParameter;
+
+/// Parameter stored in a shader parameter block.
+struct ShaderParameterBlockEntry
+{
+    /// Parameter name hash.
+    StringHash name_;
+    /// Value type. Raw float arrays are stored as VAR_BUFFER.
+    VariantType type_;
+    /// Offset of the value in the block's float data.
+    unsigned offset_;
+    /// Number of floats in the value.
+    unsigned count_;
+};
+
+/// Locations of a block's parameters resolved against one shader program.
+struct ShaderParameterLayout
+{
+    /// Shader program the layout was resolved against.
+    WeakPtr<RefCounted> program_;
+    /// Block signature when resolved.
+    unsigned signature_;
+    /// Layout generation when resolved.
+    unsigned generation_;
+    /// Resolved parameter info per block entry, null if the program does not use the parameter.
+    PODVector<const ShaderParameter*> parameters_;
+};
+
+/// Packed set of shader parameter values that can be uploaded with one call. Caches the parameter locations per shader program, so that uploading does not need per-parameter hash lookups.
+class URHO3D_API ShaderParameterBlock
+{
+public:
+    /// Construct.
+    ShaderParameterBlock();
+
+    /// Remove all parameters. Resolved layouts are kept and stay valid if the same parameters are added again.
+    void Clear();
+    /// Add a parameter from a variant. Unsupported value types are ignored.
+    void AddParameter(StringHash name, const Variant& value);
+    /// Return the locations of the parameters in a shader program, resolving and caching them if necessary. Only to be called from the main thread.
+    const PODVector<const ShaderParameter*>& GetLayout(RefCounted* program, const HashMap<StringHash, ShaderParameter>& parameters) const;
+
+    /// Return parameter entries.
+    const PODVector<ShaderParameterBlockEntry>& GetEntries() const { return entries_; }
+
+    /// Return packed parameter values.
+    const float* GetData() const { return data_.Buffer(); }
+
+    /// Return number of parameters.
+    unsigned GetNumParameters() const { return entries_.Size(); }
+
+    /// Return whether has no parameters.
+    bool IsEmpty() const { return entries_.Empty(); }
+
+    /// Invalidate resolved layouts of all blocks. Called when shader programs are relinked in place.
+    static void InvalidateLayouts();
+
+private:
+    /// Add a parameter and copy its value to the data.
+    void AddParameter(StringHash name, VariantType type, const float* data, unsigned count);
+
+    /// Parameter entries.
+    PODVector<ShaderParameterBlockEntry> entries_;
+    /// Packed parameter values.
+    PODVector<float> data_;
+    /// Hash of the parameter names and types, used to validate resolved layouts.
+    unsigned signature_;
+    /// Resolved layouts per shader program.
+    mutable Vector<ShaderParameterLayout> layouts_;
+    /// Index of the layout to replace next when the cache is full.
+    mutable unsigned nextLayout_;
+
+    /// Global layout generation.
+    static unsigned layoutGeneration;
+};
+
+}
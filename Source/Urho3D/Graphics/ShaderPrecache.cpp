@@ -86,11 +86,11 @@ void ShaderPrecache::StoreShaders(ShaderVariation* vs, ShaderVariation* ps)
         return;
     usedPtrCombinations_.Insert(shaderPair);
 
-    String vsName = vs->GetName();
-    String psName = ps->GetName();
-    const String& vsDefines = vs->GetDefines();
-    const String& psDefines = ps->GetDefines();
+    StoreShaders(vs->GetName(), vs->GetDefines(), ps->GetName(), ps->GetDefines());
+}
 
+void ShaderPrecache::StoreShaders(const String& vsName, const String& vsDefines, const String& psName, const String& psDefines)
+{
     // Check for duplicate using strings (needed for combinations loaded from existing file)
     String newCombination = vsName + " " + vsDefines + " " + psName + " " + psDefines;
     if (usedCombinations_.Contains(newCombination))
@@ -45,6 +45,8 @@ public:
 
     /// Collect a shader combination. Called by Graphics when shaders have been set.
     void StoreShaders(ShaderVariation* vs, ShaderVariation* ps);
+    /// Collect a shader combination by names and defines. Used when enumerating combinations offline.
+    void StoreShaders(const String& vsName, const String& vsDefines, const String& psName, const String& psDefines);
 
     /// Load shaders from an XML file.
     static void LoadShaders(Graphics* graphics, Deserializer& source);
@@ -22,15 +22,28 @@
 
 #include "../Precompiled.h"
 
+#include "../Core/StringUtils.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/Shader.h"
 #include "../Graphics/ShaderVariation.h"
+#include "../IO/FileSystem.h"
 
 #include "../DebugNew.h"
 
 namespace Urho3D
 {
 
+/// Add bytes to a 64-bit FNV-1a hash.
+static void HashBytes(unsigned long long& hash, const void* data, unsigned size)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
 ShaderParameter::ShaderParameter(const String& name, unsigned glType, int location) :   // NOLINT(hicpp-member-init)
     name_{name},
     glType_{glType},
@@ -77,4 +90,28 @@ Shader* ShaderVariation::GetOwner() const
     return owner_;
 }
 
+unsigned long long ShaderVariation::GetCacheKey(const String& sourceCode) const
+{
+    unsigned long long hash = 14695981039346656037ULL;
+
+    // Hash everything that affects the compiled output, so that stale bytecode is never found and no timestamps are needed
+    const String& apiName = graphics_ ? graphics_->GetApiName() : String::EMPTY;
+    unsigned type = type_;
+    unsigned maxBones = Graphics::GetMaxBones();
+    HashBytes(hash, apiName.CString(), apiName.Length());
+    HashBytes(hash, &type, sizeof type);
+    HashBytes(hash, &maxBones, sizeof maxBones);
+    HashBytes(hash, defines_.CString(), defines_.Length() + 1);
+    HashBytes(hash, sourceCode.CString(), sourceCode.Length());
+    return hash;
+}
+
+String ShaderVariation::GetCacheFileName(const String& sourceCode, const String& extension) const
+{
+    String path, name, ext;
+    SplitPath(owner_->GetName(), path, name, ext);
+
+    return graphics_->GetShaderCacheDir() + name + "_" + ToString("%016llx", GetCacheKey(sourceCode)) + extension;
+}
+
 }
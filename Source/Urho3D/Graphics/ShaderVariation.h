@@ -93,10 +93,16 @@ public:
 
     /// Compile the shader. Return true if successful.
     bool Create();
+    /// Load the bytecode from the shader cache, or compile it from the source code and store it in the cache, without creating the GPU object. Can be called from a worker thread while the variation is released and not in use. Return true if successful, or false with the error written to compilerOutput. No-op on OpenGL.
+    bool CompileByteCode(const String& sourceCode, String& compilerOutput);
+    /// Create the GPU object from the compiled bytecode. Return true if successful.
+    bool CreateObject();
     /// Set name.
     void SetName(const String& name);
     /// Set defines.
     void SetDefines(const String& defines);
+    /// Set compile error/warning string. Used to store the result of a background compile.
+    void SetCompilerOutput(const String& output) { compilerOutput_ = output; }
 
     /// Return the owner resource.
     Shader* GetOwner() const;
@@ -131,26 +137,37 @@ public:
     /// Return compile error/warning string.
     const String& GetCompilerOutput() const { return compilerOutput_; }
 
+    /// Return whether the bytecode was loaded from the shader cache instead of compiling.
+    bool IsLoadedFromCache() const { return loadedFromCache_; }
+
+    /// Return the shader cache key, which hashes the source code, defines and compile options.
+    unsigned long long GetCacheKey(const String& sourceCode) const;
+
     /// Return constant buffer data sizes.
     const unsigned* GetConstantBufferSizes() const { return &constantBufferSizes_[0]; }
 
     /// Return defines with the CLIPPLANE define appended. Used internally on Direct3D11 only, will be empty on other APIs.
     const String& GetDefinesClipPlane() { return definesClipPlane_; }
 
+    /// Return whether shaders are compiled to bytecode that can be cached and compiled on worker threads. False on OpenGL.
+    static bool GetByteCodeSupport();
+
     /// D3D11 vertex semantic names. Used internally.
     static const char* elementSemanticNames[];
 
 private:
     /// Load bytecode from a file. Return true if successful.
     bool LoadByteCode(const String& binaryShaderName);
-    /// Compile from source. Return true if successful.
-    bool Compile();
+    /// Compile from source. Return true if successful, or false with the error written to compilerOutput.
+    bool Compile(const String& sourceCode, String& compilerOutput);
     /// Inspect the constant parameters and input layout (if applicable) from the shader bytecode.
     void ParseParameters(unsigned char* bufData, unsigned bufSize);
     /// Save bytecode to a file.
     void SaveByteCode(const String& binaryShaderName);
     /// Calculate constant buffer sizes from parameters.
     void CalculateConstantBufferSizes();
+    /// Return the bytecode file name in the shader cache directory.
+    String GetCacheFileName(const String& sourceCode, const String& extension) const;
 
     /// Shader this variation belongs to.
     WeakPtr<Shader> owner_;
@@ -174,6 +191,8 @@ private:
     String definesClipPlane_;
     /// Shader compile error string.
     String compilerOutput_;
+    /// Bytecode loaded from the shader cache flag.
+    bool loadedFromCache_{};
 };
 
 }
@@ -77,6 +77,17 @@ struct Bone
     WeakPtr<Node> node_;
 };
 
+/// Local transform of a bone in an animated model's pose buffer.
+struct BonePose
+{
+    /// Position.
+    Vector3 position_;
+    /// Rotation.
+    Quaternion rotation_;
+    /// Scale.
+    Vector3 scale_{Vector3::ONE};
+};
+
 /// Hierarchical collection of bones.
 class URHO3D_API Skeleton
 {
@@ -0,0 +1,624 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Core/Profiler.h"
+#include "../Core/Timer.h"
+#include "../Core/WorkQueue.h"
+#include "../Graphics/Drawable.h"
+#include "../Graphics/StaticBVH.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Ranges of at most this many drawables always become leaves.
+static const unsigned MIN_STATIC_BVH_SPLIT = 4;
+/// Ranges of more than this many drawables are always split.
+static const unsigned MAX_STATIC_BVH_LEAF = 16;
+/// Number of bins for evaluating the surface area heuristic.
+static const unsigned NUM_STATIC_BVH_BINS = 16;
+/// Minimum number of drawables added, moved or removed since the last build to start a rebuild.
+static const unsigned MIN_STATIC_BVH_REBUILD_CHANGES = 64;
+/// Fraction (as a divisor) of the built drawables that must have changed to start a rebuild.
+static const unsigned STATIC_BVH_REBUILD_DIVISOR = 8;
+
+void BuildStaticBVHWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* bvh = reinterpret_cast<StaticBVH*>(item->aux_);
+    bvh->BuildSnapshot();
+}
+
+static inline float GetSurfaceArea(const BoundingBox& box)
+{
+    Vector3 size = box.Size();
+    return size.x_ * size.y_ + size.y_ * size.z_ + size.z_ * size.x_;
+}
+
+static inline Vector3 GetCenter(const BoundingBox& box)
+{
+    return box.Defined() ? box.Center() : Vector3::ZERO;
+}
+
+StaticBVH::StaticBVH(Context* context) :
+    Object(context),
+    buildSnapshotSize_(0),
+    numBuiltDrawables_(0),
+    numDrawables_(0),
+    numBuiltRemoved_(0),
+    numUnbuiltRemoved_(0),
+    numMoved_(0),
+    refitNeeded_(false)
+{
+}
+
+StaticBVH::~StaticBVH()
+{
+    CancelBuild();
+}
+
+void StaticBVH::AddDrawable(Drawable* drawable)
+{
+    drawable->inStaticBVH_ = true;
+    drawable->octantIndex_ = drawables_.Size();
+    drawables_.Push(drawable);
+    data_.Push(drawable);
+    ++numDrawables_;
+}
+
+void StaticBVH::RemoveDrawable(Drawable* drawable)
+{
+    unsigned index = drawable->octantIndex_;
+    if (index >= drawables_.Size() || drawables_[index] != drawable)
+        return;
+
+    // Leave a null slot so that the leaf ranges and a pending build snapshot stay valid
+    drawables_[index] = nullptr;
+    data_.InvalidateBox(index);
+    drawable->inStaticBVH_ = false;
+    --numDrawables_;
+
+    if (index < numBuiltDrawables_)
+        ++numBuiltRemoved_;
+    else
+        ++numUnbuiltRemoved_;
+}
+
+void StaticBVH::UpdateDrawable(Drawable* drawable)
+{
+    unsigned index = drawable->octantIndex_;
+    data_.SetBox(index, drawable->GetWorldBoundingBox());
+
+    if (index < numBuiltDrawables_)
+    {
+        refitNeeded_ = true;
+        ++numMoved_;
+    }
+}
+
+void StaticBVH::InvalidateDrawableBox(Drawable* drawable)
+{
+    unsigned index = drawable->octantIndex_;
+    if (index < data_.Size())
+        data_.InvalidateBox(index);
+}
+
+void StaticBVH::UpdateDrawableViewMask(Drawable* drawable)
+{
+    unsigned index = drawable->octantIndex_;
+    if (index < data_.Size())
+        data_.viewMasks_[index] = drawable->GetViewMask();
+}
+
+void StaticBVH::RemoveAllDrawables()
+{
+    CancelBuild();
+
+    for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+    {
+        Drawable* drawable = *i;
+        if (drawable)
+        {
+            drawable->SetOctant(nullptr);
+            drawable->inStaticBVH_ = false;
+        }
+    }
+
+    drawables_.Clear();
+    data_.Clear();
+    nodes_.Clear();
+    numBuiltDrawables_ = 0;
+    numDrawables_ = 0;
+    numBuiltRemoved_ = 0;
+    numUnbuiltRemoved_ = 0;
+    numMoved_ = 0;
+    refitNeeded_ = false;
+}
+
+void StaticBVH::Update()
+{
+    if (buildItem_ && buildItem_->completed_)
+        FinishBuild();
+
+    if (!buildItem_)
+    {
+        unsigned numChanges = numBuiltRemoved_ + drawables_.Size() - numBuiltDrawables_ + numMoved_;
+        if (numChanges >= Max(MIN_STATIC_BVH_REBUILD_CHANGES, numBuiltDrawables_ / STATIC_BVH_REBUILD_DIVISOR))
+            StartBuild();
+    }
+
+    if (refitNeeded_)
+    {
+        URHO3D_PROFILE(RefitStaticBVH);
+        Refit();
+    }
+}
+
+void StaticBVH::Rebuild()
+{
+    URHO3D_PROFILE(BuildStaticBVH);
+
+    CancelBuild();
+    TakeSnapshot();
+    BuildSnapshot();
+    FinishBuild();
+}
+
+void StaticBVH::GetDrawables(OctreeQuery& query) const
+{
+    if (!nodes_.Empty())
+        GetDrawablesInternal(query, 0, false);
+    if (numBuiltDrawables_ < drawables_.Size())
+        TestDrawables(query, numBuiltDrawables_, drawables_.Size(), false);
+}
+
+void StaticBVH::Raycast(RayOctreeQuery& query) const
+{
+    if (!nodes_.Empty())
+        RaycastInternal(query, 0);
+    if (numBuiltDrawables_ < drawables_.Size())
+        RaycastInternal(query, numBuiltDrawables_, drawables_.Size());
+}
+
+void StaticBVH::GetDrawables(MultiFrustumOctreeQuery& query) const
+{
+    if (!nodes_.Empty())
+        GetDrawablesInternal(query, 0, query.GetFrustumMask(), 0);
+    if (numBuiltDrawables_ < drawables_.Size())
+        TestDrawables(query, numBuiltDrawables_, drawables_.Size(), query.GetFrustumMask(), 0);
+}
+
+void StaticBVH::GetDrawablesOnly(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const
+{
+    if (!nodes_.Empty())
+        GetDrawablesOnlyInternal(query, 0, drawables);
+    if (numBuiltDrawables_ < drawables_.Size())
+        GetDrawablesOnlyInternal(query, numBuiltDrawables_, drawables_.Size(), drawables);
+}
+
+void StaticBVH::TakeSnapshot()
+{
+    buildSnapshotSize_ = drawables_.Size();
+    buildBoxes_.Resize(buildSnapshotSize_);
+    buildIndices_.Clear();
+    buildIndices_.Reserve(numDrawables_);
+
+    for (unsigned i = 0; i < buildSnapshotSize_; ++i)
+    {
+        Drawable* drawable = drawables_[i];
+        if (drawable)
+        {
+            buildBoxes_[i] = data_.GetBox(i, drawable);
+            buildIndices_.Push(i);
+        }
+    }
+
+    numMoved_ = 0;
+}
+
+void StaticBVH::StartBuild()
+{
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (!queue)
+    {
+        Rebuild();
+        return;
+    }
+
+    TakeSnapshot();
+
+    // Use a low priority, so that the build is not waited for when the frame's work is completed
+    buildItem_ = new WorkItem();
+    buildItem_->workFunction_ = BuildStaticBVHWork;
+    buildItem_->aux_ = this;
+    buildItem_->priority_ = 0;
+    queue->AddWorkItem(buildItem_);
+}
+
+void StaticBVH::BuildSnapshot()
+{
+    buildNodes_.Clear();
+    if (!buildIndices_.Empty())
+    {
+        buildNodes_.Reserve(2 * buildIndices_.Size() / MIN_STATIC_BVH_SPLIT + 1);
+        BuildNode(0, buildIndices_.Size());
+    }
+}
+
+unsigned StaticBVH::BuildNode(unsigned start, unsigned end)
+{
+    unsigned nodeIndex = buildNodes_.Size();
+    buildNodes_.Resize(nodeIndex + 1);
+
+    BoundingBox box;
+    BoundingBox centerBox;
+    for (unsigned i = start; i < end; ++i)
+    {
+        const BoundingBox& drawableBox = buildBoxes_[buildIndices_[i]];
+        box.Merge(drawableBox);
+        centerBox.Merge(GetCenter(drawableBox));
+    }
+
+    StaticBVHNode node;
+    node.box_ = box;
+    node.start_ = start;
+    node.count_ = end - start;
+    node.right_ = 0;
+
+    unsigned split = SplitNode(start, end, box, centerBox);
+    if (split != start)
+    {
+        // The left child is built directly after this node, so only the right child index needs to be stored
+        BuildNode(start, split);
+        node.start_ = 0;
+        node.count_ = 0;
+        node.right_ = BuildNode(split, end);
+    }
+
+    buildNodes_[nodeIndex] = node;
+    return nodeIndex;
+}
+
+unsigned StaticBVH::SplitNode(unsigned start, unsigned end, const BoundingBox& box, const BoundingBox& centerBox)
+{
+    unsigned count = end - start;
+    if (count <= MIN_STATIC_BVH_SPLIT)
+        return start;
+
+    Vector3 centerSize = centerBox.Size();
+    unsigned axis = 0;
+    if (centerSize.y_ > centerSize.Data()[axis])
+        axis = 1;
+    if (centerSize.z_ > centerSize.Data()[axis])
+        axis = 2;
+
+    float axisMin = centerBox.min_.Data()[axis];
+    float axisSize = centerSize.Data()[axis];
+    if (axisSize <= M_EPSILON)
+    {
+        // All centers coincide, so the heuristic can not separate the drawables. Split in the middle if too many
+        return count > MAX_STATIC_BVH_LEAF ? start + count / 2 : start;
+    }
+
+    // Bin the drawables by their centers along the longest axis
+    BoundingBox binBoxes[NUM_STATIC_BVH_BINS];
+    unsigned binCounts[NUM_STATIC_BVH_BINS] = {};
+    float binScale = (float)NUM_STATIC_BVH_BINS / axisSize;
+    for (unsigned i = start; i < end; ++i)
+    {
+        const BoundingBox& drawableBox = buildBoxes_[buildIndices_[i]];
+        auto bin = (unsigned)((GetCenter(drawableBox).Data()[axis] - axisMin) * binScale);
+        bin = Min(bin, NUM_STATIC_BVH_BINS - 1);
+        binBoxes[bin].Merge(drawableBox);
+        ++binCounts[bin];
+    }
+
+    // Sweep from the right to get the cost of the right side of each split, then from the left to find the cheapest split
+    float rightCosts[NUM_STATIC_BVH_BINS];
+    BoundingBox rightBox;
+    unsigned rightCount = 0;
+    for (unsigned i = NUM_STATIC_BVH_BINS - 1; i > 0; --i)
+    {
+        rightBox.Merge(binBoxes[i]);
+        rightCount += binCounts[i];
+        rightCosts[i - 1] = rightCount ? GetSurfaceArea(rightBox) * rightCount : 0.0f;
+    }
+
+    BoundingBox leftBox;
+    unsigned leftCount = 0;
+    unsigned bestBin = NUM_STATIC_BVH_BINS;
+    float bestCost = M_INFINITY;
+    for (unsigned i = 0; i < NUM_STATIC_BVH_BINS - 1; ++i)
+    {
+        leftBox.Merge(binBoxes[i]);
+        leftCount += binCounts[i];
+        if (!leftCount || leftCount == count)
+            continue;
+
+        float cost = GetSurfaceArea(leftBox) * leftCount + rightCosts[i];
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestBin = i;
+        }
+    }
+
+    if (bestBin == NUM_STATIC_BVH_BINS || (bestCost >= GetSurfaceArea(box) * count && count <= MAX_STATIC_BVH_LEAF))
+        return start;
+
+    // Partition so that the drawables in bins up to the best split come first
+    unsigned left = start;
+    unsigned right = end;
+    while (left < right)
+    {
+        auto bin = (unsigned)((GetCenter(buildBoxes_[buildIndices_[left]]).Data()[axis] - axisMin) * binScale);
+        if (Min(bin, NUM_STATIC_BVH_BINS - 1) <= bestBin)
+            ++left;
+        else
+            Swap(buildIndices_[left], buildIndices_[--right]);
+    }
+
+    return left;
+}
+
+void StaticBVH::FinishBuild()
+{
+    URHO3D_PROFILE(FinishStaticBVHBuild);
+
+    // Reorder the drawables into leaf order. Drawables removed since the snapshot remain as null slots, and drawables
+    // added since the snapshot follow the built part
+    PODVector<Drawable*> drawables;
+    DrawableQueryData data;
+    drawables.Reserve(buildIndices_.Size() + drawables_.Size() - buildSnapshotSize_);
+    data.Reserve(drawables.Capacity());
+
+    numBuiltRemoved_ = 0;
+    for (PODVector<unsigned>::ConstIterator i = buildIndices_.Begin(); i != buildIndices_.End(); ++i)
+    {
+        Drawable* drawable = drawables_[*i];
+        if (!drawable)
+            ++numBuiltRemoved_;
+        drawables.Push(drawable);
+        data.Push(data_, *i);
+    }
+    numBuiltDrawables_ = drawables.Size();
+
+    for (unsigned i = buildSnapshotSize_; i < drawables_.Size(); ++i)
+    {
+        if (drawables_[i])
+        {
+            drawables.Push(drawables_[i]);
+            data.Push(data_, i);
+        }
+    }
+    numUnbuiltRemoved_ = 0;
+
+    drawables_.Swap(drawables);
+    data_.Swap(data);
+    nodes_.Swap(buildNodes_);
+    for (unsigned i = 0; i < drawables_.Size(); ++i)
+    {
+        if (drawables_[i])
+            drawables_[i]->octantIndex_ = i;
+    }
+
+    buildItem_.Reset();
+    buildIndices_.Clear();
+    buildBoxes_.Clear();
+    buildNodes_.Clear();
+    buildSnapshotSize_ = 0;
+
+    // Drawables may have moved while building
+    refitNeeded_ = true;
+}
+
+void StaticBVH::CancelBuild()
+{
+    if (!buildItem_)
+        return;
+
+    if (!buildItem_->completed_)
+    {
+        auto* queue = GetSubsystem<WorkQueue>();
+        if (queue && !queue->RemoveWorkItem(buildItem_))
+        {
+            while (!buildItem_->completed_)
+                Time::Sleep(0);
+        }
+    }
+
+    buildItem_.Reset();
+    buildIndices_.Clear();
+    buildBoxes_.Clear();
+    buildNodes_.Clear();
+    buildSnapshotSize_ = 0;
+}
+
+void StaticBVH::Refit()
+{
+    // Children always follow their parent, so a reverse pass visits the children first
+    for (unsigned i = nodes_.Size(); i-- > 0;)
+    {
+        StaticBVHNode& node = nodes_[i];
+        node.box_.Clear();
+
+        if (node.count_)
+        {
+            for (unsigned j = node.start_; j < node.start_ + node.count_; ++j)
+                node.box_.Merge(data_.GetBox(j));
+        }
+        else
+        {
+            node.box_.Merge(nodes_[i + 1].box_);
+            node.box_.Merge(nodes_[node.right_].box_);
+        }
+    }
+
+    refitNeeded_ = false;
+}
+
+void StaticBVH::TestDrawables(OctreeQuery& query, unsigned start, unsigned end, bool inside) const
+{
+    // Pass on each run of drawables between removed slots
+    while (start < end)
+    {
+        while (start < end && !drawables_[start])
+            ++start;
+        unsigned runEnd = start;
+        while (runEnd < end && drawables_[runEnd])
+            ++runEnd;
+
+        if (runEnd > start)
+        {
+            auto** runStart = const_cast<Drawable**>(&drawables_[start]);
+            query.TestCachedDrawables(runStart, runStart + (runEnd - start), data_, start, inside);
+        }
+        start = runEnd;
+    }
+}
+
+void StaticBVH::GetDrawablesInternal(OctreeQuery& query, unsigned nodeIndex, bool inside) const
+{
+    const StaticBVHNode& node = nodes_[nodeIndex];
+    if (!node.box_.Defined())
+        return;
+
+    Intersection res = query.TestOctant(node.box_, inside);
+    if (res == INSIDE)
+        inside = true;
+    else if (res == OUTSIDE)
+        return;
+
+    if (node.count_)
+        TestDrawables(query, node.start_, node.start_ + node.count_, inside);
+    else
+    {
+        GetDrawablesInternal(query, nodeIndex + 1, inside);
+        GetDrawablesInternal(query, node.right_, inside);
+    }
+}
+
+void StaticBVH::RaycastInternal(RayOctreeQuery& query, unsigned start, unsigned end) const
+{
+    for (unsigned i = start; i < end; ++i)
+    {
+        Drawable* drawable = drawables_[i];
+        if (drawable && (data_.drawableFlags_[i] & query.drawableFlags_) && (data_.viewMasks_[i] & query.viewMask_))
+        {
+            if (!data_.IsBoxDefined(i) || query.ray_.HitDistance(data_.GetBox(i)) < query.maxDistance_)
+                drawable->ProcessRayQuery(query, query.result_);
+        }
+    }
+}
+
+void StaticBVH::RaycastInternal(RayOctreeQuery& query, unsigned nodeIndex) const
+{
+    const StaticBVHNode& node = nodes_[nodeIndex];
+    if (!node.box_.Defined() || query.ray_.HitDistance(node.box_) >= query.maxDistance_)
+        return;
+
+    if (node.count_)
+        RaycastInternal(query, node.start_, node.start_ + node.count_);
+    else
+    {
+        RaycastInternal(query, nodeIndex + 1);
+        RaycastInternal(query, node.right_);
+    }
+}
+
+void StaticBVH::TestDrawables(MultiFrustumOctreeQuery& query, unsigned start, unsigned end, unsigned activeMask,
+    unsigned insideMask) const
+{
+    while (start < end)
+    {
+        while (start < end && !drawables_[start])
+            ++start;
+        unsigned runEnd = start;
+        while (runEnd < end && drawables_[runEnd])
+            ++runEnd;
+
+        if (runEnd > start)
+        {
+            auto** runStart = const_cast<Drawable**>(&drawables_[start]);
+            query.TestDrawables(runStart, runStart + (runEnd - start), data_, start, activeMask, insideMask);
+        }
+        start = runEnd;
+    }
+}
+
+void StaticBVH::GetDrawablesInternal(MultiFrustumOctreeQuery& query, unsigned nodeIndex, unsigned activeMask,
+    unsigned insideMask) const
+{
+    const StaticBVHNode& node = nodes_[nodeIndex];
+    if (!node.box_.Defined())
+        return;
+
+    unsigned testMask = activeMask & ~insideMask;
+    if (testMask)
+    {
+        activeMask &= ~query.TestBox(node.box_, testMask, insideMask);
+        if (!activeMask)
+            return;
+    }
+
+    if (node.count_)
+        TestDrawables(query, node.start_, node.start_ + node.count_, activeMask, insideMask);
+    else
+    {
+        GetDrawablesInternal(query, nodeIndex + 1, activeMask, insideMask);
+        GetDrawablesInternal(query, node.right_, activeMask, insideMask);
+    }
+}
+
+void StaticBVH::GetDrawablesOnlyInternal(RayOctreeQuery& query, unsigned start, unsigned end,
+    PODVector<Drawable*>& drawables) const
+{
+    for (unsigned i = start; i < end; ++i)
+    {
+        Drawable* drawable = drawables_[i];
+        if (drawable && (data_.drawableFlags_[i] & query.drawableFlags_) && (data_.viewMasks_[i] & query.viewMask_))
+        {
+            if (!data_.IsBoxDefined(i) || query.ray_.HitDistance(data_.GetBox(i)) < query.maxDistance_)
+                drawables.Push(drawable);
+        }
+    }
+}
+
+void StaticBVH::GetDrawablesOnlyInternal(RayOctreeQuery& query, unsigned nodeIndex, PODVector<Drawable*>& drawables) const
+{
+    const StaticBVHNode& node = nodes_[nodeIndex];
+    if (!node.box_.Defined() || query.ray_.HitDistance(node.box_) >= query.maxDistance_)
+        return;
+
+    if (node.count_)
+        GetDrawablesOnlyInternal(query, node.start_, node.start_ + node.count_, drawables);
+    else
+    {
+        GetDrawablesOnlyInternal(query, nodeIndex + 1, drawables);
+        GetDrawablesOnlyInternal(query, node.right_, drawables);
+    }
+}
+
+}
@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Core/Object.h"
+#include "../Graphics/OctreeQuery.h"
+
+namespace Urho3D
+{
+
+class Drawable;
+struct WorkItem;
+
+/// Node of a static drawable bounding volume hierarchy.
+struct StaticBVHNode
+{
+    /// Bounding box of the drawables below the node.
+    BoundingBox box_;
+    /// Index of the first drawable of a leaf node.
+    unsigned start_;
+    /// Number of drawables of a leaf node, zero for an interior node.
+    unsigned count_;
+    /// Index of the right child of an interior node. The left child directly follows its parent.
+    unsigned right_;
+};
+
+/// Bounding volume hierarchy of static drawable objects, built using the surface area heuristic. Owned by the octree, which queries it alongside its octants. Drawables added, moved or removed after a build are handled incrementally, and the hierarchy is rebuilt in a background work item once enough of them have accumulated.
+class URHO3D_API StaticBVH : public Object
+{
+    URHO3D_OBJECT(StaticBVH, Object);
+
+    friend void BuildStaticBVHWork(const WorkItem* item, unsigned threadIndex);
+
+public:
+    /// Construct.
+    explicit StaticBVH(Context* context);
+    /// Destruct. Wait for a background build to finish.
+    ~StaticBVH() override;
+
+    /// Add a drawable object.
+    void AddDrawable(Drawable* drawable);
+    /// Remove a drawable object.
+    void RemoveDrawable(Drawable* drawable);
+    /// Store the current world bounding box of a moved drawable object.
+    void UpdateDrawable(Drawable* drawable);
+    /// Invalidate the stored world bounding box of a drawable object, so that queries read it from the drawable until it is updated.
+    void InvalidateDrawableBox(Drawable* drawable);
+    /// Store the current view mask of a drawable object.
+    void UpdateDrawableViewMask(Drawable* drawable);
+    /// Remove and detach all drawable objects. Called when the octree is destroyed.
+    void RemoveAllDrawables();
+    /// Apply a finished background build, start a new one if enough static content has changed, and refit the node bounding boxes of moved drawables. Called by the octree update.
+    void Update();
+    /// Rebuild immediately in the calling thread, for example after loading a scene.
+    void Rebuild();
+
+    /// Return drawable objects by a query.
+    void GetDrawables(OctreeQuery& query) const;
+    /// Return drawable objects by a multiple frustum query.
+    void GetDrawables(MultiFrustumOctreeQuery& query) const;
+    /// Return drawable objects by a ray query.
+    void Raycast(RayOctreeQuery& query) const;
+    /// Return drawable objects only for a ray query that is processed by the caller.
+    void GetDrawablesOnly(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const;
+
+    /// Return number of drawable objects.
+    unsigned GetNumDrawables() const { return numDrawables_; }
+
+    /// Return number of hierarchy nodes.
+    unsigned GetNumNodes() const { return nodes_.Size(); }
+
+    /// Return number of drawable objects that were added after the last build and are tested without the hierarchy.
+    unsigned GetNumUnbuiltDrawables() const { return drawables_.Size() - numBuiltDrawables_ - numUnbuiltRemoved_; }
+
+    /// Return whether a background build is in progress.
+    bool IsBuilding() const { return buildItem_.NotNull(); }
+
+private:
+    /// Take a snapshot of the drawable bounding boxes for a build.
+    void TakeSnapshot();
+    /// Start a background build from a new snapshot.
+    void StartBuild();
+    /// Build the hierarchy from the snapshot. Called from a worker thread when building in the background.
+    void BuildSnapshot();
+    /// Build the hierarchy for a range of the snapshot recursively. Return the node index.
+    unsigned BuildNode(unsigned start, unsigned end);
+    /// Choose the split position for a range of the snapshot and partition it. Return the start if the range should be a leaf.
+    unsigned SplitNode(unsigned start, unsigned end, const BoundingBox& box, const BoundingBox& centerBox);
+    /// Replace the hierarchy and the drawable order with the finished build.
+    void FinishBuild();
+    /// Cancel a background build, or wait for it to finish if it has already started.
+    void CancelBuild();
+    /// Recalculate the node bounding boxes from the drawable bounding boxes.
+    void Refit();
+    /// Test a range of drawable objects against a query, skipping removed ones.
+    void TestDrawables(OctreeQuery& query, unsigned start, unsigned end, bool inside) const;
+    /// Return drawable objects by a query, called internally.
+    void GetDrawablesInternal(OctreeQuery& query, unsigned nodeIndex, bool inside) const;
+    /// Test a range of drawable objects against a multiple frustum query, skipping removed ones.
+    void TestDrawables(MultiFrustumOctreeQuery& query, unsigned start, unsigned end, unsigned activeMask, unsigned insideMask) const;
+    /// Return drawable objects by a multiple frustum query, called internally.
+    void GetDrawablesInternal(MultiFrustumOctreeQuery& query, unsigned nodeIndex, unsigned activeMask, unsigned insideMask) const;
+    /// Return drawable objects by a ray query, called internally.
+    void RaycastInternal(RayOctreeQuery& query, unsigned start, unsigned end) const;
+    /// Return drawable objects by a ray query, called internally.
+    void RaycastInternal(RayOctreeQuery& query, unsigned nodeIndex) const;
+    /// Return drawable objects only for a ray query, called internally.
+    void GetDrawablesOnlyInternal(RayOctreeQuery& query, unsigned start, unsigned end, PODVector<Drawable*>& drawables) const;
+    /// Return drawable objects only for a ray query, called internally.
+    void GetDrawablesOnlyInternal(RayOctreeQuery& query, unsigned nodeIndex, PODVector<Drawable*>& drawables) const;
+
+    /// Drawable objects, ordered by leaf for the part covered by the hierarchy and followed by drawables added after the last build. Removed drawables leave null slots until the next build.
+    PODVector<Drawable*> drawables_;
+    /// Cached bounding boxes, flags and view masks of the drawable objects.
+    DrawableQueryData data_;
+    /// Hierarchy nodes in depth-first order.
+    PODVector<StaticBVHNode> nodes_;
+    /// Background build work item.
+    SharedPtr<WorkItem> buildItem_;
+    /// Drawable indices of the build snapshot, reordered into leaf order by the build.
+    PODVector<unsigned> buildIndices_;
+    /// Drawable bounding boxes of the build snapshot.
+    PODVector<BoundingBox> buildBoxes_;
+    /// Hierarchy nodes produced by the build.
+    PODVector<StaticBVHNode> buildNodes_;
+    /// Number of drawable slots when the build snapshot was taken.
+    unsigned buildSnapshotSize_;
+    /// Number of drawable slots covered by the hierarchy.
+    unsigned numBuiltDrawables_;
+    /// Number of drawable objects.
+    unsigned numDrawables_;
+    /// Number of removed drawable slots covered by the hierarchy.
+    unsigned numBuiltRemoved_;
+    /// Number of removed drawable slots after the part covered by the hierarchy.
+    unsigned numUnbuiltRemoved_;
+    /// Number of drawable objects moved since the last build snapshot.
+    unsigned numMoved_;
+    /// Node bounding boxes need recalculation flag.
+    bool refitNeeded_;
+};
+
+}
@@ -60,6 +60,8 @@ public:
     bool SetData(const void* data);
     /// Set a data range in the buffer. Optionally discard data outside the range.
     bool SetDataRange(const void* data, unsigned start, unsigned count, bool discard = false);
+    /// Set a data range in a dynamic buffer without waiting for the GPU. The range must not be used by pending draws, for example because it has not been written since the buffer was last discarded. Same as SetDataRange() on OpenGL.
+    bool SetDataRangeNoOverwrite(const void* data, unsigned start, unsigned count);
     /// Lock the buffer for write-only editing. Return data pointer if successful. Optionally discard data outside the range.
     void* Lock(unsigned start, unsigned count, bool discard = false);
     /// Unlock the buffer and apply changes to the GPU buffer.
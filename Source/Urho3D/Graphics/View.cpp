@@ -55,6 +55,94 @@
 namespace Urho3D
 {
 
+/// Relative tolerance for the coherent culling margins, scaled by the octree's largest coordinate.
+static const float COHERENT_CULL_TOLERANCE = 0.00001f;
+/// Minimum number of instances per work item when writing instancing data in worker threads.
+static const unsigned MIN_INSTANCES_PER_WORK_ITEM = 256;
+
+/// Next owner identifier for octant culling results cached by coherent culling.
+static unsigned nextCullCacheOwner = 1;
+
+/// Test a bounding box against a frustum like Frustum::IsInside(), and return how far the frustum planes can move within the box before the result may change.
+static Intersection TestFrustumMargin(const Frustum& frustum, const BoundingBox& box, float& margin)
+{
+    Vector3 center = box.Center();
+    Vector3 edge = center - box.min_;
+    float insideMargin = M_INFINITY;
+    float outsideMargin = 0.0f;
+    bool allInside = true;
+
+    for (const auto& plane : frustum.planes_)
+    {
+        float dist = plane.normal_.DotProduct(center) + plane.d_;
+        float absDist = plane.absNormal_.DotProduct(edge);
+
+        if (dist < -absDist)
+            outsideMargin = Max(outsideMargin, -absDist - dist);
+        else if (dist < absDist)
+            allInside = false;
+        else
+            insideMargin = Min(insideMargin, dist - absDist);
+    }
+
+    if (outsideMargin > 0.0f)
+    {
+        margin = outsideMargin;
+        return OUTSIDE;
+    }
+    else if (!allInside)
+    {
+        margin = 0.0f;
+        return INTERSECTS;
+    }
+    else
+    {
+        margin = insideMargin;
+        return INSIDE;
+    }
+}
+
+/// Return an upper bound for how far any plane of a frustum has moved within a bounding box compared to a previous frustum.
+static float GetFrustumDelta(const Frustum& previous, const Frustum& current, const BoundingBox& box)
+{
+    Vector3 center = box.Center();
+    Vector3 edge = center - box.min_;
+    float delta = 0.0f;
+
+    for (unsigned i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        Vector3 normalDelta = current.planes_[i].normal_ - previous.planes_[i].normal_;
+        float distDelta = current.planes_[i].d_ - previous.planes_[i].d_;
+        delta = Max(delta, Abs(normalDelta.DotProduct(center) + distDelta) + normalDelta.Abs().DotProduct(edge));
+    }
+
+    return delta;
+}
+
+/// Scramble a 64-bit value so that a sum of scrambled values does not cancel out when the inputs change together.
+static unsigned long long MixShadowCasterHash(unsigned long long value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+/// Return the hash of a shadow caster and the geometries and materials of its batches.
+static unsigned long long GetShadowCasterHash(Drawable* drawable)
+{
+    unsigned long long hash = MixShadowCasterHash((unsigned long long)(size_t)drawable);
+    const Vector<SourceBatch>& batches = drawable->GetBatches();
+    for (Vector<SourceBatch>::ConstIterator i = batches.Begin(); i != batches.End(); ++i)
+    {
+        hash = MixShadowCasterHash(hash ^ (unsigned long long)(size_t)i->geometry_);
+        hash = MixShadowCasterHash(hash ^ (unsigned long long)(size_t)i->material_.Get());
+    }
+    return hash;
+}
+
 /// %Frustum octree query for shadowcasters.
 class ShadowCasterOctreeQuery : public FrustumOctreeQuery
 {
@@ -81,6 +169,20 @@ public:
             }
         }
     }
+
+    /// Intersection test for drawables using cached query data. The drawable is only read after the cached tests pass.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override
+    {
+        for (unsigned i = first; start != end; ++i)
+        {
+            Drawable* drawable = *start++;
+
+            if ((data.drawableFlags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_) &&
+                (inside || frustum_.IsInsideFast(data.GetBox(i, drawable))) && drawable->GetCastShadows())
+                result_.Push(drawable);
+        }
+    }
 };
 
 /// %Frustum octree query for zones and occluders.
@@ -110,6 +212,22 @@ public:
             }
         }
     }
+
+    /// Intersection test for drawables using cached query data. The drawable is only read after the cached tests pass.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override
+    {
+        for (unsigned i = first; start != end; ++i)
+        {
+            Drawable* drawable = *start++;
+            unsigned char flags = data.drawableFlags_[i];
+
+            if ((flags == DRAWABLE_ZONE || flags == DRAWABLE_GEOMETRY) && (data.viewMasks_[i] & viewMask_) &&
+                (inside || frustum_.IsInsideFast(data.GetBox(i, drawable))) &&
+                (flags == DRAWABLE_ZONE || drawable->IsOccluder()))
+                result_.Push(drawable);
+        }
+    }
 };
 
 /// %Frustum octree query with occlusion.
@@ -153,10 +271,125 @@ public:
         }
     }
 
+    /// Intersection test for drawables using cached query data.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override
+    {
+        for (unsigned i = first; start != end; ++i)
+        {
+            Drawable* drawable = *start++;
+
+            if ((data.drawableFlags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_))
+            {
+                if (inside || frustum_.IsInsideFast(data.GetBox(i, drawable)))
+                    result_.Push(drawable);
+            }
+        }
+    }
+
     /// Occlusion buffer.
     OcclusionBuffer* buffer_;
 };
 
+/// %Frustum octree query that reuses octant culling results from earlier frames while the frustum has not moved enough to change them. Optionally uses occlusion like OccludedFrustumOctreeQuery.
+class CoherentFrustumOctreeQuery : public FrustumOctreeQuery
+{
+public:
+    /// Construct with frustum, occlusion buffer, cache owner, accumulated frustum movement and query parameters.
+    CoherentFrustumOctreeQuery(PODVector<Drawable*>& result, const Frustum& frustum, OcclusionBuffer* buffer, unsigned owner,
+        double frustumDelta, float tolerance, unsigned char drawableFlags = DRAWABLE_ANY, unsigned viewMask = DEFAULT_VIEWMASK) :
+        FrustumOctreeQuery(result, frustum, drawableFlags, viewMask),
+        buffer_(buffer),
+        owner_(owner),
+        frustumDelta_(frustumDelta),
+        tolerance_(tolerance)
+    {
+    }
+
+    /// Intersection test for an octant.
+    Intersection TestOctant(const BoundingBox& box, bool inside) override
+    {
+        Intersection result = inside ? INSIDE : frustum_.IsInside(box);
+        if (buffer_ && result != OUTSIDE && !buffer_->IsVisible(box))
+            result = OUTSIDE;
+        return result;
+    }
+
+    /// Intersection test for an octant's culling box, reusing the cached result if still valid.
+    Intersection TestOctantCached(const Octant* octant, bool inside) override
+    {
+        const BoundingBox& box = octant->GetCullingBox();
+        Intersection result = INSIDE;
+
+        if (!inside)
+        {
+            OctantCullCache& cache = octant->GetCullCache();
+            if (cache.owner_ == owner_ && frustumDelta_ < cache.validUntil_)
+            {
+                result = cache.result_;
+                ++numReused_;
+            }
+            else
+            {
+                float margin;
+                result = TestFrustumMargin(frustum_, box, margin);
+                cache.owner_ = owner_;
+                cache.validUntil_ = frustumDelta_ + margin - tolerance_;
+                cache.result_ = result;
+                ++numTested_;
+            }
+        }
+
+        if (buffer_ && result != OUTSIDE && !buffer_->IsVisible(box))
+            result = OUTSIDE;
+        return result;
+    }
+
+    /// Intersection test for drawables. Note: drawable occlusion is performed later in worker threads.
+    void TestDrawables(Drawable** start, Drawable** end, bool inside) override
+    {
+        while (start != end)
+        {
+            Drawable* drawable = *start++;
+
+            if ((drawable->GetDrawableFlags() & drawableFlags_) && (drawable->GetViewMask() & viewMask_))
+            {
+                if (inside || frustum_.IsInsideFast(drawable->GetWorldBoundingBox()))
+                    result_.Push(drawable);
+            }
+        }
+    }
+
+    /// Intersection test for drawables using cached query data.
+    void TestCachedDrawables(Drawable** start, Drawable** end, const DrawableQueryData& data, unsigned first,
+        bool inside) override
+    {
+        for (unsigned i = first; start != end; ++i)
+        {
+            Drawable* drawable = *start++;
+
+            if ((data.drawableFlags_[i] & drawableFlags_) && (data.viewMasks_[i] & viewMask_))
+            {
+                if (inside || frustum_.IsInsideFast(data.GetBox(i, drawable)))
+                    result_.Push(drawable);
+            }
+        }
+    }
+
+    /// Occlusion buffer, or null if not used.
+    OcclusionBuffer* buffer_;
+    /// Owner identifier of the cached results.
+    unsigned owner_;
+    /// Accumulated frustum movement since the owner identifier was assigned.
+    double frustumDelta_;
+    /// Tolerance subtracted from the margins to cover floating point error.
+    float tolerance_;
+    /// Number of octants tested.
+    unsigned numTested_{};
+    /// Number of octant results reused.
+    unsigned numReused_{};
+};
+
 void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
 {
     auto* view = reinterpret_cast<View*>(item->aux_);
@@ -249,6 +482,18 @@ void UpdateDrawableGeometriesWork(const WorkItem* item, unsigned threadIndex)
     }
 }
 
+void WriteInstancingDataWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* buffer = reinterpret_cast<VertexBuffer*>(item->aux_);
+    auto** start = reinterpret_cast<BatchGroup**>(item->start_);
+    auto** end = reinterpret_cast<BatchGroup**>(item->end_);
+    unsigned char* data = buffer->GetShadowData();
+    unsigned stride = buffer->GetVertexSize();
+
+    while (start != end)
+        (*start++)->WriteInstancingData(data, stride);
+}
+
 void SortBatchQueueFrontToBackWork(const WorkItem* item, unsigned threadIndex)
 {
     auto* queue = reinterpret_cast<BatchQueue*>(item->start_);
@@ -277,6 +522,17 @@ void SortShadowQueueWork(const WorkItem* item, unsigned threadIndex)
         start->shadowSplits_[i].shadowBatches_.SortFrontToBack();
 }
 
+void RecordScenePassWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* view = reinterpret_cast<View*>(item->aux_);
+    auto* command = reinterpret_cast<const RenderPathCommand*>(item->start_);
+    auto* buffer = reinterpret_cast<RenderCommandBuffer*>(item->end_);
+    View* actualView = view->sourceView_ ? view->sourceView_ : view;
+
+    const BatchQueue& queue = actualView->batchQueues_.Find(command->passIndex_)->second_;
+    queue.Record(view, view->camera_, buffer, command->markToStencil_, false);
+}
+
 StringHash ParseTextureTypeXml(ResourceCache* cache, const String& filename);
 
 View::View(Context* context) :
@@ -342,6 +598,7 @@ bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
             deferred_ = sourceView_->deferred_;
             deferredAmbient_ = sourceView_->deferredAmbient_;
             useLitBase_ = sourceView_->useLitBase_;
+            clusteredLights_ = sourceView_->clusteredLights_;
             hasScenePasses_ = sourceView_->hasScenePasses_;
             noStencil_ = sourceView_->noStencil_;
             lightVolumeCommand_ = sourceView_->lightVolumeCommand_;
@@ -367,6 +624,7 @@ bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
     deferred_ = false;
     deferredAmbient_ = false;
     useLitBase_ = false;
+    clusteredLights_ = false;
     hasScenePasses_ = false;
     noStencil_ = false;
     lightVolumeCommand_ = nullptr;
@@ -374,6 +632,7 @@ bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
 
     scenePasses_.Clear();
     geometriesUpdated_ = false;
+    instancingPrepared_ = false;
 
 #ifdef URHO3D_OPENGL
 #ifdef GL_ES_VERSION_2_0
@@ -413,6 +672,7 @@ bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
             info.allowInstancing_ = command.sortMode_ != SORT_BACKTOFRONT;
             info.markToStencil_ = !noStencil_ && command.markToStencil_;
             info.vertexLights_ = command.vertexLights_;
+            info.clusteredLights_ = command.clusteredLights_;
 
             // Check scenepass metadata for defining custom passes which interact with lighting
             if (!command.metadata_.Empty())
@@ -492,9 +752,39 @@ bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
         }
     }
 
+    // Clustered lights are left out of the per-pixel light queues, so they can not be used with light volumes. Lit base
+    // batches would replace the clustered base pass, so disable them
+    if (!deferred_)
+    {
+        for (PODVector<ScenePassInfo>::Iterator i = scenePasses_.Begin(); i != scenePasses_.End(); ++i)
+        {
+            if (!i->clusteredLights_)
+                continue;
+
+            clusteredLights_ = true;
+            BatchQueue& queue = *i->batchQueue_;
+            if (!queue.psExtraDefines_.Contains("CLUSTERED"))
+            {
+                if (!queue.hasExtraDefines_)
+                {
+                    queue.vsExtraDefines_.Clear();
+                    queue.psExtraDefines_.Clear();
+                }
+                queue.vsExtraDefines_ = (queue.vsExtraDefines_ + " CLUSTERED").Trimmed();
+                queue.psExtraDefines_ = (queue.psExtraDefines_ + " CLUSTERED").Trimmed();
+                queue.vsExtraDefinesHash_ = StringHash(queue.vsExtraDefines_);
+                queue.psExtraDefinesHash_ = StringHash(queue.psExtraDefines_);
+                queue.hasExtraDefines_ = true;
+            }
+        }
+        if (clusteredLights_)
+            useLitBase_ = false;
+    }
+
     drawShadows_ = renderer_->GetDrawShadows();
     materialQuality_ = renderer_->GetMaterialQuality();
     maxOccluderTriangles_ = renderer_->GetMaxOccluderTriangles();
+    coherentCulling_ = renderer_->GetCoherentCulling();
     minInstances_ = renderer_->GetMinInstances();
 
     // Set possible quality overrides from the camera
@@ -536,9 +826,13 @@ void View::Update(const RenderFrameInfo& frame)
     renderTargets_.Clear();
     geometries_.Clear();
     lights_.Clear();
+    clusterLights_.Clear();
     zones_.Clear();
     occluders_.Clear();
     activeOccluders_ = 0;
+    numTestedOctants_ = 0;
+    numReusedOctants_ = 0;
+    cullingShared_ = false;
     vertexLightQueues_.Clear();
     for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
         i->second_.Clear(maxSortedInstances);
@@ -606,6 +900,19 @@ void View::Render()
 #endif
     }
 
+    // Assign the clustered lights with the render camera, whose projection may have been flipped above
+    if (clusteredLights_ && camera_)
+    {
+        if (!lightClusters_)
+            lightClusters_ = new LightClusters(context_);
+        View* actualView = sourceView_ ? sourceView_ : this;
+        lightClusters_->Assign(camera_, actualView->clusterLights_);
+        lightClusters_->UpdateTextures();
+    }
+
+    // Record scene passes in worker threads if enabled. The command buffers are replayed during the render path
+    RecordScenePasses();
+
     // Render
     ExecuteRenderPathCommands();
 
@@ -739,7 +1046,30 @@ void View::SetCameraShaderParameters(Camera* camera)
 
     // If in a scene pass and the command defines shader parameters, set them now
     if (passCommand_)
+    {
+        if (passCommand_->clusteredLights_ && lightClusters_)
+            graphics_->SetShaderParameter(PSP_CLUSTERPARAMS, lightClusters_->GetShaderParameters());
         SetCommandShaderParameters(*passCommand_);
+    }
+}
+
+void View::SetViewShaderParameters(Camera* camera)
+{
+    // Set global (per-frame) shader parameters
+    if (graphics_->NeedParameterUpdate(SP_FRAME, nullptr))
+        SetGlobalShaderParameters();
+
+    // Set camera & viewport shader parameters
+    auto cameraHash = (unsigned)(size_t)camera;
+    IntRect viewport = graphics_->GetViewport();
+    IntVector2 viewSize = IntVector2(viewport.Width(), viewport.Height());
+    auto viewportHash = (unsigned)viewSize.x_ | (unsigned)viewSize.y_ << 16u;
+    if (graphics_->NeedParameterUpdate(SP_CAMERA, reinterpret_cast<const void*>(cameraHash + viewportHash)))
+    {
+        SetCameraShaderParameters(camera);
+        // During renderpath commands the G-Buffer or viewport texture is assumed to always be viewport-sized
+        SetGBufferShaderParameters(viewSize, IntRect(0, 0, viewSize.x_, viewSize.y_));
+    }
 }
 
 void View::SetCommandShaderParameters(const RenderPathCommand& command)
@@ -781,7 +1111,23 @@ void View::GetDrawables()
     auto* queue = GetSubsystem<WorkQueue>();
     PODVector<Drawable*>& tempDrawables = tempDrawables_[0];
 
+    // If other views of the same scene are being updated this frame, the renderer may have culled them all in one pass
+    const PODVector<Drawable*>* sharedDrawables = renderer_->GetSharedCullDrawables(octree_, cullCamera_);
+    cullingShared_ = sharedDrawables != nullptr;
+
     // Get zones and occluders first
+    if (sharedDrawables)
+    {
+        tempDrawables.Clear();
+        for (PODVector<Drawable*>::ConstIterator i = sharedDrawables->Begin(); i != sharedDrawables->End(); ++i)
+        {
+            Drawable* drawable = *i;
+            unsigned char flags = drawable->GetDrawableFlags();
+            if (flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && drawable->IsOccluder()))
+                tempDrawables.Push(drawable);
+        }
+    }
+    else
     {
         ZoneOccluderOctreeQuery
             query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_ZONE, cullCamera_->GetViewMask());
@@ -851,8 +1197,44 @@ void View::GetDrawables()
     else
         occluders_.Clear();
 
-    // Get lights and geometries. Coarse occlusion for octants is used at this point
-    if (occlusionBuffer_)
+    // Get lights and geometries. Coarse occlusion for octants is used at this point, except with shared culling
+    if (sharedDrawables)
+    {
+        tempDrawables.Clear();
+        for (PODVector<Drawable*>::ConstIterator i = sharedDrawables->Begin(); i != sharedDrawables->End(); ++i)
+        {
+            if ((*i)->GetDrawableFlags() & (DRAWABLE_GEOMETRY | DRAWABLE_LIGHT))
+                tempDrawables.Push(*i);
+        }
+    }
+    else if (coherentCulling_)
+    {
+        const Frustum& frustum = cullCamera_->GetFrustum();
+        const BoundingBox& octreeBox = octree_->GetCullingBox();
+
+        // The frustum movement is bounded within the octree, so a different or resized octree needs new cached results
+        if (!cullCacheOwner_ || octree_ != lastCullOctree_ || octreeBox != lastCullOctreeBox_)
+        {
+            cullCacheOwner_ = nextCullCacheOwner++;
+            cullFrustumDelta_ = 0.0;
+            lastCullOctree_ = octree_;
+            lastCullOctreeBox_ = octreeBox;
+        }
+        else
+            cullFrustumDelta_ += GetFrustumDelta(lastCullFrustum_, frustum, octreeBox);
+        lastCullFrustum_ = frustum;
+
+        // Cover the floating point error of the plane distances, which grows with the coordinate magnitude
+        Vector3 extent = VectorMax(octreeBox.min_.Abs(), octreeBox.max_.Abs());
+        float tolerance = COHERENT_CULL_TOLERANCE * Max(Max(extent.x_, extent.y_), extent.z_);
+
+        CoherentFrustumOctreeQuery query(tempDrawables, frustum, occlusionBuffer_, cullCacheOwner_, cullFrustumDelta_, tolerance,
+            DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, cullCamera_->GetViewMask());
+        octree_->GetDrawables(query);
+        numTestedOctants_ = query.numTested_;
+        numReusedOctants_ = query.numReused_;
+    }
+    else if (occlusionBuffer_)
     {
         OccludedFrustumOctreeQuery query
             (tempDrawables, cullCamera_->GetFrustum(), occlusionBuffer_, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, cullCamera_->GetViewMask());
@@ -864,6 +1246,10 @@ void View::GetDrawables()
         octree_->GetDrawables(query);
     }
 
+    // Results cached while coherent culling was enabled become invalid as the frustum movement is no longer tracked
+    if (!coherentCulling_ || sharedDrawables)
+        cullCacheOwner_ = 0;
+
     // Check drawable occlusion, find zones for moved drawables and collect geometries & lights in worker threads
     {
         for (unsigned i = 0; i < sceneResults_.Size(); ++i)
@@ -941,6 +1327,23 @@ void View::GetDrawables()
     }
 
     Sort(lights_.Begin(), lights_.End(), CompareLights);
+
+    // Move unshadowed point and spot lights to the light clusters, keeping the sort order so that the most important ones
+    // are kept if clusters overflow
+    if (clusteredLights_)
+    {
+        unsigned numKept = 0;
+        for (unsigned i = 0; i < lights_.Size(); ++i)
+        {
+            Light* light = lights_[i];
+            if (light->GetLightType() != LIGHT_DIRECTIONAL && !light->GetPerVertex() && !(drawShadows_ && light->GetCastShadows())
+                && clusterLights_.Size() < MAX_CLUSTERED_LIGHTS)
+                clusterLights_.Push(light);
+            else
+                lights_[numKept++] = light;
+        }
+        lights_.Resize(numKept);
+    }
 }
 
 void View::GetBatches()
@@ -1024,6 +1427,8 @@ void View::GetLightBatches()
                 lightQueue.light_ = light;
                 lightQueue.negative_ = light->IsNegative();
                 lightQueue.shadowMap_ = nullptr;
+                lightQueue.shadowMapCached_ = false;
+                lightQueue.shadowMapReused_ = false;
                 lightQueue.litBaseBatches_.Clear(maxSortedInstances);
                 lightQueue.litBatches_.Clear(maxSortedInstances);
                 if (forwardLightsCommand_)
@@ -1041,7 +1446,9 @@ void View::GetLightBatches()
                 // Allocate shadow map now
                 if (shadowSplits > 0)
                 {
-                    lightQueue.shadowMap_ = renderer_->GetShadowMap(light, cullCamera_, (unsigned)viewSize_.x_, (unsigned)viewSize_.y_);
+                    lightQueue.shadowMap_ = query.cacheShadowMap_ ?
+                        renderer_->GetCachedShadowMap(light, cullCamera_, (unsigned)viewSize_.x_, (unsigned)viewSize_.y_) :
+                        renderer_->GetShadowMap(light, cullCamera_, (unsigned)viewSize_.x_, (unsigned)viewSize_.y_);
                     // If did not manage to get a shadow map, convert the light to unshadowed
                     if (!lightQueue.shadowMap_)
                         shadowSplits = 0;
@@ -1061,8 +1468,32 @@ void View::GetLightBatches()
                     // Setup the shadow split viewport and finalize shadow camera parameters
                     shadowQueue.shadowViewport_ = GetShadowMapViewport(light, j, lightQueue.shadowMap_);
                     FinalizeShadowCamera(shadowCamera, light, shadowQueue.shadowViewport_, query.shadowCasterBox_[j]);
+                }
+
+                // A cached shadow map does not need to be rendered if the shadow cameras and casters have not changed
+                lightQueue.shadowMapCached_ = shadowSplits > 0 && query.cacheShadowMap_;
+                lightQueue.shadowMapReused_ = false;
+                if (lightQueue.shadowMapCached_)
+                {
+                    CachedShadowMap contents;
+                    for (unsigned j = 0; j < shadowSplits; ++j)
+                    {
+                        Camera* shadowCamera = lightQueue.shadowSplits_[j].shadowCamera_;
+                        contents.viewProj_[j] = shadowCamera->GetProjection() * shadowCamera->GetView();
+                    }
+                    const BiasParameters& bias = light->GetShadowBias();
+                    contents.numSplits_ = shadowSplits;
+                    contents.casterHash_ = query.shadowCasterHash_;
+                    contents.numCasters_ = query.shadowCasters_.Size();
+                    contents.constantBias_ = bias.constantBias_;
+                    contents.slopeScaledBias_ = bias.slopeScaledBias_;
+                    lightQueue.shadowMapReused_ = renderer_->ReuseCachedShadowMap(light, cullCamera_, contents, query.lastCasterUpdate_);
+                }
 
-                    // Loop through shadow casters
+                // Loop through shadow casters of each split, unless reusing the shadow map contents
+                for (unsigned j = 0; j < shadowSplits && !lightQueue.shadowMapReused_; ++j)
+                {
+                    ShadowBatchQueue& shadowQueue = lightQueue.shadowSplits_[j];
                     for (PODVector<Drawable*>::ConstIterator k = query.shadowCasters_.Begin() + query.shadowCasterBegin_[j];
                          k < query.shadowCasters_.Begin() + query.shadowCasterEnd_[j]; ++k)
                     {
@@ -1240,6 +1671,8 @@ void View::GetBaseBatches()
                             i = vertexLightQueues_.Insert(MakePair(hash, LightBatchQueue()));
                             i->second_.light_ = nullptr;
                             i->second_.shadowMap_ = nullptr;
+                            i->second_.shadowMapCached_ = false;
+                            i->second_.shadowMapReused_ = false;
                             i->second_.vertexLights_ = drawableVertexLights;
                         }
 
@@ -1570,15 +2003,20 @@ void View::ExecuteRenderPathCommands()
                         graphics_->SetClipPlane(camera_->GetUseClipping(), camera_->GetClipPlane(), camera_->GetView(),
                             camera_->GetGPUProjection());
 
-                        if (command.shaderParameters_.Size())
+                        // The light cluster textures are bound by the batches themselves
+                        bool clustered = clusteredLights_ && command.clusteredLights_ && lightClusters_;
+                        if (command.shaderParameters_.Size() || clustered)
                         {
-                            // If pass defines shader parameters, reset parameter sources now to ensure they all will be set
-                            // (will be set after camera shader parameters)
+                            // If pass defines shader parameters or uses light clusters, reset parameter sources now to ensure
+                            // they all will be set (will be set after camera shader parameters)
                             graphics_->ClearParameterSources();
                             passCommand_ = &command;
                         }
 
-                        queue.Draw(this, camera_, command.markToStencil_, false, allowDepthWrite);
+                        if (scenePassesRecorded_)
+                            scenePassCommandBuffers_[i].Replay(this, allowDepthWrite);
+                        else
+                            queue.Draw(this, camera_, command.markToStencil_, false, allowDepthWrite);
 
                         passCommand_ = nullptr;
                     }
@@ -1732,7 +2170,7 @@ void View::SetRenderTargets(RenderPathCommand& command)
             {
                 useColorWrite = false;
                 useCustomDepth = true;
-#if !defined(URHO3D_OPENGL) && !defined(URHO3D_D3D11)
+#if !defined(URHO3D_OPENGL) && !defined(URHO3D_D3D11) && !defined(URHO3D_NULL_GRAPHICS)
                 // On D3D9 actual depth-only rendering is illegal, we need a color rendertarget
                 if (!depthOnlyDummyTexture_)
                 {
@@ -2272,6 +2710,11 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
     if (isShadowed && type == LIGHT_POINT)
         isShadowed = false;
 #endif
+    // Point and spot light shadow maps may be cached between frames. Directional light cascades follow the camera
+    query.cacheShadowMap_ = isShadowed && type != LIGHT_DIRECTIONAL && renderer_->GetShadowMapCaching();
+    query.shadowCasterHash_ = 0;
+    query.lastCasterUpdate_ = 0;
+
     // Get lit geometries. They must match the light mask and be inside the main camera frustum to be considered
     PODVector<Drawable*>& tempDrawables = tempDrawables_[threadIndex];
     query.litGeometries_.Clear();
@@ -2331,8 +2774,8 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
         const Frustum& shadowCameraFrustum = shadowCamera->GetFrustum();
         query.shadowCasterBegin_[i] = query.shadowCasterEnd_[i] = query.shadowCasters_.Size();
 
-        // For point light check that the face is visible: if not, can skip the split
-        if (type == LIGHT_POINT && frustum.IsInsideFast(BoundingBox(shadowCameraFrustum)) == OUTSIDE)
+        // For point light check that the face is visible: if not, can skip the split. A cached shadow map needs all faces
+        if (type == LIGHT_POINT && !query.cacheShadowMap_ && frustum.IsInsideFast(BoundingBox(shadowCameraFrustum)) == OUTSIDE)
             continue;
 
         // For directional light check that the split is inside the visible scene: if not, can skip the split
@@ -2356,6 +2799,16 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
     // only cost has been the shadow camera setup & queries
     if (query.shadowCasters_.Empty())
         query.numSplits_ = 0;
+    else if (query.cacheShadowMap_)
+    {
+        // Combine an order-independent hash of the caster set, including the current LOD geometries and materials, and the
+        // last frame any of the casters moved, so that a cached shadow map can be checked for validity
+        for (PODVector<Drawable*>::ConstIterator i = query.shadowCasters_.Begin(); i != query.shadowCasters_.End(); ++i)
+        {
+            query.shadowCasterHash_ += GetShadowCasterHash(*i);
+            query.lastCasterUpdate_ = Max(query.lastCasterUpdate_, (*i)->GetUpdateFrameNumber());
+        }
+    }
 }
 
 void View::ProcessShadowCasters(LightQueryResult& query, const PODVector<Drawable*>& drawables, unsigned splitIndex)
@@ -2383,8 +2836,9 @@ void View::ProcessShadowCasters(LightQueryResult& query, const PODVector<Drawabl
 
     BoundingBox lightViewFrustumBox(lightViewFrustum);
 
-    // Check for degenerate split frustum: in that case there is no need to get shadow casters
-    if (lightViewFrustum.vertices_[0] == lightViewFrustum.vertices_[4])
+    // Check for degenerate split frustum: in that case there is no need to get shadow casters. A cached shadow map does not
+    // depend on the view, so skip the check
+    if (!query.cacheShadowMap_ && lightViewFrustum.vertices_[0] == lightViewFrustum.vertices_[4])
         return;
 
     BoundingBox lightViewBox;
@@ -2419,7 +2873,9 @@ void View::ProcessShadowCasters(LightQueryResult& query, const PODVector<Drawabl
         // Project shadow caster bounding box to light view space for visibility check
         lightViewBox = drawable->GetWorldBoundingBox().Transformed(lightView);
 
-        if (IsShadowCasterVisible(drawable, lightViewBox, shadowCamera, lightView, lightViewFrustum, lightViewFrustumBox))
+        // A cached shadow map keeps casters outside the view's shadow receiving volume, so that it stays valid while the
+        // camera moves. Distance culling still applies and shows up as a change in the caster set
+        if (query.cacheShadowMap_ || IsShadowCasterVisible(drawable, lightViewBox, shadowCamera, lightView, lightViewFrustum, lightViewFrustumBox))
         {
             // Merge to shadow caster bounding box (only needed for focused spot lights) and add to the list
             if (type == LIGHT_SPOT && light->GetShadowFocus().focus_)
@@ -2935,51 +3391,207 @@ void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, boo
 
 void View::PrepareInstancingBuffer()
 {
-    // Prepare instancing buffer from the source view
-    /// \todo If rendering the same view several times back-to-back, would not need to refill the buffer
+    // Prepare instancing buffer from the source view. Its instances stay in the buffer for the rest of the frame, so they
+    // are written only once even if the view is rendered several times
     if (sourceView_)
     {
         sourceView_->PrepareInstancingBuffer();
         return;
     }
 
+    if (instancingPrepared_)
+        return;
+    instancingPrepared_ = true;
+
     URHO3D_PROFILE(PrepareInstancingBuffer);
 
+    // Gather the groups that draw as instanced and assign their offsets within the view's range
+    instancingGroups_.Clear();
     unsigned totalInstances = 0;
 
     for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
-        totalInstances += i->second_.GetNumInstances();
+        AddInstancingGroups(i->second_, totalInstances);
 
     for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
     {
         for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
-            totalInstances += i->shadowSplits_[j].shadowBatches_.GetNumInstances();
-        totalInstances += i->litBaseBatches_.GetNumInstances();
-        totalInstances += i->litBatches_.GetNumInstances();
+            AddInstancingGroups(i->shadowSplits_[j].shadowBatches_, totalInstances);
+        AddInstancingGroups(i->litBaseBatches_, totalInstances);
+        AddInstancingGroups(i->litBatches_, totalInstances);
     }
 
-    if (!totalInstances || !renderer_->ResizeInstancingBuffer(totalInstances))
+    if (!totalInstances)
+        return;
+
+    // Suballocate the view's range from the instancing buffer ring. If it is full, draw this view without instancing
+    unsigned start = renderer_->AllocateInstances(totalInstances);
+    if (start == M_MAX_UNSIGNED)
+    {
+        for (PODVector<BatchGroup*>::Iterator i = instancingGroups_.Begin(); i != instancingGroups_.End(); ++i)
+            (*i)->startIndex_ = M_MAX_UNSIGNED;
         return;
+    }
+
+    for (PODVector<BatchGroup*>::Iterator i = instancingGroups_.Begin(); i != instancingGroups_.End(); ++i)
+        (*i)->startIndex_ += start;
 
     VertexBuffer* instancingBuffer = renderer_->GetInstancingBuffer();
-    unsigned freeIndex = 0;
-    void* dest = instancingBuffer->Lock(0, totalInstances, true);
-    if (!dest)
+    auto* queue = GetSubsystem<WorkQueue>();
+
+    if (queue->GetNumThreads() && totalInstances >= 2 * MIN_INSTANCES_PER_WORK_ITEM)
+    {
+        // Split the groups into work items of roughly equal instance counts. The groups write disjoint ranges
+        unsigned numWorkItems = Min(queue->GetNumThreads() + 1, totalInstances / MIN_INSTANCES_PER_WORK_ITEM);
+        unsigned instancesPerItem = (totalInstances + numWorkItems - 1) / numWorkItems;
+
+        PODVector<BatchGroup*>::Iterator groupStart = instancingGroups_.Begin();
+        while (groupStart != instancingGroups_.End())
+        {
+            PODVector<BatchGroup*>::Iterator groupEnd = groupStart;
+            unsigned itemInstances = 0;
+            while (groupEnd != instancingGroups_.End() && itemInstances < instancesPerItem)
+                itemInstances += (*groupEnd++)->instances_.Size();
+
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->priority_ = M_MAX_UNSIGNED;
+            item->workFunction_ = WriteInstancingDataWork;
+            item->aux_ = instancingBuffer;
+            item->start_ = &(*groupStart);
+            item->end_ = &(*groupEnd);
+            queue->AddWorkItem(item);
+
+            groupStart = groupEnd;
+        }
+
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+    {
+        unsigned char* data = instancingBuffer->GetShadowData();
+        const unsigned stride = instancingBuffer->GetVertexSize();
+        for (PODVector<BatchGroup*>::Iterator i = instancingGroups_.Begin(); i != instancingGroups_.End(); ++i)
+            (*i)->WriteInstancingData(data, stride);
+    }
+
+    renderer_->CommitInstances(start, totalInstances);
+}
+
+void View::AddInstancingGroups(BatchQueue& queue, unsigned& freeIndex)
+{
+    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = queue.batchGroups_.Begin(); i != queue.batchGroups_.End(); ++i)
+    {
+        BatchGroup& group = i->second_;
+        // Do not use up buffer space if not going to draw as instanced
+        if (group.geometryType_ != GEOM_INSTANCED)
+            continue;
+
+        group.startIndex_ = freeIndex;
+        freeIndex += group.instances_.Size();
+        instancingGroups_.Push(&group);
+    }
+}
+
+void View::RecordScenePasses()
+{
+    scenePassesRecorded_ = false;
+    numRecordedCommands_ = 0;
+    numFilteredCommands_ = 0;
+
+    if (!renderer_->GetCommandRecording() || !camera_)
         return;
 
-    const unsigned stride = instancingBuffer->GetVertexSize();
-    for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
-        i->second_.SetInstancingData(dest, stride, freeIndex);
+    URHO3D_PROFILE(RecordScenePasses);
 
-    for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
+    View* actualView = sourceView_ ? sourceView_ : this;
+    scenePassCommandBuffers_.Resize(renderPath_->commands_.Size());
+
+    // Worker threads may only read the scene, so evaluate everything the batches update lazily first
+    Node* cameraNode = camera_->GetNode();
+    if (cameraNode)
+        cameraNode->GetWorldTransform();
+
+    for (unsigned i = 0; i < renderPath_->commands_.Size(); ++i)
     {
-        for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
-            i->shadowSplits_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
-        i->litBaseBatches_.SetInstancingData(dest, stride, freeIndex);
-        i->litBatches_.SetInstancingData(dest, stride, freeIndex);
+        const RenderPathCommand& command = renderPath_->commands_[i];
+        if (command.type_ == CMD_SCENEPASS && actualView->IsNecessary(command))
+            UpdateBatchQueueState(actualView->batchQueues_[command.passIndex_]);
     }
 
-    instancingBuffer->Unlock();
+    auto* queue = GetSubsystem<WorkQueue>();
+
+    for (unsigned i = 0; i < renderPath_->commands_.Size(); ++i)
+    {
+        const RenderPathCommand& command = renderPath_->commands_[i];
+        RenderCommandBuffer& buffer = scenePassCommandBuffers_[i];
+        buffer.Clear();
+
+        if (command.type_ != CMD_SCENEPASS || !actualView->IsNecessary(command))
+            continue;
+
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = RecordScenePassWork;
+        item->aux_ = this;
+        item->start_ = const_cast<RenderPathCommand*>(&command);
+        item->end_ = &buffer;
+        queue->AddWorkItem(item);
+    }
+
+    queue->Complete(M_MAX_UNSIGNED);
+
+    for (unsigned i = 0; i < scenePassCommandBuffers_.Size(); ++i)
+    {
+        numRecordedCommands_ += scenePassCommandBuffers_[i].GetNumCommands();
+        numFilteredCommands_ += scenePassCommandBuffers_[i].GetNumFilteredCommands();
+    }
+
+    scenePassesRecorded_ = true;
+}
+
+void View::UpdateBatchQueueState(const BatchQueue& queue)
+{
+    Zone* lastZone = nullptr;
+    LightBatchQueue* lastLightQueue = nullptr;
+
+    for (unsigned i = 0; i < queue.sortedBatchGroups_.Size() + queue.sortedBatches_.Size(); ++i)
+    {
+        const Batch* batch = i < queue.sortedBatchGroups_.Size() ? queue.sortedBatchGroups_[i] :
+            queue.sortedBatches_[i - queue.sortedBatchGroups_.Size()];
+
+        Zone* zone = batch->zone_;
+        if (zone && zone != lastZone)
+        {
+            zone->GetInverseWorldTransform();
+            zone->GetAmbientStartColor();
+            zone->GetAmbientEndColor();
+            if (zone->GetNode())
+                zone->GetNode()->GetWorldTransform();
+            lastZone = zone;
+        }
+
+        LightBatchQueue* lightQueue = batch->lightQueue_;
+        if (lightQueue && lightQueue != lastLightQueue)
+        {
+            if (lightQueue->light_ && lightQueue->light_->GetNode())
+                lightQueue->light_->GetNode()->GetWorldTransform();
+            for (unsigned j = 0; j < lightQueue->shadowSplits_.Size(); ++j)
+            {
+                Camera* shadowCamera = lightQueue->shadowSplits_[j].shadowCamera_;
+                if (shadowCamera)
+                {
+                    shadowCamera->GetView();
+                    shadowCamera->GetProjection();
+                }
+            }
+            for (unsigned j = 0; j < lightQueue->vertexLights_.Size(); ++j)
+            {
+                Node* lightNode = lightQueue->vertexLights_[j]->GetNode();
+                if (lightNode)
+                    lightNode->GetWorldTransform();
+            }
+            lastLightQueue = lightQueue;
+        }
+    }
 }
 
 void View::SetupLightVolumeBatch(Batch& batch)
@@ -3034,7 +3646,7 @@ void View::SetupLightVolumeBatch(Batch& batch)
 bool View::NeedRenderShadowMap(const LightBatchQueue& queue)
 {
     // Must have a shadow map, and either forward or deferred lit batches
-    return queue.shadowMap_ && (!queue.litBatches_.IsEmpty() || !queue.litBaseBatches_.IsEmpty() ||
+    return queue.shadowMap_ && !queue.shadowMapReused_ && (!queue.litBatches_.IsEmpty() || !queue.litBaseBatches_.IsEmpty() ||
         !queue.volumeBatches_.Empty());
 }
 
@@ -3115,6 +3727,10 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
     float blurScale = queue.shadowSplits_[0].shadowViewport_.Width() / 1024.0f;
     renderer_->ApplyShadowMapFilter(this, shadowMap, blurScale);
 
+    // The cached shadow map contents are now valid for reuse on later frames
+    if (queue.shadowMapCached_)
+        renderer_->MarkCachedShadowMapRendered(queue.light_, cullCamera_);
+
     // reset some parameters
     graphics_->SetColorWrite(true);
     graphics_->SetDepthBias(0.0f, 0.0f);
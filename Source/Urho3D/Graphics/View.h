@@ -27,6 +27,8 @@
 #include "../Core/Object.h"
 #include "../Graphics/Batch.h"
 #include "../Graphics/Light.h"
+#include "../Graphics/LightClusters.h"
+#include "../Graphics/RenderCommandBuffer.h"
 #include "../Graphics/Zone.h"
 #include "../Math/Polyhedron.h"
 
@@ -74,6 +76,12 @@ struct LightQueryResult
     float shadowFarSplits_[MAX_LIGHT_SPLITS];
     /// Shadow map split count.
     unsigned numSplits_;
+    /// Shadow map cached between frames flag.
+    bool cacheShadowMap_;
+    /// Order-independent hash of the shadow casters and their geometries and materials. Only calculated for cached shadow maps.
+    unsigned long long shadowCasterHash_;
+    /// Latest frame number on which the octree updated one of the shadow casters. Only calculated for cached shadow maps.
+    unsigned lastCasterUpdate_;
 };
 
 /// Scene render pass info.
@@ -87,6 +95,8 @@ struct ScenePassInfo
     bool markToStencil_;
     /// Vertex light flag.
     bool vertexLights_;
+    /// Clustered forward lights flag.
+    bool clusteredLights_;
     /// Batch queue.
     BatchQueue* batchQueue_;
 };
@@ -111,6 +121,7 @@ class URHO3D_API View : public Object
 {
     friend void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex);
     friend void ProcessLightWork(const WorkItem* item, unsigned threadIndex);
+    friend void RecordScenePassWork(const WorkItem* item, unsigned threadIndex);
 
     URHO3D_OBJECT(View, Object);
 
@@ -166,12 +177,33 @@ public:
     /// Return light batch queues.
     const Vector<LightBatchQueue>& GetLightQueues() const { return lightQueues_; }
 
+    /// Return lights assigned to light clusters instead of per-pixel light queues.
+    const PODVector<Light*>& GetClusterLights() const { return clusterLights_; }
+
+    /// Return the light cluster assignment of the last render, or null if clustered forward lighting is not used.
+    LightClusters* GetLightClusters() const { return lightClusters_; }
+
     /// Return the last used software occlusion buffer.
     OcclusionBuffer* GetOcclusionBuffer() const { return occlusionBuffer_; }
 
     /// Return number of occluders that were actually rendered. Occluders may be rejected if running out of triangles or if behind other occluders.
     unsigned GetNumActiveOccluders() const { return activeOccluders_; }
 
+    /// Return number of octants tested against the frustum with coherent culling.
+    unsigned GetNumTestedOctants() const { return numTestedOctants_; }
+
+    /// Return number of octants whose culling result was reused from an earlier frame with coherent culling.
+    unsigned GetNumReusedOctants() const { return numReusedOctants_; }
+
+    /// Return whether frustum culling was shared with other views of the same scene.
+    bool IsCullingShared() const { return cullingShared_; }
+
+    /// Return number of render commands recorded for scene passes this frame.
+    unsigned GetNumRecordedCommands() const { return numRecordedCommands_; }
+
+    /// Return number of redundant render commands dropped while recording scene passes this frame.
+    unsigned GetNumFilteredCommands() const { return numFilteredCommands_; }
+
     /// Return the source view that was already prepared. Used when viewports specify the same culling camera.
     View* GetSourceView() const;
 
@@ -183,6 +215,8 @@ public:
     void SetCommandShaderParameters(const RenderPathCommand& command);
     /// Set G-buffer offset and inverse size shader parameters. Called by Batch and internally by View.
     void SetGBufferShaderParameters(const IntVector2& texSize, const IntRect& viewRect);
+    /// Set global, camera and viewport shader parameters if they need update. Called by Batch and RenderCommandBuffer.
+    void SetViewShaderParameters(Camera* camera);
 
     /// Draw a fullscreen quad. Shaders and renderstates must have been set beforehand. Quad will be drawn to the middle of depth range, similarly to deferred directional lights.
     void DrawFullscreenQuad(bool setIdentityProjection = false);
@@ -260,6 +294,12 @@ private:
     void AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, bool allowInstancing = true, bool allowShadows = true);
     /// Prepare instancing buffer by filling it with all instance transforms.
     void PrepareInstancingBuffer();
+    /// Collect the instanced batch groups of a queue and assign their instancing buffer offsets.
+    void AddInstancingGroups(BatchQueue& queue, unsigned& freeIndex);
+    /// Record the scene pass batch queues into render command buffers in worker threads.
+    void RecordScenePasses();
+    /// Evaluate the lazily updated scene state read by a batch queue, so that it can be recorded in worker threads.
+    void UpdateBatchQueueState(const BatchQueue& queue);
     /// Set up a light volume rendering batch.
     void SetupLightVolumeBatch(Batch& batch);
     /// Check whether a light queue needs shadow rendering.
@@ -361,16 +401,24 @@ private:
     int highestZonePriority_{};
     /// Geometries updated flag.
     bool geometriesUpdated_{};
+    /// Instancing data written flag.
+    bool instancingPrepared_{};
     /// Camera zone's override flag.
     bool cameraZoneOverride_{};
     /// Draw shadows flag.
     bool drawShadows_{};
+    /// Coherent culling flag.
+    bool coherentCulling_{};
+    /// Frustum culling shared with other views flag.
+    bool cullingShared_{};
     /// Deferred flag. Inferred from the existence of a light volume command in the renderpath.
     bool deferred_{};
     /// Deferred ambient pass flag. This means that the destination rendertarget is being written to at the same time as albedo/normal/depth buffers, and needs to be RGBA on OpenGL.
     bool deferredAmbient_{};
     /// Forward light base pass optimization flag. If in use, combine the base pass and first light for all opaque objects.
     bool useLitBase_{};
+    /// Clustered forward lighting flag. Inferred from scene passes with clustered lights in a renderpath without light volumes.
+    bool clusteredLights_{};
     /// Has scene passes flag. If no scene passes, view can be defined without a valid scene or camera to only perform quad rendering.
     bool hasScenePasses_{};
     /// Whether is using a custom readable depth texture without a stencil channel.
@@ -391,12 +439,32 @@ private:
     PODVector<Drawable*> nonThreadedGeometries_;
     /// Geometry objects that will be updated in worker threads.
     PODVector<Drawable*> threadedGeometries_;
+    /// Batch groups drawn as instanced, whose instancing data is written in worker threads.
+    PODVector<BatchGroup*> instancingGroups_;
     /// Occluder objects.
     PODVector<Drawable*> occluders_;
     /// Lights.
     PODVector<Light*> lights_;
+    /// Unshadowed point and spot lights evaluated from light clusters in the scene passes.
+    PODVector<Light*> clusterLights_;
+    /// Light cluster assignment.
+    SharedPtr<LightClusters> lightClusters_;
     /// Number of active occluders.
     unsigned activeOccluders_{};
+    /// Number of octants tested with coherent culling.
+    unsigned numTestedOctants_{};
+    /// Number of octant culling results reused with coherent culling.
+    unsigned numReusedOctants_{};
+    /// Owner identifier of the octant culling results cached by coherent culling, or zero if not assigned.
+    unsigned cullCacheOwner_{};
+    /// Accumulated movement of the culling frustum since the owner identifier was assigned.
+    double cullFrustumDelta_{};
+    /// Culling frustum of the previous frame.
+    Frustum lastCullFrustum_;
+    /// Octree culled on the previous frame.
+    Octree* lastCullOctree_{};
+    /// Octree bounding box on the previous frame.
+    BoundingBox lastCullOctreeBox_;
 
     /// Drawables that limit their maximum light count.
     HashSet<Drawable*> maxLightsDrawables_;
@@ -430,6 +498,14 @@ private:
     const RenderPathCommand* forwardLightsCommand_{};
     /// Pointer to the current commmand if it contains shader parameters to be set for a render pass.
     const RenderPathCommand* passCommand_{};
+    /// Recorded scene pass render commands by render path command index.
+    Vector<RenderCommandBuffer> scenePassCommandBuffers_;
+    /// Number of render commands recorded for scene passes.
+    unsigned numRecordedCommands_{};
+    /// Number of redundant render commands dropped while recording scene passes.
+    unsigned numFilteredCommands_{};
+    /// Flag for scene passes having been recorded this frame.
+    bool scenePassesRecorded_{};
     /// Flag for scene being resolved from the backbuffer.
     bool usedResolve_{};
 };
@@ -61,6 +61,24 @@ static const Vector3 DEFAULT_GRAVITY = Vector3(0.0f, -9.81f, 0.0f);
 
 PhysicsWorldConfig PhysicsWorld::config;
 
+/// Remove queued objects from a tracking vector in one pass and clear the queue.
+template <class T> static void RemoveQueuedObjects(PODVector<T*>& objects, HashSet<T*>& queued)
+{
+    if (queued.Empty())
+        return;
+
+    unsigned numKept = 0;
+    for (unsigned i = 0; i < objects.Size(); ++i)
+    {
+        T* object = objects[i];
+        if (!queued.Contains(object))
+            objects[numKept++] = object;
+    }
+
+    objects.Resize(numKept);
+    queued.Clear();
+}
+
 static bool CompareRaycastResults(const PhysicsRaycastResult& lhs, const PhysicsRaycastResult& rhs)
 {
     return lhs.distance_ < rhs.distance_;
@@ -717,34 +735,51 @@ bool PhysicsWorld::GetSplitImpulse() const
 
 void PhysicsWorld::AddRigidBody(RigidBody* body)
 {
+    // An object may be re-added, or a new one allocated at the same address, while removals are queued. In that case it is
+    // still in the list
+    if (!queuedRigidBodyRemovals_.Empty() && queuedRigidBodyRemovals_.Erase(body))
+        return;
     rigidBodies_.Push(body);
 }
 
 void PhysicsWorld::RemoveRigidBody(RigidBody* body)
 {
-    rigidBodies_.Remove(body);
+    if (scene_ && scene_->IsBatchRemoving())
+        queuedRigidBodyRemovals_.Insert(body);
+    else
+        rigidBodies_.Remove(body);
     // Remove possible dangling pointer from the delayedWorldTransforms structure
     delayedWorldTransforms_.Erase(body);
 }
 
 void PhysicsWorld::AddCollisionShape(CollisionShape* shape)
 {
+    if (!queuedCollisionShapeRemovals_.Empty() && queuedCollisionShapeRemovals_.Erase(shape))
+        return;
     collisionShapes_.Push(shape);
 }
 
 void PhysicsWorld::RemoveCollisionShape(CollisionShape* shape)
 {
-    collisionShapes_.Remove(shape);
+    if (scene_ && scene_->IsBatchRemoving())
+        queuedCollisionShapeRemovals_.Insert(shape);
+    else
+        collisionShapes_.Remove(shape);
 }
 
 void PhysicsWorld::AddConstraint(Constraint* constraint)
 {
+    if (!queuedConstraintRemovals_.Empty() && queuedConstraintRemovals_.Erase(constraint))
+        return;
     constraints_.Push(constraint);
 }
 
 void PhysicsWorld::RemoveConstraint(Constraint* constraint)
 {
-    constraints_.Remove(constraint);
+    if (scene_ && scene_->IsBatchRemoving())
+        queuedConstraintRemovals_.Insert(constraint);
+    else
+        constraints_.Remove(constraint);
 }
 
 void PhysicsWorld::AddDelayedWorldTransform(const DelayedWorldTransform& transform)
@@ -783,9 +818,13 @@ void PhysicsWorld::OnSceneSet(Scene* scene)
     {
         scene_ = GetScene();
         SubscribeToEvent(scene_, E_SCENESUBSYSTEMUPDATE, URHO3D_HANDLER(PhysicsWorld, HandleSceneSubsystemUpdate));
+        SubscribeToEvent(scene_, E_SCENEBATCHREMOVED, URHO3D_HANDLER(PhysicsWorld, HandleSceneBatchRemoved));
     }
     else
+    {
         UnsubscribeFromEvent(E_SCENESUBSYSTEMUPDATE);
+        UnsubscribeFromEvent(E_SCENEBATCHREMOVED);
+    }
 }
 
 void PhysicsWorld::HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData)
@@ -797,6 +836,15 @@ void PhysicsWorld::HandleSceneSubsystemUpdate(StringHash eventType, VariantMap&
     Update(eventData[P_TIMESTEP].GetFloat());
 }
 
+void PhysicsWorld::HandleSceneBatchRemoved(StringHash eventType, VariantMap& eventData)
+{
+    URHO3D_PROFILE(RemoveQueuedPhysicsObjects);
+
+    RemoveQueuedObjects(rigidBodies_, queuedRigidBodyRemovals_);
+    RemoveQueuedObjects(collisionShapes_, queuedCollisionShapeRemovals_);
+    RemoveQueuedObjects(constraints_, queuedConstraintRemovals_);
+}
+
 void PhysicsWorld::PreStep(float timeStep)
 {
     // Send pre-step event
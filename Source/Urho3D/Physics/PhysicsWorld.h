@@ -293,6 +293,8 @@ protected:
 private:
     /// Handle the scene subsystem update event, step simulation here.
     void HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle the scene finishing a batch node removal. Remove the queued physics objects in one pass.
+    void HandleSceneBatchRemoved(StringHash eventType, VariantMap& eventData);
     /// Trigger update before each physics simulation step.
     void PreStep(float timeStep);
     /// Trigger update after each physics simulation step.
@@ -318,6 +320,12 @@ private:
     PODVector<CollisionShape*> collisionShapes_;
     /// Constraints in the world.
     PODVector<Constraint*> constraints_;
+    /// Rigid bodies queued for removal during a batch node removal.
+    HashSet<RigidBody*> queuedRigidBodyRemovals_;
+    /// Collision shapes queued for removal during a batch node removal.
+    HashSet<CollisionShape*> queuedCollisionShapeRemovals_;
+    /// Constraints queued for removal during a batch node removal.
+    HashSet<Constraint*> queuedConstraintRemovals_;
     /// Collision pairs on this frame.
     HashMap<Pair<WeakPtr<RigidBody>, WeakPtr<RigidBody> >, ManifoldPair> currentCollisions_;
     /// Collision pairs on the previous frame. Used to check if a collision is "new." Manifolds are not guaranteed to exist anymore.
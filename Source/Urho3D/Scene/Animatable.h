@@ -115,6 +115,10 @@ public:
     float GetAttributeAnimationSpeed(const String& name) const;
     /// Return attribute animation time position.
     float GetAttributeAnimationTime(const String& name) const;
+    /// Return number of attribute animations.
+    unsigned GetNumAttributeAnimations() const { return attributeAnimationInfos_.Size(); }
+    /// Return attribute animation infos.
+    const HashMap<String, SharedPtr<AttributeAnimationInfo> >& GetAttributeAnimationInfos() const { return attributeAnimationInfos_; }
 
     /// Set object animation attribute.
     void SetObjectAnimationAttr(const ResourceRef& value);
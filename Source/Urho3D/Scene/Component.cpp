@@ -55,6 +55,7 @@ Component::Component(Context* context) :
     Animatable(context),
     node_(nullptr),
     id_(0),
+    sceneTypeIndex_(M_MAX_UNSIGNED),
     networkUpdate_(false),
     enabled_(true)
 {
@@ -98,6 +99,8 @@ bool Component::SaveJSON(JSONValue& dest) const
 
 void Component::MarkNetworkUpdate()
 {
+    MarkChanged();
+
     if (!networkUpdate_ && IsReplicated())
     {
         Scene* scene = GetScene();
@@ -109,6 +112,13 @@ void Component::MarkNetworkUpdate()
     }
 }
 
+void Component::MarkChanged()
+{
+    Scene* scene = GetScene();
+    if (scene)
+        scene->MarkChanged(this);
+}
+
 void Component::GetDependencyNodes(PODVector<Node*>& dest)
 {
 }
@@ -225,14 +235,16 @@ void Component::CleanupConnection(Connection* connection)
 
 void Component::OnAttributeAnimationAdded()
 {
-    if (attributeAnimationInfos_.Size() == 1)
-        SubscribeToEvent(GetScene(), E_ATTRIBUTEANIMATIONUPDATE, URHO3D_HANDLER(Component, HandleAttributeAnimationUpdate));
+    Scene* scene = GetScene();
+    if (attributeAnimationInfos_.Size() == 1 && scene)
+        scene->AnimatableAdded(this);
 }
 
 void Component::OnAttributeAnimationRemoved()
 {
-    if (attributeAnimationInfos_.Empty())
-        UnsubscribeFromEvent(GetScene(), E_ATTRIBUTEANIMATIONUPDATE);
+    Scene* scene = GetScene();
+    if (attributeAnimationInfos_.Empty() && scene)
+        scene->AnimatableRemoved(this);
 }
 
 void Component::OnNodeSet(Node* node)
@@ -280,13 +292,6 @@ void Component::GetComponents(PODVector<Component*>& dest, StringHash type) cons
         dest.Clear();
 }
 
-void Component::HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData)
-{
-    using namespace AttributeAnimationUpdate;
-
-    UpdateAttributeAnimations(eventData[P_TIMESTEP].GetFloat());
-}
-
 Component* Component::GetFixedUpdateSource()
 {
     Component* ret = nullptr;
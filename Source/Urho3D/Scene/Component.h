@@ -66,6 +66,8 @@ public:
 	virtual bool SaveJSON(JSONValue& dest) const override;
     /// Mark for attribute check on the next network update.
     void MarkNetworkUpdate() override;
+    /// Mark as changed since the last save for incremental scene saving.
+    void MarkChanged() override;
     /// Return the depended on nodes to order network updates.
     virtual void GetDependencyNodes(PODVector<Node*>& dest);
     /// Visualize the component as debug geometry.
@@ -125,8 +127,6 @@ protected:
     void SetID(unsigned id);
     /// Set scene node. Called by Node when creating the component.
     void SetNode(Node* node);
-    /// Handle scene attribute animation update event.
-    void HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData);
     /// Return a component from the scene root that sends out fixed update events (either PhysicsWorld or PhysicsWorld2D). Return null if neither exists.
     Component* GetFixedUpdateSource();
     /// Perform autoremove. Called by subclasses. Caller should keep a weak pointer to itself to check whether was actually removed, and return immediately without further member operations in that case.
@@ -136,6 +136,8 @@ protected:
     Node* node_;
     /// Unique ID within the scene.
     unsigned id_;
+    /// Index in the scene's per-type component array.
+    unsigned sceneTypeIndex_;
     /// Network update queued flag.
     bool networkUpdate_;
     /// Enabled flag.
@@ -290,6 +290,8 @@ void Node::ApplyAttributes()
 
 void Node::MarkNetworkUpdate()
 {
+    MarkChanged();
+
     if (!networkUpdate_ && scene_ && IsReplicated())
     {
         scene_->MarkNetworkUpdate(this);
@@ -297,6 +299,12 @@ void Node::MarkNetworkUpdate()
     }
 }
 
+void Node::MarkChanged()
+{
+    if (scene_)
+        scene_->MarkChanged(this);
+}
+
 void Node::AddReplicationState(NodeReplicationState* state)
 {
     if (!networkState_)
@@ -1900,14 +1908,16 @@ void Node::SetTransformSilent(const Vector3& position, const Quaternion& rotatio
 
 void Node::OnAttributeAnimationAdded()
 {
-    if (attributeAnimationInfos_.Size() == 1)
-        SubscribeToEvent(GetScene(), E_ATTRIBUTEANIMATIONUPDATE, URHO3D_HANDLER(Node, HandleAttributeAnimationUpdate));
+    Scene* scene = GetScene();
+    if (attributeAnimationInfos_.Size() == 1 && scene)
+        scene->AnimatableAdded(this);
 }
 
 void Node::OnAttributeAnimationRemoved()
 {
-    if (attributeAnimationInfos_.Empty())
-        UnsubscribeFromEvent(GetScene(), E_ATTRIBUTEANIMATIONUPDATE);
+    Scene* scene = GetScene();
+    if (attributeAnimationInfos_.Empty() && scene)
+        scene->AnimatableRemoved(this);
 }
 
 Animatable* Node::FindAttributeAnimationTarget(const String& name, String& outName)
@@ -2258,11 +2268,4 @@ void Node::RemoveComponent(Vector<SharedPtr<Component> >::Iterator i)
     components_.Erase(i);
 }
 
-void Node::HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData)
-{
-    using namespace AttributeAnimationUpdate;
-
-    UpdateAttributeAnimations(eventData[P_TIMESTEP].GetFloat());
-}
-
 }
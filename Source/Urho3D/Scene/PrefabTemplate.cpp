@@ -0,0 +1,577 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "../IO/VectorBuffer.h"
+#include "../Resource/JSONFile.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/XMLFile.h"
+#include "../Scene/Component.h"
+#include "../Scene/ObjectAnimation.h"
+#include "../Scene/PrefabTemplate.h"
+#include "../Scene/Scene.h"
+#include "../Scene/SceneResolver.h"
+#include "../Scene/UnknownComponent.h"
+#include "../Scene/ValueAnimation.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+extern const char* wrapModeNames[];
+
+/// Convert a wrap mode name to the enum value. Return WM_LOOP if not found.
+static WrapMode ResolveWrapMode(const String& value)
+{
+    for (int i = 0; i <= WM_CLAMP; ++i)
+    {
+        if (value == wrapModeNames[i])
+            return (WrapMode)i;
+    }
+
+    return WM_LOOP;
+}
+
+/// Convert an enum name to its index. Return an empty variant if not found.
+static Variant ResolveEnumValue(const AttributeInfo& attr, const String& value)
+{
+    int enumValue = 0;
+    const char** enumPtr = attr.enumNames_;
+    while (*enumPtr)
+    {
+        if (!value.Compare(*enumPtr, false))
+            return Variant(enumValue);
+        ++enumPtr;
+        ++enumValue;
+    }
+
+    URHO3D_LOGWARNING("Unknown enum value " + value + " in attribute " + attr.name_);
+    return Variant::EMPTY;
+}
+
+/// Find a file attribute by case-insensitive name, starting the search from the attribute following the previous match.
+static unsigned FindAttribute(const Vector<AttributeInfo>& attributes, const String& name, unsigned& startIndex)
+{
+    unsigned i = startIndex;
+    unsigned attempts = attributes.Size();
+
+    while (attempts)
+    {
+        const AttributeInfo& attr = attributes[i];
+        if ((attr.mode_ & AM_FILE) && !attr.name_.Compare(name, true))
+        {
+            startIndex = (i + 1) % attributes.Size();
+            return i;
+        }
+
+        i = (i + 1) % attributes.Size();
+        --attempts;
+    }
+
+    return M_MAX_UNSIGNED;
+}
+
+PrefabTemplate::PrefabTemplate(Context* context) :
+    Resource(context),
+    numComponents_(0)
+{
+}
+
+PrefabTemplate::~PrefabTemplate() = default;
+
+void PrefabTemplate::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PrefabTemplate>();
+}
+
+bool PrefabTemplate::BeginLoad(Deserializer& source)
+{
+    String extension = GetExtension(source.GetName());
+
+    bool success;
+    if (extension == ".xml")
+    {
+        XMLFile xmlFile(context_);
+        success = xmlFile.Load(source) && LoadXML(xmlFile.GetRoot());
+    }
+    else if (extension == ".json")
+    {
+        JSONFile jsonFile(context_);
+        success = jsonFile.Load(source) && LoadJSON(jsonFile.GetRoot());
+    }
+    else
+        success = Load(source);
+
+    if (!success)
+        return false;
+
+    // If async loading, request the referenced resources so that the first instantiation does not load synchronously
+    if (GetAsyncLoadState() == ASYNC_LOADING)
+    {
+        for (unsigned i = 0; i < nodes_.Size(); ++i)
+        {
+            const PrefabNode& node = nodes_[i];
+            for (unsigned j = 0; j < node.components_.Size(); ++j)
+                PreloadResources(node.components_[j].attributes_);
+        }
+    }
+
+    return true;
+}
+
+bool PrefabTemplate::Load(Deserializer& source)
+{
+    nodes_.Clear();
+    numComponents_ = 0;
+
+    bool success = LoadNode(source, M_MAX_UNSIGNED);
+    if (!success)
+        nodes_.Clear();
+
+    SetMemoryUse(sizeof(PrefabTemplate) + nodes_.Size() * sizeof(PrefabNode) + numComponents_ * sizeof(PrefabComponent));
+    return success;
+}
+
+bool PrefabTemplate::LoadXML(const XMLElement& source)
+{
+    nodes_.Clear();
+    numComponents_ = 0;
+
+    if (source.IsNull())
+    {
+        URHO3D_LOGERROR("Could not load prefab template, null source element");
+        return false;
+    }
+
+    bool success = LoadNodeXML(source, M_MAX_UNSIGNED);
+    if (!success)
+        nodes_.Clear();
+
+    SetMemoryUse(sizeof(PrefabTemplate) + nodes_.Size() * sizeof(PrefabNode) + numComponents_ * sizeof(PrefabComponent));
+    return success;
+}
+
+bool PrefabTemplate::LoadJSON(const JSONValue& source)
+{
+    nodes_.Clear();
+    numComponents_ = 0;
+
+    if (source.IsNull())
+    {
+        URHO3D_LOGERROR("Could not load prefab template, null JSON source element");
+        return false;
+    }
+
+    bool success = LoadNodeJSON(source, M_MAX_UNSIGNED);
+    if (!success)
+        nodes_.Clear();
+
+    SetMemoryUse(sizeof(PrefabTemplate) + nodes_.Size() * sizeof(PrefabNode) + numComponents_ * sizeof(PrefabComponent));
+    return success;
+}
+
+Node* PrefabTemplate::CreateNodes(Node* parent, SceneResolver& resolver, CreateMode mode) const
+{
+    if (!parent || nodes_.Empty())
+        return nullptr;
+
+    PODVector<Node*> createdNodes(nodes_.Size());
+
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        const PrefabNode& src = nodes_[i];
+
+        // The root node is created in the requested mode, child nodes follow their stored ID like in Node::Load()
+        Node* newNode;
+        if (src.parentIndex_ == M_MAX_UNSIGNED)
+            newNode = parent->CreateChild(0, mode);
+        else
+        {
+            newNode = createdNodes[src.parentIndex_]->CreateChild(0, (mode == REPLICATED && Scene::IsReplicatedID(src.id_)) ?
+                REPLICATED : LOCAL);
+        }
+        createdNodes[i] = newNode;
+        resolver.AddNode(src.id_, newNode);
+
+        ApplyToObject(newNode, src.attributes_, src.objectAnimation_, src.attributeAnimations_);
+
+        for (Vector<PrefabComponent>::ConstIterator j = src.components_.Begin(); j != src.components_.End(); ++j)
+        {
+            // Do not create replicated components to local nodes, same as Node::SafeCreateComponent()
+            CreateMode compMode = (mode == REPLICATED && newNode->IsReplicated() && Scene::IsReplicatedID(j->id_)) ? REPLICATED :
+                LOCAL;
+            Component* newComponent;
+            if (!j->unknown_)
+                newComponent = newNode->CreateComponent(j->type_, compMode);
+            else
+            {
+                // Create a placeholder for an unknown type, same as Node::SafeCreateComponent()
+                SharedPtr<UnknownComponent> unknownComponent(new UnknownComponent(context_));
+                if (j->typeName_.Empty() || j->typeName_.StartsWith("Unknown", false))
+                    unknownComponent->SetStoredType(j->type_);
+                else
+                    unknownComponent->SetStoredTypeName(j->typeName_);
+                newNode->AddComponent(unknownComponent, 0, compMode);
+                newComponent = unknownComponent;
+            }
+            if (!newComponent)
+                continue;
+
+            resolver.AddComponent(j->id_, newComponent);
+            ApplyToObject(newComponent, j->attributes_, j->objectAnimation_, j->attributeAnimations_);
+        }
+    }
+
+    return createdNodes[0];
+}
+
+bool PrefabTemplate::LoadNode(Deserializer& source, unsigned parentIndex)
+{
+    unsigned nodeIndex = nodes_.Size();
+    nodes_.Resize(nodeIndex + 1);
+    nodes_[nodeIndex].id_ = source.ReadUInt();
+    nodes_[nodeIndex].parentIndex_ = parentIndex;
+
+    if (!LoadAttributes(source, Node::GetTypeStatic(), nodes_[nodeIndex].attributes_))
+        return false;
+
+    unsigned numComponents = source.ReadVLE();
+    for (unsigned i = 0; i < numComponents; ++i)
+    {
+        VectorBuffer compBuffer(source, source.ReadVLE());
+        PrefabComponent component;
+        component.type_ = compBuffer.ReadStringHash();
+        component.id_ = compBuffer.ReadUInt();
+        component.unknown_ = context_->GetTypeName(component.type_).Empty();
+
+        // Unknown component data is read as UnknownComponent attributes, same as Node::Load(). Do not abort if a component
+        // fails to load, as the component buffer is nested and we can skip to the next
+        if (component.unknown_)
+        {
+            URHO3D_LOGWARNING("Component type " + component.type_.ToString() +
+                " not known, creating UnknownComponent as placeholder");
+            LoadAttributes(compBuffer, UnknownComponent::GetTypeStatic(), component.attributes_);
+        }
+        else if (!LoadAttributes(compBuffer, component.type_, component.attributes_))
+            continue;
+
+        nodes_[nodeIndex].components_.Push(component);
+        ++numComponents_;
+    }
+
+    unsigned numChildren = source.ReadVLE();
+    for (unsigned i = 0; i < numChildren; ++i)
+    {
+        if (!LoadNode(source, nodeIndex))
+            return false;
+    }
+
+    return true;
+}
+
+bool PrefabTemplate::LoadNodeXML(const XMLElement& source, unsigned parentIndex)
+{
+    unsigned nodeIndex = nodes_.Size();
+    nodes_.Resize(nodeIndex + 1);
+    nodes_[nodeIndex].id_ = source.GetUInt("id");
+    nodes_[nodeIndex].parentIndex_ = parentIndex;
+
+    LoadAttributesXML(source, Node::GetTypeStatic(), nodes_[nodeIndex].attributes_);
+    if (!LoadAnimationsXML(source, nodes_[nodeIndex].objectAnimation_, nodes_[nodeIndex].attributeAnimations_))
+        return false;
+
+    XMLElement compElem = source.GetChild("component");
+    while (compElem)
+    {
+        PrefabComponent component;
+        component.typeName_ = compElem.GetAttribute("type");
+        component.type_ = StringHash(component.typeName_);
+        component.id_ = compElem.GetUInt("id");
+        component.unknown_ = context_->GetTypeName(component.type_).Empty();
+        if (component.unknown_)
+            URHO3D_LOGWARNING("Component type " + component.typeName_ + " not known, creating UnknownComponent as placeholder");
+
+        LoadAttributesXML(compElem, component.unknown_ ? UnknownComponent::GetTypeStatic() : component.type_,
+            component.attributes_);
+        if (!LoadAnimationsXML(compElem, component.objectAnimation_, component.attributeAnimations_))
+            return false;
+        nodes_[nodeIndex].components_.Push(component);
+        ++numComponents_;
+
+        compElem = compElem.GetNext("component");
+    }
+
+    XMLElement childElem = source.GetChild("node");
+    while (childElem)
+    {
+        if (!LoadNodeXML(childElem, nodeIndex))
+            return false;
+
+        childElem = childElem.GetNext("node");
+    }
+
+    return true;
+}
+
+bool PrefabTemplate::LoadNodeJSON(const JSONValue& source, unsigned parentIndex)
+{
+    unsigned nodeIndex = nodes_.Size();
+    nodes_.Resize(nodeIndex + 1);
+    nodes_[nodeIndex].id_ = source.Get("id").GetUInt();
+    nodes_[nodeIndex].parentIndex_ = parentIndex;
+
+    LoadAttributesJSON(source, Node::GetTypeStatic(), nodes_[nodeIndex].attributes_);
+    if (!LoadAnimationsJSON(source, nodes_[nodeIndex].objectAnimation_, nodes_[nodeIndex].attributeAnimations_))
+        return false;
+
+    const JSONArray& componentsArray = source.Get("components").GetArray();
+    for (unsigned i = 0; i < componentsArray.Size(); ++i)
+    {
+        const JSONValue& compVal = componentsArray.At(i);
+        PrefabComponent component;
+        component.typeName_ = compVal.Get("type").GetString();
+        component.type_ = StringHash(component.typeName_);
+        component.id_ = compVal.Get("id").GetUInt();
+        component.unknown_ = context_->GetTypeName(component.type_).Empty();
+        if (component.unknown_)
+            URHO3D_LOGWARNING("Component type " + component.typeName_ + " not known, creating UnknownComponent as placeholder");
+
+        LoadAttributesJSON(compVal, component.unknown_ ? UnknownComponent::GetTypeStatic() : component.type_,
+            component.attributes_);
+        if (!LoadAnimationsJSON(compVal, component.objectAnimation_, component.attributeAnimations_))
+            return false;
+        nodes_[nodeIndex].components_.Push(component);
+        ++numComponents_;
+    }
+
+    const JSONArray& childrenArray = source.Get("children").GetArray();
+    for (unsigned i = 0; i < childrenArray.Size(); ++i)
+    {
+        if (!LoadNodeJSON(childrenArray.At(i), nodeIndex))
+            return false;
+    }
+
+    return true;
+}
+
+bool PrefabTemplate::LoadAttributes(Deserializer& source, StringHash type, Vector<PrefabAttribute>& dest) const
+{
+    const Vector<AttributeInfo>* attributes = context_->GetAttributes(type);
+    if (!attributes)
+        return true;
+
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        const AttributeInfo& attr = attributes->At(i);
+        if (!(attr.mode_ & AM_FILE))
+            continue;
+
+        if (source.IsEof())
+        {
+            URHO3D_LOGERROR("Could not load prefab template " + GetName() + ", stream not open or at end");
+            return false;
+        }
+
+        PrefabAttribute value;
+        value.index_ = i;
+        value.value_ = source.ReadVariant(attr.type_);
+        dest.Push(value);
+    }
+
+    return true;
+}
+
+void PrefabTemplate::LoadAttributesXML(const XMLElement& source, StringHash type, Vector<PrefabAttribute>& dest) const
+{
+    const Vector<AttributeInfo>* attributes = context_->GetAttributes(type);
+    if (!attributes || attributes->Empty())
+        return;
+
+    XMLElement attrElem = source.GetChild("attribute");
+    unsigned startIndex = 0;
+
+    while (attrElem)
+    {
+        String name = attrElem.GetAttribute("name");
+        unsigned index = FindAttribute(*attributes, name, startIndex);
+        if (index != M_MAX_UNSIGNED)
+        {
+            const AttributeInfo& attr = attributes->At(index);
+            PrefabAttribute value;
+            value.index_ = index;
+            value.value_ = attr.enumNames_ ? ResolveEnumValue(attr, attrElem.GetAttribute("value")) :
+                attrElem.GetVariantValue(attr.type_);
+            if (!value.value_.IsEmpty())
+                dest.Push(value);
+        }
+        else
+            URHO3D_LOGWARNING("Unknown attribute " + name + " in XML data");
+
+        attrElem = attrElem.GetNext("attribute");
+    }
+}
+
+void PrefabTemplate::LoadAttributesJSON(const JSONValue& source, StringHash type, Vector<PrefabAttribute>& dest) const
+{
+    const Vector<AttributeInfo>* attributes = context_->GetAttributes(type);
+    if (!attributes || attributes->Empty())
+        return;
+
+    JSONValue attributesValue = source.Get("attributes");
+    if (!attributesValue.IsObject())
+        return;
+
+    const JSONObject& attributesObject = attributesValue.GetObject();
+    unsigned startIndex = 0;
+
+    for (JSONObject::ConstIterator i = attributesObject.Begin(); i != attributesObject.End(); ++i)
+    {
+        unsigned index = FindAttribute(*attributes, i->first_, startIndex);
+        if (index != M_MAX_UNSIGNED)
+        {
+            const AttributeInfo& attr = attributes->At(index);
+            PrefabAttribute value;
+            value.index_ = index;
+            value.value_ = attr.enumNames_ ? ResolveEnumValue(attr, i->second_.GetString()) :
+                i->second_.GetVariantValue(attr.type_);
+            if (!value.value_.IsEmpty())
+                dest.Push(value);
+        }
+        else
+            URHO3D_LOGWARNING("Unknown attribute " + i->first_ + " in JSON data");
+    }
+}
+
+bool PrefabTemplate::LoadAnimationsXML(const XMLElement& source, SharedPtr<ObjectAnimation>& objectAnimation,
+    Vector<PrefabAttributeAnimation>& attributeAnimations) const
+{
+    XMLElement elem = source.GetChild("objectanimation");
+    if (elem)
+    {
+        objectAnimation = new ObjectAnimation(context_);
+        if (!objectAnimation->LoadXML(elem))
+            return false;
+    }
+
+    elem = source.GetChild("attributeanimation");
+    while (elem)
+    {
+        PrefabAttributeAnimation attributeAnimation;
+        attributeAnimation.name_ = elem.GetAttribute("name");
+        attributeAnimation.animation_ = new ValueAnimation(context_);
+        if (!attributeAnimation.animation_->LoadXML(elem))
+            return false;
+
+        attributeAnimation.wrapMode_ = ResolveWrapMode(elem.GetAttribute("wrapmode"));
+        attributeAnimation.speed_ = elem.GetFloat("speed");
+        attributeAnimations.Push(attributeAnimation);
+
+        elem = elem.GetNext("attributeanimation");
+    }
+
+    return true;
+}
+
+bool PrefabTemplate::LoadAnimationsJSON(const JSONValue& source, SharedPtr<ObjectAnimation>& objectAnimation,
+    Vector<PrefabAttributeAnimation>& attributeAnimations) const
+{
+    JSONValue value = source.Get("objectanimation");
+    if (!value.IsNull())
+    {
+        objectAnimation = new ObjectAnimation(context_);
+        if (!objectAnimation->LoadJSON(value))
+            return false;
+    }
+
+    JSONValue attributeAnimationValue = source.Get("attributeanimation");
+    if (attributeAnimationValue.IsNull())
+        return true;
+
+    if (!attributeAnimationValue.IsObject())
+    {
+        URHO3D_LOGWARNING("'attributeanimation' value is present in JSON data, but is not a JSON object; skipping it");
+        return true;
+    }
+
+    const JSONObject& attributeAnimationObject = attributeAnimationValue.GetObject();
+    for (JSONObject::ConstIterator i = attributeAnimationObject.Begin(); i != attributeAnimationObject.End(); ++i)
+    {
+        PrefabAttributeAnimation attributeAnimation;
+        attributeAnimation.name_ = i->first_;
+        attributeAnimation.animation_ = new ValueAnimation(context_);
+        if (!attributeAnimation.animation_->LoadJSON(i->second_))
+            return false;
+
+        attributeAnimation.wrapMode_ = ResolveWrapMode(i->second_.Get("wrapmode").GetString());
+        attributeAnimation.speed_ = i->second_.Get("speed").GetFloat();
+        attributeAnimations.Push(attributeAnimation);
+    }
+
+    return true;
+}
+
+void PrefabTemplate::ApplyToObject(Animatable* dest, const Vector<PrefabAttribute>& attributes, ObjectAnimation* objectAnimation,
+    const Vector<PrefabAttributeAnimation>& attributeAnimations) const
+{
+    // Set attributes like Serializable::Load() does, so that objects defer work such as bone node creation to ApplyAttributes()
+    dest->SetLoading(true);
+    const Vector<AttributeInfo>* destAttributes = dest->GetAttributes();
+    for (Vector<PrefabAttribute>::ConstIterator i = attributes.Begin(); i != attributes.End(); ++i)
+        dest->OnSetAttribute(destAttributes->At(i->index_), i->value_);
+    dest->SetLoading(false);
+
+    if (objectAnimation)
+        dest->SetObjectAnimation(objectAnimation);
+    for (Vector<PrefabAttributeAnimation>::ConstIterator i = attributeAnimations.Begin(); i != attributeAnimations.End(); ++i)
+        dest->SetAttributeAnimation(i->name_, i->animation_, i->wrapMode_, i->speed_);
+}
+
+void PrefabTemplate::PreloadResources(const Vector<PrefabAttribute>& attributes)
+{
+    auto* cache = GetSubsystem<ResourceCache>();
+
+    for (Vector<PrefabAttribute>::ConstIterator i = attributes.Begin(); i != attributes.End(); ++i)
+    {
+        if (i->value_.GetType() == VAR_RESOURCEREF)
+        {
+            const ResourceRef& ref = i->value_.GetResourceRef();
+            if (!ref.name_.Empty())
+                cache->BackgroundLoadResource(ref.type_, ref.name_, true, this);
+        }
+        else if (i->value_.GetType() == VAR_RESOURCEREFLIST)
+        {
+            const ResourceRefList& refList = i->value_.GetResourceRefList();
+            for (unsigned j = 0; j < refList.names_.Size(); ++j)
+            {
+                if (!refList.names_[j].Empty())
+                    cache->BackgroundLoadResource(refList.type_, refList.names_[j], true, this);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Core/Variant.h"
+#include "../Resource/Resource.h"
+#include "../Scene/AnimationDefs.h"
+#include "../Scene/Node.h"
+
+namespace Urho3D
+{
+
+class Animatable;
+class JSONValue;
+class ObjectAnimation;
+class SceneResolver;
+class ValueAnimation;
+class XMLElement;
+
+/// Pre-resolved attribute value of a prefab node or component.
+struct PrefabAttribute
+{
+    /// Index into the object type's attribute list.
+    unsigned index_;
+    /// Attribute value converted to the attribute's type.
+    Variant value_;
+};
+
+/// Attribute animation of a prefab node or component.
+struct PrefabAttributeAnimation
+{
+    /// Animated attribute name.
+    String name_;
+    /// Value animation, shared by all instances.
+    SharedPtr<ValueAnimation> animation_;
+    /// Wrap mode.
+    WrapMode wrapMode_;
+    /// Speed.
+    float speed_;
+};
+
+/// Pre-resolved component of a prefab node.
+struct PrefabComponent
+{
+    /// Component type. For an unknown type, the type of the stored component.
+    StringHash type_;
+    /// Type name from XML or JSON data, used for unknown component placeholders.
+    String typeName_;
+    /// Component ID in the source data, used for resolving ID references.
+    unsigned id_;
+    /// Whether the type is not known and an UnknownComponent placeholder is created instead.
+    bool unknown_;
+    /// Attribute values in load order.
+    Vector<PrefabAttribute> attributes_;
+    /// Object animation without a resource name, shared by all instances.
+    SharedPtr<ObjectAnimation> objectAnimation_;
+    /// Attribute animations.
+    Vector<PrefabAttributeAnimation> attributeAnimations_;
+};
+
+/// Pre-resolved node of a prefab. Nodes are stored depth-first, so a parent always precedes its children.
+struct PrefabNode
+{
+    /// Node ID in the source data, used for resolving ID references.
+    unsigned id_;
+    /// Index of the parent node in the template, or M_MAX_UNSIGNED for the root.
+    unsigned parentIndex_;
+    /// Attribute values in load order.
+    Vector<PrefabAttribute> attributes_;
+    /// Object animation without a resource name, shared by all instances.
+    SharedPtr<ObjectAnimation> objectAnimation_;
+    /// Attribute animations.
+    Vector<PrefabAttributeAnimation> attributeAnimations_;
+    /// Components.
+    Vector<PrefabComponent> components_;
+};
+
+/// Object prefab compiled from binary, XML or JSON node data. Component types and attribute values are resolved once on load, so that instantiating does not need to parse the source again.
+class URHO3D_API PrefabTemplate : public Resource
+{
+    URHO3D_OBJECT(PrefabTemplate, Resource);
+
+public:
+    /// Construct.
+    explicit PrefabTemplate(Context* context);
+    /// Destruct.
+    ~PrefabTemplate() override;
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Load resource from stream. May be called from a worker thread. Return true if successful.
+    bool BeginLoad(Deserializer& source) override;
+
+    /// Compile from binary node data. Return true if successful.
+    bool Load(Deserializer& source);
+    /// Compile from XML node data. Return true if successful.
+    bool LoadXML(const XMLElement& source);
+    /// Compile from JSON node data. Return true if successful.
+    bool LoadJSON(const JSONValue& source);
+
+    /// Create the prefab hierarchy as a child of the parent node. Attributes are set like in Node::Load(), so work deferred to ApplyAttributes() is not done yet. Node and component ID references are registered to the resolver, which the caller must resolve before applying attributes. Return the root node, or null if the template is empty.
+    Node* CreateNodes(Node* parent, SceneResolver& resolver, CreateMode mode = REPLICATED) const;
+
+    /// Return compiled nodes.
+    const Vector<PrefabNode>& GetNodes() const { return nodes_; }
+
+    /// Return number of compiled nodes.
+    unsigned GetNumNodes() const { return nodes_.Size(); }
+
+    /// Return total number of compiled components.
+    unsigned GetNumComponents() const { return numComponents_; }
+
+private:
+    /// Compile a node and its children from binary data.
+    bool LoadNode(Deserializer& source, unsigned parentIndex);
+    /// Compile a node and its children from XML data.
+    bool LoadNodeXML(const XMLElement& source, unsigned parentIndex);
+    /// Compile a node and its children from JSON data.
+    bool LoadNodeJSON(const JSONValue& source, unsigned parentIndex);
+    /// Compile attributes of an object type from binary data.
+    bool LoadAttributes(Deserializer& source, StringHash type, Vector<PrefabAttribute>& dest) const;
+    /// Compile attributes of an object type from XML data.
+    void LoadAttributesXML(const XMLElement& source, StringHash type, Vector<PrefabAttribute>& dest) const;
+    /// Compile attributes of an object type from JSON data.
+    void LoadAttributesJSON(const JSONValue& source, StringHash type, Vector<PrefabAttribute>& dest) const;
+    /// Compile object and attribute animations from XML data. Return true if successful.
+    bool LoadAnimationsXML(const XMLElement& source, SharedPtr<ObjectAnimation>& objectAnimation,
+        Vector<PrefabAttributeAnimation>& attributeAnimations) const;
+    /// Compile object and attribute animations from JSON data. Return true if successful.
+    bool LoadAnimationsJSON(const JSONValue& source, SharedPtr<ObjectAnimation>& objectAnimation,
+        Vector<PrefabAttributeAnimation>& attributeAnimations) const;
+    /// Apply compiled attributes and animations to a newly created node or component.
+    void ApplyToObject(Animatable* dest, const Vector<PrefabAttribute>& attributes, ObjectAnimation* objectAnimation,
+        const Vector<PrefabAttributeAnimation>& attributeAnimations) const;
+    /// Request background loading of resources referenced by the compiled attributes.
+    void PreloadResources(const Vector<PrefabAttribute>& attributes);
+
+    /// Compiled nodes, depth-first.
+    Vector<PrefabNode> nodes_;
+    /// Total number of compiled components.
+    unsigned numComponents_;
+};
+
+}
@@ -22,6 +22,7 @@
 
 #include "../Precompiled.h"
 
+#include "../Container/Sort.h"
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
 #include "../Core/Profiler.h"
@@ -35,10 +36,12 @@
 #include "../Resource/JSONFile.h"
 #include "../Scene/Component.h"
 #include "../Scene/ObjectAnimation.h"
+#include "../Scene/PrefabTemplate.h"
 #include "../Scene/ReplicationState.h"
 #include "../Scene/Scene.h"
 #include "../Scene/SceneEvents.h"
 #include "../Scene/SmoothedTransform.h"
+#include "../Scene/SpatialHash.h"
 #include "../Scene/SplinePath.h"
 #include "../Scene/UnknownComponent.h"
 #include "../Scene/ValueAnimation.h"
@@ -59,22 +62,59 @@ const char* SUBSYSTEM_CATEGORY = "Subsystem";
 
 static const float DEFAULT_SMOOTHING_CONSTANT = 50.0f;
 static const float DEFAULT_SNAP_THRESHOLD = 5.0f;
+/// Minimum number of batched attribute animations to evaluate them in worker threads.
+static const unsigned MIN_THREADED_ANIMATION_EVALUATIONS = 64;
+
+void EvaluateAttributeAnimationsWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* values = reinterpret_cast<float*>(item->aux_);
+    auto* start = reinterpret_cast<AttributeAnimationEvaluation*>(item->start_);
+    auto* end = reinterpret_cast<AttributeAnimationEvaluation*>(item->end_);
+
+    while (start != end)
+    {
+        if (start->valueOffset_ != M_MAX_UNSIGNED)
+            start->scaledTime_ = start->info_->Evaluate(start->timeStep_, values + start->valueOffset_, start->finished_);
+        ++start;
+    }
+}
+
+/// Return depth of a node below the scene, or M_MAX_UNSIGNED if the node or one of its parents is temporary and therefore not saved.
+static unsigned GetSavedNodeDepth(const Node* node)
+{
+    unsigned depth = 0;
+    while (node)
+    {
+        if (node->IsTemporary())
+            return M_MAX_UNSIGNED;
+        node = node->GetParent();
+        ++depth;
+    }
+    return depth;
+}
 
 Scene::Scene(Context* context) :
     Node(context),
+    replicatedNodes_(FIRST_REPLICATED_ID),
+    localNodes_(FIRST_LOCAL_ID),
+    replicatedComponents_(FIRST_REPLICATED_ID),
+    localComponents_(FIRST_LOCAL_ID),
     replicatedNodeID_(FIRST_REPLICATED_ID),
     replicatedComponentID_(FIRST_REPLICATED_ID),
     localNodeID_(FIRST_LOCAL_ID),
     localComponentID_(FIRST_LOCAL_ID),
     checksum_(0),
     asyncLoadingMs_(5),
+    detachedReleaseMs_(2),
     timeScale_(1.0f),
     elapsedTime_(0),
     smoothingConstant_(DEFAULT_SMOOTHING_CONSTANT),
     snapThreshold_(DEFAULT_SNAP_THRESHOLD),
     updateEnabled_(true),
     asyncLoading_(false),
-    threadedUpdate_(false)
+    threadedUpdate_(false),
+    batchRemoving_(false),
+    changeTracking_(false)
 {
     // Assign an ID to self so that nodes can refer to this node as a parent
     SetID(GetFreeNodeID(REPLICATED));
@@ -92,10 +132,13 @@ Scene::~Scene()
     RemoveAllChildren();
 
     // Remove scene reference and owner from all nodes that still exist
-    for (HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
-        i->second_->ResetScene();
-    for (HashMap<unsigned, Node*>::Iterator i = localNodes_.Begin(); i != localNodes_.End(); ++i)
-        i->second_->ResetScene();
+    PODVector<Node*> nodes;
+    replicatedNodes_.GetObjects(nodes);
+    for (PODVector<Node*>::Iterator i = nodes.Begin(); i != nodes.End(); ++i)
+        (*i)->ResetScene();
+    localNodes_.GetObjects(nodes);
+    for (PODVector<Node*>::Iterator i = nodes.Begin(); i != nodes.End(); ++i)
+        (*i)->ResetScene();
 }
 
 void Scene::RegisterObject(Context* context)
@@ -203,6 +246,8 @@ bool Scene::LoadJSON(const JSONValue& source)
 
 void Scene::MarkNetworkUpdate()
 {
+    MarkChanged(this);
+
     if (!networkUpdate_)
     {
         MarkNetworkUpdate(this);
@@ -215,8 +260,10 @@ void Scene::AddReplicationState(NodeReplicationState* state)
     Node::AddReplicationState(state);
 
     // This is the first update for a new connection. Mark all replicated nodes dirty
-    for (HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
-        state->sceneState_->dirtyNodes_.Insert(i->first_);
+    PODVector<Node*> nodes;
+    replicatedNodes_.GetObjects(nodes);
+    for (PODVector<Node*>::ConstIterator i = nodes.Begin(); i != nodes.End(); ++i)
+        state->sceneState_->dirtyNodes_.Insert((*i)->GetID());
 }
 
 bool Scene::LoadXML(Deserializer& source)
@@ -346,6 +393,8 @@ bool Scene::LoadAsync(File* file, LoadMode mode)
     asyncProgress_.mode_ = mode;
     asyncProgress_.loadedNodes_ = asyncProgress_.totalNodes_ = asyncProgress_.loadedResources_ = asyncProgress_.totalResources_ = 0;
     asyncProgress_.resources_.Clear();
+    asyncProgress_.deferSceneSet_ = mode > LOAD_RESOURCES_ONLY;
+    asyncLoadTimings_.Clear();
 
     if (mode > LOAD_RESOURCES_ONLY)
     {
@@ -410,6 +459,8 @@ bool Scene::LoadAsyncXML(File* file, LoadMode mode)
     asyncProgress_.mode_ = mode;
     asyncProgress_.loadedNodes_ = asyncProgress_.totalNodes_ = asyncProgress_.loadedResources_ = asyncProgress_.totalResources_ = 0;
     asyncProgress_.resources_.Clear();
+    asyncProgress_.deferSceneSet_ = mode > LOAD_RESOURCES_ONLY;
+    asyncLoadTimings_.Clear();
 
     if (mode > LOAD_RESOURCES_ONLY)
     {
@@ -479,6 +530,8 @@ bool Scene::LoadAsyncJSON(File* file, LoadMode mode)
     asyncProgress_.mode_ = mode;
     asyncProgress_.loadedNodes_ = asyncProgress_.totalNodes_ = asyncProgress_.loadedResources_ = asyncProgress_.totalResources_ = 0;
     asyncProgress_.resources_.Clear();
+    asyncProgress_.deferSceneSet_ = mode > LOAD_RESOURCES_ONLY;
+    asyncLoadTimings_.Clear();
 
     if (mode > LOAD_RESOURCES_ONLY)
     {
@@ -527,6 +580,19 @@ void Scene::StopAsyncLoading()
     asyncProgress_.xmlElement_ = XMLElement::EMPTY;
     asyncProgress_.jsonIndex_ = 0;
     asyncProgress_.resources_.Clear();
+
+    // Components whose scene assignment was deferred need it even if the loading was stopped
+    asyncProgress_.deferSceneSet_ = false;
+    for (unsigned i = asyncProgress_.sceneSetComponents_; i < asyncProgress_.components_.Size(); ++i)
+    {
+        Component* component = asyncProgress_.components_[i];
+        if (component && component->GetID() && component->GetScene() == this && component->GetNode() != this)
+            component->OnSceneSet(this);
+    }
+    asyncProgress_.components_.Clear();
+    asyncProgress_.sceneSetComponents_ = 0;
+    asyncProgress_.appliedComponents_ = 0;
+    asyncProgress_.resolved_ = false;
     resolver_.Reset();
 }
 
@@ -617,6 +683,292 @@ Node* Scene::InstantiateJSON(Deserializer& source, const Vector3& position, cons
     return InstantiateJSON(json->GetRoot(), position, rotation, mode);
 }
 
+Node* Scene::Instantiate(PrefabTemplate* prefab, const Vector3& position, const Quaternion& rotation, CreateMode mode)
+{
+    if (!prefab)
+    {
+        URHO3D_LOGERROR("Null prefab template for instantiation");
+        return nullptr;
+    }
+
+    URHO3D_PROFILE(InstantiatePrefab);
+
+    SceneResolver resolver;
+    Node* node = prefab->CreateNodes(this, resolver, mode);
+    if (!node)
+        return nullptr;
+
+    resolver.Resolve();
+    node->SetTransform(position, rotation);
+    node->ApplyAttributes();
+    return node;
+}
+
+unsigned Scene::Instantiate(PrefabTemplate* prefab, const PODVector<Vector3>& positions, const PODVector<Quaternion>& rotations,
+    PODVector<Node*>& dest, CreateMode mode)
+{
+    if (!prefab)
+    {
+        URHO3D_LOGERROR("Null prefab template for instantiation");
+        return 0;
+    }
+
+    if (positions.Size() != rotations.Size())
+    {
+        URHO3D_LOGERROR("Mismatching position and rotation counts for prefab instantiation");
+        return 0;
+    }
+
+    URHO3D_PROFILE(InstantiatePrefabBatch);
+
+    unsigned startIndex = dest.Size();
+    dest.Reserve(startIndex + positions.Size());
+
+    // The resolver resets itself after each resolve, so it can be reused for all instances
+    SceneResolver resolver;
+    for (unsigned i = 0; i < positions.Size(); ++i)
+    {
+        Node* node = prefab->CreateNodes(this, resolver, mode);
+        if (!node)
+            break;
+
+        resolver.Resolve();
+        node->SetTransform(positions[i], rotations[i]);
+        dest.Push(node);
+    }
+
+    // Apply attributes only after all instances exist, so that components see a consistent scene
+    for (unsigned i = startIndex; i < dest.Size(); ++i)
+        dest[i]->ApplyAttributes();
+
+    return dest.Size() - startIndex;
+}
+
+bool Scene::DetachNode(Node* node)
+{
+    if (!node || node == this || node->GetScene() != this || !node->GetParent())
+    {
+        URHO3D_LOGERROR("Null node or node not in scene for detaching");
+        return false;
+    }
+
+    if (batchRemoving_)
+    {
+        URHO3D_LOGERROR("Can not detach a node while another is being detached");
+        return false;
+    }
+
+    URHO3D_PROFILE(DetachNode);
+
+    SharedPtr<Node> root(node);
+    PODVector<Node*> children;
+    node->GetChildren(children, true);
+
+    // Subsystems queue the removals of the subtree's components and perform them in one pass when the batch finishes
+    batchRemoving_ = true;
+    node->Remove();
+    batchRemoving_ = false;
+
+    using namespace SceneBatchRemoved;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_SCENE] = this;
+    SendEvent(E_SCENEBATCHREMOVED, eventData);
+
+    // Defer destruction. Parents are queued before their children, and nodes are destroyed from the back of the queue
+    detachedNodes_.Reserve(detachedNodes_.Size() + children.Size() + 1);
+    detachedNodes_.Push(root);
+    for (PODVector<Node*>::ConstIterator i = children.Begin(); i != children.End(); ++i)
+        detachedNodes_.Push(SharedPtr<Node>(*i));
+
+    return true;
+}
+
+bool Scene::SaveChanges(Serializer& dest)
+{
+    URHO3D_PROFILE(SaveSceneChanges);
+
+    if (!changeTracking_)
+    {
+        URHO3D_LOGERROR("Could not save scene changes, change tracking is not enabled");
+        return false;
+    }
+
+    if (!dest.WriteFileID("UCHG"))
+    {
+        URHO3D_LOGERROR("Could not save scene changes, writing to stream failed");
+        return false;
+    }
+
+    // Write removals first, so that an ID that was removed and then reused is recreated when the changes are loaded
+    dest.WriteVLE(removedComponents_.Size());
+    for (HashSet<unsigned>::ConstIterator i = removedComponents_.Begin(); i != removedComponents_.End(); ++i)
+        dest.WriteUInt(*i);
+    dest.WriteVLE(removedNodes_.Size());
+    for (HashSet<unsigned>::ConstIterator i = removedNodes_.Begin(); i != removedNodes_.End(); ++i)
+        dest.WriteUInt(*i);
+
+    // Write changed nodes ordered by depth, so that a new node's parent always exists when the node is loaded
+    PODVector<Pair<unsigned, Node*> > nodes;
+    nodes.Reserve(changedNodes_.Size());
+    for (HashSet<unsigned>::ConstIterator i = changedNodes_.Begin(); i != changedNodes_.End(); ++i)
+    {
+        Node* node = GetNode(*i);
+        unsigned depth = GetSavedNodeDepth(node);
+        if (node && depth != M_MAX_UNSIGNED)
+            nodes.Push(MakePair(depth, node));
+    }
+    Sort(nodes.Begin(), nodes.End());
+
+    dest.WriteVLE(nodes.Size());
+    for (PODVector<Pair<unsigned, Node*> >::ConstIterator i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Node* node = i->second_;
+        Node* parent = node->GetParent();
+        dest.WriteUInt(node->GetID());
+        dest.WriteUInt(parent ? parent->GetID() : 0);
+        if (!node->Animatable::Save(dest))
+            return false;
+    }
+
+    PODVector<Component*> components;
+    components.Reserve(changedComponents_.Size());
+    for (HashSet<unsigned>::ConstIterator i = changedComponents_.Begin(); i != changedComponents_.End(); ++i)
+    {
+        Component* component = GetComponent(*i);
+        if (component && !component->IsTemporary() && GetSavedNodeDepth(component->GetNode()) != M_MAX_UNSIGNED)
+            components.Push(component);
+    }
+
+    // Write components to separate buffers like in a full save, to be able to skip failing components when loading
+    dest.WriteVLE(components.Size());
+    VectorBuffer compBuffer;
+    for (PODVector<Component*>::ConstIterator i = components.Begin(); i != components.End(); ++i)
+    {
+        compBuffer.Clear();
+        if (!(*i)->Save(compBuffer))
+            return false;
+        dest.WriteUInt((*i)->GetNode()->GetID());
+        dest.WriteVLE(compBuffer.GetSize());
+        dest.Write(compBuffer.GetData(), compBuffer.GetSize());
+    }
+
+    ClearChanges();
+    return true;
+}
+
+bool Scene::LoadChanges(Deserializer& source)
+{
+    URHO3D_PROFILE(LoadSceneChanges);
+
+    StopAsyncLoading();
+
+    Vector<WeakPtr<Component> > loadedComponents;
+
+    // The source may contain several appended change sets, apply them in order
+    while (!source.IsEof())
+    {
+        if (source.ReadFileID() != "UCHG")
+        {
+            URHO3D_LOGERROR(source.GetName() + " is not a valid scene change file");
+            return false;
+        }
+
+        unsigned numRemoved = source.ReadVLE();
+        for (unsigned i = 0; i < numRemoved; ++i)
+        {
+            Component* component = GetComponent(source.ReadUInt());
+            if (component)
+                component->Remove();
+        }
+        numRemoved = source.ReadVLE();
+        for (unsigned i = 0; i < numRemoved; ++i)
+        {
+            Node* node = GetNode(source.ReadUInt());
+            if (node && node != this)
+                node->Remove();
+        }
+
+        unsigned numNodes = source.ReadVLE();
+        for (unsigned i = 0; i < numNodes; ++i)
+        {
+            unsigned nodeID = source.ReadUInt();
+            unsigned parentID = source.ReadUInt();
+
+            // A node without parent is the scene itself
+            Node* node = this;
+            if (parentID)
+            {
+                Node* parent = GetNode(parentID);
+                if (!parent)
+                {
+                    URHO3D_LOGERROR("Could not load scene changes, parent of node " + String(nodeID) + " not found");
+                    return false;
+                }
+
+                node = GetNode(nodeID);
+                if (!node)
+                    node = parent->CreateChild(String::EMPTY, IsReplicatedID(nodeID) ? REPLICATED : LOCAL, nodeID);
+                else if (node->GetParent() != parent)
+                    parent->AddChild(node);
+            }
+
+            if (!node->Animatable::Load(source))
+                return false;
+        }
+
+        unsigned numComponents = source.ReadVLE();
+        for (unsigned i = 0; i < numComponents; ++i)
+        {
+            unsigned nodeID = source.ReadUInt();
+            VectorBuffer compBuffer(source, source.ReadVLE());
+            StringHash compType = compBuffer.ReadStringHash();
+            unsigned compID = compBuffer.ReadUInt();
+
+            Node* node = GetNode(nodeID);
+            if (!node)
+            {
+                URHO3D_LOGWARNING("Node of changed component " + String(compID) + " not found");
+                continue;
+            }
+
+            Component* component = GetComponent(compID);
+            if (component && (component->GetType() != compType || component->GetNode() != node))
+            {
+                component->Remove();
+                component = nullptr;
+            }
+            if (!component)
+                component = node->CreateComponent(compType, IsReplicatedID(compID) ? REPLICATED : LOCAL, compID);
+
+            if (component)
+            {
+                // Do not abort if component fails to load, as the component buffer is nested and we can skip to the next
+                component->Load(compBuffer);
+                loadedComponents.Push(WeakPtr<Component>(component));
+            }
+        }
+    }
+
+    for (Vector<WeakPtr<Component> >::Iterator i = loadedComponents.Begin(); i != loadedComponents.End(); ++i)
+    {
+        if (*i)
+            (*i)->ApplyAttributes();
+    }
+
+    // The loaded state is the base of the next change set
+    ClearChanges();
+    return true;
+}
+
+void Scene::ClearChanges()
+{
+    changedNodes_.Clear();
+    changedComponents_.Clear();
+    removedNodes_.Clear();
+    removedComponents_.Clear();
+}
+
 void Scene::Clear(bool clearReplicated, bool clearLocal)
 {
     StopAsyncLoading();
@@ -674,6 +1026,18 @@ void Scene::SetAsyncLoadingMs(int ms)
     asyncLoadingMs_ = Max(ms, 1);
 }
 
+void Scene::SetDetachedReleaseMs(int ms)
+{
+    detachedReleaseMs_ = Max(ms, 1);
+}
+
+void Scene::SetChangeTracking(bool enable)
+{
+    changeTracking_ = enable;
+    if (!enable)
+        ClearChanges();
+}
+
 void Scene::SetElapsedTime(float time)
 {
     elapsedTime_ = time;
@@ -710,16 +1074,17 @@ void Scene::UnregisterAllVars()
 
 Node* Scene::GetNode(unsigned id) const
 {
-    if (IsReplicatedID(id))
-    {
-        HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Find(id);
-        return i != replicatedNodes_.End() ? i->second_ : nullptr;
-    }
-    else
-    {
-        HashMap<unsigned, Node*>::ConstIterator i = localNodes_.Find(id);
-        return i != localNodes_.End() ? i->second_ : nullptr;
-    }
+    return IsReplicatedID(id) ? replicatedNodes_.Get(id) : localNodes_.Get(id);
+}
+
+Node* Scene::GetNode(unsigned id, unsigned generation) const
+{
+    return IsReplicatedID(id) ? replicatedNodes_.Get(id, generation) : localNodes_.Get(id, generation);
+}
+
+unsigned Scene::GetNodeGeneration(unsigned id) const
+{
+    return IsReplicatedID(id) ? replicatedNodes_.GetGeneration(id) : localNodes_.GetGeneration(id);
 }
 
 bool Scene::GetNodesWithTag(PODVector<Node*>& dest, const String& tag) const
@@ -735,20 +1100,57 @@ bool Scene::GetNodesWithTag(PODVector<Node*>& dest, const String& tag) const
         return false;
 }
 
-Component* Scene::GetComponent(unsigned id) const
+const PODVector<Component*>& Scene::GetComponentsOfType(StringHash type) const
 {
-    if (IsReplicatedID(id))
+    static const PODVector<Component*> noComponents;
+
+    HashMap<StringHash, PODVector<Component*> >::ConstIterator i = componentsByType_.Find(type);
+    return i != componentsByType_.End() ? i->second_ : noComponents;
+}
+
+void Scene::GetDerivedComponentsOfType(PODVector<Component*>& dest, StringHash type, bool clearVector) const
+{
+    if (clearVector)
+        dest.Clear();
+
+    // Components are stored by exact type, so check each populated type array for inheritance once
+    for (HashMap<StringHash, PODVector<Component*> >::ConstIterator i = componentsByType_.Begin(); i != componentsByType_.End();
+         ++i)
     {
-        HashMap<unsigned, Component*>::ConstIterator i = replicatedComponents_.Find(id);
-        return i != replicatedComponents_.End() ? i->second_ : nullptr;
+        const PODVector<Component*>& typeComponents = i->second_;
+        if (!typeComponents.Empty() && typeComponents.Front()->GetTypeInfo()->IsTypeOf(type))
+            dest.Push(typeComponents);
     }
-    else
+}
+
+void Scene::GetEnabledComponentsOfType(PODVector<Component*>& dest, StringHash type, bool clearVector) const
+{
+    if (clearVector)
+        dest.Clear();
+
+    const PODVector<Component*>& typeComponents = GetComponentsOfType(type);
+    for (PODVector<Component*>::ConstIterator i = typeComponents.Begin(); i != typeComponents.End(); ++i)
     {
-        HashMap<unsigned, Component*>::ConstIterator i = localComponents_.Find(id);
-        return i != localComponents_.End() ? i->second_ : nullptr;
+        if ((*i)->IsEnabledEffective())
+            dest.Push(*i);
     }
 }
 
+Component* Scene::GetComponent(unsigned id) const
+{
+    return IsReplicatedID(id) ? replicatedComponents_.Get(id) : localComponents_.Get(id);
+}
+
+Component* Scene::GetComponent(unsigned id, unsigned generation) const
+{
+    return IsReplicatedID(id) ? replicatedComponents_.Get(id, generation) : localComponents_.Get(id, generation);
+}
+
+unsigned Scene::GetComponentGeneration(unsigned id) const
+{
+    return IsReplicatedID(id) ? replicatedComponents_.GetGeneration(id) : localComponents_.GetGeneration(id);
+}
+
 float Scene::GetAsyncProgress() const
 {
     return !asyncLoading_ || asyncProgress_.totalNodes_ + asyncProgress_.totalResources_ == 0 ? 1.0f :
@@ -764,6 +1166,9 @@ const String& Scene::GetVarName(StringHash hash) const
 
 void Scene::Update(float timeStep)
 {
+    if (!detachedNodes_.Empty())
+        ReleaseDetachedNodes();
+
     if (asyncLoading_)
     {
         UpdateAsyncLoading();
@@ -785,7 +1190,10 @@ void Scene::Update(float timeStep)
     // Update variable timestep logic
     SendEvent(E_SCENEUPDATE, eventData);
 
-    // Update scene attribute animation.
+    // Update scene attribute animation. Attribute setters and event frames may have reused the event data map, so refill it
+    UpdateAnimatables(timeStep);
+    eventData[P_SCENE] = this;
+    eventData[P_TIMESTEP] = timeStep;
     SendEvent(E_ATTRIBUTEANIMATIONUPDATE, eventData);
 
     // Update scene subsystems. If a physics world is present, it will be updated, triggering fixed timestep logic updates
@@ -814,6 +1222,154 @@ void Scene::Update(float timeStep)
     elapsedTime_ += timeStep;
 }
 
+void Scene::ReleaseDetachedNodes()
+{
+    URHO3D_PROFILE(ReleaseDetachedNodes);
+
+    HiresTimer releaseTimer;
+
+    while (!detachedNodes_.Empty())
+    {
+        // Detach from the parent so that dropping the last reference destroys only this node. If the node has been added
+        // back to a scene meanwhile, just let go of it
+        Node* node = detachedNodes_.Back();
+        if (!node->GetScene())
+            node->Remove();
+        detachedNodes_.Pop();
+
+        if (releaseTimer.GetUSec(false) >= detachedReleaseMs_ * 1000LL)
+            break;
+    }
+}
+
+void Scene::UpdateAnimatables(float timeStep)
+{
+    if (animatables_.Empty())
+        return;
+
+    URHO3D_PROFILE(UpdateAttributeAnimations);
+
+    // Gather the attribute animations of all nodes and components. Float-based values get a slot in the value array for
+    // batched evaluation, others are updated through Variant interpolation when applying
+    unsigned numValues = 0;
+    for (HashMap<Animatable*, WeakPtr<Animatable> >::Iterator i = animatables_.Begin(); i != animatables_.End();)
+    {
+        Animatable* animatable = i->second_;
+        if (!animatable || !animatable->GetNumAttributeAnimations())
+        {
+            i = animatables_.Erase(i);
+            continue;
+        }
+        ++i;
+
+        if (!animatable->GetAnimationEnabled())
+            continue;
+
+        const HashMap<String, SharedPtr<AttributeAnimationInfo> >& infos = animatable->GetAttributeAnimationInfos();
+        for (HashMap<String, SharedPtr<AttributeAnimationInfo> >::ConstIterator j = infos.Begin(); j != infos.End(); ++j)
+        {
+            AttributeAnimationEvaluation evaluation;
+            evaluation.info_ = j->second_;
+            evaluation.valueOffset_ = M_MAX_UNSIGNED;
+            evaluation.scaledTime_ = 0.0f;
+            evaluation.timeStep_ = timeStep;
+            evaluation.finished_ = false;
+
+            ValueAnimation* animation = j->second_->GetAnimation();
+            unsigned numComponents = animation ? animation->GetNumFloatComponents() : 0;
+            if (numComponents && animation->IsValid() && !animation->GetKeyFrames().Empty())
+            {
+                // Build the key caches now, as evaluation may happen in worker threads
+                animation->PrepareEvaluation();
+                evaluation.valueOffset_ = numValues;
+                numValues += numComponents;
+            }
+
+            animationEvaluations_.Push(evaluation);
+        }
+    }
+
+    if (animationEvaluations_.Empty())
+        return;
+
+    animationValues_.Resize(numValues);
+
+    if (numValues)
+    {
+        URHO3D_PROFILE(EvaluateAttributeAnimations);
+
+        auto* queue = GetSubsystem<WorkQueue>();
+        if (queue && queue->GetNumThreads() && animationEvaluations_.Size() >= MIN_THREADED_ANIMATION_EVALUATIONS)
+        {
+            int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
+            int evaluationsPerItem = Max((int)(animationEvaluations_.Size() / numWorkItems), 1);
+
+            Vector<AttributeAnimationEvaluation>::Iterator start = animationEvaluations_.Begin();
+            for (int i = 0; i < numWorkItems; ++i)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->priority_ = M_MAX_UNSIGNED;
+                item->workFunction_ = EvaluateAttributeAnimationsWork;
+                item->aux_ = animationValues_.Buffer();
+
+                Vector<AttributeAnimationEvaluation>::Iterator end = animationEvaluations_.End();
+                if (i < numWorkItems - 1 && end - start > evaluationsPerItem)
+                    end = start + evaluationsPerItem;
+
+                item->start_ = &(*start);
+                item->end_ = &(*end);
+                queue->AddWorkItem(item);
+
+                start = end;
+            }
+
+            queue->Complete(M_MAX_UNSIGNED);
+        }
+        else
+        {
+            for (Vector<AttributeAnimationEvaluation>::Iterator i = animationEvaluations_.Begin(); i != animationEvaluations_.End(); ++i)
+            {
+                if (i->valueOffset_ != M_MAX_UNSIGNED)
+                    i->scaledTime_ = i->info_->Evaluate(timeStep, &animationValues_[i->valueOffset_], i->finished_);
+            }
+        }
+    }
+
+    // Apply in the main thread, as attribute setters and event frames are not thread-safe
+    for (Vector<AttributeAnimationEvaluation>::Iterator i = animationEvaluations_.Begin(); i != animationEvaluations_.End(); ++i)
+    {
+        AttributeAnimationInfo* info = i->info_;
+        // The target may have been destroyed by an event sent during an earlier animation
+        if (!info->GetTarget())
+        {
+            i->finished_ = false;
+            continue;
+        }
+
+        if (i->valueOffset_ != M_MAX_UNSIGNED)
+        {
+            i->finished_ = info->Apply(info->GetAnimation()->GetValueFromFloats(&animationValues_[i->valueOffset_]),
+                i->scaledTime_, i->finished_);
+        }
+        else
+            i->finished_ = info->Update(timeStep);
+    }
+
+    for (Vector<AttributeAnimationEvaluation>::Iterator i = animationEvaluations_.Begin(); i != animationEvaluations_.End(); ++i)
+    {
+        if (!i->finished_)
+            continue;
+
+        AttributeAnimationInfo* info = i->info_;
+        auto* animatable = static_cast<Animatable*>(info->GetTarget());
+        const String& name = info->GetAttributeInfo().name_;
+        if (animatable && animatable->GetAttributeAnimation(name) == info->GetAnimation())
+            animatable->RemoveAttributeAnimation(name);
+    }
+
+    animationEvaluations_.Clear();
+}
+
 void Scene::BeginThreadedUpdate()
 {
     // Check the work queue subsystem whether it actually has created worker threads. If not, do not enter threaded mode.
@@ -931,29 +1487,31 @@ void Scene::NodeAdded(Node* node)
     // If node with same ID exists, remove the scene reference from it and overwrite with the new node
     if (IsReplicatedID(id))
     {
-        HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Find(id);
-        if (i != replicatedNodes_.End() && i->second_ != node)
+        Node* existing = replicatedNodes_.Get(id);
+        if (existing && existing != node)
         {
             URHO3D_LOGWARNING("Overwriting node with ID " + String(id));
-            NodeRemoved(i->second_);
+            NodeRemoved(existing);
         }
 
-        replicatedNodes_[id] = node;
+        replicatedNodes_.Set(id, node);
 
         MarkNetworkUpdate(node);
         MarkReplicationDirty(node);
     }
     else
     {
-        HashMap<unsigned, Node*>::Iterator i = localNodes_.Find(id);
-        if (i != localNodes_.End() && i->second_ != node)
+        Node* existing = localNodes_.Get(id);
+        if (existing && existing != node)
         {
             URHO3D_LOGWARNING("Overwriting node with ID " + String(id));
-            NodeRemoved(i->second_);
+            NodeRemoved(existing);
         }
-        localNodes_[id] = node;
+        localNodes_.Set(id, node);
     }
 
+    MarkChanged(node);
+
     // Cache tag if already tagged.
     if (!node->GetTags().Empty())
     {
@@ -962,6 +1520,9 @@ void Scene::NodeAdded(Node* node)
             taggedNodes_[tags[i]].Push(node);
     }
 
+    if (node->GetNumAttributeAnimations())
+        AnimatableAdded(node);
+
     // Add already created components and child nodes now
     const Vector<SharedPtr<Component> >& components = node->GetComponents();
     for (Vector<SharedPtr<Component> >::ConstIterator i = components.Begin(); i != components.End(); ++i)
@@ -995,7 +1556,14 @@ void Scene::NodeRemoved(Node* node)
     else
         localNodes_.Erase(id);
 
+    if (changeTracking_)
+    {
+        changedNodes_.Erase(id);
+        removedNodes_.Insert(id);
+    }
+
     node->ResetScene();
+    AnimatableRemoved(node);
 
     // Remove node from tag cache
     if (!node->GetTags().Empty())
@@ -1030,28 +1598,50 @@ void Scene::ComponentAdded(Component* component)
 
     if (IsReplicatedID(id))
     {
-        HashMap<unsigned, Component*>::Iterator i = replicatedComponents_.Find(id);
-        if (i != replicatedComponents_.End() && i->second_ != component)
+        Component* existing = replicatedComponents_.Get(id);
+        if (existing && existing != component)
         {
             URHO3D_LOGWARNING("Overwriting component with ID " + String(id));
-            ComponentRemoved(i->second_);
+            ComponentRemoved(existing);
         }
 
-        replicatedComponents_[id] = component;
+        replicatedComponents_.Set(id, component);
     }
     else
     {
-        HashMap<unsigned, Component*>::Iterator i = localComponents_.Find(id);
-        if (i != localComponents_.End() && i->second_ != component)
+        Component* existing = localComponents_.Get(id);
+        if (existing && existing != component)
         {
             URHO3D_LOGWARNING("Overwriting component with ID " + String(id));
-            ComponentRemoved(i->second_);
+            ComponentRemoved(existing);
         }
 
-        localComponents_[id] = component;
+        localComponents_.Set(id, component);
     }
 
-    component->OnSceneSet(this);
+    MarkChanged(component);
+
+    if (component->sceneTypeIndex_ == M_MAX_UNSIGNED)
+    {
+        PODVector<Component*>& typeComponents = componentsByType_[component->GetType()];
+        component->sceneTypeIndex_ = typeComponents.Size();
+        typeComponents.Push(component);
+    }
+
+    if (component->GetNumAttributeAnimations())
+        AnimatableAdded(component);
+
+    // During asynchronous loading the scene assignment of node components is performed in time-budgeted finalization after all
+    // nodes are loaded. Components of the scene itself, such as Octree and PhysicsWorld, are assigned immediately so that the
+    // scene is usable while loading; only their attributes are applied in finalization
+    if (asyncProgress_.deferSceneSet_)
+    {
+        asyncProgress_.components_.Push(WeakPtr<Component>(component));
+        if (component->GetNode() == this)
+            component->OnSceneSet(this);
+    }
+    else
+        component->OnSceneSet(this);
 }
 
 void Scene::ComponentRemoved(Component* component)
@@ -1065,10 +1655,44 @@ void Scene::ComponentRemoved(Component* component)
     else
         localComponents_.Erase(id);
 
+    if (changeTracking_)
+    {
+        changedComponents_.Erase(id);
+        removedComponents_.Insert(id);
+    }
+
+    // Swap the last component of the same type into the vacated slot to keep the type array dense
+    if (component->sceneTypeIndex_ != M_MAX_UNSIGNED)
+    {
+        PODVector<Component*>& typeComponents = componentsByType_[component->GetType()];
+        unsigned index = component->sceneTypeIndex_;
+        if (index < typeComponents.Size() && typeComponents[index] == component)
+        {
+            Component* last = typeComponents.Back();
+            typeComponents[index] = last;
+            last->sceneTypeIndex_ = index;
+            typeComponents.Pop();
+        }
+        component->sceneTypeIndex_ = M_MAX_UNSIGNED;
+    }
+
+    AnimatableRemoved(component);
+
     component->SetID(0);
     component->OnSceneSet(nullptr);
 }
 
+void Scene::AnimatableAdded(Animatable* animatable)
+{
+    if (animatable)
+        animatables_[animatable] = animatable;
+}
+
+void Scene::AnimatableRemoved(Animatable* animatable)
+{
+    animatables_.Erase(animatable);
+}
+
 void Scene::SetVarNamesAttr(const String& value)
 {
     Vector<String> varNames = value.Split(';');
@@ -1117,11 +1741,15 @@ void Scene::CleanupConnection(Connection* connection)
 {
     Node::CleanupConnection(connection);
 
-    for (HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
-        i->second_->CleanupConnection(connection);
+    PODVector<Node*> nodes;
+    replicatedNodes_.GetObjects(nodes);
+    for (PODVector<Node*>::Iterator i = nodes.Begin(); i != nodes.End(); ++i)
+        (*i)->CleanupConnection(connection);
 
-    for (HashMap<unsigned, Component*>::Iterator i = replicatedComponents_.Begin(); i != replicatedComponents_.End(); ++i)
-        i->second_->CleanupConnection(connection);
+    PODVector<Component*> components;
+    replicatedComponents_.GetObjects(components);
+    for (PODVector<Component*>::Iterator i = components.Begin(); i != components.End(); ++i)
+        (*i)->CleanupConnection(connection);
 }
 
 void Scene::MarkNetworkUpdate(Node* node)
@@ -1152,6 +1780,34 @@ void Scene::MarkNetworkUpdate(Component* component)
     }
 }
 
+void Scene::MarkChanged(Node* node)
+{
+    if (changeTracking_ && node)
+    {
+        if (!threadedUpdate_)
+            changedNodes_.Insert(node->GetID());
+        else
+        {
+            MutexLock lock(sceneMutex_);
+            changedNodes_.Insert(node->GetID());
+        }
+    }
+}
+
+void Scene::MarkChanged(Component* component)
+{
+    if (changeTracking_ && component)
+    {
+        if (!threadedUpdate_)
+            changedComponents_.Insert(component->GetID());
+        else
+        {
+            MutexLock lock(sceneMutex_);
+            changedComponents_.Insert(component->GetID());
+        }
+    }
+}
+
 void Scene::MarkReplicationDirty(Node* node)
 {
     if (networkState_ && node->IsReplicated())
@@ -1203,11 +1859,14 @@ void Scene::UpdateAsyncLoading()
     {
         if (asyncProgress_.loadedNodes_ >= asyncProgress_.totalNodes_)
         {
-            FinishAsyncLoading();
-            return;
+            if (asyncProgress_.mode_ <= LOAD_RESOURCES_ONLY || FinalizeAsyncLoading(asyncLoadTimer))
+            {
+                FinishAsyncLoading();
+                return;
+            }
+            break;
         }
 
-
         // Read one child node with its full sub-hierarchy either from binary, JSON, or XML
         /// \todo Works poorly in scenes where one root-level child node contains all content
         if (asyncProgress_.xmlFile_)
@@ -1255,15 +1914,63 @@ void Scene::UpdateAsyncLoading()
     SendEvent(E_ASYNCLOADPROGRESS, eventData);
 }
 
-void Scene::FinishAsyncLoading()
+bool Scene::FinalizeAsyncLoading(HiresTimer& timer)
 {
-    if (asyncProgress_.mode_ > LOAD_RESOURCES_ONLY)
+    URHO3D_PROFILE(FinalizeAsyncLoading);
+
+    const long long maxUSec = asyncLoadingMs_ * 1000LL;
+    Vector<WeakPtr<Component> >& components = asyncProgress_.components_;
+
+    // Components added from now on are assigned the scene immediately
+    asyncProgress_.deferSceneSet_ = false;
+
+    while (asyncProgress_.sceneSetComponents_ < components.Size())
+    {
+        Component* component = components[asyncProgress_.sceneSetComponents_++];
+        // Skip components that were removed during loading, and the scene's own components which were assigned when added
+        if (component && component->GetID() && component->GetScene() == this && component->GetNode() != this)
+        {
+            AsyncLoadTiming& timing = asyncLoadTimings_[component->GetType()];
+            long long startUSec = timer.GetUSec(false);
+            component->OnSceneSet(this);
+            timing.sceneSetUSec_ += timer.GetUSec(false) - startUSec;
+            ++timing.numComponents_;
+        }
+
+        if (timer.GetUSec(false) >= maxUSec)
+            return false;
+    }
+
+    // Resolve node and component ID references once all components are in the scene
+    if (!asyncProgress_.resolved_)
     {
         resolver_.Resolve();
-        ApplyAttributes();
-        FinishLoading(asyncProgress_.file_);
+        asyncProgress_.resolved_ = true;
+    }
+
+    while (asyncProgress_.appliedComponents_ < components.Size())
+    {
+        Component* component = components[asyncProgress_.appliedComponents_++];
+        if (component && component->GetScene() == this)
+        {
+            AsyncLoadTiming& timing = asyncLoadTimings_[component->GetType()];
+            long long startUSec = timer.GetUSec(false);
+            component->ApplyAttributes();
+            timing.applyAttributesUSec_ += timer.GetUSec(false) - startUSec;
+        }
+
+        if (timer.GetUSec(false) >= maxUSec)
+            return false;
     }
 
+    return true;
+}
+
+void Scene::FinishAsyncLoading()
+{
+    if (asyncProgress_.mode_ > LOAD_RESOURCES_ONLY)
+        FinishLoading(asyncProgress_.file_);
+
     StopAsyncLoading();
 
     using namespace AsyncLoadFinished;
@@ -1280,6 +1987,8 @@ void Scene::FinishLoading(Deserializer* source)
         fileName_ = source->GetName();
         checksum_ = source->GetChecksum();
     }
+
+    ClearChanges();
 }
 
 void Scene::FinishSaving(Serializer* dest) const
@@ -1290,6 +1999,12 @@ void Scene::FinishSaving(Serializer* dest) const
         fileName_ = ptr->GetName();
         checksum_ = ptr->GetChecksum();
     }
+
+    // The saved state is the base of the next change set
+    changedNodes_.Clear();
+    changedComponents_.Clear();
+    removedNodes_.Clear();
+    removedComponents_.Clear();
 }
 
 void Scene::PreloadResources(File* file, bool isSceneFile)
@@ -1535,9 +2250,11 @@ void RegisterSceneLibrary(Context* context)
 {
     ValueAnimation::RegisterObject(context);
     ObjectAnimation::RegisterObject(context);
+    PrefabTemplate::RegisterObject(context);
     Node::RegisterObject(context);
     Scene::RegisterObject(context);
     SmoothedTransform::RegisterObject(context);
+    SpatialHash::RegisterObject(context);
     UnknownComponent::RegisterObject(context);
     SplinePath::RegisterObject(context);
 	ASyncNodeLoader::RegisterObject(context);
@@ -27,13 +27,16 @@
 #include "../Resource/XMLElement.h"
 #include "../Resource/JSONFile.h"
 #include "../Scene/Node.h"
+#include "../Scene/SceneIDTable.h"
 #include "../Scene/SceneResolver.h"
 
 namespace Urho3D
 {
 
 class File;
+class HiresTimer;
 class PackageFile;
+class PrefabTemplate;
 
 static const unsigned FIRST_REPLICATED_ID = 0x1;
 static const unsigned LAST_REPLICATED_ID = 0xffffff;
@@ -79,6 +82,50 @@ struct AsyncProgress
     unsigned loadedNodes_;
     /// Total root-level nodes.
     unsigned totalNodes_;
+    /// Components added during loading, waiting for finalization.
+    Vector<WeakPtr<Component> > components_;
+    /// Number of components whose deferred scene assignment has been performed.
+    unsigned sceneSetComponents_ = 0;
+    /// Number of components whose attributes have been applied.
+    unsigned appliedComponents_ = 0;
+    /// Node and component ID references resolved flag.
+    bool resolved_ = false;
+    /// Defer scene assignment of added components until finalization flag.
+    bool deferSceneSet_ = false;
+};
+
+/// Time spent finalizing asynchronously loaded components of one type.
+struct AsyncLoadTiming
+{
+    /// Construct.
+    AsyncLoadTiming() :
+        numComponents_(0),
+        sceneSetUSec_(0),
+        applyAttributesUSec_(0)
+    {
+    }
+
+    /// Number of finalized components.
+    unsigned numComponents_;
+    /// Microseconds spent in OnSceneSet().
+    long long sceneSetUSec_;
+    /// Microseconds spent in ApplyAttributes().
+    long long applyAttributesUSec_;
+};
+
+/// Batched attribute animation update entry.
+struct AttributeAnimationEvaluation
+{
+    /// Attribute animation.
+    SharedPtr<AttributeAnimationInfo> info_;
+    /// Offset into the evaluated float values, or M_MAX_UNSIGNED if the animation is updated through Variant interpolation.
+    unsigned valueOffset_;
+    /// Evaluated scaled time.
+    float scaledTime_;
+    /// Time step for the evaluation.
+    float timeStep_;
+    /// Animation finished flag.
+    bool finished_;
 };
 
 /// Root scene node, represents the whole scene.
@@ -139,6 +186,19 @@ public:
         (const JSONValue& source, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
     /// Instantiate scene content from JSON data. Return root node if successful.
     Node* InstantiateJSON(Deserializer& source, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
+    /// Instantiate scene content from a compiled prefab template. Return root node if successful.
+    Node* Instantiate(PrefabTemplate* prefab, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
+    /// Instantiate a compiled prefab template once per position and rotation pair. Created root nodes are appended to dest. Return number of instances created.
+    unsigned Instantiate(PrefabTemplate* prefab, const PODVector<Vector3>& positions, const PODVector<Quaternion>& rotations,
+        PODVector<Node*>& dest, CreateMode mode = REPLICATED);
+    /// Detach a node and its subtree from the scene as one batch. Subsystems such as the octree and physics world remove the subtree's components in one pass, and the detached nodes are destroyed over the following frames. Return true if successful.
+    bool DetachNode(Node* node);
+    /// Append the node and component changes since the last full save or SaveChanges() call to a binary change journal. Requires change tracking to be enabled. Return true if successful.
+    bool SaveChanges(Serializer& dest);
+    /// Apply a binary change journal written by SaveChanges() on top of the scene state it was based on. Loading the base scene, applying its journal and saving again compacts the journal into a full scene. Return true if successful.
+    bool LoadChanges(Deserializer& source);
+    /// Forget the tracked changes, making the current state the base of the next SaveChanges().
+    void ClearChanges();
 
     /// Clear scene completely of either replicated, local or all nodes and components.
     void Clear(bool clearReplicated = true, bool clearLocal = true);
@@ -154,6 +214,10 @@ public:
     void SetSnapThreshold(float threshold);
     /// Set maximum milliseconds per frame to spend on async scene loading.
     void SetAsyncLoadingMs(int ms);
+    /// Set maximum milliseconds per frame to spend on destroying detached nodes.
+    void SetDetachedReleaseMs(int ms);
+    /// Enable or disable tracking of node and component changes for SaveChanges(). Disabling forgets the tracked changes.
+    void SetChangeTracking(bool enable);
     /// Add a required package file for networking. To be called on the server.
     void AddRequiredPackageFile(PackageFile* package);
     /// Clear required package files.
@@ -169,8 +233,28 @@ public:
     Node* GetNode(unsigned id) const;
     /// Return component from the whole scene by ID, or null if not found.
     Component* GetComponent(unsigned id) const;
+    /// Return node by ID only if the ID's generation matches, or null if not found or the ID is stale.
+    Node* GetNode(unsigned id, unsigned generation) const;
+    /// Return component by ID only if the ID's generation matches, or null if not found or the ID is stale.
+    Component* GetComponent(unsigned id, unsigned generation) const;
+    /// Return generation of a node ID. The generation advances whenever a node using the ID is removed, so storing it alongside the ID allows detecting stale references.
+    unsigned GetNodeGeneration(unsigned id) const;
+    /// Return generation of a component ID. The generation advances whenever a component using the ID is removed.
+    unsigned GetComponentGeneration(unsigned id) const;
     /// Get nodes with specific tag from the whole scene, return false if empty.
     bool GetNodesWithTag(PODVector<Node*>& dest, const String& tag)  const;
+    /// Return all components of exactly the specified type in the whole scene, in no particular order. The array is updated in place as components are added or removed, so do not hold on to it across such changes.
+    const PODVector<Component*>& GetComponentsOfType(StringHash type) const;
+    /// Return components of the specified type or derived from it in the whole scene, without traversing the node hierarchy.
+    void GetDerivedComponentsOfType(PODVector<Component*>& dest, StringHash type, bool clearVector = true) const;
+    /// Return effectively enabled components of exactly the specified type in the whole scene, without traversing the node hierarchy.
+    void GetEnabledComponentsOfType(PODVector<Component*>& dest, StringHash type, bool clearVector = true) const;
+    /// Template version of returning all components of exactly the specified type in the whole scene.
+    template <class T> const PODVector<T*>& GetComponentsOfType() const;
+    /// Template version of returning components of the specified type or derived from it in the whole scene.
+    template <class T> void GetDerivedComponentsOfType(PODVector<T*>& dest, bool clearVector = true) const;
+    /// Template version of returning effectively enabled components of exactly the specified type in the whole scene.
+    template <class T> void GetEnabledComponentsOfType(PODVector<T*>& dest, bool clearVector = true) const;
 
     /// Return whether updates are enabled.
     bool IsUpdateEnabled() const { return updateEnabled_; }
@@ -180,6 +264,8 @@ public:
 
     /// Return asynchronous loading progress between 0.0 and 1.0, or 1.0 if not in progress.
     float GetAsyncProgress() const;
+    /// Return time spent finalizing the components of the last asynchronous load by component type.
+    const HashMap<StringHash, AsyncLoadTiming>& GetAsyncLoadTimings() const { return asyncLoadTimings_; }
 
     /// Return the load mode of the current asynchronous loading operation.
     LoadMode GetAsyncLoadMode() const { return asyncProgress_.mode_; }
@@ -205,6 +291,19 @@ public:
     /// Return maximum milliseconds per frame to spend on async loading.
     int GetAsyncLoadingMs() const { return asyncLoadingMs_; }
 
+    /// Return maximum milliseconds per frame to spend on destroying detached nodes.
+    int GetDetachedReleaseMs() const { return detachedReleaseMs_; }
+
+    /// Return number of detached nodes waiting to be destroyed.
+    unsigned GetNumDetachedNodes() const { return detachedNodes_.Size(); }
+    /// Return whether node and component changes are tracked for SaveChanges().
+    bool IsChangeTracking() const { return changeTracking_; }
+    /// Return whether there are tracked changes not yet saved.
+    bool HasChanges() const
+    {
+        return !changedNodes_.Empty() || !changedComponents_.Empty() || !removedNodes_.Empty() || !removedComponents_.Empty();
+    }
+
     /// Return required package files.
     const Vector<SharedPtr<PackageFile> >& GetRequiredPackageFiles() const { return requiredPackageFiles_; }
 
@@ -223,6 +322,9 @@ public:
     /// Return threaded update flag.
     bool IsThreadedUpdate() const { return threadedUpdate_; }
 
+    /// Return whether a batch of nodes is being detached. During it subsystems may defer removals until E_SCENEBATCHREMOVED.
+    bool IsBatchRemoving() const { return batchRemoving_; }
+
     /// Get free node ID, either non-local or local.
     unsigned GetFreeNodeID(CreateMode mode);
     /// Get free component ID, either non-local or local.
@@ -243,6 +345,10 @@ public:
     void ComponentAdded(Component* component);
     /// Component removed. Remove from ID map.
     void ComponentRemoved(Component* component);
+    /// Node or component attribute animations added. Add to the batched attribute animation update.
+    void AnimatableAdded(Animatable* animatable);
+    /// Node or component attribute animations removed. Remove from the batched attribute animation update.
+    void AnimatableRemoved(Animatable* animatable);
     /// Set node user variable reverse mappings.
     void SetVarNamesAttr(const String& value);
     /// Return node user variable reverse mappings.
@@ -255,6 +361,10 @@ public:
     void MarkNetworkUpdate(Node* node);
     /// Mark a component for attribute check on the next network update.
     void MarkNetworkUpdate(Component* component);
+    /// Mark a node changed since the last save if change tracking is enabled.
+    void MarkChanged(Node* node);
+    /// Mark a component changed since the last save if change tracking is enabled.
+    void MarkChanged(Component* component);
     /// Mark a node dirty in scene replication states. The node does not need to have own replication state yet.
     void MarkReplicationDirty(Node* node);
 
@@ -265,11 +375,17 @@ private:
     void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
     /// Update asynchronous loading.
     void UpdateAsyncLoading();
+    /// Finalize the components of an asynchronous load within the time budget: perform deferred scene assignment, resolve ID references and apply attributes. Return true when done.
+    bool FinalizeAsyncLoading(HiresTimer& timer);
     /// Finish asynchronous loading.
     void FinishAsyncLoading();
-    /// Finish loading. Sets the scene filename and checksum.
+    /// Destroy detached nodes within the time budget, leaves first.
+    void ReleaseDetachedNodes();
+    /// Update attribute animations of nodes and components. Float-based values are evaluated as a batch, optionally in worker threads, then applied in the main thread.
+    void UpdateAnimatables(float timeStep);
+    /// Finish loading. Sets the scene filename and checksum and forgets tracked changes.
     void FinishLoading(Deserializer* source);
-    /// Finish saving. Sets the scene filename and checksum.
+    /// Finish saving. Sets the scene filename and checksum and forgets tracked changes.
     void FinishSaving(Serializer* dest) const;
     /// Preload resources from a binary scene or object prefab file.
     void PreloadResources(File* file, bool isSceneFile);
@@ -279,19 +395,31 @@ private:
     void PreloadResourcesJSON(const JSONValue& value);
 
     /// Replicated scene nodes by ID.
-    HashMap<unsigned, Node*> replicatedNodes_;
+    SceneIDTable<Node> replicatedNodes_;
     /// Local scene nodes by ID.
-    HashMap<unsigned, Node*> localNodes_;
+    SceneIDTable<Node> localNodes_;
     /// Replicated components by ID.
-    HashMap<unsigned, Component*> replicatedComponents_;
+    SceneIDTable<Component> replicatedComponents_;
     /// Local components by ID.
-    HashMap<unsigned, Component*> localComponents_;
+    SceneIDTable<Component> localComponents_;
     /// Cached tagged nodes by tag.
     HashMap<StringHash, PODVector<Node*> > taggedNodes_;
+    /// Dense component arrays by exact component type.
+    HashMap<StringHash, PODVector<Component*> > componentsByType_;
+    /// Nodes and components with attribute animations.
+    HashMap<Animatable*, WeakPtr<Animatable> > animatables_;
+    /// Attribute animations gathered for the batched update.
+    Vector<AttributeAnimationEvaluation> animationEvaluations_;
+    /// Evaluated float values of the batched attribute animations.
+    PODVector<float> animationValues_;
+    /// Detached nodes waiting to be destroyed. Parents precede their children.
+    Vector<SharedPtr<Node> > detachedNodes_;
     /// Asynchronous loading progress.
     AsyncProgress asyncProgress_;
     /// Node and component ID resolver for asynchronous loading.
     SceneResolver resolver_;
+    /// Component finalization timings of the last asynchronous load by component type.
+    HashMap<StringHash, AsyncLoadTiming> asyncLoadTimings_;
     /// Source file name.
     mutable String fileName_;
     /// Required package files for networking.
@@ -302,6 +430,14 @@ private:
     HashSet<unsigned> networkUpdateNodes_;
     /// Components to check for attribute changes on the next network update.
     HashSet<unsigned> networkUpdateComponents_;
+    /// Nodes changed or added since the last save.
+    mutable HashSet<unsigned> changedNodes_;
+    /// Components changed or added since the last save.
+    mutable HashSet<unsigned> changedComponents_;
+    /// Nodes removed since the last save.
+    mutable HashSet<unsigned> removedNodes_;
+    /// Components removed since the last save.
+    mutable HashSet<unsigned> removedComponents_;
     /// Delayed dirty notification queue for components.
     PODVector<Component*> delayedDirtyComponents_;
     /// Mutex for the delayed dirty notification queue.
@@ -320,6 +456,8 @@ private:
     mutable unsigned checksum_;
     /// Maximum milliseconds per frame to spend on async scene loading.
     int asyncLoadingMs_;
+    /// Maximum milliseconds per frame to spend on destroying detached nodes.
+    int detachedReleaseMs_;
     /// Scene update time scale.
     float timeScale_;
     /// Elapsed time accumulator.
@@ -334,8 +472,27 @@ private:
     bool asyncLoading_;
     /// Threaded update flag.
     bool threadedUpdate_;
+    /// Batch removal flag.
+    bool batchRemoving_;
+    /// Change tracking flag.
+    bool changeTracking_;
 };
 
+template <class T> const PODVector<T*>& Scene::GetComponentsOfType() const
+{
+    return reinterpret_cast<const PODVector<T*>&>(GetComponentsOfType(T::GetTypeStatic()));
+}
+
+template <class T> void Scene::GetDerivedComponentsOfType(PODVector<T*>& dest, bool clearVector) const
+{
+    GetDerivedComponentsOfType(reinterpret_cast<PODVector<Component*>&>(dest), T::GetTypeStatic(), clearVector);
+}
+
+template <class T> void Scene::GetEnabledComponentsOfType(PODVector<T*>& dest, bool clearVector) const
+{
+    GetEnabledComponentsOfType(reinterpret_cast<PODVector<Component*>&>(dest), T::GetTypeStatic(), clearVector);
+}
+
 /// Register Scene library objects.
 void URHO3D_API RegisterSceneLibrary(Context* context);
 
@@ -126,6 +126,12 @@ URHO3D_EVENT(E_NODEREMOVED, NodeRemoved)
     URHO3D_PARAM(P_NODE, Node);                    // Node pointer
 }
 
+/// A batch of nodes has been detached from the scene by Scene::DetachNode(). Subsystems should now perform removals they deferred during the batch.
+URHO3D_EVENT(E_SCENEBATCHREMOVED, SceneBatchRemoved)
+{
+    URHO3D_PARAM(P_SCENE, Scene);                  // Scene pointer
+}
+
 /// A component has been created to a node.
 URHO3D_EVENT(E_COMPONENTADDED, ComponentAdded)
 {
@@ -0,0 +1,183 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/Vector.h"
+#include "../Math/MathDefs.h"
+
+namespace Urho3D
+{
+
+/// Minimum number of slots allocated when a scene ID table first grows.
+static const unsigned MIN_SCENE_ID_SLOTS = 1024;
+
+/// Slot array mapping scene object IDs of one ID range to objects, so that a lookup is a bounds check plus an index. Each slot has a generation counter that is incremented when its object is removed, which allows detecting stale IDs. IDs far beyond the densely used part of the range, such as sparse IDs read from a file or received from the network, are kept in a hash map instead.
+template <class T> class SceneIDTable
+{
+public:
+    /// Object and generation of one ID.
+    struct Slot
+    {
+        /// Construct empty.
+        Slot() :
+            object_(nullptr),
+            generation_(0)
+        {
+        }
+
+        /// Object, or null if the ID is free.
+        T* object_;
+        /// Number of times an object has been removed from the slot.
+        unsigned generation_;
+    };
+
+    /// Construct with the first ID of the range.
+    explicit SceneIDTable(unsigned firstID) :
+        firstID_(firstID),
+        size_(0)
+    {
+    }
+
+    /// Assign an object to an ID, overwriting any previous object.
+    void Set(unsigned id, T* object)
+    {
+        unsigned index = id - firstID_;
+        if (index >= slots_.Size() && index < Max(slots_.Size() * 2, MIN_SCENE_ID_SLOTS))
+            Grow(index + 1);
+
+        Slot& slot = index < slots_.Size() ? slots_[index] : overflow_[id];
+        if (!slot.object_)
+            ++size_;
+        slot.object_ = object;
+    }
+
+    /// Remove the object of an ID and advance the ID's generation.
+    void Erase(unsigned id)
+    {
+        unsigned index = id - firstID_;
+        if (index < slots_.Size())
+        {
+            Slot& slot = slots_[index];
+            if (slot.object_)
+            {
+                slot.object_ = nullptr;
+                ++slot.generation_;
+                --size_;
+            }
+        }
+        else if (overflow_.Erase(id))
+            --size_;
+    }
+
+    /// Remove all objects. Generations are preserved so that IDs handed out earlier remain detectably stale.
+    void Clear()
+    {
+        for (typename PODVector<Slot>::Iterator i = slots_.Begin(); i != slots_.End(); ++i)
+        {
+            if (i->object_)
+            {
+                i->object_ = nullptr;
+                ++i->generation_;
+            }
+        }
+        overflow_.Clear();
+        size_ = 0;
+    }
+
+    /// Return the object of an ID, or null if not found.
+    T* Get(unsigned id) const
+    {
+        unsigned index = id - firstID_;
+        if (index < slots_.Size())
+            return slots_[index].object_;
+
+        if (overflow_.Empty())
+            return nullptr;
+        typename HashMap<unsigned, Slot>::ConstIterator i = overflow_.Find(id);
+        return i != overflow_.End() ? i->second_.object_ : nullptr;
+    }
+
+    /// Return the object of an ID only if the ID's generation matches, or null if not found or stale.
+    T* Get(unsigned id, unsigned generation) const { return GetGeneration(id) == generation ? Get(id) : nullptr; }
+
+    /// Return current generation of an ID. IDs kept in the hash map always have generation zero.
+    unsigned GetGeneration(unsigned id) const
+    {
+        unsigned index = id - firstID_;
+        return index < slots_.Size() ? slots_[index].generation_ : 0;
+    }
+
+    /// Return whether an ID is in use.
+    bool Contains(unsigned id) const { return Get(id) != nullptr; }
+
+    /// Return number of objects.
+    unsigned Size() const { return size_; }
+
+    /// Return all objects.
+    void GetObjects(PODVector<T*>& dest) const
+    {
+        dest.Clear();
+        dest.Reserve(size_);
+        for (typename PODVector<Slot>::ConstIterator i = slots_.Begin(); i != slots_.End(); ++i)
+        {
+            if (i->object_)
+                dest.Push(i->object_);
+        }
+        for (typename HashMap<unsigned, Slot>::ConstIterator i = overflow_.Begin(); i != overflow_.End(); ++i)
+            dest.Push(i->second_.object_);
+    }
+
+private:
+    /// Grow the slot array and move hash map entries that now fit into it.
+    void Grow(unsigned minSize)
+    {
+        unsigned oldSize = slots_.Size();
+        slots_.Resize(Max(minSize, Max(oldSize * 2, MIN_SCENE_ID_SLOTS)));
+        for (unsigned i = oldSize; i < slots_.Size(); ++i)
+            slots_[i] = Slot();
+
+        for (typename HashMap<unsigned, Slot>::Iterator i = overflow_.Begin(); i != overflow_.End();)
+        {
+            unsigned index = i->first_ - firstID_;
+            if (index < slots_.Size())
+            {
+                slots_[index].object_ = i->second_.object_;
+                i = overflow_.Erase(i);
+            }
+            else
+                ++i;
+        }
+    }
+
+    /// Slots indexed by ID minus the first ID of the range.
+    PODVector<Slot> slots_;
+    /// Objects with IDs beyond the slot array.
+    HashMap<unsigned, Slot> overflow_;
+    /// First ID of the range.
+    unsigned firstID_;
+    /// Number of objects.
+    unsigned size_;
+};
+
+}
@@ -72,6 +72,8 @@ void Serializable::OnSetAttribute(const AttributeInfo& attr, const Variant& src)
     if (attr.accessor_)
     {
         attr.accessor_->Set(this, src);
+        if (attr.mode_ & AM_FILE)
+            MarkChanged();
         return;
     }
 
@@ -173,6 +175,10 @@ void Serializable::OnSetAttribute(const AttributeInfo& attr, const Variant& src)
     // If it is a network attribute then mark it for next network update
     if (attr.mode_ & AM_NET)
         MarkNetworkUpdate();
+    // Otherwise if it is a file attribute then mark it for the next incremental save. Nodes and components do this already
+    // as part of the network update marking
+    else if (attr.mode_ & AM_FILE)
+        MarkChanged();
 }
 
 void Serializable::OnGetAttribute(const AttributeInfo& attr, Variant& dest) const
@@ -80,12 +80,16 @@ public:
 
     /// Apply attribute changes that can not be applied immediately. Called after scene load or a network update.
     virtual void ApplyAttributes() { }
+    /// Set whether attributes are being loaded from file data outside Load(), for example when instantiating a prefab template. Objects that defer work to ApplyAttributes() during a load should behave as if loading.
+    virtual void SetLoading(bool enable) { }
 
     /// Return whether should save default-valued attributes into XML. Default false.
     virtual bool SaveDefaultAttributes() const { return false; }
 
     /// Mark for attribute check on the next network update.
     virtual void MarkNetworkUpdate() { }
+    /// Mark as changed since the last save for incremental scene saving.
+    virtual void MarkChanged() { }
 
     /// Set attribute by index. Return true if successfully set.
     bool SetAttribute(unsigned index, const Variant& value);
@@ -0,0 +1,448 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
+#include "../IO/Log.h"
+#include "../Scene/Scene.h"
+#include "../Scene/SceneEvents.h"
+#include "../Scene/SpatialHash.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+extern const char* SUBSYSTEM_CATEGORY;
+
+static const float DEFAULT_CELL_SIZE = 10.0f;
+/// Minimum number of batched queries to execute them in worker threads.
+static const unsigned MIN_THREADED_SPATIAL_HASH_QUERIES = 16;
+
+void ExecuteSpatialHashQueriesWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* spatialHash = reinterpret_cast<const SpatialHash*>(item->aux_);
+    auto* start = reinterpret_cast<SpatialHashQuery*>(item->start_);
+    auto* end = reinterpret_cast<SpatialHashQuery*>(item->end_);
+
+    while (start != end)
+    {
+        spatialHash->Query(*start);
+        ++start;
+    }
+}
+
+SpatialHash::SpatialHash(Context* context) :
+    Component(context),
+    cellSize_(DEFAULT_CELL_SIZE)
+{
+}
+
+SpatialHash::~SpatialHash()
+{
+    RemoveAllNodes();
+}
+
+void SpatialHash::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SpatialHash>(SUBSYSTEM_CATEGORY);
+
+    URHO3D_ACCESSOR_ATTRIBUTE("Cell Size", GetCellSize, SetCellSize, float, DEFAULT_CELL_SIZE, AM_DEFAULT);
+}
+
+void SpatialHash::OnMarkedDirty(Node* node)
+{
+    // Only record the node, as its world position can not be safely read during threaded update
+    Scene* scene = GetScene();
+    if (scene && scene->IsThreadedUpdate())
+    {
+        MutexLock lock(dirtyNodesMutex_);
+        dirtyNodes_.Push(node);
+    }
+    else
+        dirtyNodes_.Push(node);
+}
+
+void SpatialHash::SetCellSize(float size)
+{
+    size = Max(size, M_EPSILON);
+    if (size == cellSize_)
+        return;
+
+    cellSize_ = size;
+
+    // Rebuild the grid with the new cell size
+    cells_.Clear();
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        nodeCells_[i] = GetCell(positions_[i]);
+        AddToCell(i);
+    }
+
+    MarkNetworkUpdate();
+}
+
+void SpatialHash::AddNode(Node* node)
+{
+    if (!node || nodeIndices_.Contains(node))
+        return;
+
+    if (node->GetScene() != GetScene())
+    {
+        URHO3D_LOGERROR("Node is not in the same scene as the spatial hash");
+        return;
+    }
+
+    unsigned index = nodes_.Size();
+    // Reading the world position also clears the node's dirty flag, so that its next transform change is notified
+    Vector3 position = node->GetWorldPosition();
+    nodes_.Push(node);
+    positions_.Push(position);
+    nodeCells_.Push(GetCell(position));
+    nodeIndices_[node] = index;
+    AddToCell(index);
+
+    node->AddListener(this);
+}
+
+void SpatialHash::RemoveNode(Node* node)
+{
+    HashMap<Node*, unsigned>::Iterator i = nodeIndices_.Find(node);
+    if (i == nodeIndices_.End())
+        return;
+
+    unsigned index = i->second_;
+    nodeIndices_.Erase(i);
+    RemoveFromCell(index);
+    node->RemoveListener(this);
+
+    // Move the last node to the vacated index
+    unsigned last = nodes_.Size() - 1;
+    if (index != last)
+    {
+        RemoveFromCell(last);
+        nodes_[index] = nodes_[last];
+        positions_[index] = positions_[last];
+        nodeCells_[index] = nodeCells_[last];
+        nodeIndices_[nodes_[index]] = index;
+        AddToCell(index);
+    }
+
+    nodes_.Pop();
+    positions_.Pop();
+    nodeCells_.Pop();
+}
+
+void SpatialHash::RemoveAllNodes()
+{
+    for (PODVector<Node*>::Iterator i = nodes_.Begin(); i != nodes_.End(); ++i)
+        (*i)->RemoveListener(this);
+
+    nodes_.Clear();
+    positions_.Clear();
+    nodeCells_.Clear();
+    nodeIndices_.Clear();
+    cells_.Clear();
+    dirtyNodes_.Clear();
+}
+
+void SpatialHash::Update()
+{
+    if (dirtyNodes_.Empty())
+        return;
+
+    URHO3D_PROFILE(UpdateSpatialHash);
+
+    // Nodes that have been marked dirty several times or are no longer tracked are looked up by pointer only, so
+    // duplicate or stale entries are harmless
+    for (PODVector<Node*>::ConstIterator i = dirtyNodes_.Begin(); i != dirtyNodes_.End(); ++i)
+    {
+        HashMap<Node*, unsigned>::ConstIterator j = nodeIndices_.Find(*i);
+        if (j == nodeIndices_.End())
+            continue;
+
+        unsigned index = j->second_;
+        positions_[index] = (*i)->GetWorldPosition();
+
+        IntVector3 cell = GetCell(positions_[index]);
+        if (cell != nodeCells_[index])
+        {
+            RemoveFromCell(index);
+            nodeCells_[index] = cell;
+            AddToCell(index);
+        }
+    }
+
+    dirtyNodes_.Clear();
+}
+
+void SpatialHash::GetNodesInRadius(PODVector<Node*>& dest, const Vector3& center, float radius) const
+{
+    dest.Clear();
+    if (nodes_.Empty() || radius < 0.0f)
+        return;
+
+    Vector3 extent(radius, radius, radius);
+    IntVector3 minCell = GetCell(center - extent);
+    IntVector3 maxCell = GetCell(center + extent);
+    float radiusSquared = radius * radius;
+
+    // If the query covers more cells than are occupied, go through the occupied cells instead
+    double numQueryCells = (double)(maxCell.x_ - minCell.x_ + 1) * (double)(maxCell.y_ - minCell.y_ + 1) *
+        (double)(maxCell.z_ - minCell.z_ + 1);
+    if (numQueryCells > (double)cells_.Size())
+    {
+        for (HashMap<IntVector3, PODVector<unsigned> >::ConstIterator i = cells_.Begin(); i != cells_.End(); ++i)
+        {
+            const IntVector3& cell = i->first_;
+            if (cell.x_ >= minCell.x_ && cell.x_ <= maxCell.x_ && cell.y_ >= minCell.y_ && cell.y_ <= maxCell.y_ &&
+                cell.z_ >= minCell.z_ && cell.z_ <= maxCell.z_)
+                CollectCell(dest, i->second_, center, radiusSquared);
+        }
+        return;
+    }
+
+    for (int z = minCell.z_; z <= maxCell.z_; ++z)
+    {
+        for (int y = minCell.y_; y <= maxCell.y_; ++y)
+        {
+            for (int x = minCell.x_; x <= maxCell.x_; ++x)
+            {
+                HashMap<IntVector3, PODVector<unsigned> >::ConstIterator i = cells_.Find(IntVector3(x, y, z));
+                if (i != cells_.End())
+                    CollectCell(dest, i->second_, center, radiusSquared);
+            }
+        }
+    }
+}
+
+void SpatialHash::GetNearestNodes(PODVector<Node*>& dest, const Vector3& center, unsigned count, float maxRadius) const
+{
+    dest.Clear();
+    if (nodes_.Empty() || !count || maxRadius < 0.0f)
+        return;
+
+    PODVector<Pair<float, Node*> > candidates;
+    float maxRadiusSquared = maxRadius * maxRadius;
+    IntVector3 centerCell = GetCell(center);
+    int maxRing = maxRadius / cellSize_ < (float)M_MAX_INT ? CeilToInt(maxRadius / cellSize_) : M_MAX_INT;
+    unsigned long long numVisitedCells = 0;
+    bool bruteForce = false;
+
+    // Search in expanding shells of cells around the center cell. Nodes in shells beyond the current one are at least
+    // ring * cellSize away, so the search can stop once enough closer nodes have been found
+    for (int ring = 0; ring <= maxRing; ++ring)
+    {
+        // If the search would cover more cells than are occupied, go through all nodes instead
+        unsigned long long side = 2 * (unsigned long long)ring + 1;
+        numVisitedCells = side * side * side;
+        if (numVisitedCells > cells_.Size())
+        {
+            bruteForce = true;
+            break;
+        }
+
+        for (int z = -ring; z <= ring; ++z)
+        {
+            for (int y = -ring; y <= ring; ++y)
+            {
+                for (int x = -ring; x <= ring; ++x)
+                {
+                    // Skip the cells inside the shell, which have been visited already
+                    if (Abs(x) != ring && Abs(y) != ring && Abs(z) != ring)
+                        continue;
+
+                    HashMap<IntVector3, PODVector<unsigned> >::ConstIterator i =
+                        cells_.Find(IntVector3(centerCell.x_ + x, centerCell.y_ + y, centerCell.z_ + z));
+                    if (i == cells_.End())
+                        continue;
+
+                    const PODVector<unsigned>& indices = i->second_;
+                    for (PODVector<unsigned>::ConstIterator j = indices.Begin(); j != indices.End(); ++j)
+                    {
+                        float distanceSquared = (positions_[*j] - center).LengthSquared();
+                        if (distanceSquared <= maxRadiusSquared)
+                            candidates.Push(MakePair(distanceSquared, nodes_[*j]));
+                    }
+                }
+            }
+        }
+
+        if (candidates.Size() >= count)
+        {
+            Sort(candidates.Begin(), candidates.End());
+            candidates.Resize(count);
+            float ringDistance = ring * cellSize_;
+            if (candidates.Back().first_ <= ringDistance * ringDistance)
+                break;
+        }
+    }
+
+    if (bruteForce)
+    {
+        candidates.Clear();
+        for (unsigned i = 0; i < positions_.Size(); ++i)
+        {
+            float distanceSquared = (positions_[i] - center).LengthSquared();
+            if (distanceSquared <= maxRadiusSquared)
+                candidates.Push(MakePair(distanceSquared, nodes_[i]));
+        }
+    }
+
+    Sort(candidates.Begin(), candidates.End());
+    if (candidates.Size() > count)
+        candidates.Resize(count);
+
+    dest.Reserve(candidates.Size());
+    for (PODVector<Pair<float, Node*> >::ConstIterator i = candidates.Begin(); i != candidates.End(); ++i)
+        dest.Push(i->second_);
+}
+
+void SpatialHash::Query(SpatialHashQuery& query) const
+{
+    if (query.maxResults_)
+        GetNearestNodes(query.result_, query.center_, query.maxResults_, query.radius_);
+    else
+        GetNodesInRadius(query.result_, query.center_, query.radius_);
+}
+
+void SpatialHash::Query(Vector<SpatialHashQuery>& queries) const
+{
+    URHO3D_PROFILE(QuerySpatialHash);
+
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (queries.Size() < MIN_THREADED_SPATIAL_HASH_QUERIES || !queue || !queue->GetNumThreads())
+    {
+        for (Vector<SpatialHashQuery>::Iterator i = queries.Begin(); i != queries.End(); ++i)
+            Query(*i);
+        return;
+    }
+
+    int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
+    int queriesPerItem = Max((int)(queries.Size() / numWorkItems), 1);
+
+    Vector<SpatialHashQuery>::Iterator start = queries.Begin();
+    // Create a work item for each thread
+    for (int i = 0; i < numWorkItems; ++i)
+    {
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = ExecuteSpatialHashQueriesWork;
+        item->aux_ = const_cast<SpatialHash*>(this);
+
+        Vector<SpatialHashQuery>::Iterator end = queries.End();
+        if (i < numWorkItems - 1 && end - start > queriesPerItem)
+            end = start + queriesPerItem;
+
+        item->start_ = &(*start);
+        item->end_ = &(*end);
+        queue->AddWorkItem(item);
+
+        start = end;
+    }
+
+    queue->Complete(M_MAX_UNSIGNED);
+}
+
+void SpatialHash::OnSceneSet(Scene* scene)
+{
+    // Nodes of the old scene can not be tracked any more
+    RemoveAllNodes();
+
+    if (scene)
+    {
+        if (scene != node_)
+            URHO3D_LOGWARNING(GetTypeName() + " should only be created to the root scene node");
+
+        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(SpatialHash, HandleScenePostUpdate));
+        SubscribeToEvent(scene, E_NODEREMOVED, URHO3D_HANDLER(SpatialHash, HandleNodeRemoved));
+    }
+    else
+        UnsubscribeFromAllEvents();
+}
+
+void SpatialHash::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    Update();
+}
+
+void SpatialHash::HandleNodeRemoved(StringHash eventType, VariantMap& eventData)
+{
+    if (nodes_.Empty())
+        return;
+
+    using namespace NodeRemoved;
+
+    // The event is sent only for the root of the removed subtree, so check its children as well
+    auto* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+    RemoveNode(node);
+
+    PODVector<Node*> children;
+    node->GetChildren(children, true);
+    for (PODVector<Node*>::ConstIterator i = children.Begin(); i != children.End(); ++i)
+        RemoveNode(*i);
+}
+
+IntVector3 SpatialHash::GetCell(const Vector3& position) const
+{
+    return IntVector3(FloorToInt(position.x_ / cellSize_), FloorToInt(position.y_ / cellSize_), FloorToInt(position.z_ / cellSize_));
+}
+
+void SpatialHash::AddToCell(unsigned index)
+{
+    cells_[nodeCells_[index]].Push(index);
+}
+
+void SpatialHash::RemoveFromCell(unsigned index)
+{
+    HashMap<IntVector3, PODVector<unsigned> >::Iterator i = cells_.Find(nodeCells_[index]);
+    if (i == cells_.End())
+        return;
+
+    PODVector<unsigned>& indices = i->second_;
+    PODVector<unsigned>::Iterator j = indices.Find(index);
+    if (j != indices.End())
+    {
+        *j = indices.Back();
+        indices.Pop();
+    }
+
+    if (indices.Empty())
+        cells_.Erase(i);
+}
+
+void SpatialHash::CollectCell(PODVector<Node*>& dest, const PODVector<unsigned>& cell, const Vector3& center,
+    float radiusSquared) const
+{
+    for (PODVector<unsigned>::ConstIterator i = cell.Begin(); i != cell.End(); ++i)
+    {
+        if ((positions_[*i] - center).LengthSquared() <= radiusSquared)
+            dest.Push(nodes_[*i]);
+    }
+}
+
+}
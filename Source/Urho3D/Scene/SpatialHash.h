@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Core/Mutex.h"
+#include "../Math/Vector3.h"
+#include "../Scene/Component.h"
+
+namespace Urho3D
+{
+
+/// Radius or nearest neighbor query for a spatial hash.
+struct URHO3D_API SpatialHashQuery
+{
+    /// Construct with defaults.
+    SpatialHashQuery() :
+        center_(Vector3::ZERO),
+        radius_(0.0f),
+        maxResults_(0)
+    {
+    }
+
+    /// Construct with center, radius and maximum number of nearest nodes to return.
+    SpatialHashQuery(const Vector3& center, float radius, unsigned maxResults = 0) :
+        center_(center),
+        radius_(radius),
+        maxResults_(maxResults)
+    {
+    }
+
+    /// Query center in world space.
+    Vector3 center_;
+    /// Query radius.
+    float radius_;
+    /// Maximum number of nearest nodes to return, or 0 to return all nodes within the radius.
+    unsigned maxResults_;
+    /// Result nodes. Ordered by distance if a maximum number of results was specified.
+    PODVector<Node*> result_;
+};
+
+/// %Scene component that maintains a uniform grid spatial hash of the world positions of tracked nodes, for radius and nearest neighbor queries. Positions are updated incrementally for nodes whose transforms have been marked dirty. Should be added only to the root scene node.
+class URHO3D_API SpatialHash : public Component
+{
+    URHO3D_OBJECT(SpatialHash, Component);
+
+public:
+    /// Construct.
+    explicit SpatialHash(Context* context);
+    /// Destruct.
+    ~SpatialHash() override;
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Handle a tracked node's transform being dirtied.
+    void OnMarkedDirty(Node* node) override;
+
+    /// Set grid cell size. Should be on the order of the typical query radius.
+    void SetCellSize(float size);
+    /// Start tracking a node's world position.
+    void AddNode(Node* node);
+    /// Stop tracking a node.
+    void RemoveNode(Node* node);
+    /// Stop tracking all nodes.
+    void RemoveAllNodes();
+    /// Update the positions of tracked nodes whose transforms have changed. Called automatically after the scene update.
+    void Update();
+
+    /// Return tracked nodes within a radius. Can be called from worker threads when no update is in progress.
+    void GetNodesInRadius(PODVector<Node*>& dest, const Vector3& center, float radius) const;
+    /// Return up to the specified number of tracked nodes nearest to a point within a maximum radius, ordered by distance. Can be called from worker threads when no update is in progress.
+    void GetNearestNodes(PODVector<Node*>& dest, const Vector3& center, unsigned count, float maxRadius = M_INFINITY) const;
+    /// Execute a query.
+    void Query(SpatialHashQuery& query) const;
+    /// Execute a batch of queries, in worker threads if there are enough of them.
+    void Query(Vector<SpatialHashQuery>& queries) const;
+
+    /// Return grid cell size.
+    float GetCellSize() const { return cellSize_; }
+    /// Return number of tracked nodes.
+    unsigned GetNumNodes() const { return nodes_.Size(); }
+    /// Return number of occupied grid cells.
+    unsigned GetNumCells() const { return cells_.Size(); }
+    /// Return whether a node is tracked.
+    bool HasNode(Node* node) const { return nodeIndices_.Contains(node); }
+
+protected:
+    /// Handle scene being assigned.
+    void OnSceneSet(Scene* scene) override;
+
+private:
+    /// Handle the scene post-update event.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle a node being removed from the scene.
+    void HandleNodeRemoved(StringHash eventType, VariantMap& eventData);
+    /// Return grid cell of a world position.
+    IntVector3 GetCell(const Vector3& position) const;
+    /// Add a tracked node's index to its grid cell.
+    void AddToCell(unsigned index);
+    /// Remove a tracked node's index from its grid cell.
+    void RemoveFromCell(unsigned index);
+    /// Add nodes of a grid cell within a radius to the destination vector.
+    void CollectCell(PODVector<Node*>& dest, const PODVector<unsigned>& cell, const Vector3& center, float radiusSquared) const;
+
+    /// Tracked nodes.
+    PODVector<Node*> nodes_;
+    /// World positions of the tracked nodes as of the last update.
+    PODVector<Vector3> positions_;
+    /// Grid cells of the tracked nodes.
+    PODVector<IntVector3> nodeCells_;
+    /// Indices of the tracked nodes.
+    HashMap<Node*, unsigned> nodeIndices_;
+    /// Tracked node indices by grid cell.
+    HashMap<IntVector3, PODVector<unsigned> > cells_;
+    /// Tracked nodes whose transforms have been marked dirty since the last update.
+    PODVector<Node*> dirtyNodes_;
+    /// Mutex for marking nodes dirty during threaded scene update.
+    Mutex dirtyNodesMutex_;
+    /// Grid cell size.
+    float cellSize_;
+};
+
+}
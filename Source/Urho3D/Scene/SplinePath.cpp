@@ -33,6 +33,9 @@ namespace Urho3D
 extern const char* interpolationModeNames[];
 extern const char* LOGIC_CATEGORY;
 
+/// Number of spline segments sampled into the arc length table.
+static const unsigned ARC_LENGTH_SEGMENTS = 1000;
+
 static const StringVector controlPointsStructureElementNames =
 {
     "Control Point Count",
@@ -46,6 +49,7 @@ SplinePath::SplinePath(Context* context) :
     elapsedTime_(0.f),
     traveled_(0.f),
     length_(0.f),
+    arcLengthsDirty_(false),
     dirty_(false),
     controlledIdAttr_(0)
 {
@@ -109,7 +113,7 @@ void SplinePath::ApplyAttributes()
         }
     }
 
-    CalculateLength();
+    arcLengthsDirty_ = true;
     dirty_ = false;
 }
 
@@ -119,13 +123,12 @@ void SplinePath::DrawDebugGeometry(DebugRenderer* debug, bool /*depthTest*/)
     {
         if (spline_.GetKnots().Size() > 1)
         {
-            Vector3 a = spline_.GetPoint(0.f).GetVector3();
-            for (auto i = 1; i <= 100; ++i)
-            {
-                Vector3 b = spline_.GetPoint(i / 100.f).GetVector3();
-                debug->AddLine(a, b, Color::GREEN);
-                a = b;
-            }
+            if (arcLengthsDirty_)
+                UpdateArcLengths();
+
+            // Draw every tenth sample of the arc length table
+            for (unsigned i = 10; i < arcLengthPoints_.Size(); i += 10)
+                debug->AddLine(arcLengthPoints_[i - 10], arcLengthPoints_[i], Color::GREEN);
         }
 
         for (Vector<WeakPtr<Node> >::ConstIterator i = controlPoints_.Begin(); i != controlPoints_.End(); ++i)
@@ -148,7 +151,7 @@ void SplinePath::AddControlPoint(Node* point, unsigned index)
     spline_.AddKnot(point->GetWorldPosition(), index);
 
     UpdateNodeIds();
-    CalculateLength();
+    arcLengthsDirty_ = true;
 }
 
 void SplinePath::RemoveControlPoint(Node* point)
@@ -171,7 +174,7 @@ void SplinePath::RemoveControlPoint(Node* point)
     }
 
     UpdateNodeIds();
-    CalculateLength();
+    arcLengthsDirty_ = true;
 }
 
 void SplinePath::ClearControlPoints()
@@ -187,7 +190,7 @@ void SplinePath::ClearControlPoints()
     spline_.Clear();
 
     UpdateNodeIds();
-    CalculateLength();
+    arcLengthsDirty_ = true;
 }
 
 void SplinePath::SetControlledNode(Node* controlled)
@@ -199,7 +202,7 @@ void SplinePath::SetControlledNode(Node* controlled)
 void SplinePath::SetInterpolationMode(InterpolationMode interpolationMode)
 {
     spline_.SetInterpolationMode(interpolationMode);
-    CalculateLength();
+    arcLengthsDirty_ = true;
 }
 
 void SplinePath::SetPosition(float factor)
@@ -214,14 +217,76 @@ void SplinePath::SetPosition(float factor)
     traveled_ = t;
 }
 
+float SplinePath::GetLength() const
+{
+    if (arcLengthsDirty_)
+        UpdateArcLengths();
+
+    return length_;
+}
+
+Vector3 SplinePath::GetPosition() const
+{
+    return GetPointAtDistance(traveled_ * GetLength());
+}
+
 Vector3 SplinePath::GetPoint(float factor) const
 {
     return spline_.GetPoint(factor).GetVector3();
 }
 
+Vector3 SplinePath::GetPointAtDistance(float distance) const
+{
+    if (arcLengthsDirty_)
+        UpdateArcLengths();
+
+    if (arcLengthPoints_.Size() < 2)
+        return arcLengthPoints_.Size() ? arcLengthPoints_[0] : Vector3::ZERO;
+
+    float fraction;
+    unsigned index = FindArcLengthSegment(distance, fraction);
+    return arcLengthPoints_[index].Lerp(arcLengthPoints_[index + 1], fraction);
+}
+
+void SplinePath::GetPointsAtDistances(const PODVector<float>& distances, PODVector<Vector3>& dest) const
+{
+    if (arcLengthsDirty_)
+        UpdateArcLengths();
+
+    dest.Resize(distances.Size());
+
+    if (arcLengthPoints_.Size() < 2)
+    {
+        Vector3 point = arcLengthPoints_.Size() ? arcLengthPoints_[0] : Vector3::ZERO;
+        for (unsigned i = 0; i < dest.Size(); ++i)
+            dest[i] = point;
+        return;
+    }
+
+    for (unsigned i = 0; i < distances.Size(); ++i)
+    {
+        float fraction;
+        unsigned index = FindArcLengthSegment(distances[i], fraction);
+        dest[i] = arcLengthPoints_[index].Lerp(arcLengthPoints_[index + 1], fraction);
+    }
+}
+
+float SplinePath::GetFactorAtDistance(float distance) const
+{
+    if (arcLengthsDirty_)
+        UpdateArcLengths();
+
+    if (arcLengthPoints_.Size() < 2)
+        return 0.f;
+
+    float fraction;
+    unsigned index = FindArcLengthSegment(distance, fraction);
+    return (index + fraction) / ARC_LENGTH_SEGMENTS;
+}
+
 void SplinePath::Move(float timeStep)
 {
-    if (traveled_ >= 1.0f || length_ <= 0.0f || controlledNode_.Null())
+    if (traveled_ >= 1.0f || GetLength() <= 0.0f || controlledNode_.Null())
         return;
 
     elapsedTime_ += timeStep;
@@ -230,7 +295,7 @@ void SplinePath::Move(float timeStep)
     float distanceCovered = elapsedTime_ * speed_;
     traveled_ = distanceCovered / length_;
 
-    controlledNode_->SetWorldPosition(GetPoint(traveled_));
+    controlledNode_->SetWorldPosition(GetPointAtDistance(distanceCovered));
 }
 
 void SplinePath::Reset()
@@ -298,7 +363,7 @@ void SplinePath::OnMarkedDirty(Node* point)
         }
     }
 
-    CalculateLength();
+    arcLengthsDirty_ = true;
 }
 
 void SplinePath::OnNodeSetEnabled(Node* point)
@@ -321,7 +386,7 @@ void SplinePath::OnNodeSetEnabled(Node* point)
         }
     }
 
-    CalculateLength();
+    arcLengthsDirty_ = true;
 }
 
 void SplinePath::UpdateNodeIds()
@@ -338,20 +403,49 @@ void SplinePath::UpdateNodeIds()
     }
 }
 
-void SplinePath::CalculateLength()
+void SplinePath::UpdateArcLengths() const
 {
+    arcLengthsDirty_ = false;
+    arcLengths_.Clear();
+    arcLengthPoints_.Clear();
+
     if (spline_.GetKnots().Size() <= 0)
         return;
 
     length_ = 0.f;
 
-    Vector3 a = spline_.GetKnot(0).GetVector3();
-    for (auto i = 0; i <= 1000; ++i)
+    arcLengths_.Resize(ARC_LENGTH_SEGMENTS + 1);
+    arcLengthPoints_.Resize(ARC_LENGTH_SEGMENTS + 1);
+
+    Vector3 a = spline_.GetPoint(0.f).GetVector3();
+    for (unsigned i = 0; i <= ARC_LENGTH_SEGMENTS; ++i)
     {
-        Vector3 b = spline_.GetPoint(i / 1000.f).GetVector3();
-        length_ += Abs((a - b).Length());
+        Vector3 b = spline_.GetPoint((float)i / ARC_LENGTH_SEGMENTS).GetVector3();
+        length_ += (a - b).Length();
+        arcLengths_[i] = length_;
+        arcLengthPoints_[i] = b;
         a = b;
     }
 }
 
+unsigned SplinePath::FindArcLengthSegment(float distance, float& fraction) const
+{
+    // Binary search for the first sample at or beyond the distance
+    unsigned low = 1;
+    unsigned high = arcLengths_.Size() - 1;
+    while (low < high)
+    {
+        unsigned mid = (low + high) >> 1;
+        if (arcLengths_[mid] < distance)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    unsigned index = low - 1;
+    float segmentLength = arcLengths_[low] - arcLengths_[index];
+    fraction = segmentLength > 0.f ? Clamp((distance - arcLengths_[index]) / segmentLength, 0.f, 1.f) : 0.f;
+    return index;
+}
+
 }
@@ -79,16 +79,22 @@ public:
     float GetSpeed() const { return speed_; }
 
     /// Get the length of SplinePath;
-    float GetLength() const { return length_; }
+    float GetLength() const;
 
     /// Get the parent Node's last position on the spline.
-    Vector3 GetPosition() const { return GetPoint(traveled_); }
+    Vector3 GetPosition() const;
 
     /// Get the controlled Node.
     Node* GetControlledNode() const { return controlledNode_; }
 
     /// Get a point on the SplinePath from 0.f to 1.f where 0 is the start and 1 is the end.
     Vector3 GetPoint(float factor) const;
+    /// Get a point on the SplinePath at a distance from the start. Equal distance steps move at constant speed regardless of Control Point spacing.
+    Vector3 GetPointAtDistance(float distance) const;
+    /// Get points on the SplinePath at distances from the start, for moving many objects along the same path.
+    void GetPointsAtDistances(const PODVector<float>& distances, PODVector<Vector3>& dest) const;
+    /// Get the spline parameter from 0.f to 1.f at a distance from the start.
+    float GetFactorAtDistance(float distance) const;
 
     /// Move the controlled Node to the next position along the SplinePath based off the Speed value.
     void Move(float timeStep);
@@ -119,8 +125,10 @@ protected:
 private:
     /// Update the Node IDs of the Control Points.
     void UpdateNodeIds();
-    /// Calculate the length of the SplinePath. Used for movement calculations.
-    void CalculateLength();
+    /// Sample the spline into the arc length table and calculate the length of the SplinePath. Used for movement calculations.
+    void UpdateArcLengths() const;
+    /// Find the arc length table segment containing a distance and the fraction within it. Requires an up to date table with at least two samples.
+    unsigned FindArcLengthSegment(float distance, float& fraction) const;
 
     /// The Control Points of the Spline.
     Spline spline_;
@@ -131,7 +139,13 @@ private:
     /// The fraction of the SplinePath covered.
     float traveled_;
     /// The length of the SplinePath.
-    float length_;
+    mutable float length_;
+    /// Cumulative distances from the start at uniformly spaced spline parameters.
+    mutable PODVector<float> arcLengths_;
+    /// Spline points at uniformly spaced spline parameters.
+    mutable PODVector<Vector3> arcLengthPoints_;
+    /// Whether the arc length table needs to be rebuilt.
+    mutable bool arcLengthsDirty_;
     /// Whether the Control Point IDs are dirty.
     bool dirty_;
     /// Node to be moved along the SplinePath.
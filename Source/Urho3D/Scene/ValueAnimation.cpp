@@ -55,7 +55,8 @@ ValueAnimation::ValueAnimation(Context* context) :
     interpolatable_(false),
     beginTime_(M_INFINITY),
     endTime_(-M_INFINITY),
-    splineTangentsDirty_(false)
+    splineTangentsDirty_(false),
+    keyCacheDirty_(false)
 {
 }
 
@@ -245,6 +246,7 @@ void ValueAnimation::SetValueType(VariantType valueType)
     eventFrames_.Clear();
     beginTime_ = M_INFINITY;
     endTime_ = -M_INFINITY;
+    keyCacheDirty_ = true;
 }
 
 void ValueAnimation::SetOwner(void* owner)
@@ -263,12 +265,14 @@ void ValueAnimation::SetInterpolationMethod(InterpMethod method)
 
     interpolationMethod_ = method;
     splineTangentsDirty_ = true;
+    keyCacheDirty_ = true;
 }
 
 void ValueAnimation::SetSplineTension(float tension)
 {
     splineTension_ = tension;
     splineTangentsDirty_ = true;
+    keyCacheDirty_ = true;
 }
 
 bool ValueAnimation::SetKeyFrame(float time, const Variant& value)
@@ -302,6 +306,7 @@ bool ValueAnimation::SetKeyFrame(float time, const Variant& value)
     beginTime_ = Min(time, beginTime_);
     endTime_ = Max(time, endTime_);
     splineTangentsDirty_ = true;
+    keyCacheDirty_ = true;
 
     return true;
 }
@@ -340,12 +345,10 @@ bool ValueAnimation::IsValid() const
 
 Variant ValueAnimation::GetAnimationValue(float scaledTime) const
 {
-    unsigned index = 1;
-    for (; index < keyFrames_.Size(); ++index)
-    {
-        if (scaledTime < keyFrames_[index].time_)
-            break;
-    }
+    if (keyCacheDirty_)
+        UpdateKeyCache();
+
+    unsigned index = FindKeyFrameIndex(scaledTime);
 
     if (index >= keyFrames_.Size() || !interpolatable_ || interpolationMethod_ == IM_NONE)
         return keyFrames_[index - 1].value_;
@@ -358,6 +361,116 @@ Variant ValueAnimation::GetAnimationValue(float scaledTime) const
     }
 }
 
+void ValueAnimation::GetAnimationFloats(float scaledTime, float* dest) const
+{
+    if (keyCacheDirty_)
+        UpdateKeyCache();
+
+    unsigned numComponents = GetNumFloatComponents();
+    unsigned index = FindKeyFrameIndex(scaledTime);
+    const float* v1 = &floatKeys_[(index - 1) * numComponents];
+
+    if (index >= keyTimes_.Size() || interpolationMethod_ == IM_NONE)
+    {
+        for (unsigned i = 0; i < numComponents; ++i)
+            dest[i] = v1[i];
+        return;
+    }
+
+    const float* v2 = v1 + numComponents;
+    float t = (scaledTime - keyTimes_[index - 1]) / (keyTimes_[index] - keyTimes_[index - 1]);
+
+    if (interpolationMethod_ == IM_LINEAR)
+    {
+        if (valueType_ == VAR_QUATERNION)
+        {
+            Quaternion value = Quaternion(v1).Slerp(Quaternion(v2), t);
+            const float* data = value.Data();
+            for (unsigned i = 0; i < numComponents; ++i)
+                dest[i] = data[i];
+        }
+        else
+        {
+            float s = 1.0f - t;
+            for (unsigned i = 0; i < numComponents; ++i)
+                dest[i] = v1[i] * s + v2[i] * t;
+        }
+    }
+    else
+    {
+        float tt = t * t;
+        float ttt = t * tt;
+
+        float h1 = 2.0f * ttt - 3.0f * tt + 1.0f;
+        float h2 = -2.0f * ttt + 3.0f * tt;
+        float h3 = ttt - 2.0f * tt + t;
+        float h4 = ttt - tt;
+
+        const float* t1 = &floatTangents_[(index - 1) * numComponents];
+        const float* t2 = t1 + numComponents;
+        for (unsigned i = 0; i < numComponents; ++i)
+            dest[i] = v1[i] * h1 + v2[i] * h2 + t1[i] * h3 + t2[i] * h4;
+    }
+}
+
+Variant ValueAnimation::GetValueFromFloats(const float* data) const
+{
+    switch (valueType_)
+    {
+    case VAR_FLOAT:
+        return data[0];
+
+    case VAR_VECTOR2:
+        return Vector2(data);
+
+    case VAR_VECTOR3:
+        return Vector3(data);
+
+    case VAR_VECTOR4:
+        return Vector4(data);
+
+    case VAR_QUATERNION:
+        return Quaternion(data);
+
+    case VAR_COLOR:
+        return Color(data);
+
+    default:
+        return Variant::EMPTY;
+    }
+}
+
+unsigned ValueAnimation::GetNumFloatComponents() const
+{
+    switch (valueType_)
+    {
+    case VAR_FLOAT:
+        return 1;
+
+    case VAR_VECTOR2:
+        return 2;
+
+    case VAR_VECTOR3:
+        return 3;
+
+    case VAR_VECTOR4:
+    case VAR_QUATERNION:
+    case VAR_COLOR:
+        return 4;
+
+    default:
+        return 0;
+    }
+}
+
+void ValueAnimation::PrepareEvaluation() const
+{
+    if (keyCacheDirty_)
+        UpdateKeyCache();
+    if (splineTangentsDirty_ && interpolationMethod_ == IM_SPLINE)
+        UpdateSplineTangents();
+}
+
 void ValueAnimation::GetEventFrames(float beginTime, float endTime, PODVector<const VAnimEventFrame*>& eventFrames) const
 {
     for (unsigned i = 0; i < eventFrames_.Size(); ++i)
@@ -541,4 +654,102 @@ Variant ValueAnimation::SubstractAndMultiply(const Variant& value1, const Varian
     }
 }
 
+void ValueAnimation::UpdateKeyCache() const
+{
+    unsigned size = keyFrames_.Size();
+    unsigned numComponents = GetNumFloatComponents();
+
+    keyTimes_.Resize(size);
+    floatKeys_.Resize(size * numComponents);
+    floatTangents_.Clear();
+
+    for (unsigned i = 0; i < size; ++i)
+    {
+        const VAnimKeyFrame& keyFrame = keyFrames_[i];
+        keyTimes_[i] = keyFrame.time_;
+
+        const float* data = nullptr;
+        switch (valueType_)
+        {
+        case VAR_FLOAT:
+            floatKeys_[i] = keyFrame.value_.GetFloat();
+            break;
+
+        case VAR_VECTOR2:
+            data = keyFrame.value_.GetVector2().Data();
+            break;
+
+        case VAR_VECTOR3:
+            data = keyFrame.value_.GetVector3().Data();
+            break;
+
+        case VAR_VECTOR4:
+            data = keyFrame.value_.GetVector4().Data();
+            break;
+
+        case VAR_QUATERNION:
+            data = keyFrame.value_.GetQuaternion().Data();
+            break;
+
+        case VAR_COLOR:
+            data = keyFrame.value_.GetColor().Data();
+            break;
+
+        default:
+            break;
+        }
+
+        if (data)
+        {
+            for (unsigned j = 0; j < numComponents; ++j)
+                floatKeys_[i * numComponents + j] = data[j];
+        }
+    }
+
+    // Calculate spline tangents the same way as UpdateSplineTangents()
+    if (numComponents && interpolationMethod_ == IM_SPLINE && size > 2)
+    {
+        floatTangents_.Resize(size * numComponents);
+
+        const float* first = &floatKeys_[0];
+        const float* last = &floatKeys_[(size - 1) * numComponents];
+        bool closed = true;
+        for (unsigned j = 0; j < numComponents; ++j)
+        {
+            if (first[j] != last[j])
+                closed = false;
+        }
+
+        for (unsigned j = 0; j < numComponents; ++j)
+        {
+            for (unsigned i = 1; i < size - 1; ++i)
+                floatTangents_[i * numComponents + j] =
+                    (floatKeys_[(i + 1) * numComponents + j] - floatKeys_[(i - 1) * numComponents + j]) * splineTension_;
+
+            // If spline is not closed, make end point's tangent zero
+            float endTangent = closed ? (floatKeys_[numComponents + j] - floatKeys_[(size - 2) * numComponents + j]) *
+                splineTension_ : 0.0f;
+            floatTangents_[j] = floatTangents_[(size - 1) * numComponents + j] = endTangent;
+        }
+    }
+
+    keyCacheDirty_ = false;
+}
+
+unsigned ValueAnimation::FindKeyFrameIndex(float scaledTime) const
+{
+    unsigned low = 1;
+    unsigned high = keyTimes_.Size();
+    while (low < high)
+    {
+        unsigned mid = (low + high) >> 1;
+        if (scaledTime < keyTimes_[mid])
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    return low;
+}
+
 }
@@ -125,6 +125,14 @@ public:
 
     /// Return animation value.
     Variant GetAnimationValue(float scaledTime) const;
+    /// Return animation value as float components into the destination. Only valid for value types with nonzero GetNumFloatComponents() and at least one key frame.
+    void GetAnimationFloats(float scaledTime, float* dest) const;
+    /// Return value constructed from float components.
+    Variant GetValueFromFloats(const float* data) const;
+    /// Return number of float components of the value type, or 0 if the value type can not be evaluated as floats.
+    unsigned GetNumFloatComponents() const;
+    /// Update key caches if necessary. Must be called from the main thread before evaluating from worker threads.
+    void PrepareEvaluation() const;
 
     /// Return all key frames.
     const Vector<VAnimKeyFrame>& GetKeyFrames() const { return keyFrames_; }
@@ -144,6 +152,10 @@ protected:
     void UpdateSplineTangents() const;
     /// Return (value1 - value2) * t.
     Variant SubstractAndMultiply(const Variant& value1, const Variant& value2, float t) const;
+    /// Update contiguous key times, float key values and float spline tangents.
+    void UpdateKeyCache() const;
+    /// Return index of the first key frame after the time, starting from the second key frame.
+    unsigned FindKeyFrameIndex(float scaledTime) const;
 
     /// Owner.
     void* owner_;
@@ -165,6 +177,14 @@ protected:
     mutable VariantVector splineTangents_;
     /// Spline tangents dirty.
     mutable bool splineTangentsDirty_;
+    /// Key frame times.
+    mutable PODVector<float> keyTimes_;
+    /// Key frame values as float components.
+    mutable PODVector<float> floatKeys_;
+    /// Spline tangents as float components.
+    mutable PODVector<float> floatTangents_;
+    /// Key caches dirty.
+    mutable bool keyCacheDirty_;
     /// Event frames.
     Vector<VAnimEventFrame> eventFrames_;
 };
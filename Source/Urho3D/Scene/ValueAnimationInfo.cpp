@@ -88,7 +88,21 @@ bool ValueAnimationInfo::SetTime(float time)
     float scaledTime = CalculateScaledTime(currentTime_, finished);
 
     // Apply to the target object
-    ApplyValue(animation_->GetAnimationValue(scaledTime));
+    return Apply(animation_->GetAnimationValue(scaledTime), scaledTime, finished);
+}
+
+float ValueAnimationInfo::Evaluate(float timeStep, float* dest, bool& finished)
+{
+    currentTime_ += timeStep * speed_;
+
+    float scaledTime = CalculateScaledTime(currentTime_, finished);
+    animation_->GetAnimationFloats(scaledTime, dest);
+    return scaledTime;
+}
+
+bool ValueAnimationInfo::Apply(const Variant& value, float scaledTime, bool finished)
+{
+    ApplyValue(value);
 
     // Send keyframe event if necessary
     if (animation_->HasEventFrames())
@@ -52,6 +52,10 @@ public:
     bool Update(float timeStep);
     /// Set time position and apply. Return true when the animation is finished. No-op when the target object is not defined.
     bool SetTime(float time);
+    /// Advance time position and evaluate the animation as float components without applying. Does not access the target object, so may be called from worker threads after ValueAnimation::PrepareEvaluation(). Return scaled time.
+    float Evaluate(float timeStep, float* dest, bool& finished);
+    /// Apply a value evaluated at the scaled time and send event frames. Return true when the animation is finished.
+    bool Apply(const Variant& value, float scaledTime, bool finished);
 
     /// Set wrap mode.
     void SetWrapMode(WrapMode wrapMode) { wrapMode_ = wrapMode; }
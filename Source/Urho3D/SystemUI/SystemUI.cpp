@@ -232,7 +232,7 @@ void SystemUI::OnRenderDrawLists(ImDrawData* data)
         if (cmdList->IdxBuffer.Size > indexBuffer_.GetIndexCount())
             indexBuffer_.SetSize((unsigned int)(cmdList->IdxBuffer.Size * 2), false, true);
 
-#if (defined(_WIN32) && !defined(URHO3D_D3D11) && !defined(URHO3D_OPENGL)) || defined(URHO3D_D3D9)
+#if (defined(_WIN32) && !defined(URHO3D_D3D11) && !defined(URHO3D_OPENGL) && !defined(URHO3D_NULL_GRAPHICS)) || defined(URHO3D_D3D9)
         for (int i = 0; i < cmdList->VtxBuffer.Size; i++)
         {
             ImDrawVert& v = cmdList->VtxBuffer.Data[i];
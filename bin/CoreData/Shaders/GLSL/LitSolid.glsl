@@ -3,6 +3,7 @@
 #include "Transform.glsl"
 #include "ScreenPos.glsl"
 #include "Lighting.glsl"
+#include "ClusteredLighting.glsl"
 #include "Fog.glsl"
 
 #ifdef NORMALMAP
@@ -33,6 +34,9 @@ varying vec4 vWorldPos;
 #else
     varying vec3 vVertexLight;
     varying vec4 vScreenPos;
+    #ifdef CLUSTERED
+        varying vec3 vClusterPos;
+    #endif
     #ifdef ENVCUBEMAP
         varying vec3 vReflectionVec;
     #endif
@@ -98,6 +102,10 @@ void VS()
         
         vScreenPos = GetScreenPos(gl_Position);
 
+        #ifdef CLUSTERED
+            vClusterPos = gl_Position.xyw;
+        #endif
+
         #ifdef ENVCUBEMAP
             vReflectionVec = worldPos - cCameraPos;
         #endif
@@ -228,6 +236,11 @@ void PS()
             finalColor += lightInput.rgb * diffColor.rgb + lightSpecColor * specColor;
         #endif
 
+        #ifdef CLUSTERED
+            // Add unshadowed point and spot lights assigned to the pixel's light cluster
+            finalColor += GetClusteredLighting(vClusterPos, vWorldPos, normal, diffColor.rgb, specColor, cMatSpecColor.a);
+        #endif
+
         #ifdef ENVCUBEMAP
             finalColor += cMatEnvMapColor * textureCube(sEnvCubeMap, reflect(vReflectionVec, normal)).rgb;
         #endif
@@ -54,6 +54,7 @@ uniform mat4 cZone;
 
 uniform vec4 cAmbientColor;
 uniform vec3 cCameraPosPS;
+uniform vec4 cClusterParams;
 uniform float cDeltaTimePS;
 uniform vec4 cDepthReconstruct;
 uniform float cElapsedTimePS;
@@ -171,6 +172,7 @@ uniform CameraPS
     vec2 cGBufferInvSize;
     float cNearClipPS;
     float cFarClipPS;
+    vec4 cClusterParams;
 };
 
 uniform ZonePS
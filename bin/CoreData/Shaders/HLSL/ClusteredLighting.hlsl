@@ -0,0 +1,80 @@
+#ifdef COMPILEPS
+#ifdef CLUSTERED
+// Clustered forward lighting. The cluster texture holds the light index offset and count of each cluster, followed by the
+// light indices four per texel. The light texture holds four texels per light: position and inverse range, color and
+// specular intensity, direction and spot cutoff, inverse spot cutoff
+
+// These must match the constants in LightClusters.h: the cluster loop reads MAX_LIGHTS_PER_CLUSTER light indices four at a
+// time, and the light texture is MAX_CLUSTERED_LIGHTS texels high. The cluster grid is 16x8x24 and the cluster texture
+// 1024 texels wide
+#define MAX_LIGHTS_PER_CLUSTER 64
+#define MAX_CLUSTERED_LIGHTS 256
+
+float4 GetClusterTexel(float index)
+{
+    float row = floor(index / 1024.0);
+    return Sample2DLod0(LightRampMap, float2((index - row * 1024.0 + 0.5) / 1024.0, (row + 0.5) * cClusterParams.z));
+}
+
+float4 GetClusterLightTexel(float light, float texel)
+{
+    return Sample2DLod0(LightSpotMap, float2((texel + 0.5) / 4.0, (light + 0.5) / (float)MAX_CLUSTERED_LIGHTS));
+}
+
+float3 GetClusterLight(float light, float3 worldPos, float3 normal, float3 eyeVec, float3 diffColor, float3 specColor, float specPower)
+{
+    float4 lightPos = GetClusterLightTexel(light, 0.0);
+    float4 lightColor = GetClusterLightTexel(light, 1.0);
+    float4 lightDir = GetClusterLightTexel(light, 2.0);
+    float invCutoff = GetClusterLightTexel(light, 3.0).x;
+
+    // Same attenuation as per-vertex point and spot lights
+    float3 lightVec = (lightPos.xyz - worldPos) * lightPos.w;
+    float lightDist = length(lightVec);
+    float3 localDir = lightVec / max(lightDist, 0.0001);
+    #ifdef TRANSLUCENT
+        float NdotL = abs(dot(normal, localDir));
+    #else
+        float NdotL = max(dot(normal, localDir), 0.0);
+    #endif
+    float atten = saturate(1.0 - lightDist * lightDist);
+    float spotAtten = saturate((dot(localDir, lightDir.xyz) - lightDir.w) * invCutoff);
+    float diff = NdotL * atten * spotAtten;
+
+    #ifdef SPECULAR
+        float spec = GetSpecular(normal, eyeVec, localDir, specPower);
+        return diff * lightColor.rgb * (diffColor + spec * specColor * lightColor.a);
+    #else
+        return diff * lightColor.rgb * diffColor;
+    #endif
+}
+
+float3 GetClusteredLighting(float3 clusterPos, float4 worldPos, float3 normal, float3 diffColor, float3 specColor, float specPower)
+{
+    // Screen tile from the clip position, depth slice from the normalized depth
+    float2 tile = clamp(floor((clusterPos.xy / clusterPos.z * 0.5 + 0.5) * float2(16.0, 8.0)), float2(0.0, 0.0), float2(15.0, 7.0));
+    float slice = clamp(floor(log(max(worldPos.w, 0.000001)) * cClusterParams.x + cClusterParams.y), 0.0, 23.0);
+    float4 cluster = GetClusterTexel((slice * 8.0 + tile.y) * 16.0 + tile.x);
+
+    float3 eyeVec = cCameraPosPS - worldPos.xyz;
+    float3 lighting = 0.0;
+    for (int i = 0; i < MAX_LIGHTS_PER_CLUSTER / 4; ++i)
+    {
+        float first = (float)i * 4.0;
+        if (first >= cluster.y)
+            break;
+
+        float4 lights = GetClusterTexel(cluster.x + (float)i);
+        lighting += GetClusterLight(lights.x, worldPos.xyz, normal, eyeVec, diffColor, specColor, specPower);
+        if (first + 1.0 < cluster.y)
+            lighting += GetClusterLight(lights.y, worldPos.xyz, normal, eyeVec, diffColor, specColor, specPower);
+        if (first + 2.0 < cluster.y)
+            lighting += GetClusterLight(lights.z, worldPos.xyz, normal, eyeVec, diffColor, specColor, specPower);
+        if (first + 3.0 < cluster.y)
+            lighting += GetClusterLight(lights.w, worldPos.xyz, normal, eyeVec, diffColor, specColor, specPower);
+    }
+
+    return lighting;
+}
+#endif
+#endif
@@ -3,6 +3,7 @@
 #include "Transform.hlsl"
 #include "ScreenPos.hlsl"
 #include "Lighting.hlsl"
+#include "ClusteredLighting.hlsl"
 #include "Fog.hlsl"
 
 void VS(float4 iPos : POSITION,
@@ -58,6 +59,9 @@ void VS(float4 iPos : POSITION,
         #if defined(LIGHTMAP) || defined(AO)
             out float2 oTexCoord2 : TEXCOORD7,
         #endif
+        #ifdef CLUSTERED
+            out float3 oClusterPos : TEXCOORD8,
+        #endif
     #endif
     #ifdef VERTEXCOLOR
         out float4 oColor : COLOR0,
@@ -130,6 +134,10 @@ void VS(float4 iPos : POSITION,
         
         oScreenPos = GetScreenPos(oPos);
 
+        #ifdef CLUSTERED
+            oClusterPos = oPos.xyw;
+        #endif
+
         #ifdef ENVCUBEMAP
             oReflectionVec = worldPos - cCameraPos;
         #endif
@@ -164,6 +172,9 @@ void PS(
         #if defined(LIGHTMAP) || defined(AO)
             float2 iTexCoord2 : TEXCOORD7,
         #endif
+        #ifdef CLUSTERED
+            float3 iClusterPos : TEXCOORD8,
+        #endif
     #endif
     #ifdef VERTEXCOLOR
         float4 iColor : COLOR0,
@@ -302,6 +313,11 @@ void PS(
             finalColor += lightInput.rgb * diffColor.rgb + lightSpecColor * specColor;
         #endif
 
+        #ifdef CLUSTERED
+            // Add unshadowed point and spot lights assigned to the pixel's light cluster
+            finalColor += GetClusteredLighting(iClusterPos, iWorldPos, normal, diffColor.rgb, specColor, cMatSpecColor.a);
+        #endif
+
         #ifdef ENVCUBEMAP
             finalColor += cMatEnvMapColor * SampleCube(EnvCubeMap, reflect(iReflectionVec, normal)).rgb;
         #endif
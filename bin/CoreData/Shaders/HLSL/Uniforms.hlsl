@@ -43,6 +43,7 @@ uniform float4x3 cZone;
 // Pixel shader uniforms
 uniform float4 cAmbientColor;
 uniform float3 cCameraPosPS;
+uniform float4 cClusterParams;
 uniform float cDeltaTimePS;
 uniform float4 cDepthReconstruct;
 uniform float cElapsedTimePS;
@@ -160,6 +161,7 @@ cbuffer CameraPS : register(b1)
     float2 cGBufferInvSize;
     float cNearClipPS;
     float cFarClipPS;
+    float4 cClusterParams;
 }
 
 cbuffer ZonePS : register(b2)